@@ -211,6 +211,7 @@
 %token KW_BATCH_LINES                 10087
 %token KW_BATCH_TIMEOUT               10088
 %token KW_TRIM_LARGE_MESSAGES         10089
+%token KW_BATCH_WRITES                10096
 %token KW_STATS                       10400
 %token KW_FREQ                        10401
 %token KW_LEVEL                       10402
@@ -219,6 +220,7 @@
 %token KW_SYSLOG_STATS                10405
 %token KW_HEALTHCHECK_FREQ            10406
 %token KW_WORKER_PARTITION_KEY        10407
+%token KW_SHARDED_COUNTERS            10408
 
 %token KW_CHAIN_HOSTNAMES             10090
 %token KW_NORMALIZE_HOSTNAMES         10091
@@ -249,6 +251,7 @@
 %token KW_FRAC_DIGITS                 10152
 
 %token KW_LOG_FIFO_SIZE               10160
+%token KW_LOG_FIFO_LOCKLESS           10161
 %token KW_LOG_FETCH_LIMIT             10162
 %token KW_LOG_IW_SIZE                 10163
 %token KW_LOG_PREFIX                  10164
@@ -290,6 +293,7 @@
 %token KW_PARTITIONS                  10213
 %token KW_PARTITION_KEY               10214
 %token KW_PARALLELIZE                 10215
+%token KW_WORK_STEALING               10216
 
 /* destination options */
 %token KW_TMPL_ESCAPE                 10220
@@ -311,6 +315,7 @@
 %token KW_TEMPLATE                    10270
 %token KW_TEMPLATE_ESCAPE             10271
 %token KW_TEMPLATE_FUNCTION           10272
+%token KW_TEMPLATE_CACHE              10273
 
 %token KW_DEFAULT_FACILITY            10300
 %token KW_DEFAULT_SEVERITY            10301
@@ -770,6 +775,10 @@ log_scheduler_option
           {
             log_scheduler_options_set_partition_key_ref(last_scheduler_options, $3);
           }
+        | KW_WORK_STEALING '(' yesno ')'
+          {
+            last_scheduler_options->work_stealing = $3;
+          }
         ;
 
 
@@ -895,7 +904,14 @@ template_block
 	  <ptr>{
 	    $$ = log_template_new(configuration, $2);
 	  }
-	  '{' { $<ptr>$ = $3; } template_items '}'				{ $$ = $3; free($2); }
+	  '{' { $<ptr>$ = $3; } template_items '}'
+	  {
+	    GError *error = NULL;
+
+	    CHECK_ERROR_GERROR(log_template_validate_cache($3, &error), @2, error, "Error in template %s", $2);
+	    $$ = $3;
+	    free($2);
+	  }
         ;
 
 template_simple
@@ -922,6 +938,7 @@ template_items
 template_item
 	: KW_TEMPLATE '(' { $<ptr>$ = $<ptr>0; } template_content_inner ')'
 	| KW_TEMPLATE_ESCAPE '(' yesno ')'	{ log_template_set_escape($<ptr>0, $3); }
+	| KW_TEMPLATE_CACHE '(' yesno ')'	{ log_template_set_cache($<ptr>0, $3); }
 	;
 
 /* START_RULES */
@@ -1061,6 +1078,7 @@ options_item
 	| KW_USE_RCPTID '(' yesno ')'		{ cfg_set_use_uniqid($3); }
 	| KW_USE_UNIQID '(' yesno ')'		{ cfg_set_use_uniqid($3); }
 	| KW_LOG_FIFO_SIZE '(' positive_integer ')'	{ configuration->log_fifo_size = $3; }
+	| KW_LOG_FIFO_LOCKLESS '(' yesno ')'	{ configuration->log_fifo_lockless = $3; }
 	| KW_LOG_IW_SIZE '(' positive_integer ')'	{ msg_warning("WARNING: Support for the global log-iw-size() option was removed, please use a per-source log-iw-size()", cfg_lexer_format_location_tag(lexer, &@1)); }
 	| KW_LOG_FETCH_LIMIT '(' positive_integer ')'	{ msg_warning("WARNING: Support for the global log-fetch-limit() option was removed, please use a per-source log-fetch-limit()", cfg_lexer_format_location_tag(lexer, &@1)); }
 	| KW_LOG_MSG_SIZE '(' positive_integer ')'	{ configuration->log_msg_size = $3; }
@@ -1110,6 +1128,7 @@ stats_group_option
 	| KW_LIFETIME '(' positive_integer ')'      { last_stats_options->lifetime = $3; }
 	| KW_MAX_DYNAMIC '(' nonnegative_integer ')'   { last_stats_options->max_dynamic = $3; }
 	| KW_SYSLOG_STATS '(' yesnoauto ')'     { last_stats_options->syslog_stats = $3; }
+	| KW_SHARDED_COUNTERS '(' yesno ')'     { last_stats_options->sharded_counters = $3; }
 	| KW_HEALTHCHECK_FREQ '(' nonnegative_integer ')' { last_healthcheck_options->freq = $3; }
 	;
 
@@ -1347,6 +1366,7 @@ dest_driver_option
         /* NOTE: plugins need to set "last_driver" in order to incorporate this rule in their grammar */
 
 	: KW_LOG_FIFO_SIZE '(' positive_integer ')'	{ ((LogDestDriver *) last_driver)->log_fifo_size = $3; }
+	| KW_LOG_FIFO_LOCKLESS '(' yesno ')'	{ ((LogDestDriver *) last_driver)->log_fifo_lockless = $3; }
 	| KW_THROTTLE '(' nonnegative_integer ')'         { ((LogDestDriver *) last_driver)->throttle = $3; }
         | inner_dest
         | driver_option
@@ -1499,6 +1519,7 @@ dest_writer_options
 dest_writer_option
         : KW_FLAGS '(' dest_writer_options_flags ')'
 	| KW_FLUSH_LINES '(' nonnegative_integer ')'		{ last_writer_options->flush_lines = $3; }
+	| KW_BATCH_WRITES '(' yesno ')'		{ last_writer_options->batch_writes = $3; }
 	| KW_FLUSH_TIMEOUT '(' positive_integer ')'	{ }
         | KW_SUPPRESS '(' nonnegative_integer ')'            { last_writer_options->suppress = $3; }
 	| KW_TEMPLATE '(' template_name_or_content ')'       { last_writer_options->template = $3; }
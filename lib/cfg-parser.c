@@ -104,9 +104,11 @@ static CfgLexerKeyword main_keywords[] =
   { "lifetime",           KW_LIFETIME },
   { "max_dynamics",       KW_MAX_DYNAMIC },
   { "syslog_stats",       KW_SYSLOG_STATS },
+  { "sharded_counters",   KW_SHARDED_COUNTERS },
   { "healthcheck_freq",   KW_HEALTHCHECK_FREQ},
   { "min_iw_size_per_reader", KW_MIN_IW_SIZE_PER_READER },
   { "flush_lines",        KW_FLUSH_LINES },
+  { "batch_writes",       KW_BATCH_WRITES },
   { "flush_timeout",      KW_FLUSH_TIMEOUT, KWS_OBSOLETE, "Some drivers support batch-timeout() instead that you can specify at the destination level." },
   { "suppress",           KW_SUPPRESS },
   { "sync_freq",          KW_FLUSH_LINES, KWS_OBSOLETE, "flush_lines" },
@@ -146,6 +148,7 @@ static CfgLexerKeyword main_keywords[] =
   { "log_level",          KW_LOG_LEVEL },
 
   { "log_fifo_size",      KW_LOG_FIFO_SIZE },
+  { "log_fifo_lockless",  KW_LOG_FIFO_LOCKLESS },
   { "log_fetch_limit",    KW_LOG_FETCH_LIMIT },
   { "log_iw_size",        KW_LOG_IW_SIZE },
   { "log_msg_size",       KW_LOG_MSG_SIZE },
@@ -167,6 +170,7 @@ static CfgLexerKeyword main_keywords[] =
   { "template",           KW_TEMPLATE },
   { "template_escape",    KW_TEMPLATE_ESCAPE },
   { "template_function",  KW_TEMPLATE_FUNCTION },
+  { "template_cache",     KW_TEMPLATE_CACHE },
   { "on_error",           KW_ON_ERROR },
   { "persist_only",       KW_PERSIST_ONLY },
   { "dns_cache_hosts",    KW_DNS_CACHE_HOSTS },
@@ -200,6 +204,7 @@ static CfgLexerKeyword main_keywords[] =
   { "parallelize",        KW_PARALLELIZE },
   { "partitions",         KW_PARTITIONS },
   { "partition_key",      KW_PARTITION_KEY },
+  { "work_stealing",      KW_WORK_STEALING },
 
   /* filter items */
   { "type",               KW_TYPE },
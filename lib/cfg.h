@@ -94,6 +94,7 @@ struct _GlobalConfig
   gint type_cast_strictness;
 
   gint log_fifo_size;
+  gboolean log_fifo_lockless;
   gint log_msg_size;
   gboolean trim_large_messages;
   gint log_level;
@@ -264,6 +264,8 @@ _create_memory_queue(LogDestDriver *self, const gchar *persist_name, gint stats_
   GlobalConfig *cfg = log_pipe_get_config(&self->super.super);
 
   gint log_fifo_size = self->log_fifo_size < 0 ? cfg->log_fifo_size : self->log_fifo_size;
+  gboolean log_fifo_lockless = self->log_fifo_lockless < 0 ? cfg->log_fifo_lockless : self->log_fifo_lockless;
+  LogQueue *queue;
 
   if (cfg_is_config_version_older(cfg, VERSION_VALUE_3_22))
     {
@@ -273,10 +275,18 @@ _create_memory_queue(LogDestDriver *self, const gchar *persist_name, gint stats_
                        "flags(flow-control) option set.) To enable the new behaviour, update the @version string in "
                        "your configuration and consider lowering the value of log-fifo-size().");
 
-      return log_queue_fifo_legacy_new(log_fifo_size, persist_name, stats_level, driver_sck_builder, queue_sck_builder);
+      queue = log_queue_fifo_legacy_new(log_fifo_size, persist_name, stats_level,
+                                        driver_sck_builder, queue_sck_builder);
+    }
+  else
+    {
+      queue = log_queue_fifo_new(log_fifo_size, persist_name, stats_level, driver_sck_builder, queue_sck_builder);
     }
 
-  return log_queue_fifo_new(log_fifo_size, persist_name, stats_level, driver_sck_builder, queue_sck_builder);
+  if (log_fifo_lockless)
+    log_queue_fifo_set_lockless(queue);
+
+  return queue;
 }
 
 /* returns a reference */
@@ -424,6 +434,7 @@ log_dest_driver_init_instance(LogDestDriver *self, GlobalConfig *cfg)
   self->acquire_queue = log_dest_driver_acquire_memory_queue;
   self->release_queue = log_dest_driver_release_queue_method;
   self->log_fifo_size = -1;
+  self->log_fifo_lockless = -1;
   self->throttle = 0;
 }
 
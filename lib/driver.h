@@ -168,6 +168,7 @@ struct _LogDestDriver
   GList *queues;
 
   gint log_fifo_size;
+  gint log_fifo_lockless;
   gint throttle;
   StatsCounterItem *queued_global_messages;
 };
@@ -0,0 +1,310 @@
+/*
+ * Copyright (c) 2024 Balabit
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+ *
+ * As an additional exemption you are allowed to compile & link against the
+ * OpenSSL libraries as published by the OpenSSL project. See the file
+ * COPYING for details.
+ *
+ */
+
+
+#include "filter-contains-any.h"
+#include "logmsg/logmsg.h"
+
+#include <errno.h>
+#include <stdio.h>
+#include <string.h>
+
+/*
+ * The automaton is built as a trie with first-child/next-sibling links
+ * (children kept sorted by byte), failure links are computed breadth
+ * first and finally the trie is packed into arrays in BFS order: every
+ * state has its outgoing edges stored contiguously, sorted, so a
+ * transition is a binary search over a few bytes.  The root has a dense
+ * transition table as that is where most of the failure chains end.
+ *
+ * As we are only interested in whether any of the literals occurs, the
+ * "match" bit is propagated along failure links and the scan stops at the
+ * first state having it set.
+ */
+
+typedef struct _ContainsAnyBuildNode
+{
+  guint32 first_child;
+  guint32 next_sibling;
+  guint32 fail;
+  guint8 byte;
+  guint8 match;
+} ContainsAnyBuildNode;
+
+typedef struct _ContainsAnyState
+{
+  guint32 first_edge;
+  guint32 fail;
+  guint16 num_edges;
+  guint8 match;
+} ContainsAnyState;
+
+typedef struct _FilterContainsAny
+{
+  FilterExprNode super;
+  NVHandle value_handle;
+  guint32 root_transitions[256];
+  ContainsAnyState *states;
+  guint8 *edge_bytes;
+  guint32 *edge_targets;
+} FilterContainsAny;
+
+#define BUILD_NODE(nodes, ndx) g_array_index(nodes, ContainsAnyBuildNode, ndx)
+
+static void
+_trie_insert(GArray *nodes, const gchar *literal, gsize len)
+{
+  guint32 node = 0;
+
+  for (gsize i = 0; i < len; i++)
+    {
+      guint8 c = (guint8) literal[i];
+      guint32 prev = 0;
+      guint32 child = BUILD_NODE(nodes, node).first_child;
+
+      while (child && BUILD_NODE(nodes, child).byte < c)
+        {
+          prev = child;
+          child = BUILD_NODE(nodes, child).next_sibling;
+        }
+
+      if (!child || BUILD_NODE(nodes, child).byte != c)
+        {
+          ContainsAnyBuildNode new_node = { .next_sibling = child, .byte = c };
+
+          g_array_append_val(nodes, new_node);
+          child = nodes->len - 1;
+          if (prev)
+            BUILD_NODE(nodes, prev).next_sibling = child;
+          else
+            BUILD_NODE(nodes, node).first_child = child;
+        }
+      node = child;
+    }
+  BUILD_NODE(nodes, node).match = TRUE;
+}
+
+static guint32
+_trie_find_child(GArray *nodes, guint32 node, guint8 c)
+{
+  guint32 child;
+
+  for (child = BUILD_NODE(nodes, node).first_child;
+       child && BUILD_NODE(nodes, child).byte < c;
+       child = BUILD_NODE(nodes, child).next_sibling)
+    ;
+  return (child && BUILD_NODE(nodes, child).byte == c) ? child : 0;
+}
+
+/* returns the nodes in BFS order, with the failure links filled in */
+static GArray *
+_trie_link_failures(GArray *nodes)
+{
+  GArray *order = g_array_sized_new(FALSE, FALSE, sizeof(guint32), nodes->len);
+  guint32 root = 0;
+
+  g_array_append_val(order, root);
+  for (guint32 k = 0; k < order->len; k++)
+    {
+      guint32 node = g_array_index(order, guint32, k);
+
+      for (guint32 child = BUILD_NODE(nodes, node).first_child; child; child = BUILD_NODE(nodes, child).next_sibling)
+        {
+          guint8 c = BUILD_NODE(nodes, child).byte;
+          guint32 fail = 0;
+
+          if (node != 0)
+            {
+              guint32 f = BUILD_NODE(nodes, node).fail;
+
+              while (f && !_trie_find_child(nodes, f, c))
+                f = BUILD_NODE(nodes, f).fail;
+              fail = _trie_find_child(nodes, f, c);
+            }
+          BUILD_NODE(nodes, child).fail = fail;
+          BUILD_NODE(nodes, child).match |= BUILD_NODE(nodes, fail).match;
+          g_array_append_val(order, child);
+        }
+    }
+  return order;
+}
+
+static void
+_compile(FilterContainsAny *self, GArray *nodes)
+{
+  GArray *order = _trie_link_failures(nodes);
+  guint32 *renumbered = g_new(guint32, nodes->len);
+  guint32 num_edges = 0;
+
+  for (guint32 k = 0; k < order->len; k++)
+    renumbered[g_array_index(order, guint32, k)] = k;
+
+  self->states = g_new0(ContainsAnyState, nodes->len);
+  self->edge_bytes = g_new(guint8, nodes->len);
+  self->edge_targets = g_new(guint32, nodes->len);
+
+  for (guint32 k = 0; k < order->len; k++)
+    {
+      ContainsAnyBuildNode *node = &BUILD_NODE(nodes, g_array_index(order, guint32, k));
+      ContainsAnyState *state = &self->states[k];
+
+      state->first_edge = num_edges;
+      state->fail = renumbered[node->fail];
+      state->match = node->match;
+      for (guint32 child = node->first_child; child; child = BUILD_NODE(nodes, child).next_sibling)
+        {
+          self->edge_bytes[num_edges] = BUILD_NODE(nodes, child).byte;
+          self->edge_targets[num_edges] = renumbered[child];
+          num_edges++;
+          state->num_edges++;
+        }
+    }
+
+  for (guint32 e = 0; e < self->states[0].num_edges; e++)
+    self->root_transitions[self->edge_bytes[e]] = self->edge_targets[e];
+
+  g_free(renumbered);
+  g_array_free(order, TRUE);
+}
+
+static inline guint32
+_find_transition(FilterContainsAny *self, const ContainsAnyState *state, guint8 c)
+{
+  const guint8 *bytes = &self->edge_bytes[state->first_edge];
+  guint32 lo = 0, hi = state->num_edges;
+
+  while (lo < hi)
+    {
+      guint32 mid = (lo + hi) / 2;
+
+      if (bytes[mid] < c)
+        lo = mid + 1;
+      else
+        hi = mid;
+    }
+  if (lo < state->num_edges && bytes[lo] == c)
+    return self->edge_targets[state->first_edge + lo];
+  return 0;
+}
+
+static gboolean
+_scan(FilterContainsAny *self, const gchar *value, gssize len)
+{
+  guint32 state = 0;
+
+  for (gssize i = 0; i < len; i++)
+    {
+      guint8 c = (guint8) value[i];
+
+      for (;;)
+        {
+          if (state == 0)
+            {
+              state = self->root_transitions[c];
+              break;
+            }
+
+          guint32 next = _find_transition(self, &self->states[state], c);
+          if (next)
+            {
+              state = next;
+              break;
+            }
+          state = self->states[state].fail;
+        }
+
+      if (self->states[state].match)
+        return TRUE;
+    }
+  return FALSE;
+}
+
+static gboolean
+filter_contains_any_eval(FilterExprNode *s, LogMessage **msgs, gint num_msg, LogTemplateEvalOptions *options)
+{
+  FilterContainsAny *self = (FilterContainsAny *) s;
+  LogMessage *msg = msgs[num_msg - 1];
+  const gchar *value;
+  gssize len = 0;
+
+  value = log_msg_get_value(msg, self->value_handle, &len);
+
+  gboolean result = _scan(self, value, len);
+  msg_trace("contains-any() evaluation started",
+            evt_tag_mem("value", value, len),
+            evt_tag_msg_reference(msg));
+
+  return result ^ s->comp;
+}
+
+static void
+filter_contains_any_free(FilterExprNode *s)
+{
+  FilterContainsAny *self = (FilterContainsAny *) s;
+
+  g_free(self->states);
+  g_free(self->edge_bytes);
+  g_free(self->edge_targets);
+}
+
+FilterExprNode *
+filter_contains_any_new(const gchar *list_file, const gchar *property)
+{
+  FilterContainsAny *self;
+  ContainsAnyBuildNode root = { 0 };
+  GArray *nodes;
+  FILE *stream;
+  gchar line[16384];
+
+  stream = fopen(list_file, "r");
+  if (!stream)
+    {
+      msg_error("Error opening contains-any filter list file",
+                evt_tag_str("file", list_file),
+                evt_tag_error("errno"));
+      return NULL;
+    }
+
+  nodes = g_array_new(FALSE, FALSE, sizeof(ContainsAnyBuildNode));
+  g_array_append_val(nodes, root);
+  while (fgets(line, sizeof(line), stream) != NULL)
+    {
+      gsize len = strlen(line);
+
+      if (len > 0 && line[len - 1] == '\n')
+        len--;
+      if (len > 0)
+        _trie_insert(nodes, line, len);
+    }
+  fclose(stream);
+
+  self = g_new0(FilterContainsAny, 1);
+  filter_expr_node_init_instance(&self->super);
+  self->value_handle = log_msg_get_value_handle(property);
+  _compile(self, nodes);
+  g_array_free(nodes, TRUE);
+
+  self->super.eval = filter_contains_any_eval;
+  self->super.free_fn = filter_contains_any_free;
+  return &self->super;
+}
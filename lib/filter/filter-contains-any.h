@@ -0,0 +1,38 @@
+/*
+ * Copyright (c) 2024 Balabit
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+ *
+ * As an additional exemption you are allowed to compile & link against the
+ * OpenSSL libraries as published by the OpenSSL project. See the file
+ * COPYING for details.
+ *
+ */
+
+#ifndef FILTER_CONTAINS_ANY_H_INCLUDED
+#define FILTER_CONTAINS_ANY_H_INCLUDED
+
+#include "filter-expr.h"
+
+/*
+ * contains-any() matches if the value contains any of the literal
+ * substrings listed (one per line) in list_file.  The literals are
+ * compiled into a single Aho-Corasick automaton, so the value is scanned
+ * only once regardless of the number of literals.
+ */
+FilterExprNode *filter_contains_any_new(const gchar *list_file,
+                                        const gchar *property);
+
+#endif
@@ -77,6 +77,57 @@ filter_expr_eval_root(FilterExprNode *self, LogMessage **msg, const LogPathOptio
   return filter_expr_eval_root_with_context(self, msg, 1, &DEFAULT_TEMPLATE_EVAL_OPTIONS, path_options);
 }
 
+/*
+ * Evaluates the filter against the messages of @msgs selected by
+ * @candidates and returns the set of matching ones.  Contrary to
+ * filter_expr_eval_with_context(), @msgs is a batch of independent
+ * messages, not a correlation context.  Nodes without a batch
+ * implementation are evaluated one message at a time.
+ */
+FilterExprSelection
+filter_expr_eval_batch_with_options(FilterExprNode *self, LogMessage **msgs, gint num_msgs,
+                                    FilterExprSelection candidates, LogTemplateEvalOptions *options)
+{
+  FilterExprSelection result = 0;
+  gint i;
+
+  g_assert(num_msgs <= FILTER_EXPR_MAX_BATCH_SIZE);
+
+  if (!candidates)
+    return 0;
+
+  if (self->eval_batch)
+    return self->eval_batch(self, msgs, num_msgs, candidates, options);
+
+  filter_expr_selection_foreach(candidates, i)
+  {
+    if (self->eval(self, &msgs[i], 1, options))
+      result |= G_GUINT64_CONSTANT(1) << i;
+  }
+  return result;
+}
+
+FilterExprSelection
+filter_expr_eval_batch(FilterExprNode *self, LogMessage **msgs, gint num_msgs)
+{
+  return filter_expr_eval_batch_with_options(self, msgs, num_msgs, FILTER_EXPR_SELECT_ALL(num_msgs),
+                                             &DEFAULT_TEMPLATE_EVAL_OPTIONS);
+}
+
+/* @path_options is an array of num_msgs elements, one for each message */
+FilterExprSelection
+filter_expr_eval_root_batch(FilterExprNode *self, LogMessage **msgs, gint num_msgs,
+                            const LogPathOptions *path_options)
+{
+  if (self->modify)
+    {
+      for (gint i = 0; i < num_msgs; i++)
+        log_msg_make_writable(&msgs[i], &path_options[i]);
+    }
+
+  return filter_expr_eval_batch(self, msgs, num_msgs);
+}
+
 static FilterExprNode *
 filter_expr_ref(FilterExprNode *self)
 {
@@ -33,6 +33,21 @@
 struct _GlobalConfig;
 typedef struct _FilterExprNode FilterExprNode;
 
+/* a set of messages in a batch, bit N represents the Nth message */
+typedef guint64 FilterExprSelection;
+
+#define FILTER_EXPR_MAX_BATCH_SIZE 64
+#define FILTER_EXPR_SELECT_ALL(num_msgs) \
+  ((num_msgs) >= FILTER_EXPR_MAX_BATCH_SIZE ? G_MAXUINT64 : (G_GUINT64_CONSTANT(1) << (num_msgs)) - 1)
+
+G_STATIC_ASSERT(LOG_PIPE_MAX_BATCH_SIZE <= FILTER_EXPR_MAX_BATCH_SIZE);
+
+/* iterates over the indexes of the selected messages */
+#define filter_expr_selection_foreach(selection, i) \
+  for (FilterExprSelection __rest = (selection); \
+       __rest && ((i) = __builtin_ctzll(__rest), TRUE); \
+       __rest &= __rest - 1)
+
 struct _FilterExprNode
 {
   guint32 ref_cnt;
@@ -41,6 +56,10 @@ struct _FilterExprNode
   const gchar *type;
   gboolean (*init)(FilterExprNode *self, GlobalConfig *cfg);
   gboolean (*eval)(FilterExprNode *self, LogMessage **msg, gint num_msg, LogTemplateEvalOptions *options);
+  /* optional, evaluates the candidates among a batch of independent
+   * messages and returns the matching ones, see filter_expr_eval_batch() */
+  FilterExprSelection (*eval_batch)(FilterExprNode *self, LogMessage **msgs, gint num_msgs,
+                                    FilterExprSelection candidates, LogTemplateEvalOptions *options);
   FilterExprNode *(*clone)(FilterExprNode *self);
   void (*free_fn)(FilterExprNode *self);
   StatsCounterItem *matched;
@@ -63,6 +82,12 @@ gboolean filter_expr_eval_root(FilterExprNode *self, LogMessage **msg, const Log
 gboolean filter_expr_eval_root_with_context(FilterExprNode *self, LogMessage **msgs, gint num_msg,
                                             LogTemplateEvalOptions *options,
                                             const LogPathOptions *path_options);
+FilterExprSelection filter_expr_eval_batch_with_options(FilterExprNode *self, LogMessage **msgs, gint num_msgs,
+                                                       FilterExprSelection candidates,
+                                                       LogTemplateEvalOptions *options);
+FilterExprSelection filter_expr_eval_batch(FilterExprNode *self, LogMessage **msgs, gint num_msgs);
+FilterExprSelection filter_expr_eval_root_batch(FilterExprNode *self, LogMessage **msgs, gint num_msgs,
+                                                const LogPathOptions *path_options);
 void filter_expr_node_init_instance(FilterExprNode *self);
 void filter_expr_unref(FilterExprNode *self);
 
@@ -24,20 +24,102 @@
 
 #include "filter-in-list.h"
 #include "logmsg/logmsg.h"
-#include "str-utils.h"
 
 #include <errno.h>
 #include <stdlib.h>
 #include <stdio.h>
 #include <string.h>
 
+/* open addressing hash set over the list entries, lookups are done
+ * directly on the (not NUL terminated) value of the message */
+typedef struct _InListEntry
+{
+  const gchar *value;
+  guint32 len;
+  guint32 hash;
+} InListEntry;
+
 typedef struct _FilterInList
 {
   FilterExprNode super;
   NVHandle value_handle;
-  GTree *tree;
+  GStringChunk *values;
+  InListEntry *entries;
+  guint32 mask;
+  guint32 num_entries;
 } FilterInList;
 
+#define IN_LIST_INITIAL_SIZE 16
+
+/* FNV-1a */
+static inline guint32
+_hash_value(const gchar *value, gsize len)
+{
+  guint32 hash = 2166136261U;
+
+  for (gsize i = 0; i < len; i++)
+    {
+      hash ^= (guint8) value[i];
+      hash *= 16777619U;
+    }
+  return hash;
+}
+
+static InListEntry *
+_lookup_entry(InListEntry *entries, guint32 mask, const gchar *value, gsize len, guint32 hash)
+{
+  guint32 i;
+
+  for (i = hash & mask; entries[i].value; i = (i + 1) & mask)
+    {
+      InListEntry *entry = &entries[i];
+
+      if (entry->hash == hash && entry->len == len && memcmp(entry->value, value, len) == 0)
+        break;
+    }
+  return &entries[i];
+}
+
+static void
+_grow(FilterInList *self)
+{
+  guint32 new_mask = (self->mask << 1) | 1;
+  InListEntry *new_entries = g_new0(InListEntry, new_mask + 1);
+
+  for (guint32 i = 0; i <= self->mask; i++)
+    {
+      InListEntry *entry = &self->entries[i];
+
+      if (entry->value)
+        *_lookup_entry(new_entries, new_mask, entry->value, entry->len, entry->hash) = *entry;
+    }
+  g_free(self->entries);
+  self->entries = new_entries;
+  self->mask = new_mask;
+}
+
+static void
+_insert(FilterInList *self, const gchar *value, gsize len)
+{
+  guint32 hash = _hash_value(value, len);
+  InListEntry *entry = _lookup_entry(self->entries, self->mask, value, len, hash);
+
+  if (entry->value)
+    return;
+
+  /* keep the table at most half full, so probe sequences stay short */
+  if ((self->num_entries + 1) * 2 > self->mask + 1)
+    {
+      _grow(self);
+      entry = _lookup_entry(self->entries, self->mask, value, len, hash);
+    }
+
+  entry->value = g_string_chunk_insert_len(self->values, value, len);
+  entry->len = len;
+  entry->hash = hash;
+  self->num_entries++;
+}
+
 static gboolean
 filter_in_list_eval(FilterExprNode *s, LogMessage **msgs, gint num_msg, LogTemplateEvalOptions *options)
 {
@@ -47,11 +129,10 @@ filter_in_list_eval(FilterExprNode *s, LogMessage **msgs, gint num_msg, LogTempl
   gssize len = 0;
 
   value = log_msg_get_value(msg, self->value_handle, &len);
-  APPEND_ZERO(value, value, len);
 
-  gboolean result = (g_tree_lookup(self->tree, value) != NULL);
+  gboolean result = (_lookup_entry(self->entries, self->mask, value, len, _hash_value(value, len))->value != NULL);
   msg_trace("in-list() evaluation started",
-            evt_tag_str("value", value),
+            evt_tag_mem("value", value, len),
             evt_tag_msg_reference(msg));
 
   return result ^ s->comp;
@@ -62,7 +143,8 @@ filter_in_list_free(FilterExprNode *s)
 {
   FilterInList *self = (FilterInList *)s;
 
-  g_tree_destroy(self->tree);
+  g_free(self->entries);
+  g_string_chunk_free(self->values);
 }
 
 FilterExprNode *
@@ -84,13 +166,18 @@ filter_in_list_new(const gchar *list_file, const gchar *property)
   self = g_new0(FilterInList, 1);
   filter_expr_node_init_instance(&self->super);
   self->value_handle = log_msg_get_value_handle(property);
-  self->tree = g_tree_new_full((GCompareDataFunc)strcmp, NULL, g_free, NULL);
+  self->values = g_string_chunk_new(16384);
+  self->mask = IN_LIST_INITIAL_SIZE - 1;
+  self->entries = g_new0(InListEntry, IN_LIST_INITIAL_SIZE);
 
   while (fgets(line, sizeof(line), stream) != NULL)
     {
-      line[strlen(line) - 1] = '\0';
-      if (line[0])
-        g_tree_insert(self->tree, g_strdup(line), GINT_TO_POINTER(1));
+      gsize len = strlen(line);
+
+      if (len > 0 && line[len - 1] == '\n')
+        len--;
+      if (len > 0)
+        _insert(self, line, len);
     }
   fclose(stream);
 
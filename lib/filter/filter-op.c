@@ -69,6 +69,7 @@ fop_clone(FilterExprNode *s)
   cloned_self->super.free_fn = fop_free;
   cloned_self->super.clone = fop_clone;
   cloned_self->super.eval = self->super.eval;
+  cloned_self->super.eval_batch = self->super.eval_batch;
   cloned_self->left = filter_expr_clone(self->left);
   cloned_self->right = filter_expr_clone(self->right);
   cloned_self->super.type = g_strdup(self->super.type);
@@ -93,6 +94,21 @@ fop_or_eval(FilterExprNode *s, LogMessage **msgs, gint num_msg, LogTemplateEvalO
           || filter_expr_eval_with_context(self->right, msgs, num_msg, options)) ^ s->comp;
 }
 
+/* the operands are evaluated over the whole batch, the right side only for
+ * the messages where the left one didn't decide the result already */
+static FilterExprSelection
+fop_or_eval_batch(FilterExprNode *s, LogMessage **msgs, gint num_msgs, FilterExprSelection candidates,
+                  LogTemplateEvalOptions *options)
+{
+  FilterOp *self = (FilterOp *) s;
+  FilterExprSelection left, right;
+
+  left = filter_expr_eval_batch_with_options(self->left, msgs, num_msgs, candidates, options);
+  right = filter_expr_eval_batch_with_options(self->right, msgs, num_msgs, candidates & ~left, options);
+
+  return s->comp ? candidates & ~(left | right) : (left | right);
+}
+
 FilterExprNode *
 fop_or_new(FilterExprNode *e1, FilterExprNode *e2)
 {
@@ -100,6 +116,7 @@ fop_or_new(FilterExprNode *e1, FilterExprNode *e2)
 
   fop_init_instance(self);
   self->super.eval = fop_or_eval;
+  self->super.eval_batch = fop_or_eval_batch;
   self->left = e1;
   self->right = e2;
   self->super.type = g_strdup("OR");
@@ -115,6 +132,19 @@ fop_and_eval(FilterExprNode *s, LogMessage **msgs, gint num_msg, LogTemplateEval
           && filter_expr_eval_with_context(self->right, msgs, num_msg, options)) ^ s->comp;
 }
 
+static FilterExprSelection
+fop_and_eval_batch(FilterExprNode *s, LogMessage **msgs, gint num_msgs, FilterExprSelection candidates,
+                   LogTemplateEvalOptions *options)
+{
+  FilterOp *self = (FilterOp *) s;
+  FilterExprSelection left, both;
+
+  left = filter_expr_eval_batch_with_options(self->left, msgs, num_msgs, candidates, options);
+  both = filter_expr_eval_batch_with_options(self->right, msgs, num_msgs, left, options);
+
+  return s->comp ? candidates & ~both : both;
+}
+
 FilterExprNode *
 fop_and_new(FilterExprNode *e1, FilterExprNode *e2)
 {
@@ -122,6 +152,7 @@ fop_and_new(FilterExprNode *e1, FilterExprNode *e2)
 
   fop_init_instance(self);
   self->super.eval = fop_and_eval;
+  self->super.eval_batch = fop_and_eval_batch;
   self->left = e1;
   self->right = e2;
   self->super.type = g_strdup("AND");
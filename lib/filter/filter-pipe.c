@@ -86,6 +86,50 @@ log_filter_pipe_queue(LogPipe *s, LogMessage *msg, const LogPathOptions *path_op
     }
 }
 
+static void
+log_filter_pipe_queue_batch(LogPipe *s, LogMessage **msgs, const LogPathOptions *path_options, gint num_msgs)
+{
+  LogFilterPipe *self = (LogFilterPipe *) s;
+  FilterExprSelection selected;
+
+  for (gint i = 0; i < num_msgs; i++)
+    filterx_eval_sync_message(path_options[i].filterx_context, &msgs[i], &path_options[i]);
+
+  msg_trace(">>>>>> filter rule batch evaluation begin",
+            evt_tag_str("rule", self->name),
+            log_pipe_location_tag(s),
+            evt_tag_int("num_msgs", num_msgs));
+
+  selected = filter_expr_eval_root_batch(self->expr, msgs, num_msgs, path_options);
+
+  /* messages are forwarded in their original order */
+  for (gint i = 0; i < num_msgs; i++)
+    {
+      gboolean res = !!(selected & (G_GUINT64_CONSTANT(1) << i));
+
+      msg_trace("<<<<<< filter rule evaluation result",
+                evt_tag_str("result", res ? "matched" : "unmatched"),
+                evt_tag_str("rule", self->name),
+                log_pipe_location_tag(s),
+                evt_tag_msg_reference(msgs[i]));
+
+      if (res)
+        {
+          log_pipe_forward_msg(s, msgs[i], &path_options[i]);
+        }
+      else
+        {
+          if (path_options[i].matched)
+            (*path_options[i].matched) = FALSE;
+          log_msg_drop(msgs[i], &path_options[i], AT_PROCESSED);
+        }
+    }
+
+  gint num_matched = __builtin_popcountll(selected);
+  stats_counter_add(self->matched, num_matched);
+  stats_counter_add(self->not_matched, num_msgs - num_matched);
+}
+
 static LogPipe *
 log_filter_pipe_clone(LogPipe *s)
 {
@@ -125,6 +169,7 @@ log_filter_pipe_new(FilterExprNode *expr, GlobalConfig *cfg)
   self->super.flags |= PIF_CONFIG_RELATED + PIF_SYNC_FILTERX;
   self->super.init = log_filter_pipe_init;
   self->super.queue = log_filter_pipe_queue;
+  self->super.queue_batch = log_filter_pipe_queue_batch;
   self->super.free_fn = log_filter_pipe_free;
   self->super.clone = log_filter_pipe_clone;
   self->expr = expr;
@@ -32,23 +32,27 @@ typedef struct _FilterPri
   guint32 valid;
 } FilterPri;
 
-static gboolean
-filter_facility_eval(FilterExprNode *s, LogMessage **msgs, gint num_msg, LogTemplateEvalOptions *options)
+static inline gboolean
+_facility_matches(FilterPri *self, LogMessage *msg)
 {
-  FilterPri *self = (FilterPri *) s;
-  LogMessage *msg = msgs[num_msg - 1];
   guint32 fac_num = (msg->pri & SYSLOG_FACMASK) >> 3;
-  gboolean res;
 
   if (G_UNLIKELY(self->valid & 0x80000000))
     {
       /* exact number specified */
-      res = ((self->valid & ~0x80000000) == fac_num);
-    }
-  else
-    {
-      res = !!(self->valid & (1 << fac_num));
+      return ((self->valid & ~0x80000000) == fac_num);
     }
+  return !!(self->valid & (1 << fac_num));
+}
+
+static gboolean
+filter_facility_eval(FilterExprNode *s, LogMessage **msgs, gint num_msg, LogTemplateEvalOptions *options)
+{
+  FilterPri *self = (FilterPri *) s;
+  LogMessage *msg = msgs[num_msg - 1];
+  guint32 fac_num = (msg->pri & SYSLOG_FACMASK) >> 3;
+  gboolean res = _facility_matches(self, msg);
+
   msg_trace("facility() evaluation started",
             evt_tag_int("fac", fac_num),
             evt_tag_printf("valid_fac", "%08x", self->valid),
@@ -57,6 +61,22 @@ filter_facility_eval(FilterExprNode *s, LogMessage **msgs, gint num_msg, LogTemp
   return res ^ s->comp;
 }
 
+static FilterExprSelection
+filter_facility_eval_batch(FilterExprNode *s, LogMessage **msgs, gint num_msgs, FilterExprSelection candidates,
+                           LogTemplateEvalOptions *options)
+{
+  FilterPri *self = (FilterPri *) s;
+  FilterExprSelection matching = 0;
+  gint i;
+
+  filter_expr_selection_foreach(candidates, i)
+  {
+    if (_facility_matches(self, msgs[i]))
+      matching |= G_GUINT64_CONSTANT(1) << i;
+  }
+  return s->comp ? candidates & ~matching : matching;
+}
+
 FilterExprNode *
 filter_facility_new(guint32 facilities)
 {
@@ -64,6 +84,7 @@ filter_facility_new(guint32 facilities)
 
   filter_expr_node_init_instance(&self->super);
   self->super.eval = filter_facility_eval;
+  self->super.eval_batch = filter_facility_eval_batch;
   self->valid = facilities;
   self->super.type = "facility";
   return &self->super;
@@ -87,6 +108,22 @@ filter_severity_eval(FilterExprNode *s, LogMessage **msgs, gint num_msg, LogTemp
   return res ^ s->comp;
 }
 
+static FilterExprSelection
+filter_severity_eval_batch(FilterExprNode *s, LogMessage **msgs, gint num_msgs, FilterExprSelection candidates,
+                           LogTemplateEvalOptions *options)
+{
+  FilterPri *self = (FilterPri *) s;
+  FilterExprSelection matching = 0;
+  gint i;
+
+  filter_expr_selection_foreach(candidates, i)
+  {
+    if ((1 << (msgs[i]->pri & SYSLOG_PRIMASK)) & self->valid)
+      matching |= G_GUINT64_CONSTANT(1) << i;
+  }
+  return s->comp ? candidates & ~matching : matching;
+}
+
 FilterExprNode *
 filter_severity_new(guint32 levels)
 {
@@ -94,6 +131,7 @@ filter_severity_new(guint32 levels)
 
   filter_expr_node_init_instance(&self->super);
   self->super.eval = filter_severity_eval;
+  self->super.eval_batch = filter_severity_eval_batch;
   self->valid = levels;
   self->super.type = "severity";
   return &self->super;
@@ -150,10 +150,14 @@ testcase_with_socket(const gchar *msg, const gchar *sockaddr,
 
   res = filter_expr_eval(f, logmsg);
   cr_assert_eq(res, expected_result, "Filter test failed; msg='%s'\n", msg);
+  res = filter_expr_eval_batch(f, &logmsg, 1) != 0;
+  cr_assert_eq(res, expected_result, "Filter test failed (batch); msg='%s'\n", msg);
 
   f->comp = !f->comp;
   res = filter_expr_eval(f, logmsg);
   cr_assert_eq(res, !expected_result, "Filter test failed (negated); msg='%s'\n", msg);
+  res = filter_expr_eval_batch(f, &logmsg, 1) != 0;
+  cr_assert_eq(res, !expected_result, "Filter test failed (negated, batch); msg='%s'\n", msg);
 
   log_msg_unref(logmsg);
   filter_expr_unref(f);
@@ -25,6 +25,9 @@
 #define __TEST_FILTER_COMMON_H__
 
 #include "filter/filter-expr.h"
+#include "msg-format.h"
+
+extern MsgFormatOptions parse_options;
 
 void
 testcase_with_socket(const gchar *msg, const gchar *sockaddr,
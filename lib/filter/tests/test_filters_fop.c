@@ -104,4 +104,45 @@ Test(filter_op, cloned_filter_with_negation_should_behave_the_same)
   testcase(msg, cloned_filter, TRUE);
 }
 
+Test(filter_op, batch_evaluation_selects_the_same_messages_as_single_evaluation)
+{
+  const gchar *snippets[] =
+  {
+    "facility(2) or facility(3)",
+    "not facility(2) and level(info)",
+    "(facility(2) and not level(info)) or (program('openvpn') and not facility(3))",
+    "not (program('noprog') or facility(3))",
+  };
+  LogMessage *msgs[FILTER_EXPR_MAX_BATCH_SIZE];
+
+  for (gint i = 0; i < G_N_ELEMENTS(msgs); i++)
+    {
+      gchar *raw_msg = g_strdup_printf("<%d> %s[2499]: PTHREAD support initialized",
+                                       ((2 + i % 3) << 3) + (i % 8), i % 5 ? "openvpn" : "dhcpd");
+
+      msgs[i] = msg_format_parse(&parse_options, (const guchar *) raw_msg, strlen(raw_msg));
+      g_free(raw_msg);
+    }
+
+  for (gint i = 0; i < G_N_ELEMENTS(snippets); i++)
+    {
+      FilterExprNode *filter = _compile_standalone_filter((gchar *) snippets[i]);
+      cr_assert(filter_expr_init(filter, configuration));
+
+      for (gint num_msgs = 1; num_msgs <= G_N_ELEMENTS(msgs); num_msgs += 21)
+        {
+          FilterExprSelection selected = filter_expr_eval_batch(filter, msgs, num_msgs);
+
+          for (gint j = 0; j < num_msgs; j++)
+            cr_assert_eq(!!(selected & (G_GUINT64_CONSTANT(1) << j)), filter_expr_eval(filter, msgs[j]),
+                         "batch and single evaluation differ; filter='%s', msg=%d", snippets[i], j);
+          cr_assert_eq(selected & ~FILTER_EXPR_SELECT_ALL(num_msgs), 0);
+        }
+      filter_expr_unref(filter);
+    }
+
+  for (gint i = 0; i < G_N_ELEMENTS(msgs); i++)
+    log_msg_unref(msgs[i]);
+}
+
 TestSuite(filter_op, .init = setup, .fini = teardown);
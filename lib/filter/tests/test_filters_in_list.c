@@ -31,15 +31,19 @@
 #include "apphook.h"
 #include "plugin.h"
 #include "filter/filter-in-list.h"
+#include "filter/filter-contains-any.h"
 #include "msg-format.h"
 
 #include <stdlib.h>
+#include <stdio.h>
+#include <unistd.h>
 #include <glib.h>
 
 
 #define MSG_1 "<15>Sep  4 15:03:55 localhost test-program[3086]: some random message"
 #define MSG_2 "<15>Sep  4 15:03:55 localhost foo[3086]: some random message"
 #define MSG_3 "<15>Sep  4 15:03:55 192.168.1.1 foo[3086]: some random message"
+#define MSG_4 "<15>Sep  4 15:03:55 localhost foo[3086]: connection from evil.example.com refused"
 #define MSG_LONG "<15>Sep  4 15:03:55 test-hostAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAA foo[3086]: some random message"
 
 #define LIST_FILE_DIR "%s/lib/filter/tests/filters-in-list/"
@@ -129,6 +133,84 @@ Test(template_filters, test_filter_with_long_line)
   g_free(list_file_with_long_line);
 }
 
+Test(template_filters, test_list_file_with_many_entries_and_no_trailing_newline)
+{
+  gchar *list_file = g_strdup_printf("%s/in-list-XXXXXX", g_get_tmp_dir());
+  gint fd = g_mkstemp(list_file);
+  FILE *stream = fdopen(fd, "w");
+
+  cr_assert_not_null(stream);
+  for (gint i = 0; i < 10000; i++)
+    fprintf(stream, "program-%d\n", i);
+  fprintf(stream, "test-program");
+  fclose(stream);
+
+  cr_assert(evaluate_testcase(MSG_1, filter_in_list_new(list_file, "PROGRAM")),
+            "in-list filter should match the last, unterminated line");
+  cr_assert_not(evaluate_testcase(MSG_2, filter_in_list_new(list_file, "PROGRAM")),
+                "in-list filter matches");
+
+  unlink(list_file);
+  g_free(list_file);
+}
+
+Test(template_filters, test_contains_any_matches_a_substring_of_the_message)
+{
+  gchar *list_file = g_strdup_printf(LIST_FILE_DIR "substrings.list", top_srcdir);
+
+  cr_assert(evaluate_testcase(MSG_4, filter_contains_any_new(list_file, "MESSAGE")),
+            "contains-any filter should match");
+  cr_assert(evaluate_testcase(MSG_1, filter_contains_any_new(list_file, "MESSAGE")),
+            "contains-any filter should match");
+  g_free(list_file);
+}
+
+Test(template_filters, test_contains_any_does_not_match_without_any_of_the_substrings)
+{
+  gchar *list_file = g_strdup_printf(LIST_FILE_DIR "substrings.list", top_srcdir);
+
+  cr_assert_not(evaluate_testcase(MSG_1, filter_contains_any_new(list_file, "PROGRAM")),
+                "contains-any filter matches");
+  cr_assert_not(evaluate_testcase(MSG_1, filter_contains_any_new(list_file, "FOO_MACRO")),
+                "contains-any filter matches");
+  g_free(list_file);
+}
+
+Test(template_filters, test_contains_any_with_empty_list)
+{
+  gchar *list_file = g_strdup_printf(LIST_FILE_DIR "empty.list", top_srcdir);
+
+  cr_assert_not(evaluate_testcase(MSG_1, filter_contains_any_new(list_file, "MESSAGE")),
+                "contains-any filter matches");
+  g_free(list_file);
+}
+
+Test(template_filters, test_contains_any_list_file_doesnt_exist)
+{
+  gchar *list_file = g_strdup_printf(LIST_FILE_DIR "notexisting.list", top_srcdir);
+
+  cr_assert_null(filter_contains_any_new(list_file, "MESSAGE"),
+                 "contains-any filter should fail, when the list file does not exist");
+  g_free(list_file);
+}
+
+Test(template_filters, test_contains_any_with_overlapping_substrings)
+{
+  gchar *list_file = g_strdup_printf("%s/contains-any-XXXXXX", g_get_tmp_dir());
+  gint fd = g_mkstemp(list_file);
+  FILE *stream = fdopen(fd, "w");
+
+  /* "andom x" fails over to "dom m", which is only found through the failure links */
+  fprintf(stream, "andom x\ndom m\n");
+  fclose(stream);
+
+  cr_assert(evaluate_testcase(MSG_1, filter_contains_any_new(list_file, "MESSAGE")),
+            "contains-any filter should match");
+
+  unlink(list_file);
+  g_free(list_file);
+}
+
 static void
 setup(void)
 {
@@ -24,6 +24,12 @@
 #include "find-crlf.h"
 
 #include <string.h>
+
+#if defined(__x86_64__) && (defined(__clang__) || __GNUC__ >= 5)
+#define FIND_CRLF_X86_SIMD 1
+#include <immintrin.h>
+#endif
+
 /**
  * This is an optimized version of finding either a CR or LF or NUL
  * character in a buffer.  It is used to find these line terminators in
@@ -31,8 +37,8 @@
  *
  * It uses an algorithm very similar to what there's in libc memchr/strchr.
  **/
-gchar *
-find_cr_or_lf_or_nul(gchar *s, gsize n)
+static gchar *
+_find_cr_or_lf_or_nul_scalar(gchar *s, gsize n)
 {
   gchar *char_ptr;
   gulong *longword_ptr;
@@ -91,3 +97,247 @@ find_cr_or_lf_or_nul(gchar *s, gsize n)
 
   return NULL;
 }
+
+/* same as above, for LF or NUL, used to find the end of a line */
+static const guchar *
+_find_lf_or_nul_scalar(const guchar *s, gsize n)
+{
+  const guchar *char_ptr;
+  const gulong *longword_ptr;
+  gulong longword, magic_bits, charmask;
+  gchar c;
+
+  c = '\n';
+
+  /* align input to long boundary */
+  for (char_ptr = s; n > 0 && ((gulong) char_ptr & (sizeof(longword) - 1)) != 0; ++char_ptr, n--)
+    {
+      if (*char_ptr == c || *char_ptr == '\0')
+        return char_ptr;
+    }
+
+  longword_ptr = (gulong *) char_ptr;
+
+#if GLIB_SIZEOF_LONG == 8
+  magic_bits = 0x7efefefefefefeffL;
+#elif GLIB_SIZEOF_LONG == 4
+  magic_bits = 0x7efefeffL;
+#else
+#error "unknown architecture"
+#endif
+  memset(&charmask, c, sizeof(charmask));
+
+  while (n > sizeof(longword))
+    {
+      longword = *longword_ptr++;
+      if ((((longword + magic_bits) ^ ~longword) & ~magic_bits) != 0 ||
+          ((((longword ^ charmask) + magic_bits) ^ ~(longword ^ charmask)) & ~magic_bits) != 0)
+        {
+          gint i;
+
+          char_ptr = (const guchar *) (longword_ptr - 1);
+
+          for (i = 0; i < sizeof(longword); i++)
+            {
+              if (*char_ptr == c || *char_ptr == '\0')
+                return char_ptr;
+              char_ptr++;
+            }
+        }
+      n -= sizeof(longword);
+    }
+
+  char_ptr = (const guchar *) longword_ptr;
+
+  while (n-- > 0)
+    {
+      if (*char_ptr == c || *char_ptr == '\0')
+        return char_ptr;
+      ++char_ptr;
+    }
+
+  return NULL;
+}
+
+#if FIND_CRLF_X86_SIMD
+
+/*
+ * SIMD versions: compare 16 (SSE2) or 32 (AVX2) bytes at a time, using
+ * unaligned loads that never read past the end of the buffer.  The tail
+ * shorter than a vector is handled by the narrower implementation.
+ */
+
+__attribute__((target("sse2")))
+static gchar *
+_find_cr_or_lf_or_nul_sse2(gchar *s, gsize n)
+{
+  const __m128i cr = _mm_set1_epi8('\r');
+  const __m128i lf = _mm_set1_epi8('\n');
+  const __m128i nul = _mm_setzero_si128();
+
+  for (; n >= sizeof(__m128i); s += sizeof(__m128i), n -= sizeof(__m128i))
+    {
+      __m128i v = _mm_loadu_si128((const __m128i *) s);
+      __m128i eq = _mm_or_si128(_mm_or_si128(_mm_cmpeq_epi8(v, cr), _mm_cmpeq_epi8(v, lf)),
+                                _mm_cmpeq_epi8(v, nul));
+      guint mask = _mm_movemask_epi8(eq);
+
+      if (mask)
+        return s + __builtin_ctz(mask);
+    }
+
+  for (; n > 0; s++, n--)
+    {
+      if (*s == '\r' || *s == '\n' || *s == 0)
+        return s;
+    }
+  return NULL;
+}
+
+__attribute__((target("avx2")))
+static gchar *
+_find_cr_or_lf_or_nul_avx2(gchar *s, gsize n)
+{
+  const __m256i cr = _mm256_set1_epi8('\r');
+  const __m256i lf = _mm256_set1_epi8('\n');
+  const __m256i nul = _mm256_setzero_si256();
+
+  for (; n >= sizeof(__m256i); s += sizeof(__m256i), n -= sizeof(__m256i))
+    {
+      __m256i v = _mm256_loadu_si256((const __m256i *) s);
+      __m256i eq = _mm256_or_si256(_mm256_or_si256(_mm256_cmpeq_epi8(v, cr), _mm256_cmpeq_epi8(v, lf)),
+                                   _mm256_cmpeq_epi8(v, nul));
+      guint mask = _mm256_movemask_epi8(eq);
+
+      if (mask)
+        return s + __builtin_ctz(mask);
+    }
+  return _find_cr_or_lf_or_nul_sse2(s, n);
+}
+
+__attribute__((target("sse2")))
+static const guchar *
+_find_lf_or_nul_sse2(const guchar *s, gsize n)
+{
+  const __m128i lf = _mm_set1_epi8('\n');
+  const __m128i nul = _mm_setzero_si128();
+
+  for (; n >= sizeof(__m128i); s += sizeof(__m128i), n -= sizeof(__m128i))
+    {
+      __m128i v = _mm_loadu_si128((const __m128i *) s);
+      __m128i eq = _mm_or_si128(_mm_cmpeq_epi8(v, lf), _mm_cmpeq_epi8(v, nul));
+      guint mask = _mm_movemask_epi8(eq);
+
+      if (mask)
+        return s + __builtin_ctz(mask);
+    }
+
+  for (; n > 0; s++, n--)
+    {
+      if (*s == '\n' || *s == 0)
+        return s;
+    }
+  return NULL;
+}
+
+__attribute__((target("avx2")))
+static const guchar *
+_find_lf_or_nul_avx2(const guchar *s, gsize n)
+{
+  const __m256i lf = _mm256_set1_epi8('\n');
+  const __m256i nul = _mm256_setzero_si256();
+
+  for (; n >= sizeof(__m256i); s += sizeof(__m256i), n -= sizeof(__m256i))
+    {
+      __m256i v = _mm256_loadu_si256((const __m256i *) s);
+      __m256i eq = _mm256_or_si256(_mm256_cmpeq_epi8(v, lf), _mm256_cmpeq_epi8(v, nul));
+      guint mask = _mm256_movemask_epi8(eq);
+
+      if (mask)
+        return s + __builtin_ctz(mask);
+    }
+  return _find_lf_or_nul_sse2(s, n);
+}
+
+#endif
+
+/* dispatch */
+
+static gchar *_resolve_find_cr_or_lf_or_nul(gchar *s, gsize n);
+static const guchar *_resolve_find_lf_or_nul(const guchar *s, gsize n);
+
+static struct
+{
+  gchar *(*find_cr_or_lf_or_nul)(gchar *s, gsize n);
+  const guchar *(*find_lf_or_nul)(const guchar *s, gsize n);
+} implementation =
+{
+  .find_cr_or_lf_or_nul = _resolve_find_cr_or_lf_or_nul,
+  .find_lf_or_nul = _resolve_find_lf_or_nul,
+};
+
+FindCrlfImplementation
+find_crlf_get_best_implementation(void)
+{
+#if FIND_CRLF_X86_SIMD
+  __builtin_cpu_init();
+  if (__builtin_cpu_supports("avx2"))
+    return FIND_CRLF_AVX2;
+  if (__builtin_cpu_supports("sse2"))
+    return FIND_CRLF_SSE2;
+#endif
+  return FIND_CRLF_SCALAR;
+}
+
+gboolean
+find_crlf_set_implementation(FindCrlfImplementation requested)
+{
+  if (requested > find_crlf_get_best_implementation())
+    return FALSE;
+
+  switch (requested)
+    {
+#if FIND_CRLF_X86_SIMD
+    case FIND_CRLF_AVX2:
+      implementation.find_cr_or_lf_or_nul = _find_cr_or_lf_or_nul_avx2;
+      implementation.find_lf_or_nul = _find_lf_or_nul_avx2;
+      break;
+    case FIND_CRLF_SSE2:
+      implementation.find_cr_or_lf_or_nul = _find_cr_or_lf_or_nul_sse2;
+      implementation.find_lf_or_nul = _find_lf_or_nul_sse2;
+      break;
+#endif
+    default:
+      implementation.find_cr_or_lf_or_nul = _find_cr_or_lf_or_nul_scalar;
+      implementation.find_lf_or_nul = _find_lf_or_nul_scalar;
+      break;
+    }
+  return TRUE;
+}
+
+/* the first call selects the implementation, racing threads would select the same one */
+static gchar *
+_resolve_find_cr_or_lf_or_nul(gchar *s, gsize n)
+{
+  find_crlf_set_implementation(find_crlf_get_best_implementation());
+  return implementation.find_cr_or_lf_or_nul(s, n);
+}
+
+static const guchar *
+_resolve_find_lf_or_nul(const guchar *s, gsize n)
+{
+  find_crlf_set_implementation(find_crlf_get_best_implementation());
+  return implementation.find_lf_or_nul(s, n);
+}
+
+gchar *
+find_cr_or_lf_or_nul(gchar *s, gsize n)
+{
+  return implementation.find_cr_or_lf_or_nul(s, n);
+}
+
+const guchar *
+find_lf_or_nul(const guchar *s, gsize n)
+{
+  return implementation.find_lf_or_nul(s, n);
+}
@@ -26,6 +26,22 @@
 
 #include "syslog-ng.h"
 
+typedef enum
+{
+  FIND_CRLF_SCALAR,
+  FIND_CRLF_SSE2,
+  FIND_CRLF_AVX2,
+} FindCrlfImplementation;
+
+/*
+ * The best implementation supported by the CPU is selected at the first
+ * call, find_crlf_set_implementation() is only used by tests/benchmarks
+ * and returns FALSE if the requested one is not supported.
+ */
+gboolean find_crlf_set_implementation(FindCrlfImplementation implementation);
+FindCrlfImplementation find_crlf_get_best_implementation(void);
+
 gchar *find_cr_or_lf_or_nul(gchar *s, gsize n);
+const guchar *find_lf_or_nul(const guchar *s, gsize n);
 
 #endif
@@ -0,0 +1,517 @@
+/*
+ * Copyright (c) 2024 Balabit
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+ *
+ * As an additional exemption you are allowed to compile & link against the
+ * OpenSSL libraries as published by the OpenSSL project. See the file
+ * COPYING for details.
+ *
+ */
+
+
+#include "logmsg/logmsg-serialize-compact.h"
+#include "logmsg/logmsg-serialize.h"
+#include "logmsg/gsockaddr-serialize.h"
+#include "scratch-buffers.h"
+
+#include <string.h>
+
+/*
+ * Compact LogMessage serialization (LGM_V27)
+ *
+ * Unlike version 26, this format does not dump the in-memory NVTable, only
+ * the values that are actually set:
+ *   - integers are stored as varints (zigzag encoded if signed)
+ *   - unset values and the slack space of the NVTable are omitted
+ *   - builtin values are referred to by their handle, dynamic values by
+ *     their index in a name dictionary stored at the beginning of the
+ *     value block, so each name is written only once per message even if
+ *     it is referenced by indirect values or the SDATA ordering
+ *
+ * Names are resolved to the handles of the reading process when the
+ * dictionary is read back, so no handle fixups are needed afterwards.
+ *
+ * Value block layout:
+ *
+ *   dictionary: <num-names> { <name-len> <name> } ...
+ *   values:     { <ref> <type << 1 | indirect> (<len> <value> | <ref> <ofs> <len>) } ... 0
+ *   sdata:      <num-sdata> { <ref> } ...
+ *
+ * where <ref> is either a builtin handle (below LM_V_MAX) or LM_V_MAX plus
+ * the index in the dictionary.  Direct values precede indirect ones, so
+ * the referenced values are already present when an indirect value is
+ * added.
+ */
+
+#define COMPACT_ENTRY_INDIRECT 0x1
+
+typedef struct _CompactWriter
+{
+  SerializeArchive *sa;
+  NVTable *payload;
+  NVHandle *names;
+  guint32 num_names;
+  gboolean indirect_pass;
+} CompactWriter;
+
+typedef struct _CompactReader
+{
+  SerializeArchive *sa;
+  LogMessage *msg;
+  NVHandle *names;
+  guint32 num_names;
+  GString *buffer;
+} CompactReader;
+
+static inline guint64
+_zigzag_encode(gint64 value)
+{
+  return ((guint64) value << 1) ^ (guint64) (value >> 63);
+}
+
+static inline gint64
+_zigzag_decode(guint64 value)
+{
+  return (gint64) (value >> 1) ^ -(gint64) (value & 1);
+}
+
+static inline gboolean
+_write_bytes(SerializeArchive *sa, const gchar *value, gsize len)
+{
+  return serialize_write_varint(sa, len) &&
+         (len == 0 || serialize_archive_write_bytes(sa, value, len));
+}
+
+static gboolean
+_read_bytes(SerializeArchive *sa, GString *buffer)
+{
+  guint64 len;
+
+  if (!serialize_read_varint(sa, &len) || len > NV_TABLE_MAX_BYTES)
+    return FALSE;
+
+  g_string_set_size(buffer, len);
+  return serialize_archive_read_bytes(sa, buffer->str, len);
+}
+
+static gboolean
+_read_varint_max(SerializeArchive *sa, guint64 max_value, guint64 *value)
+{
+  return serialize_read_varint(sa, value) && *value <= max_value;
+}
+
+/**********************************************************************
+ * header
+ **********************************************************************/
+
+static gboolean
+_write_timestamps(SerializeArchive *sa, const UnixTime *timestamps)
+{
+  for (gint i = 0; i < LM_TS_MAX; i++)
+    {
+      if (!serialize_write_varint(sa, _zigzag_encode(timestamps[i].ut_sec)) ||
+          !serialize_write_varint(sa, timestamps[i].ut_usec) ||
+          !serialize_write_varint(sa, _zigzag_encode(timestamps[i].ut_gmtoff)))
+        return FALSE;
+    }
+  return TRUE;
+}
+
+static gboolean
+_read_timestamps(SerializeArchive *sa, UnixTime *timestamps)
+{
+  guint64 sec, usec, gmtoff;
+
+  for (gint i = 0; i < LM_TS_MAX; i++)
+    {
+      if (!serialize_read_varint(sa, &sec) ||
+          !_read_varint_max(sa, G_MAXUINT32, &usec) ||
+          !serialize_read_varint(sa, &gmtoff))
+        return FALSE;
+
+      timestamps[i].ut_sec = _zigzag_decode(sec);
+      timestamps[i].ut_usec = usec;
+      timestamps[i].ut_gmtoff = _zigzag_decode(gmtoff);
+    }
+  return TRUE;
+}
+
+static gboolean
+_write_tag(const LogMessage *msg, LogTagId tag_id, const gchar *name, gpointer user_data)
+{
+  SerializeArchive *sa = (SerializeArchive *) user_data;
+
+  _write_bytes(sa, name, strlen(name));
+  return TRUE;
+}
+
+static gboolean
+_write_tags(LogMessage *msg, SerializeArchive *sa)
+{
+  log_msg_tags_foreach(msg, _write_tag, sa);
+  return _write_bytes(sa, "", 0);
+}
+
+static gboolean
+_read_tags(CompactReader *reader)
+{
+  while (TRUE)
+    {
+      if (!_read_bytes(reader->sa, reader->buffer))
+        return FALSE;
+
+      /* empty string terminates the list of tags */
+      if (reader->buffer->len == 0)
+        break;
+      log_msg_set_tag_by_name(reader->msg, reader->buffer->str);
+    }
+  reader->msg->flags |= LF_STATE_OWN_TAGS;
+  return TRUE;
+}
+
+/**********************************************************************
+ * values
+ **********************************************************************/
+
+static gint
+_handle_cmp(const void *a, const void *b)
+{
+  NVHandle handle_a = *(const NVHandle *) a;
+  NVHandle handle_b = *(const NVHandle *) b;
+
+  if (handle_a < handle_b)
+    return -1;
+  return handle_a > handle_b;
+}
+
+static guint64
+_writer_lookup_ref(CompactWriter *writer, NVHandle handle)
+{
+  if (handle < LM_V_MAX)
+    return handle;
+
+  /* names are collected from the index of the NVTable, thus they are sorted by handle */
+  NVHandle *name = bsearch(&handle, writer->names, writer->num_names, sizeof(NVHandle), _handle_cmp);
+  g_assert(name);
+  return LM_V_MAX + (name - writer->names);
+}
+
+static gboolean
+_is_direct_entry(NVEntry *entry)
+{
+  return entry && !entry->unset && !entry->indirect;
+}
+
+/* only indirect values that can be restored using log_msg_set_value_indirect() are
+ * kept as references, the rest (e.g. slices of builtin values) are stored resolved */
+static gboolean
+_is_indirect_entry_kept(NVTable *payload, NVHandle handle, NVEntry *entry)
+{
+  if (handle < LM_V_MAX)
+    return FALSE;
+
+  if (entry->vindirect.ofs > G_MAXUINT16 || entry->vindirect.len > G_MAXUINT16)
+    return FALSE;
+
+  NVHandle ref_handle = entry->vindirect.handle;
+  return _is_direct_entry(nv_table_get_entry(payload, ref_handle, NULL, NULL));
+}
+
+static gboolean
+_collect_name(NVHandle handle, NVEntry *entry, NVIndexEntry *index_entry, gpointer user_data)
+{
+  CompactWriter *writer = (CompactWriter *) user_data;
+
+  if (!index_entry || entry->unset)
+    return FALSE;
+
+  writer->names[writer->num_names++] = handle;
+  return FALSE;
+}
+
+static gboolean
+_write_dictionary(CompactWriter *writer)
+{
+  nv_table_foreach_entry(writer->payload, _collect_name, writer);
+
+  if (!serialize_write_varint(writer->sa, writer->num_names))
+    return FALSE;
+
+  for (guint32 i = 0; i < writer->num_names; i++)
+    {
+      gssize name_len;
+      const gchar *name = log_msg_get_value_name(writer->names[i], &name_len);
+
+      if (!_write_bytes(writer->sa, name, name_len))
+        return FALSE;
+    }
+  return TRUE;
+}
+
+static gboolean
+_write_entry(NVHandle handle, NVEntry *entry, NVIndexEntry *index_entry, gpointer user_data)
+{
+  CompactWriter *writer = (CompactWriter *) user_data;
+  SerializeArchive *sa = writer->sa;
+
+  if (entry->unset)
+    return FALSE;
+
+  gboolean indirect = entry->indirect && _is_indirect_entry_kept(writer->payload, handle, entry);
+  if (indirect != writer->indirect_pass)
+    return FALSE;
+
+  serialize_write_varint(sa, _writer_lookup_ref(writer, handle));
+  serialize_write_varint(sa, (entry->type << 1) | (indirect ? COMPACT_ENTRY_INDIRECT : 0));
+
+  if (indirect)
+    {
+      serialize_write_varint(sa, _writer_lookup_ref(writer, entry->vindirect.handle));
+      serialize_write_varint(sa, entry->vindirect.ofs);
+      serialize_write_varint(sa, entry->vindirect.len);
+    }
+  else
+    {
+      gssize value_len;
+      const gchar *value = nv_table_get_value(writer->payload, handle, &value_len, NULL);
+
+      _write_bytes(sa, value, value_len);
+    }
+  return FALSE;
+}
+
+static gboolean
+_write_values(CompactWriter *writer)
+{
+  writer->indirect_pass = FALSE;
+  nv_table_foreach_entry(writer->payload, _write_entry, writer);
+  writer->indirect_pass = TRUE;
+  nv_table_foreach_entry(writer->payload, _write_entry, writer);
+
+  return serialize_write_varint(writer->sa, LM_V_NONE);
+}
+
+static gboolean
+_write_sdata(CompactWriter *writer, LogMessage *msg)
+{
+  if (!serialize_write_varint(writer->sa, msg->num_sdata))
+    return FALSE;
+
+  for (gint i = 0; i < msg->num_sdata; i++)
+    {
+      if (!serialize_write_varint(writer->sa, _writer_lookup_ref(writer, msg->sdata[i])))
+        return FALSE;
+    }
+  return TRUE;
+}
+
+static gboolean
+_write_value_block(LogMessageSerializationState *state)
+{
+  NVTable *payload = state->msg->payload;
+  NVTable *parent = nv_table_get_parent(payload);
+  NVHandle names[payload->index_size + (parent ? parent->index_size : 0) + 1];
+  CompactWriter writer =
+  {
+    .sa = state->sa,
+    .payload = payload,
+    .names = names,
+  };
+
+  /* NOTE: the names array is allocated on the stack, index_size is a
+   * guint16, a layered payload may inherit the names of its parent */
+  return _write_dictionary(&writer) &&
+         _write_values(&writer) &&
+         _write_sdata(&writer, state->msg);
+}
+
+static gboolean
+_read_ref(CompactReader *reader, NVHandle *handle)
+{
+  guint64 ref;
+
+  if (!_read_varint_max(reader->sa, LM_V_MAX + (guint64) reader->num_names - 1, &ref))
+    return FALSE;
+
+  *handle = ref < LM_V_MAX ? ref : reader->names[ref - LM_V_MAX];
+  return TRUE;
+}
+
+static gboolean
+_read_dictionary(CompactReader *reader)
+{
+  guint64 num_names;
+
+  if (!_read_varint_max(reader->sa, G_MAXUINT16, &num_names))
+    return FALSE;
+
+  reader->names = g_new(NVHandle, num_names);
+  for (reader->num_names = 0; reader->num_names < num_names; reader->num_names++)
+    {
+      if (!_read_bytes(reader->sa, reader->buffer) || reader->buffer->len == 0 ||
+          reader->buffer->len > G_MAXUINT8 || memchr(reader->buffer->str, 0, reader->buffer->len))
+        return FALSE;
+
+      reader->names[reader->num_names] = log_msg_get_value_handle(reader->buffer->str);
+    }
+  return TRUE;
+}
+
+static gboolean
+_read_entry(CompactReader *reader, NVHandle handle)
+{
+  guint64 meta, ofs, len;
+  NVHandle ref_handle;
+
+  if (!_read_varint_max(reader->sa, (G_MAXUINT8 << 1) | COMPACT_ENTRY_INDIRECT, &meta))
+    return FALSE;
+
+  LogMessageValueType type = meta >> 1;
+  if ((meta & COMPACT_ENTRY_INDIRECT) == 0)
+    {
+      if (!_read_bytes(reader->sa, reader->buffer))
+        return FALSE;
+      log_msg_set_value_with_type(reader->msg, handle, reader->buffer->str, reader->buffer->len, type);
+      return TRUE;
+    }
+
+  if (handle < LM_V_MAX ||
+      !_read_ref(reader, &ref_handle) || ref_handle == LM_V_NONE || ref_handle == handle ||
+      !_read_varint_max(reader->sa, G_MAXUINT16, &ofs) ||
+      !_read_varint_max(reader->sa, G_MAXUINT16, &len))
+    return FALSE;
+
+  log_msg_set_value_indirect_with_type(reader->msg, handle, ref_handle, ofs, len, type);
+  return TRUE;
+}
+
+static gboolean
+_read_values(CompactReader *reader)
+{
+  NVHandle handle;
+
+  while (TRUE)
+    {
+      if (!_read_ref(reader, &handle))
+        return FALSE;
+
+      if (handle == LM_V_NONE)
+        break;
+
+      if (!_read_entry(reader, handle))
+        return FALSE;
+    }
+  return TRUE;
+}
+
+/* values are added in the order of their handles, restore the original SDATA order */
+static gboolean
+_read_sdata(CompactReader *reader)
+{
+  LogMessage *msg = reader->msg;
+  guint64 num_sdata;
+
+  if (!_read_varint_max(reader->sa, G_MAXUINT8, &num_sdata) || num_sdata != msg->num_sdata)
+    return FALSE;
+
+  for (gint i = 0; i < num_sdata; i++)
+    {
+      if (!_read_ref(reader, &msg->sdata[i]) || !log_msg_is_handle_sdata(msg->sdata[i]))
+        return FALSE;
+    }
+  return TRUE;
+}
+
+static gboolean
+_read_value_block(CompactReader *reader)
+{
+  return _read_dictionary(reader) &&
+         _read_values(reader) &&
+         _read_sdata(reader);
+}
+
+/**********************************************************************
+ * LogMessage
+ **********************************************************************/
+
+gboolean
+log_msg_serialize_compact(LogMessageSerializationState *state)
+{
+  LogMessage *msg = state->msg;
+  SerializeArchive *sa = state->sa;
+  UnixTime timestamps[LM_TS_MAX];
+
+  memcpy(&timestamps, msg->timestamps, LM_TS_MAX * sizeof(UnixTime));
+  if (state->processed)
+    timestamps[LM_TS_PROCESSED] = *state->processed;
+  else if (!unix_time_is_set(&timestamps[LM_TS_PROCESSED]))
+    timestamps[LM_TS_PROCESSED] = timestamps[LM_TS_RECVD];
+
+  return serialize_write_uint8(sa, LGM_V27) &&
+         serialize_write_varint(sa, msg->rcptid) &&
+         serialize_write_varint(sa, msg->flags & ~LF_STATE_MASK) &&
+         serialize_write_varint(sa, msg->pri) &&
+         g_sockaddr_serialize(sa, msg->saddr) &&
+         _write_timestamps(sa, timestamps) &&
+         serialize_write_varint(sa, msg->host_id) &&
+         _write_tags(msg, sa) &&
+         serialize_write_uint8(sa, msg->initial_parse) &&
+         serialize_write_uint8(sa, msg->num_matches) &&
+         _write_value_block(state);
+}
+
+gboolean
+log_msg_deserialize_compact(LogMessageSerializationState *state)
+{
+  LogMessage *msg = state->msg;
+  SerializeArchive *sa = state->sa;
+  ScratchBuffersMarker marker;
+  CompactReader reader =
+  {
+    .sa = sa,
+    .msg = msg,
+    .buffer = scratch_buffers_alloc_and_mark(&marker),
+  };
+  guint64 flags, pri, host_id;
+  guint8 initial_parse, num_matches;
+  gboolean success = FALSE;
+
+  g_assert(state->version == LGM_V27);
+
+  if (!serialize_read_varint(sa, &msg->rcptid) ||
+      !_read_varint_max(sa, G_MAXUINT32, &flags) ||
+      !_read_varint_max(sa, G_MAXUINT16, &pri) ||
+      !g_sockaddr_deserialize(sa, &msg->saddr) ||
+      !_read_timestamps(sa, msg->timestamps) ||
+      !_read_varint_max(sa, G_MAXUINT32, &host_id) ||
+      !_read_tags(&reader) ||
+      !serialize_read_uint8(sa, &initial_parse) ||
+      !serialize_read_uint8(sa, &num_matches) ||
+      !_read_value_block(&reader))
+    goto exit;
+
+  msg->flags = flags | LF_STATE_MASK;
+  msg->pri = pri;
+  msg->host_id = host_id;
+  msg->initial_parse = initial_parse;
+  msg->num_matches = num_matches;
+  success = TRUE;
+
+exit:
+  g_free(reader.names);
+  scratch_buffers_reclaim_marked(marker);
+  return success;
+}
@@ -24,6 +24,7 @@
 
 #include "logmsg/logmsg-serialize.h"
 #include "logmsg/logmsg-serialize-fixup.h"
+#include "logmsg/logmsg-serialize-compact.h"
 #include "logmsg/nvtable-serialize.h"
 #include "logmsg/nvtable-serialize-legacy.h"
 #include "logmsg/gsockaddr-serialize.h"
@@ -79,7 +80,8 @@ _serialize_message(LogMessageSerializationState *state)
   serialize_write_uint8(sa, msg->alloc_sdata);
   serialize_write_uint32_array(sa, (guint32 *) msg->sdata, msg->num_sdata);
 
-  if (state->flags & LMSF_COMPACTION)
+  /* a layered payload is flattened, the on-disk format has no notion of parents */
+  if ((state->flags & LMSF_COMPACTION) || msg->payload->layered)
     nv_table_serialize_with_compaction(state, msg->payload);
   else
     nv_table_serialize(state, msg->payload);
@@ -91,11 +93,14 @@ log_msg_serialize_with_ts_processed(LogMessage *self, SerializeArchive *sa, cons
 {
   LogMessageSerializationState state = { 0 };
 
-  state.version = LGM_V26;
+  state.version = (flags & LMSF_COMPACT_FORMAT) ? LGM_V27 : LGM_V26;
   state.msg = self;
   state.sa = sa;
   state.processed = processed;
   state.flags = flags;
+
+  if (state.version == LGM_V27)
+    return log_msg_serialize_compact(&state);
   return _serialize_message(&state);
 }
 
@@ -499,7 +504,7 @@ _check_msg_version(LogMessageSerializationState *state)
   if (!serialize_read_uint8(state->sa, &state->version))
     return FALSE;
 
-  if (state->version < LGM_V10 || state->version > LGM_V26)
+  if (state->version < LGM_V10 || state->version > LGM_V27)
     {
       msg_error("Error deserializing log message, unsupported version",
                 evt_tag_int("version", state->version));
@@ -523,5 +528,8 @@ log_msg_deserialize(LogMessage *self, SerializeArchive *sa)
   if (state.version < LGM_V20)
     return _deserialize_message_version_1x(&state);
 
+  if (state.version == LGM_V27)
+    return log_msg_deserialize_compact(&state);
+
   return _deserialize_message_version_2x(&state);
 }
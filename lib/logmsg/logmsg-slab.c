@@ -0,0 +1,373 @@
+/*
+ * Copyright (c) 2024 Balabit
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+ *
+ * As an additional exemption you are allowed to compile & link against the
+ * OpenSSL libraries as published by the OpenSSL project. See the file
+ * COPYING for details.
+ *
+ */
+
+#include "logmsg/logmsg-slab.h"
+#include "mainloop-worker.h"
+#include "stats/stats-registry.h"
+#include "stats/stats-cluster-single.h"
+
+#include <string.h>
+
+/*
+ * LogMessage and NVTable allocations are short lived and come in a handful
+ * of typical sizes, most of them being allocated by source threads and
+ * freed by destination threads.  Going to malloc() for each of them causes
+ * arena contention and fragmentation, so free blocks are kept in per-thread
+ * caches instead, indexed by the main_loop_worker thread index:
+ *
+ *   - every block starts with a LogMsgSlabHeader, recording its size class
+ *     and the thread that allocated it (its owner)
+ *
+ *   - blocks freed by their owner go to the local free list of the owner,
+ *     which is only ever touched by the owner thread, no locking needed
+ *
+ *   - blocks freed by any other thread are pushed to the "remote" list of
+ *     the owner (a lock-free stack), which the owner takes over in one go
+ *     once its local list runs empty
+ *
+ * Threads without a thread index (the main thread for instance) allocate
+ * directly from malloc(), allocations larger than the largest size class
+ * always do.  The number of cached blocks is limited per size class, the
+ * excess is released to malloc().  Setting G_SLICE=always-malloc in the
+ * environment disables caching altogether, useful when hunting memory
+ * errors with valgrind or similar.
+ */
+
+#define LOG_MSG_SLAB_NUM_CLASSES 7
+#define LOG_MSG_SLAB_MIN_BLOCK_SHIFT 8
+#define LOG_MSG_SLAB_MAX_BLOCK_SIZE (1 << (LOG_MSG_SLAB_MIN_BLOCK_SHIFT + LOG_MSG_SLAB_NUM_CLASSES - 1))
+
+/* upper limit of memory cached per thread and size class (for both the
+ * local and the remote list) */
+#define LOG_MSG_SLAB_MAX_CACHED_BYTES (256 * 1024)
+#define LOG_MSG_SLAB_MIN_CACHED_BLOCKS 16
+
+/* per-thread stats are published after this many events */
+#define LOG_MSG_SLAB_STATS_FLUSH_EVENTS 256
+
+#define LOG_MSG_SLAB_NO_CLASS 0xFFFF
+#define LOG_MSG_SLAB_NO_OWNER 0xFFFF
+
+#define LOG_MSG_SLAB_CACHE_LINE_SIZE 64
+
+typedef union _LogMsgSlabHeader
+{
+  struct
+  {
+    guint32 size;
+    guint16 size_class;
+    guint16 owner;
+    /* only used while the block is on a free list */
+    union _LogMsgSlabHeader *next;
+  };
+  /* keep the returned memory aligned just like malloc() would */
+  guint8 __alignment[16];
+} LogMsgSlabHeader;
+
+G_STATIC_ASSERT(MAIN_LOOP_MAX_WORKER_THREADS < LOG_MSG_SLAB_NO_OWNER);
+
+/* only accessed by the thread owning the cache */
+typedef union _LogMsgSlabLocalCache
+{
+  struct
+  {
+    LogMsgSlabHeader *free_list[LOG_MSG_SLAB_NUM_CLASSES];
+    gint free_count[LOG_MSG_SLAB_NUM_CLASSES];
+
+    gint hits;
+    gint misses;
+    gint returns;
+  };
+  gchar __pad[2 * LOG_MSG_SLAB_CACHE_LINE_SIZE];
+} LogMsgSlabLocalCache;
+
+/* blocks returned by other threads */
+typedef union _LogMsgSlabRemoteCache
+{
+  struct
+  {
+    LogMsgSlabHeader *free_list[LOG_MSG_SLAB_NUM_CLASSES];
+    gint free_count[LOG_MSG_SLAB_NUM_CLASSES];
+  };
+  gchar __pad[2 * LOG_MSG_SLAB_CACHE_LINE_SIZE];
+} LogMsgSlabRemoteCache;
+
+static LogMsgSlabLocalCache local_caches[MAIN_LOOP_MAX_WORKER_THREADS];
+static LogMsgSlabRemoteCache remote_caches[MAIN_LOOP_MAX_WORKER_THREADS];
+static gboolean log_msg_slab_disabled;
+
+static StatsCounterItem *count_slab_hits;
+static StatsCounterItem *count_slab_misses;
+static StatsCounterItem *count_slab_returns;
+
+static inline gsize
+_get_block_size(gint size_class)
+{
+  return 1 << (LOG_MSG_SLAB_MIN_BLOCK_SHIFT + size_class);
+}
+
+static inline gint
+_get_max_cached_blocks(gint size_class)
+{
+  return MAX(LOG_MSG_SLAB_MAX_CACHED_BYTES / _get_block_size(size_class), LOG_MSG_SLAB_MIN_CACHED_BLOCKS);
+}
+
+static inline gint
+_lookup_size_class(gsize block_size)
+{
+  if (log_msg_slab_disabled || block_size > LOG_MSG_SLAB_MAX_BLOCK_SIZE)
+    return LOG_MSG_SLAB_NO_CLASS;
+
+  if (block_size <= _get_block_size(0))
+    return 0;
+
+  return g_bit_storage(block_size - 1) - LOG_MSG_SLAB_MIN_BLOCK_SHIFT;
+}
+
+static inline LogMsgSlabHeader *
+_get_header(gpointer mem)
+{
+  return ((LogMsgSlabHeader *) mem) - 1;
+}
+
+static void
+_flush_stats(LogMsgSlabLocalCache *cache)
+{
+  stats_counter_add(count_slab_hits, cache->hits);
+  stats_counter_add(count_slab_misses, cache->misses);
+  stats_counter_add(count_slab_returns, cache->returns);
+  cache->hits = cache->misses = cache->returns = 0;
+}
+
+static inline void
+_account_event(LogMsgSlabLocalCache *cache, gint *counter)
+{
+  (*counter)++;
+  if (cache->hits + cache->misses + cache->returns >= LOG_MSG_SLAB_STATS_FLUSH_EVENTS)
+    _flush_stats(cache);
+}
+
+static LogMsgSlabHeader *
+_take_remote_list(LogMsgSlabRemoteCache *remote, gint size_class, gint *count)
+{
+  LogMsgSlabHeader *list;
+
+  do
+    {
+      list = g_atomic_pointer_get(&remote->free_list[size_class]);
+    }
+  while (list && !g_atomic_pointer_compare_and_exchange(&remote->free_list[size_class], list, NULL));
+
+  *count = 0;
+  for (LogMsgSlabHeader *block = list; block; block = block->next)
+    (*count)++;
+
+  if (*count)
+    g_atomic_int_add(&remote->free_count[size_class], -(*count));
+  return list;
+}
+
+static LogMsgSlabHeader *
+_alloc_cached_block(gint thread_index, gint size_class)
+{
+  LogMsgSlabLocalCache *cache = &local_caches[thread_index];
+
+  if (!cache->free_list[size_class])
+    cache->free_list[size_class] = _take_remote_list(&remote_caches[thread_index], size_class,
+                                                     &cache->free_count[size_class]);
+
+  LogMsgSlabHeader *block = cache->free_list[size_class];
+  if (!block)
+    {
+      _account_event(cache, &cache->misses);
+      return g_malloc(_get_block_size(size_class));
+    }
+
+  cache->free_list[size_class] = block->next;
+  cache->free_count[size_class]--;
+  _account_event(cache, &cache->hits);
+  return block;
+}
+
+gpointer
+log_msg_slab_alloc(gsize size)
+{
+  gsize block_size = size + sizeof(LogMsgSlabHeader);
+  gint size_class = _lookup_size_class(block_size);
+  gint thread_index = main_loop_worker_get_thread_index();
+  LogMsgSlabHeader *block;
+
+  if (size_class == LOG_MSG_SLAB_NO_CLASS)
+    block = g_malloc(block_size);
+  else if (thread_index < 0)
+    block = g_malloc(_get_block_size(size_class));
+  else
+    block = _alloc_cached_block(thread_index, size_class);
+
+  block->size = size;
+  block->size_class = size_class;
+  block->owner = thread_index < 0 ? LOG_MSG_SLAB_NO_OWNER : thread_index;
+  block->next = NULL;
+  return block + 1;
+}
+
+static void
+_free_to_remote_cache(LogMsgSlabHeader *block, LogMsgSlabLocalCache *cache)
+{
+  LogMsgSlabRemoteCache *remote = &remote_caches[block->owner];
+  gint size_class = block->size_class;
+  LogMsgSlabHeader *head;
+
+  if (g_atomic_int_add(&remote->free_count[size_class], 1) >= _get_max_cached_blocks(size_class))
+    {
+      g_atomic_int_add(&remote->free_count[size_class], -1);
+      g_free(block);
+      return;
+    }
+
+  do
+    {
+      head = g_atomic_pointer_get(&remote->free_list[size_class]);
+      block->next = head;
+    }
+  while (!g_atomic_pointer_compare_and_exchange(&remote->free_list[size_class], head, block));
+
+  if (cache)
+    _account_event(cache, &cache->returns);
+}
+
+static void
+_free_to_local_cache(LogMsgSlabHeader *block, LogMsgSlabLocalCache *cache)
+{
+  gint size_class = block->size_class;
+
+  if (cache->free_count[size_class] >= _get_max_cached_blocks(size_class))
+    {
+      g_free(block);
+      return;
+    }
+
+  block->next = cache->free_list[size_class];
+  cache->free_list[size_class] = block;
+  cache->free_count[size_class]++;
+}
+
+void
+log_msg_slab_free(gpointer mem)
+{
+  LogMsgSlabHeader *block = _get_header(mem);
+  gint thread_index = main_loop_worker_get_thread_index();
+  LogMsgSlabLocalCache *cache = thread_index >= 0 ? &local_caches[thread_index] : NULL;
+
+  if (block->size_class == LOG_MSG_SLAB_NO_CLASS || log_msg_slab_disabled)
+    g_free(block);
+  else if (block->owner != LOG_MSG_SLAB_NO_OWNER && block->owner != thread_index)
+    _free_to_remote_cache(block, cache);
+  else if (cache)
+    _free_to_local_cache(block, cache);
+  else
+    g_free(block);
+}
+
+gpointer
+log_msg_slab_realloc(gpointer mem, gsize size)
+{
+  LogMsgSlabHeader *block = _get_header(mem);
+
+  if (block->size_class == LOG_MSG_SLAB_NO_CLASS)
+    {
+      block = g_realloc(block, size + sizeof(LogMsgSlabHeader));
+      block->size = size;
+      return block + 1;
+    }
+
+  if (size + sizeof(LogMsgSlabHeader) <= _get_block_size(block->size_class))
+    {
+      block->size = size;
+      return mem;
+    }
+
+  gpointer new_mem = log_msg_slab_alloc(size);
+  memcpy(new_mem, mem, block->size);
+  log_msg_slab_free(mem);
+  return new_mem;
+}
+
+static void
+_free_list(LogMsgSlabHeader *list)
+{
+  while (list)
+    {
+      LogMsgSlabHeader *next = list->next;
+
+      g_free(list);
+      list = next;
+    }
+}
+
+void
+log_msg_slab_register_stats(void)
+{
+  StatsClusterKey sc_key;
+
+  stats_lock();
+  stats_cluster_single_key_set(&sc_key, "events_slab_hits", NULL, 0);
+  stats_cluster_single_key_add_legacy_alias(&sc_key, SCS_GLOBAL, "msg_slab_hits", NULL);
+  stats_register_counter(1, &sc_key, SC_TYPE_SINGLE_VALUE, &count_slab_hits);
+
+  stats_cluster_single_key_set(&sc_key, "events_slab_misses", NULL, 0);
+  stats_cluster_single_key_add_legacy_alias(&sc_key, SCS_GLOBAL, "msg_slab_misses", NULL);
+  stats_register_counter(1, &sc_key, SC_TYPE_SINGLE_VALUE, &count_slab_misses);
+
+  stats_cluster_single_key_set(&sc_key, "events_slab_returns", NULL, 0);
+  stats_cluster_single_key_add_legacy_alias(&sc_key, SCS_GLOBAL, "msg_slab_returns", NULL);
+  stats_register_counter(1, &sc_key, SC_TYPE_SINGLE_VALUE, &count_slab_returns);
+  stats_unlock();
+}
+
+void
+log_msg_slab_global_init(void)
+{
+  const gchar *g_slice = g_getenv("G_SLICE");
+
+  log_msg_slab_disabled = g_slice && strstr(g_slice, "always-malloc") != NULL;
+}
+
+/* NOTE: there must be no worker threads running at this point */
+void
+log_msg_slab_global_deinit(void)
+{
+  for (gint i = 0; i < MAIN_LOOP_MAX_WORKER_THREADS; i++)
+    {
+      for (gint size_class = 0; size_class < LOG_MSG_SLAB_NUM_CLASSES; size_class++)
+        {
+          _free_list(local_caches[i].free_list[size_class]);
+          _free_list(remote_caches[i].free_list[size_class]);
+        }
+      memset(&local_caches[i], 0, sizeof(local_caches[i]));
+      memset(&remote_caches[i], 0, sizeof(remote_caches[i]));
+    }
+
+  /* messages freed after this point go straight back to malloc() */
+  log_msg_slab_disabled = TRUE;
+}
@@ -0,0 +1,46 @@
+/*
+ * Copyright (c) 2024 Balabit
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+ *
+ * As an additional exemption you are allowed to compile & link against the
+ * OpenSSL libraries as published by the OpenSSL project. See the file
+ * COPYING for details.
+ *
+ */
+
+#ifndef LOGMSG_SLAB_H_INCLUDED
+#define LOGMSG_SLAB_H_INCLUDED
+
+#include "syslog-ng.h"
+
+/*
+ * Allocator for LogMessage and NVTable instances, with per-worker-thread
+ * caches of free blocks in a couple of power-of-two size classes.  Memory
+ * returned by these functions must be released using log_msg_slab_free()
+ * (and resized using log_msg_slab_realloc()), never with g_free().
+ *
+ * Blocks can be freed from any thread, a block freed by a thread other than
+ * the one that allocated it is returned to the cache of its owner.
+ */
+gpointer log_msg_slab_alloc(gsize size);
+gpointer log_msg_slab_realloc(gpointer mem, gsize size);
+void log_msg_slab_free(gpointer mem);
+
+void log_msg_slab_register_stats(void);
+void log_msg_slab_global_init(void);
+void log_msg_slab_global_deinit(void);
+
+#endif
@@ -30,6 +30,7 @@
 #include "timeutils/cache.h"
 #include "timeutils/misc.h"
 #include "logmsg/nvtable.h"
+#include "logmsg/logmsg-slab.h"
 #include "stats/stats-registry.h"
 #include "stats/stats-cluster-single.h"
 #include "template/templates.h"
@@ -627,7 +628,7 @@ log_msg_set_value_with_type(LogMessage *self, NVHandle handle,
 
   if (!log_msg_chk_flag(self, LF_STATE_OWN_PAYLOAD))
     {
-      self->payload = nv_table_clone(self->payload, name_len + value_len + 2);
+      self->payload = nv_table_clone_layered(self->payload, name_len + value_len + 2);
       log_msg_set_flag(self, LF_STATE_OWN_PAYLOAD);
       self->allocated_bytes += self->payload->size;
       stats_counter_add(count_allocated_bytes, self->payload->size);
@@ -683,7 +684,7 @@ log_msg_unset_value(LogMessage *self, NVHandle handle)
 
   if (!log_msg_chk_flag(self, LF_STATE_OWN_PAYLOAD))
     {
-      self->payload = nv_table_clone(self->payload, 0);
+      self->payload = nv_table_clone_layered(self->payload, 0);
       log_msg_set_flag(self, LF_STATE_OWN_PAYLOAD);
     }
 
@@ -716,25 +717,12 @@ log_msg_unset_value_by_name(LogMessage *self, const gchar *name)
   log_msg_unset_value(self, log_msg_get_value_handle(name));
 }
 
-void
-log_msg_set_value_indirect_with_type(LogMessage *self, NVHandle handle,
-                                     NVHandle ref_handle, guint16 ofs, guint16 len,
-                                     LogMessageValueType type)
+static void
+_set_value_indirect(LogMessage *self, NVHandle handle, const gchar *name, gssize name_len,
+                    NVHandle ref_handle, guint32 ofs, guint32 len, LogMessageValueType type)
 {
-  const gchar *name;
-  gssize name_len;
   gboolean new_entry = FALSE;
 
-  g_assert(!log_msg_is_write_protected(self));
-
-  if (handle == LM_V_NONE)
-    return;
-
-  g_assert(handle >= LM_V_MAX);
-
-  name_len = 0;
-  name = log_msg_get_value_name(handle, &name_len);
-
   if (_log_name_value_updates(self))
     {
       msg_trace("Setting indirect value",
@@ -746,12 +734,6 @@ log_msg_set_value_indirect_with_type(LogMessage *self, NVHandle handle,
                 evt_tag_msg_reference(self));
     }
 
-  if (!log_msg_chk_flag(self, LF_STATE_OWN_PAYLOAD))
-    {
-      self->payload = nv_table_clone(self->payload, name_len + 1);
-      log_msg_set_flag(self, LF_STATE_OWN_PAYLOAD);
-    }
-
   NVReferencedSlice referenced_slice =
   {
     .handle = ref_handle,
@@ -778,6 +760,82 @@ log_msg_set_value_indirect_with_type(LogMessage *self, NVHandle handle,
   log_msg_update_num_matches(self, handle);
 }
 
+void
+log_msg_set_value_indirect_with_type(LogMessage *self, NVHandle handle,
+                                     NVHandle ref_handle, guint16 ofs, guint16 len,
+                                     LogMessageValueType type)
+{
+  const gchar *name;
+  gssize name_len;
+
+  g_assert(!log_msg_is_write_protected(self));
+
+  if (handle == LM_V_NONE)
+    return;
+
+  g_assert(handle >= LM_V_MAX);
+
+  name_len = 0;
+  name = log_msg_get_value_name(handle, &name_len);
+
+  if (!log_msg_chk_flag(self, LF_STATE_OWN_PAYLOAD))
+    {
+      self->payload = nv_table_clone_layered(self->payload, name_len + 1);
+      log_msg_set_flag(self, LF_STATE_OWN_PAYLOAD);
+    }
+
+  _set_value_indirect(self, handle, name, name_len, ref_handle, ofs, len, type);
+}
+
+/*
+ * Sets @handle to the range [@ofs, @ofs + @len) of the value @ref_handle,
+ * without copying it.  Unlike log_msg_set_value_indirect(), this works for
+ * builtin values as well, which are expected to be NUL terminated: the
+ * character following the range is replaced by a NUL in the referenced
+ * value.  This is only usable on values that are private to the caller,
+ * like the buffer stored by syslog-parser in zero-copy mode.
+ */
+void
+log_msg_set_value_slice(LogMessage *self, NVHandle handle, NVHandle ref_handle, guint32 ofs, guint32 len)
+{
+  NVIndexEntry *index_entry, *index_slot;
+  const gchar *name;
+  gssize name_len;
+
+  g_assert(!log_msg_is_write_protected(self));
+
+  if (handle == LM_V_NONE)
+    return;
+
+  name_len = 0;
+  name = log_msg_get_value_name(handle, &name_len);
+
+  if (!log_msg_chk_flag(self, LF_STATE_OWN_PAYLOAD))
+    {
+      self->payload = nv_table_clone(self->payload, name_len + 1);
+      log_msg_set_flag(self, LF_STATE_OWN_PAYLOAD);
+    }
+  else if (self->payload->layered)
+    {
+      /* the referenced value is changed in place below, it must not be
+       * shared with the parent of the payload */
+      NVTable *flat = nv_table_compact(self->payload);
+
+      nv_table_unref(self->payload);
+      self->payload = flat;
+    }
+
+  NVEntry *ref_entry = nv_table_get_entry(self->payload, ref_handle, &index_entry, &index_slot);
+  g_assert(ref_entry && !ref_entry->indirect && handle != ref_handle);
+  g_assert(ofs + len <= ref_entry->vdirect.value_len);
+
+  ref_entry->vdirect.data[ref_entry->name_len + 1 + ofs + len] = 0;
+  _set_value_indirect(self, handle, name, name_len, ref_handle, ofs, len, LM_VT_STRING);
+
+  if (_value_invalidates_legacy_header(handle))
+    log_msg_unset_value(self, LM_V_LEGACY_MSGHDR);
+}
+
 void
 log_msg_set_value_indirect(LogMessage *self, NVHandle handle, NVHandle ref_handle,
                            guint16 ofs, guint16 len)
@@ -1363,6 +1421,92 @@ log_msg_init(LogMessage *self)
   log_msg_set_host_id(self);
 }
 
+struct _LogMessageCachedValue
+{
+  LogMessageCachedValue *next;
+  guint64 key;
+  guint32 owner_id;
+  LogMessageValueType type;
+  gsize value_len;
+  gchar value[];
+};
+
+const gchar *
+log_msg_lookup_cached_value(LogMessage *self, guint32 owner_id, guint64 key,
+                            gssize *value_len, LogMessageValueType *type)
+{
+  /* entries are never removed while the message is alive, the list can be
+   * walked without locking */
+  for (LogMessageCachedValue *entry = g_atomic_pointer_get(&self->cached_values); entry; entry = entry->next)
+    {
+      if (entry->owner_id == owner_id && entry->key == key)
+        {
+          if (value_len)
+            *value_len = entry->value_len;
+          if (type)
+            *type = entry->type;
+          return entry->value;
+        }
+    }
+  return NULL;
+}
+
+void
+log_msg_store_cached_value(LogMessage *self, guint32 owner_id, guint64 key,
+                           const gchar *value, gssize value_len, LogMessageValueType type)
+{
+  LogMessageCachedValue *entry;
+
+  if (!log_msg_is_write_protected(self))
+    return;
+
+  if (value_len < 0)
+    value_len = strlen(value);
+
+  gsize entry_size = sizeof(LogMessageCachedValue) + value_len + 1;
+  if (entry_size > LOGMSG_CACHED_VALUES_MAX_SIZE)
+    return;
+
+  if (g_atomic_int_add(&self->cached_values_size, (gint) entry_size) + entry_size > LOGMSG_CACHED_VALUES_MAX_SIZE)
+    {
+      g_atomic_int_add(&self->cached_values_size, -(gint) entry_size);
+      return;
+    }
+  stats_counter_add(count_allocated_bytes, entry_size);
+
+  entry = g_malloc(entry_size);
+  entry->owner_id = owner_id;
+  entry->key = key;
+  entry->type = type;
+  entry->value_len = value_len;
+  memcpy(entry->value, value, value_len);
+  entry->value[value_len] = 0;
+
+  /* concurrent stores of the same value may both succeed, in which case
+   * the entry inserted last shadows the other one, which is harmless */
+  do
+    entry->next = g_atomic_pointer_get(&self->cached_values);
+  while (!g_atomic_pointer_compare_and_exchange(&self->cached_values, entry->next, entry));
+}
+
+static void
+log_msg_free_cached_values(LogMessage *self)
+{
+  LogMessageCachedValue *entry = self->cached_values;
+
+  while (entry)
+    {
+      LogMessageCachedValue *next = entry->next;
+
+      g_free(entry);
+      entry = next;
+    }
+  self->cached_values = NULL;
+
+  stats_counter_sub(count_allocated_bytes, self->cached_values_size);
+  self->cached_values_size = 0;
+}
+
 void
 log_msg_clear(LogMessage *self)
 {
@@ -1400,6 +1544,8 @@ log_msg_clear(LogMessage *self)
     g_sockaddr_unref(self->daddr);
   self->daddr = NULL;
 
+  log_msg_free_cached_values(self);
+
   /* clear "local", "utf8", "internal", "mark" and similar flags, we start afresh */
   self->flags = LF_STATE_OWN_MASK;
 }
@@ -1422,7 +1568,7 @@ log_msg_alloc(gsize payload_size)
       payload_ofs = alloc_size;
       alloc_size += payload_space;
     }
-  msg = g_malloc(alloc_size);
+  msg = log_msg_slab_alloc(alloc_size);
 
   memset(msg, 0, sizeof(LogMessage));
 
@@ -1500,6 +1646,8 @@ log_msg_clone_cow(LogMessage *msg, const LogPathOptions *path_options)
                                                 0) + LOGMSG_REFCACHE_ABORT_TO_VALUE(0);
   self->cur_node = 0;
   self->write_protected = FALSE;
+  self->cached_values = NULL;
+  self->cached_values_size = 0;
 
   log_msg_add_ack(self, path_options);
   if (!path_options->ack_needed)
@@ -1613,9 +1761,10 @@ log_msg_free(LogMessage *self)
   if (self->original)
     log_msg_unref(self->original);
 
+  log_msg_free_cached_values(self);
   stats_counter_sub(count_allocated_bytes, self->allocated_bytes);
 
-  g_free(self);
+  log_msg_slab_free(self);
 }
 
 /**
@@ -2082,11 +2231,14 @@ log_msg_register_stats(void)
   stats_cluster_single_key_add_legacy_alias(&sc_key, SCS_GLOBAL, "msg_allocated_bytes", NULL);
   stats_register_counter(1, &sc_key, SC_TYPE_SINGLE_VALUE, &count_allocated_bytes);
   stats_unlock();
+
+  log_msg_slab_register_stats();
 }
 
 void
 log_msg_global_init(void)
 {
+  log_msg_slab_global_init();
   log_msg_registry_init();
   log_tags_global_init();
   log_msg_tags_init();
@@ -2109,6 +2261,7 @@ log_msg_global_deinit(void)
 {
   log_tags_global_deinit();
   log_msg_registry_deinit();
+  log_msg_slab_global_deinit();
 }
 
 gint
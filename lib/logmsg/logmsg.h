@@ -64,6 +64,9 @@ typedef void (*LMAckFunc)(LogMessage *lm, AckType ack_type);
 
 #define LOGMSG_MAX_MATCHES 256
 
+/* upper limit of the memory taken by the cached values of a message */
+#define LOGMSG_CACHED_VALUES_MAX_SIZE 16384
+
 typedef enum
 {
   LM_TS_STAMP = 0,
@@ -102,6 +105,9 @@ enum
   LM_V_PREDEFINED_MAX,
 };
 
+/* NVTable stores the number of static entries on 7 bits */
+G_STATIC_ASSERT(LM_V_MAX < 128);
+
 enum
 {
   /* means that the message is not valid utf8 */
@@ -214,10 +220,14 @@ typedef struct _LogMessageQueueNode
   guint ack_needed:1, embedded:1, flow_control_requested:1;
 } LogMessageQueueNode;
 
+typedef struct _LogMessageCachedValue LogMessageCachedValue;
 
 /* NOTE: the members are ordered according to the presumed use frequency.
- * The structure itself is 2 cachelines, the border is right after the "msg"
- * member */
+ * Everything that is touched when a message is routed through filters and
+ * templates (refcount, flags, payload, tags, the most important
+ * timestamps) is in the first cacheline, see the static assertions below
+ * the struct.  Members related to acknowledgement, queueing and the
+ * network addresses follow. */
 struct _LogMessage
 {
   /* if you change any of the fields here, be sure to adjust
@@ -229,25 +239,8 @@ struct _LogMessage
    * a lot of magic behind its implementation.  See the logmsg.c file, around
    * log_msg_ref/unref.
    */
-
-  /* FIXME: the structure has holes, but right now it's 1 byte short to make
-   * it smaller (it is possible to create a 7 byte contiguos block but 8
-   * byte alignment is needed. Let's check this with the inline-tags stuff */
-
   gint ack_and_ref_and_abort_and_suspended;
 
-  /* NOTE: in theory this should be a size_t (or gsize), however that takes
-   * 8 bytes, and it's highly unlikely that we'd be using more than 4GB for
-   * a LogMessage */
-
-  guint allocated_bytes;
-
-  guint32 recvd_rawmsg_size;
-
-  AckRecord *ack_record;
-  LMAckFunc ack_func;
-  LogMessage *original;
-
   /* message parts */
 
   /* the contents of the members below is directly copied into another
@@ -256,15 +249,10 @@ struct _LogMessage
    * correctly.
    */
   /* ==== start of directly copied part ==== */
-  UnixTime timestamps[LM_TS_MAX];
-  gulong *tags;
-  NVHandle *sdata;
-
-  GSockAddr *saddr;
-  GSockAddr *daddr;
+  guint32 flags;
   NVTable *payload;
+  gulong *tags;
 
-  guint32 flags;
   guint16 pri;
   guint8 initial_parse:1,
          recursed:1,
@@ -278,17 +266,41 @@ struct _LogMessage
 
          proto:6;
   guint8 num_matches;
-  guint32 host_id;
-  guint64 rcptid;
   guint8 num_tags;
   guint8 alloc_sdata;
   guint8 num_sdata;
+  /* not copied, it is here to fill the hole before timestamps */
+  guint8 write_protected;
+
+  UnixTime timestamps[LM_TS_MAX];
+  NVHandle *sdata;
+
+  GSockAddr *saddr;
+  GSockAddr *daddr;
+
+  guint32 host_id;
+  guint64 rcptid;
   /* ==== end of directly copied part ==== */
 
+  /* NOTE: in theory this should be a size_t (or gsize), however that takes
+   * 8 bytes, and it's highly unlikely that we'd be using more than 4GB for
+   * a LogMessage */
+
+  guint allocated_bytes;
+
+  guint32 recvd_rawmsg_size;
+
+  AckRecord *ack_record;
+  LMAckFunc ack_func;
+  LogMessage *original;
+
+  /* memoized results computed from this message once it was write
+   * protected, see log_msg_lookup_cached_value() */
+  LogMessageCachedValue *cached_values;
+  gint cached_values_size;
+
   guint8 num_nodes;
   guint8 cur_node;
-  guint8 write_protected;
-
 
   /* preallocated LogQueueNodes used to insert this message into a LogQueue */
   LogMessageQueueNode nodes[0];
@@ -296,6 +308,10 @@ struct _LogMessage
   /* a preallocated space for the initial NVTable (payload) may follow */
 };
 
+/* the members used on the filter/template hot path share the first cacheline */
+G_STATIC_ASSERT(G_STRUCT_OFFSET(LogMessage, write_protected) < 64);
+G_STATIC_ASSERT(G_STRUCT_OFFSET(LogMessage, timestamps[LM_TS_RECVD]) + sizeof(UnixTime) <= 64);
+
 extern NVRegistry *logmsg_registry;
 extern const char logmsg_sd_prefix[];
 extern const gint logmsg_sd_prefix_len;
@@ -314,6 +330,28 @@ log_msg_is_write_protected(const LogMessage *self)
 LogMessage *log_msg_clone_cow(LogMessage *msg, const LogPathOptions *path_options);
 LogMessage *log_msg_make_writable(LogMessage **pmsg, const LogPathOptions *path_options);
 
+/*
+ * A write protected message cannot change anymore (modifications need
+ * log_msg_make_writable(), which creates a new LogMessage instance), so
+ * values derived from it (e.g. rendered templates) can be stored along the
+ * message and reused by everyone processing the same instance.  Entries
+ * are identified by an owner_id (unique to the code storing them, e.g. a
+ * compiled template) and a key (e.g. a hash of evaluation options).
+ *
+ * Lookups and stores are lock free and may be done from multiple threads.
+ * Storing into a writable message is a no-op.
+ *
+ * The message may already sit in queues when a value is stored, whose
+ * memory usage was accounted when the message was pushed, so cached values
+ * are not part of allocated_bytes.  They are only counted by the global
+ * allocated bytes counter, and values are not cached beyond
+ * LOGMSG_CACHED_VALUES_MAX_SIZE, limiting what the queues do not see.
+ */
+const gchar *log_msg_lookup_cached_value(LogMessage *self, guint32 owner_id, guint64 key,
+                                         gssize *value_len, LogMessageValueType *type);
+void log_msg_store_cached_value(LogMessage *self, guint32 owner_id, guint64 key,
+                                const gchar *value, gssize value_len, LogMessageValueType type);
+
 gboolean log_msg_write(LogMessage *self, SerializeArchive *sa);
 gboolean log_msg_read(LogMessage *self, SerializeArchive *sa);
 
@@ -439,6 +477,7 @@ void log_msg_set_value_indirect(LogMessage *self, NVHandle handle, NVHandle ref_
                                 guint16 ofs, guint16 len);
 void log_msg_set_value_indirect_with_type(LogMessage *self, NVHandle handle, NVHandle ref_handle,
                                           guint16 ofs, guint16 len, LogMessageValueType type);
+void log_msg_set_value_slice(LogMessage *self, NVHandle handle, NVHandle ref_handle, guint32 ofs, guint32 len);
 void log_msg_unset_value(LogMessage *self, NVHandle handle);
 void log_msg_unset_value_by_name(LogMessage *self, const gchar *name);
 gboolean log_msg_values_foreach(const LogMessage *self, NVTableForeachFunc func, gpointer user_data);
@@ -27,6 +27,8 @@
 #include "nvtable-serialize-legacy.h"
 #include "nvtable-serialize-endianutils.h"
 #include "nvtable-serialize.h"
+#include "logmsg.h"
+#include "logmsg-slab.h"
 #include "syslog-ng.h"
 #include <string.h>
 
@@ -279,6 +281,7 @@ NVTable *
 nv_table_deserialize_22(SerializeArchive *sa)
 {
   guint16 old_res;
+  guint8 num_static_entries;
   guint32 magic = 0;
   guint8 flags = 0;
   NVTable *res = NULL;
@@ -297,52 +300,52 @@ nv_table_deserialize_22(SerializeArchive *sa)
   if (memcmp(&magic, NV_TABLE_MAGIC_V2, 4) != 0)
     return NULL;
 
-  res = (NVTable *)g_malloc(sizeof(NVTable));
+  res = (NVTable *) log_msg_slab_alloc(sizeof(NVTable));
 
   if (!serialize_read_uint16(sa, &old_res))
     {
-      g_free(res);
+      log_msg_slab_free(res);
       return NULL;
     }
   res->size = old_res << NV_TABLE_OLD_SCALE;
 
   if (!serialize_read_uint16(sa, &old_res))
     {
-      g_free(res);
+      log_msg_slab_free(res);
       return NULL;
     }
   res->used = old_res << NV_TABLE_OLD_SCALE;
 
   if (!serialize_read_uint16(sa, &res->index_size))
     {
-      g_free(res);
+      log_msg_slab_free(res);
       return NULL;
     }
 
-  if (!serialize_read_uint8(sa, &res->num_static_entries))
+  if (!serialize_read_uint8(sa, &num_static_entries) || num_static_entries > LM_V_MAX)
     {
-      g_free(res);
+      log_msg_slab_free(res);
       return NULL;
     }
+  res->num_static_entries = num_static_entries;
 
   res->size = _calculate_new_size(res);
-  res = (NVTable *)g_realloc(res, res->size);
-  if(!res)
-    return NULL;
+  res = (NVTable *) log_msg_slab_realloc(res, res->size);
 
   res->ref_cnt = 1;
+  res->layered = FALSE;
   res->borrowed = FALSE;
 
   if (!_deserialize_struct_22(sa, res))
     {
-      g_free(res);
+      log_msg_slab_free(res);
       return NULL;
     }
 
   different_endianness = (is_big_endian != (flags & NVT_SF_BE));
   if (!_deserialize_blob_v22(sa, res, nv_table_get_top(res), different_endianness))
     {
-      g_free(res);
+      log_msg_slab_free(res);
       return NULL;
     }
 
@@ -365,7 +368,7 @@ static inline guint32 *_get_legacy_dynamic_entries(OldNVTable *old)
 static NVTable *
 _create_new_nvtable_from_legacy_nvtable(OldNVTable *old)
 {
-  NVTable *res = g_try_malloc(_calculate_new_size_from_legacy_nvtable(old));
+  NVTable *res = log_msg_slab_alloc(_calculate_new_size_from_legacy_nvtable(old));
   NVIndexEntry *dyn_entries;
   guint32 *old_entries;
   int i;
@@ -453,25 +456,24 @@ nv_table_deserialize_legacy(SerializeArchive *sa)
   if (swap_bytes)
     _struct_swap_bytes_legacy(tmp);
 
-  res = _create_new_nvtable_from_legacy_nvtable(tmp);
-  if (!res)
+  if (tmp->num_static_entries > LM_V_MAX)
     {
       g_free(tmp);
       return NULL;
     }
-  g_free(tmp);
 
-  res = (NVTable *)g_try_realloc(res, res->size);
+  res = _create_new_nvtable_from_legacy_nvtable(tmp);
+  g_free(tmp);
 
-  if (!res)
-    return NULL;
+  res = (NVTable *) log_msg_slab_realloc(res, res->size);
 
   res->borrowed = FALSE;
+  res->layered = FALSE;
   res->ref_cnt = 1;
 
   if (!_deserialize_blob_v22(sa, res, nv_table_get_top(res), swap_bytes))
     {
-      g_free(res);
+      log_msg_slab_free(res);
       return NULL;
     }
 
@@ -27,6 +27,7 @@
 #include "logmsg/nvtable-serialize.h"
 #include "logmsg/nvtable-serialize-endianutils.h"
 #include "logmsg/logmsg.h"
+#include "logmsg/logmsg-slab.h"
 #include "messages.h"
 
 #include <stdlib.h>
@@ -116,6 +117,7 @@ _read_header(SerializeArchive *sa, NVTable **nvtable)
 {
   NVTable *res = NULL;
   guint32 size;
+  guint8 num_static_entries;
 
   g_assert(*nvtable == NULL);
 
@@ -125,7 +127,7 @@ _read_header(SerializeArchive *sa, NVTable **nvtable)
   if (size > NV_TABLE_MAX_BYTES)
     goto error;
 
-  res = (NVTable *) g_malloc(size);
+  res = (NVTable *) log_msg_slab_alloc(size);
   res->size = size;
 
   if (!serialize_read_uint32(sa, &res->used))
@@ -134,7 +136,7 @@ _read_header(SerializeArchive *sa, NVTable **nvtable)
   if (!serialize_read_uint16(sa, &res->index_size))
     goto error;
 
-  if (!serialize_read_uint8(sa, &res->num_static_entries))
+  if (!serialize_read_uint8(sa, &num_static_entries))
     goto error;
 
   /* static entries has to be known by this syslog-ng, if they are over
@@ -142,21 +144,23 @@ _read_header(SerializeArchive *sa, NVTable **nvtable)
    * entries don't contain names.  If there are less static entries, that
    * can be ok. */
 
-  if (res->num_static_entries > LM_V_MAX)
+  if (num_static_entries > LM_V_MAX)
     goto error;
+  res->num_static_entries = num_static_entries;
 
   /* validates self->used and self->index_size value as compared to "size" */
   if (!nv_table_alloc_check(res, 0))
     goto error;
 
   res->borrowed = FALSE;
+  res->layered = FALSE;
   res->ref_cnt = 1;
   *nvtable = res;
   return TRUE;
 
 error:
   if (res)
-    g_free(res);
+    log_msg_slab_free(res);
   return FALSE;
 }
 
@@ -195,7 +199,7 @@ nv_table_deserialize(LogMessageSerializationState *state)
 
 error:
   if (res)
-    g_free(res);
+    log_msg_slab_free(res);
   return NULL;
 }
 
@@ -22,6 +22,7 @@
  *
  */
 #include "logmsg/nvtable.h"
+#include "logmsg/logmsg-slab.h"
 #include "messages.h"
 
 #include <string.h>
@@ -29,17 +30,126 @@
 
 static GMutex nv_registry_lock;
 
+/* initial size of a layer, enough for a couple of overridden values */
+#define NV_TABLE_LAYER_INDEX_SIZE_HINT  4
+#define NV_TABLE_LAYER_INIT_LENGTH      256
+
+#define NV_REGISTRY_INDEX_INITIAL_SIZE 1024
+
 const gchar *null_string = "";
 
+/*
+ * NVRegistryIndex is an insert-only, open addressing hash table that
+ * mirrors name_map, so that resolving already registered names does not
+ * need nv_registry_lock.
+ *
+ * Slots are only written with nv_registry_lock held, a slot is published
+ * by setting its name pointer last, readers don't look at slots with a
+ * NULL name.  When the index needs to grow, a new one is built and
+ * published by swapping the pointer in NVRegistry.  The old one is kept
+ * until the registry is freed, as readers may still be using it (the same
+ * way NVHandleDescArray keeps its old buffers).
+ */
+typedef struct _NVRegistryIndexSlot
+{
+  const gchar *name;
+  guint hash;
+  NVHandle handle;
+} NVRegistryIndexSlot;
+
+struct _NVRegistryIndex
+{
+  guint mask;
+  guint num_entries;
+  NVRegistryIndexSlot slots[0];
+};
+
+static NVRegistryIndex *
+nv_registry_index_new(guint size)
+{
+  NVRegistryIndex *self = g_malloc0(sizeof(NVRegistryIndex) + size * sizeof(NVRegistryIndexSlot));
+
+  g_assert((size & (size - 1)) == 0);
+  self->mask = size - 1;
+  return self;
+}
+
+static NVHandle
+nv_registry_index_lookup(NVRegistryIndex *self, const gchar *name, guint hash)
+{
+  for (guint i = hash & self->mask; ; i = (i + 1) & self->mask)
+    {
+      NVRegistryIndexSlot *slot = &self->slots[i];
+      const gchar *slot_name = g_atomic_pointer_get(&slot->name);
+
+      /* the index is at most half full, so we always find an empty slot */
+      if (!slot_name)
+        return 0;
+      if (slot->hash == hash && strcmp(slot_name, name) == 0)
+        return (NVHandle) g_atomic_int_get((gint *) &slot->handle);
+    }
+}
+
+/* must be called with nv_registry_lock held */
+static void
+nv_registry_index_insert(NVRegistryIndex *self, const gchar *name, guint hash, NVHandle handle)
+{
+  for (guint i = hash & self->mask; ; i = (i + 1) & self->mask)
+    {
+      NVRegistryIndexSlot *slot = &self->slots[i];
+
+      if (!slot->name)
+        {
+          slot->hash = hash;
+          slot->handle = handle;
+          g_atomic_pointer_set(&slot->name, name);
+          self->num_entries++;
+          return;
+        }
+      if (slot->hash == hash && strcmp(slot->name, name) == 0)
+        {
+          /* an alias may be redefined */
+          g_atomic_int_set((gint *) &slot->handle, handle);
+          return;
+        }
+    }
+}
+
+/* must be called with nv_registry_lock held */
+static void
+_register_name(NVRegistry *self, const gchar *name, NVHandle handle)
+{
+  NVRegistryIndex *index = self->lookup_index;
+  gpointer key;
+
+  g_hash_table_insert(self->name_map, g_strdup(name), GUINT_TO_POINTER((glong) handle));
+  /* the key of an already existing name is kept by GHashTable, use that */
+  g_hash_table_lookup_extended(self->name_map, name, &key, NULL);
+
+  if ((index->num_entries + 1) * 2 > index->mask + 1)
+    {
+      NVRegistryIndex *new_index = nv_registry_index_new((index->mask + 1) * 2);
+
+      for (guint i = 0; i <= index->mask; i++)
+        {
+          NVRegistryIndexSlot *slot = &index->slots[i];
+
+          if (slot->name)
+            nv_registry_index_insert(new_index, slot->name, slot->hash, slot->handle);
+        }
+      g_ptr_array_add(self->old_lookup_indexes, index);
+      g_atomic_pointer_set(&self->lookup_index, new_index);
+      index = new_index;
+    }
+  nv_registry_index_insert(index, (const gchar *) key, g_str_hash(name), handle);
+}
+
 NVHandle
 nv_registry_get_handle(NVRegistry *self, const gchar *name)
 {
-  gpointer p;
+  NVRegistryIndex *index = g_atomic_pointer_get(&self->lookup_index);
 
-  p = g_hash_table_lookup(self->name_map, name);
-  if (p)
-    return GPOINTER_TO_UINT(p);
-  return 0;
+  return nv_registry_index_lookup(index, name, g_str_hash(name));
 }
 
 NVHandle
@@ -50,6 +160,11 @@ nv_registry_alloc_handle(NVRegistry *self, const gchar *name)
   gsize len;
   NVHandle res = 0;
 
+  /* fast path: names are registered once, but resolved all the time */
+  res = nv_registry_get_handle(self, name);
+  if (res)
+    return res;
+
   g_mutex_lock(&nv_registry_lock);
   p = g_hash_table_lookup(self->name_map, name);
   if (p)
@@ -85,7 +200,7 @@ nv_registry_alloc_handle(NVRegistry *self, const gchar *name)
   stored.name_len = len;
   stored.name = g_strdup(name);
   nvhandle_desc_array_append(self->names, &stored);
-  g_hash_table_insert(self->name_map, g_strdup(name), GUINT_TO_POINTER(self->names->len));
+  _register_name(self, name, self->names->len);
   res = self->names->len;
 exit:
   g_mutex_unlock(&nv_registry_lock);
@@ -101,7 +216,7 @@ void
 nv_registry_add_alias(NVRegistry *self, NVHandle handle, const gchar *alias)
 {
   g_mutex_lock(&nv_registry_lock);
-  g_hash_table_insert(self->name_map, g_strdup(alias), GUINT_TO_POINTER((glong) handle));
+  _register_name(self, alias, handle);
   g_mutex_unlock(&nv_registry_lock);
 }
 
@@ -147,6 +262,8 @@ nv_registry_new(const gchar **static_names, guint32 nvhandle_max_value)
 
   self->nvhandle_max_value = nvhandle_max_value;
   self->name_map = g_hash_table_new_full(g_str_hash, g_str_equal, g_free, NULL);
+  self->lookup_index = nv_registry_index_new(NV_REGISTRY_INDEX_INITIAL_SIZE);
+  self->old_lookup_indexes = g_ptr_array_new_with_free_func(g_free);
   self->names = nvhandle_desc_array_new(NVHANDLE_DESC_ARRAY_INITIAL_SIZE);
   for (i = 0; static_names[i]; i++)
     {
@@ -159,6 +276,8 @@ void
 nv_registry_free(NVRegistry *self)
 {
   nvhandle_desc_array_free(self->names);
+  g_free(self->lookup_index);
+  g_ptr_array_free(self->old_lookup_indexes, TRUE);
   g_hash_table_destroy(self->name_map);
   g_free(self);
 }
@@ -209,13 +328,17 @@ nv_table_resolve_indirect(NVTable *self, NVEntry *entry, gssize *length)
       return null_string;
     }
 
+  gssize resolved_length = MIN(entry->vindirect.ofs + entry->vindirect.len, referenced_length) - entry->vindirect.ofs;
+
   /* here we assume that indirect references are only looked up with
    * non-zero terminated strings properly handled, thus the caller has
-   * to supply a non-NULL value_len */
+   * to supply a non-NULL value_len, unless the referenced range was
+   * explicitly terminated, see log_msg_set_value_slice() */
 
-  g_assert(length != NULL);
+  g_assert(length != NULL || referenced_value[entry->vindirect.ofs + resolved_length] == '\0');
 
-  *length = MIN(entry->vindirect.ofs + entry->vindirect.len, referenced_length) - entry->vindirect.ofs;
+  if (length)
+    *length = resolved_length;
   return referenced_value + entry->vindirect.ofs;
 }
 
@@ -388,11 +511,52 @@ _make_entry_direct(NVHandle handle, NVEntry *entry, NVIndexEntry *index_entry, g
   return FALSE;
 }
 
+static gboolean
+_collect_referencing_entry(NVHandle handle, NVEntry *entry, NVIndexEntry *index_entry, gpointer user_data)
+{
+  GArray *handles = (GArray *) (((gpointer *) user_data)[0]);
+  NVHandle ref_handle = GPOINTER_TO_UINT(((gpointer *) user_data)[1]);
+
+  if (entry->indirect && entry->vindirect.handle == ref_handle)
+    g_array_append_val(handles, handle);
+  return FALSE;
+}
+
+/* In a layered table the referencing entries may be inherited, these are
+ * copied into the layer as direct values, which adds new entries to the
+ * index, so they are collected first instead of being converted while
+ * iterating. */
+static gboolean
+nv_table_break_references_in_layers(NVTable *self, NVHandle handle)
+{
+  GArray *handles = g_array_new(FALSE, FALSE, sizeof(NVHandle));
+  gpointer data[2] = { handles, GUINT_TO_POINTER((glong) handle) };
+  gboolean success = TRUE;
+
+  nv_table_foreach_entry(self, _collect_referencing_entry, data);
+  for (guint i = 0; success && i < handles->len; i++)
+    {
+      NVHandle referencing_handle = g_array_index(handles, NVHandle, i);
+      NVEntry *entry = nv_table_get_entry(self, referencing_handle, NULL, NULL);
+      const gchar *value;
+      gssize value_len;
+
+      value = nv_table_resolve_indirect(self, entry, &value_len);
+      success = nv_table_add_value(self, referencing_handle, entry->vindirect.name, entry->name_len,
+                                   value, value_len, entry->type, NULL);
+    }
+  g_array_free(handles, TRUE);
+  return success;
+}
+
 static inline gboolean
 nv_table_break_references_to_entry(NVTable *self, NVHandle handle, NVEntry *entry)
 {
   if (G_UNLIKELY(entry && !entry->indirect && entry->referenced))
     {
+      if (self->layered)
+        return nv_table_break_references_in_layers(self, handle);
+
       gpointer data[2] = { self, GUINT_TO_POINTER((glong) handle) };
 
       if (nv_table_foreach_entry(self, _make_entry_direct, data))
@@ -406,6 +570,24 @@ nv_table_break_references_to_entry(NVTable *self, NVHandle handle, NVEntry *entr
   return TRUE;
 }
 
+/* Breaks the references to the entry that is about to be changed.  In a
+ * layered table this might be an inherited entry, which is shadowed by a
+ * new one in the layer.  index_entry/index_slot are looked up again, as
+ * breaking the references in a layered table may add entries to the index. */
+static inline gboolean
+nv_table_prepare_to_shadow(NVTable *self, NVHandle handle, NVEntry *entry, NVEntry *inherited_entry,
+                           NVIndexEntry **index_entry, NVIndexEntry **index_slot)
+{
+  NVEntry *changed_entry = entry ? entry : inherited_entry;
+
+  if (!nv_table_break_references_to_entry(self, handle, changed_entry))
+    return FALSE;
+
+  if (G_UNLIKELY(self->layered && changed_entry && !changed_entry->indirect && changed_entry->referenced))
+    nv_table_get_own_entry(self, handle, index_entry, index_slot);
+  return TRUE;
+}
+
 static inline void
 _overwrite_with_a_direct_entry(NVTable *self, NVHandle handle, NVEntry *entry, const gchar *name, gsize name_len,
                                const gchar *value, gsize value_len, NVType type)
@@ -453,7 +635,7 @@ nv_table_add_value(NVTable *self, NVHandle handle,
                    NVType type,
                    gboolean *new_entry)
 {
-  NVEntry *entry;
+  NVEntry *entry, *inherited_entry;
   guint32 ofs;
   NVIndexEntry *index_entry, *index_slot;
 
@@ -461,8 +643,9 @@ nv_table_add_value(NVTable *self, NVHandle handle,
     value_len = NV_TABLE_MAX_BYTES;
   if (new_entry)
     *new_entry = FALSE;
-  entry = nv_table_get_entry(self, handle, &index_entry, &index_slot);
-  if (!nv_table_break_references_to_entry(self, handle, entry))
+  entry = nv_table_get_own_entry(self, handle, &index_entry, &index_slot);
+  inherited_entry = entry ? NULL : nv_table_get_inherited_entry(self, handle);
+  if (!nv_table_prepare_to_shadow(self, handle, entry, inherited_entry, &index_entry, &index_slot))
     return FALSE;
 
   if (entry && entry->alloc_len >= NV_ENTRY_DIRECT_SIZE(entry->name_len, value_len))
@@ -470,7 +653,7 @@ nv_table_add_value(NVTable *self, NVHandle handle,
       _overwrite_with_a_direct_entry(self, handle, entry, name, name_len, value, value_len, type);
       return TRUE;
     }
-  else if (!entry && new_entry)
+  else if (!entry && !inherited_entry && new_entry)
     *new_entry = TRUE;
 
   /* check if there's enough free space: size of the struct plus the
@@ -507,10 +690,21 @@ gboolean
 nv_table_unset_value(NVTable *self, NVHandle handle)
 {
   NVIndexEntry *index_entry;
-  NVEntry *entry = nv_table_get_entry(self, handle, &index_entry, NULL);
+  NVEntry *entry = nv_table_get_own_entry(self, handle, &index_entry, NULL);
 
   if (!entry)
-    return TRUE;
+    {
+      NVEntry *inherited_entry = nv_table_get_inherited_entry(self, handle);
+
+      if (!inherited_entry || inherited_entry->unset)
+        return TRUE;
+
+      /* shadow the inherited value with an empty one, which is marked as unset below */
+      if (!nv_table_add_value(self, handle, nv_entry_get_name(inherited_entry), inherited_entry->name_len,
+                              null_string, 0, 0, NULL))
+        return FALSE;
+      entry = nv_table_get_own_entry(self, handle, &index_entry, NULL);
+    }
 
   if (!nv_table_break_references_to_entry(self, handle, entry))
     return FALSE;
@@ -586,23 +780,32 @@ gboolean
 nv_table_add_value_indirect(NVTable *self, NVHandle handle, const gchar *name, gsize name_len,
                             NVReferencedSlice *referenced_slice, NVType type, gboolean *new_entry)
 {
-  NVEntry *entry, *ref_entry;
+  NVEntry *entry, *inherited_entry, *ref_entry;
   NVIndexEntry *index_entry, *index_slot;
   guint32 ofs;
+  gboolean ref_inherited = FALSE;
 
   if (new_entry)
     *new_entry = FALSE;
-  ref_entry = nv_table_get_entry(self, referenced_slice->handle, NULL, NULL);
+  ref_entry = nv_table_get_own_entry(self, referenced_slice->handle, NULL, NULL);
+  if (!ref_entry)
+    {
+      ref_entry = nv_table_get_inherited_entry(self, referenced_slice->handle);
+      ref_inherited = (ref_entry != NULL);
+    }
 
-  if ((ref_entry && ref_entry->indirect) || handle == referenced_slice->handle)
+  if ((ref_entry && ref_entry->indirect) || handle == referenced_slice->handle || ref_inherited)
     {
       /* NOTE: uh-oh, the to-be-referenced value is already an indirect
-       * reference, this is not supported, copy the stuff */
+       * reference, this is not supported, copy the stuff.  The same
+       * applies to values inherited by a layered table, as the entries
+       * of the parent can't be marked as referenced. */
       return nv_table_copy_referenced_value(self, ref_entry, handle, name, name_len, referenced_slice, type, new_entry);
     }
 
-  entry = nv_table_get_entry(self, handle, &index_entry, &index_slot);
-  if ((!entry && !new_entry && referenced_slice->len == 0) || !ref_entry)
+  entry = nv_table_get_own_entry(self, handle, &index_entry, &index_slot);
+  inherited_entry = entry ? NULL : nv_table_get_inherited_entry(self, handle);
+  if ((!entry && !inherited_entry && !new_entry && referenced_slice->len == 0) || !ref_entry)
     {
       /* we don't store zero length matches unless the caller is
        * interested in whether a new entry was created. It is used by
@@ -612,7 +815,7 @@ nv_table_add_value_indirect(NVTable *self, NVHandle handle, const gchar *name, g
       return TRUE;
     }
 
-  if (!nv_table_break_references_to_entry(self, handle, entry))
+  if (!nv_table_prepare_to_shadow(self, handle, entry, inherited_entry, &index_entry, &index_slot))
     return FALSE;
 
   if (entry && (entry->alloc_len >= NV_ENTRY_INDIRECT_SIZE(name_len)))
@@ -622,7 +825,7 @@ nv_table_add_value_indirect(NVTable *self, NVHandle handle, const gchar *name, g
       ref_entry->referenced = TRUE;
       return TRUE;
     }
-  else if (!entry && new_entry)
+  else if (!entry && !inherited_entry && new_entry)
     {
       *new_entry = TRUE;
     }
@@ -671,6 +874,64 @@ nv_table_foreach(NVTable *self, NVRegistry *registry, NVTableForeachFunc func, g
   return nv_table_foreach_entry(self, nv_table_call_foreach, data);
 }
 
+/* iterates over the entries of a layered table and the ones inherited from
+ * its parent, in the same (handle) order as nv_table_foreach_entry() */
+static gboolean
+_foreach_entry_layered(NVTable *self, NVTable *parent, NVTableForeachEntryFunc func, gpointer user_data)
+{
+  NVIndexEntry *index_table, *parent_index_table, *index_entry;
+  NVEntry *entry;
+  gint i, j;
+
+  for (i = 0; i < self->num_static_entries; i++)
+    {
+      entry = nv_table_get_entry_at_ofs(self, self->static_entries[i]);
+      if (!entry && i < parent->num_static_entries)
+        entry = nv_table_get_entry_at_ofs(parent, parent->static_entries[i]);
+      if (!entry)
+        continue;
+
+      if (func(i + 1, entry, NULL, user_data))
+        return TRUE;
+    }
+
+  /* merge the two sorted indexes, entries of the layer shadow the inherited ones */
+  index_table = nv_table_get_index(self);
+  parent_index_table = nv_table_get_index(parent);
+  i = j = 0;
+  while (i < self->index_size || j < parent->index_size)
+    {
+      if (j >= parent->index_size ||
+          (i < self->index_size && index_table[i].handle <= parent_index_table[j].handle))
+        {
+          index_entry = &index_table[i++];
+          entry = nv_table_get_entry_at_ofs(self, index_entry->ofs);
+
+          if (j < parent->index_size && index_entry->handle == parent_index_table[j].handle)
+            {
+              if (!entry)
+                {
+                  index_entry = &parent_index_table[j];
+                  entry = nv_table_get_entry_at_ofs(parent, index_entry->ofs);
+                }
+              j++;
+            }
+        }
+      else
+        {
+          index_entry = &parent_index_table[j++];
+          entry = nv_table_get_entry_at_ofs(parent, index_entry->ofs);
+        }
+
+      if (!entry)
+        continue;
+
+      if (func(index_entry->handle, entry, index_entry, user_data))
+        return TRUE;
+    }
+  return FALSE;
+}
+
 gboolean
 nv_table_foreach_entry(NVTable *self, NVTableForeachEntryFunc func, gpointer user_data)
 {
@@ -678,6 +939,9 @@ nv_table_foreach_entry(NVTable *self, NVTableForeachEntryFunc func, gpointer use
   NVEntry *entry;
   gint i;
 
+  if (G_UNLIKELY(self->layered))
+    return _foreach_entry_layered(self, nv_table_get_parent(self), func, user_data);
+
   for (i = 0; i < self->num_static_entries; i++)
     {
       entry = nv_table_get_entry_at_ofs(self, self->static_entries[i]);
@@ -712,6 +976,7 @@ nv_table_init(NVTable *self, gsize alloc_length, gint num_static_entries)
   self->index_size = 0;
   self->num_static_entries = num_static_entries;
   self->ref_cnt = 1;
+  self->layered = FALSE;
   self->borrowed = FALSE;
   memset(&self->static_entries[0], 0, self->num_static_entries * sizeof(self->static_entries[0]));
 }
@@ -723,7 +988,7 @@ nv_table_new(gint num_static_entries, gint index_size_hint, gint init_length)
   gsize alloc_length;
 
   alloc_length = nv_table_get_alloc_size(num_static_entries, index_size_hint, init_length);
-  self = (NVTable *) g_malloc(alloc_length);
+  self = (NVTable *) log_msg_slab_alloc(alloc_length);
 
   nv_table_init(self, alloc_length, num_static_entries);
   return self;
@@ -755,9 +1020,17 @@ nv_table_realloc(NVTable *self, NVTable **new_nv_table)
   if (new_size == old_size)
     return FALSE;
 
+  if (self->layered && new_size >= nv_table_get_parent(self)->size)
+    {
+      /* the layer is about to grow as large as its parent, flatten them */
+      *new_nv_table = nv_table_compact(self);
+      nv_table_unref(self);
+      return TRUE;
+    }
+
   if (self->ref_cnt == 1 && !self->borrowed)
     {
-      *new_nv_table = self = g_realloc(self, new_size);
+      *new_nv_table = self = log_msg_slab_realloc(self, new_size);
 
       self->size = new_size;
       /* move the downwards growing region to the end of the new buffer */
@@ -767,7 +1040,7 @@ nv_table_realloc(NVTable *self, NVTable **new_nv_table)
     }
   else
     {
-      *new_nv_table = g_malloc(new_size);
+      *new_nv_table = log_msg_slab_alloc(new_size);
 
       /* we only copy the header first */
       memcpy(*new_nv_table, self, sizeof(NVTable) + self->num_static_entries * sizeof(self->static_entries[0]) +
@@ -797,7 +1070,7 @@ nv_table_unref(NVTable *self)
 {
   if ((--self->ref_cnt == 0) && !self->borrowed)
     {
-      g_free(self);
+      log_msg_slab_free(self);
     }
 }
 
@@ -822,7 +1095,7 @@ nv_table_clone(NVTable *self, gint additional_space)
   if (new_size > NV_TABLE_MAX_BYTES)
     new_size = NV_TABLE_MAX_BYTES;
 
-  new = g_malloc(new_size);
+  new = log_msg_slab_alloc(new_size);
   memcpy(new, self, sizeof(NVTable) + self->num_static_entries * sizeof(self->static_entries[0]) + self->index_size *
          sizeof(NVIndexEntry));
   new->size = new_size;
@@ -836,6 +1109,37 @@ nv_table_clone(NVTable *self, gint additional_space)
   return new;
 }
 
+/**
+ * nv_table_clone_layered:
+ * @self: payload to clone
+ * @additional_space: specifies how much additional space is needed in
+ *                    the newly allocated clone
+ *
+ * Instead of copying @self, returns an empty layer on top of it.  @self
+ * is not referenced by the layer: it must not be changed or freed as long
+ * as the layer (or any clone of it) is in use.  Falls back to
+ * nv_table_clone() if @self is a layer itself.
+ **/
+NVTable *
+nv_table_clone_layered(NVTable *self, gint additional_space)
+{
+  NVTable *new;
+  gsize alloc_length;
+
+  if (self->layered)
+    return nv_table_clone(self, additional_space);
+
+  alloc_length = nv_table_get_alloc_size(self->num_static_entries, NV_TABLE_LAYER_INDEX_SIZE_HINT,
+                                         NV_TABLE_PARENT_SLOT_SIZE + NV_TABLE_LAYER_INIT_LENGTH + additional_space);
+  new = log_msg_slab_alloc(alloc_length);
+  nv_table_init(new, alloc_length, self->num_static_entries);
+
+  new->layered = TRUE;
+  new->used = NV_TABLE_PARENT_SLOT_SIZE;
+  memcpy(nv_table_get_top(new) - sizeof(self), &self, sizeof(self));
+  return new;
+}
+
 
 static gboolean
 _compact_foreach_entry(NVHandle handle, NVEntry *entry, NVIndexEntry *index_entry, gpointer user_data)
@@ -843,6 +1147,7 @@ _compact_foreach_entry(NVHandle handle, NVEntry *entry, NVIndexEntry *index_entr
   gpointer *args = (gpointer *) user_data;
   NVTable *old = (NVTable *) args[0];
   NVTable *new = (NVTable *) args[1];
+  gboolean indirect_pass = GPOINTER_TO_INT(args[2]);
   const gchar *value, *name;
   gssize value_len, name_len;
 
@@ -850,6 +1155,11 @@ _compact_foreach_entry(NVHandle handle, NVEntry *entry, NVIndexEntry *index_entr
   if (entry->unset)
     return FALSE;
 
+  /* direct entries are copied first, so that indirect ones find the
+   * values they reference, regardless of the order of handles */
+  if (entry->indirect != indirect_pass)
+    return FALSE;
+
   if (entry->name_len)
     {
       /* non-builtin entries have their name stored in the origin NVTable, use that */
@@ -898,11 +1208,19 @@ NVTable *
 nv_table_compact(NVTable *self)
 {
   gint new_size = self->size;
-  NVTable *new = g_malloc(new_size);
-  gpointer args[2] = { self, new };
+  NVTable *parent = nv_table_get_parent(self);
+
+  /* flattening a layered table needs the space of both */
+  if (parent)
+    new_size = MIN(new_size + parent->size, NV_TABLE_MAX_BYTES);
+
+  NVTable *new = log_msg_slab_alloc(new_size);
+  gpointer args[3] = { self, new, GINT_TO_POINTER(FALSE) };
 
   nv_table_init(new, new_size, self->num_static_entries);
 
+  nv_table_foreach_entry(self, _compact_foreach_entry, args);
+  args[2] = GINT_TO_POINTER(TRUE);
   nv_table_foreach_entry(self, _compact_foreach_entry, args);
   return new;
 }
@@ -28,8 +28,11 @@
 #include "syslog-ng.h"
 #include "nvhandle-descriptors.h"
 
+#include <string.h>
+
 typedef struct _NVTable NVTable;
 typedef struct _NVRegistry NVRegistry;
+typedef struct _NVRegistryIndex NVRegistryIndex;
 typedef struct _NVIndexEntry NVIndexEntry;
 typedef struct _NVEntry NVEntry;
 typedef guint32 NVHandle;
@@ -63,6 +66,9 @@ struct _NVRegistry
   gint num_static_names;
   NVHandleDescArray *names;
   GHashTable *name_map;
+  /* lock-free copy of name_map for lookups, see nv_registry_get_handle() */
+  NVRegistryIndex *lookup_index;
+  GPtrArray *old_lookup_indexes;
   guint32 nvhandle_max_value;
 };
 
@@ -251,6 +257,27 @@ nv_entry_get_name(NVEntry *self)
  *   - It is possible to clone an NVTable, which basically copies the
  *     underlying memory contents.
  *
+ * Layered tables
+ * ==============
+ *   - nv_table_clone_layered() creates a small, empty table on top of a
+ *     shared, read-only parent instead of copying it.  Lookups of values
+ *     not present in the layer fall through to the parent, changes only
+ *     touch the layer (unsetting an inherited value adds an unset entry).
+ *
+ *   - the parent pointer is stored at the top of the name-value area of the
+ *     layer.  The parent is not referenced by the layer, its owner has to
+ *     keep it alive (LogMessage does that through the reference of a
+ *     clone to its original message).  Parents are never layered
+ *     themselves, cloning a layer copies it and shares its parent.
+ *
+ *   - entries of the parent are never modified: indirect values in the
+ *     layer referring to inherited values are stored as copies and when an
+ *     inherited value referenced by other inherited values is changed,
+ *     those are copied into the layer first.
+ *
+ *   - when a layer would grow to the size of its parent, it is flattened
+ *     into a single table by nv_table_realloc().
+ *
  * Limits
  * ======
  * There might be various assumptions here and there in the code that fields
@@ -261,6 +288,9 @@ nv_entry_get_name(NVEntry *self)
  *     so 2^16 * sizeof(NVIndexEntry) is allocated at most (512k). If you
  *     however change this limit, please be careful to audit the
  *     deserialization code.
+ *   - num_static_entries shares its byte with the layered flag, so at most
+ *     127 static entries are supported (LM_V_MAX is checked at compile
+ *     time).
  *
  */
 struct _NVTable
@@ -273,7 +303,8 @@ struct _NVTable
    * the type of the original type, so it is compatible with earlier
    * versions, but index_size is a more descriptive name */
   guint16 index_size;
-  guint8 num_static_entries;
+  guint8 num_static_entries:7,
+         layered:1;  /* values not present in this table are inherited from a parent, see nv_table_clone_layered() */
   guint8 ref_cnt:7,
          borrowed:1; /* specifies if the memory used by NVTable was borrowed from the container struct */
 
@@ -297,6 +328,9 @@ struct _NVTable
  * static values */
 #define NV_TABLE_MIN_BYTES  128
 
+/* space reserved at the top of a layered table for the pointer of its parent */
+#define NV_TABLE_PARENT_SLOT_SIZE NV_TABLE_BOUND(sizeof(NVTable *))
+
 gboolean nv_table_add_value(NVTable *self, NVHandle handle,
                             const gchar *name, gsize name_len,
                             const gchar *value, gsize value_len,
@@ -315,6 +349,7 @@ NVTable *nv_table_init_borrowed(gpointer space, gsize space_len, gint num_static
 gboolean nv_table_realloc(NVTable *self, NVTable **new_nv_table);
 NVTable *nv_table_compact(NVTable *self);
 NVTable *nv_table_clone(NVTable *self, gint additional_space);
+NVTable *nv_table_clone_layered(NVTable *self, gint additional_space);
 NVTable *nv_table_ref(NVTable *self);
 void nv_table_unref(NVTable *self);
 
@@ -345,6 +380,18 @@ nv_table_get_top(NVTable *self)
   return NV_TABLE_ADDR(self, self->size);
 }
 
+static inline NVTable *
+nv_table_get_parent(NVTable *self)
+{
+  NVTable *parent;
+
+  if (G_LIKELY(!self->layered))
+    return NULL;
+
+  memcpy(&parent, nv_table_get_top(self) - sizeof(parent), sizeof(parent));
+  return parent;
+}
+
 static inline gchar *
 nv_table_get_bottom(NVTable *self)
 {
@@ -405,12 +452,35 @@ __nv_table_get_entry(NVTable *self, NVHandle handle, guint16 num_static_entries,
     }
 }
 
+/* looks up @handle in @self only, without falling back to the parent of a layered table */
 static inline NVEntry *
-nv_table_get_entry(NVTable *self, NVHandle handle, NVIndexEntry **index_entry, NVIndexEntry **index_slot)
+nv_table_get_own_entry(NVTable *self, NVHandle handle, NVIndexEntry **index_entry, NVIndexEntry **index_slot)
 {
   return __nv_table_get_entry(self, handle, self->num_static_entries, index_entry, index_slot);
 }
 
+static inline NVEntry *
+nv_table_get_inherited_entry(NVTable *self, NVHandle handle)
+{
+  NVTable *parent = nv_table_get_parent(self);
+
+  if (!parent)
+    return NULL;
+  return __nv_table_get_entry(parent, handle, parent->num_static_entries, NULL, NULL);
+}
+
+/* NOTE: index_entry and index_slot always refer to @self, even if the
+ * entry itself was inherited from the parent of a layered table */
+static inline NVEntry *
+nv_table_get_entry(NVTable *self, NVHandle handle, NVIndexEntry **index_entry, NVIndexEntry **index_slot)
+{
+  NVEntry *entry = nv_table_get_own_entry(self, handle, index_entry, index_slot);
+
+  if (G_UNLIKELY(!entry && self->layered))
+    return nv_table_get_inherited_entry(self, handle);
+  return entry;
+}
+
 static inline gboolean
 nv_table_is_value_set(NVTable *self, NVHandle handle)
 {
@@ -24,6 +24,7 @@
 #include <criterion/criterion.h>
 #include "libtest/msg_parse_lib.h"
 #include "libtest/persist_lib.h"
+#include "libtest/stopwatch.h"
 
 #include "apphook.h"
 #include "logpipe.h"
@@ -886,6 +887,94 @@ Test(log_message, test_cow_writing_cloned_message)
 }
 
 
+Test(log_message, test_cow_clone_fan_out_performance)
+{
+  LogMessage *msg = _construct_log_message();
+  const gint fan_out = 8;
+  const gint iterations = 100000;
+  gchar value[1024];
+
+  /* a reasonably large payload, which is shared by the clones */
+  memset(value, 'x', sizeof(value) - 1);
+  value[sizeof(value) - 1] = 0;
+  log_msg_set_value(msg, LM_V_MESSAGE, value, -1);
+  for (gint i = 0; i < 32; i++)
+    {
+      gchar name[32];
+
+      g_snprintf(name, sizeof(name), "orig_name%d", i);
+      log_msg_set_value_by_name(msg, name, "orig_value", -1);
+    }
+  log_msg_write_protect(msg);
+
+  start_stopwatch();
+  for (gint i = 0; i < iterations; i++)
+    {
+      for (gint j = 0; j < fan_out; j++)
+        {
+          LogPathOptions path_options = LOG_PATH_OPTIONS_INIT;
+          LogMessage *cloned = log_msg_clone_cow(msg, &path_options);
+
+          log_msg_set_value_by_name(cloned, "destination", "changed", -1);
+          log_msg_unref(cloned);
+        }
+    }
+  stop_stopwatch_and_display_result(iterations * fan_out, "cloning and changing a message %d times took",
+                                    iterations * fan_out);
+
+  log_msg_unref(msg);
+}
+
+Test(log_message, test_cached_values_are_only_kept_by_write_protected_messages)
+{
+  LogMessage *msg = _construct_log_message();
+  LogPathOptions path_options = LOG_PATH_OPTIONS_INIT;
+  LogMessageValueType type;
+  gssize value_len;
+
+  log_msg_store_cached_value(msg, 1, 42, "foo", -1, LM_VT_STRING);
+  cr_assert_null(log_msg_lookup_cached_value(msg, 1, 42, NULL, NULL));
+
+  log_msg_write_protect(msg);
+  log_msg_store_cached_value(msg, 1, 42, "foo", -1, LM_VT_STRING);
+  log_msg_store_cached_value(msg, 2, 42, "123", 2, LM_VT_INTEGER);
+
+  cr_assert_str_eq(log_msg_lookup_cached_value(msg, 1, 42, &value_len, &type), "foo");
+  cr_assert_eq(value_len, 3);
+  cr_assert_eq(type, LM_VT_STRING);
+  cr_assert_str_eq(log_msg_lookup_cached_value(msg, 2, 42, &value_len, &type), "12");
+  cr_assert_eq(value_len, 2);
+  cr_assert_eq(type, LM_VT_INTEGER);
+  cr_assert_null(log_msg_lookup_cached_value(msg, 1, 43, NULL, NULL));
+
+  LogMessage *cloned = log_msg_clone_cow(msg, &path_options);
+  cr_assert_null(log_msg_lookup_cached_value(cloned, 1, 42, NULL, NULL));
+
+  log_msg_unref(cloned);
+  log_msg_unref(msg);
+}
+
+Test(log_message, test_cached_values_are_limited_in_size)
+{
+  LogMessage *msg = _construct_log_message();
+  gsize value_len = LOGMSG_CACHED_VALUES_MAX_SIZE / 4;
+  gchar *value = g_strnfill(value_len, 'x');
+  guint32 owner_id = 1;
+
+  log_msg_write_protect(msg);
+
+  for (; owner_id < 10; owner_id++)
+    log_msg_store_cached_value(msg, owner_id, 42, value, value_len, LM_VT_STRING);
+
+  cr_assert_not_null(log_msg_lookup_cached_value(msg, 1, 42, NULL, NULL));
+  cr_assert_null(log_msg_lookup_cached_value(msg, owner_id - 1, 42, NULL, NULL),
+                 "values beyond LOGMSG_CACHED_VALUES_MAX_SIZE should not be cached");
+  cr_assert_leq(msg->cached_values_size, LOGMSG_CACHED_VALUES_MAX_SIZE);
+
+  g_free(value);
+  log_msg_unref(msg);
+}
+
 Test(log_message, test_cow_make_writable)
 {
   LogMessage *msg = _construct_log_message();
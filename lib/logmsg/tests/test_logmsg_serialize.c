@@ -176,6 +176,74 @@ Test(logmsg_serialize, serialize)
   g_string_free(stream, TRUE);
 }
 
+Test(logmsg_serialize, compact_format)
+{
+  GString *legacy_stream = g_string_new("");
+  GString *stream = g_string_new("");
+  SerializeArchive *sa = serialize_string_archive_new(stream);
+
+  LogMessage *msg = _create_message_to_be_serialized(RAW_MSG, strlen(RAW_MSG));
+  log_msg_set_tag_by_name(msg, "compact_tag");
+  log_msg_set_match(msg, 1, "match1", -1);
+  msg->rcptid = 555;
+  msg->host_id = 0xdeadbeef;
+
+  SerializeArchive *legacy_sa = serialize_string_archive_new(legacy_stream);
+  log_msg_serialize(msg, legacy_sa, LMSF_COMPACTION);
+  log_msg_serialize(msg, sa, LMSF_COMPACT_FORMAT);
+  cr_assert_lt(stream->len, legacy_stream->len, "compact format is expected to be smaller, %d >= %d",
+               (gint) stream->len, (gint) legacy_stream->len);
+  cr_assert_eq(stream->str[0], LGM_V27);
+
+  /* handles change across the registry reset below, compare the SDATA order by name */
+  GPtrArray *sdata_order = g_ptr_array_new_with_free_func(g_free);
+  for (gint i = 0; i < msg->num_sdata; i++)
+    g_ptr_array_add(sdata_order, g_strdup(log_msg_get_value_name(msg->sdata[i], NULL)));
+  log_msg_unref(msg);
+
+  _reset_log_msg_registry();
+  msg = log_msg_new_empty();
+  cr_assert(log_msg_deserialize(msg, sa), ERROR_MSG);
+
+  _check_deserialized_message_all_fields(msg);
+  cr_assert(log_msg_is_tag_by_name(msg, "compact_tag"));
+  assert_log_message_value(msg, log_msg_get_match_handle(1), "match1");
+  cr_assert_eq(msg->num_matches, 2);
+  cr_assert_eq(msg->rcptid, 555);
+  cr_assert_eq(msg->host_id, 0xdeadbeef);
+
+  cr_assert_eq(msg->num_sdata, sdata_order->len);
+  for (gint i = 0; i < msg->num_sdata; i++)
+    cr_assert_str_eq(log_msg_get_value_name(msg->sdata[i], NULL), g_ptr_array_index(sdata_order, i));
+
+  g_ptr_array_free(sdata_order, TRUE);
+  log_msg_unref(msg);
+  serialize_archive_free(legacy_sa);
+  serialize_archive_free(sa);
+  g_string_free(legacy_stream, TRUE);
+  g_string_free(stream, TRUE);
+}
+
+Test(logmsg_serialize, compact_format_truncated_input_is_rejected)
+{
+  GString *stream = g_string_new("");
+  SerializeArchive *sa = serialize_string_archive_new(stream);
+
+  LogMessage *msg = _create_message_to_be_serialized(RAW_MSG, strlen(RAW_MSG));
+  log_msg_serialize(msg, sa, LMSF_COMPACT_FORMAT);
+  log_msg_unref(msg);
+  serialize_archive_free(sa);
+
+  g_string_truncate(stream, stream->len - 1);
+  sa = serialize_string_archive_new(stream);
+  msg = log_msg_new_empty();
+  cr_assert_not(log_msg_deserialize(msg, sa));
+
+  log_msg_unref(msg);
+  serialize_archive_free(sa);
+  g_string_free(stream, TRUE);
+}
+
 static LogMessage *
 _create_message_to_be_serialized_with_ts_processed(const gchar *raw_msg, const int raw_msg_len, UnixTime *processed)
 {
@@ -0,0 +1,170 @@
+/*
+ * Copyright (c) 2024 Balabit
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+ *
+ * As an additional exemption you are allowed to compile & link against the
+ * OpenSSL libraries as published by the OpenSSL project. See the file
+ * COPYING for details.
+ *
+ */
+#include <criterion/criterion.h>
+
+#include "logmsg/logmsg-slab.h"
+#include "logmsg/logmsg.h"
+#include "mainloop-worker.h"
+#include "apphook.h"
+
+#include <iv.h>
+#include <string.h>
+
+typedef gpointer (*WorkerFunc)(gpointer user_data);
+
+typedef struct _WorkerArgs
+{
+  WorkerFunc func;
+  gpointer user_data;
+} WorkerArgs;
+
+static gpointer
+_worker_thread(gpointer user_data)
+{
+  WorkerArgs *args = user_data;
+  gpointer result;
+
+  iv_init();
+  main_loop_worker_thread_start(MLW_ASYNC_WORKER);
+  result = args->func(args->user_data);
+  main_loop_worker_thread_stop();
+  iv_deinit();
+  return result;
+}
+
+static gpointer
+_run_in_worker(WorkerFunc func, gpointer user_data)
+{
+  WorkerArgs args = { func, user_data };
+
+  return g_thread_join(g_thread_new(NULL, _worker_thread, &args));
+}
+
+static gpointer
+_free_block(gpointer mem)
+{
+  log_msg_slab_free(mem);
+  return NULL;
+}
+
+/* these run in worker threads, the result is checked in the main thread */
+
+static gpointer
+_local_free_and_alloc(gpointer user_data)
+{
+  gpointer mem = log_msg_slab_alloc(300);
+  gboolean reused = TRUE;
+
+  log_msg_slab_free(mem);
+  reused &= (log_msg_slab_alloc(300) == mem);
+  /* same size class */
+  log_msg_slab_free(mem);
+  reused &= (log_msg_slab_alloc(400) == mem);
+  log_msg_slab_free(mem);
+  return GINT_TO_POINTER(reused);
+}
+
+static gpointer
+_remote_free_and_alloc(gpointer user_data)
+{
+  gpointer mem = log_msg_slab_alloc(1000);
+  gboolean reused;
+
+  /* this runs in another thread with a different thread index */
+  _run_in_worker(_free_block, mem);
+  reused = (log_msg_slab_alloc(1000) == mem);
+  log_msg_slab_free(mem);
+  return GINT_TO_POINTER(reused);
+}
+
+static gboolean
+_check_content(const gchar *mem, gchar c, gsize len)
+{
+  for (gsize i = 0; i < len; i++)
+    if (mem[i] != c)
+      return FALSE;
+  return TRUE;
+}
+
+static gpointer
+_realloc_keeps_content(gpointer user_data)
+{
+  gchar *mem = log_msg_slab_alloc(100);
+  gboolean content_kept = TRUE;
+
+  memset(mem, 'x', 100);
+  mem = log_msg_slab_realloc(mem, 200);
+  content_kept &= _check_content(mem, 'x', 100);
+
+  mem = log_msg_slab_realloc(mem, 64 * 1024);
+  content_kept &= _check_content(mem, 'x', 100);
+  memset(mem, 'y', 64 * 1024);
+
+  mem = log_msg_slab_realloc(mem, 128 * 1024);
+  content_kept &= _check_content(mem, 'y', 64 * 1024);
+
+  log_msg_slab_free(mem);
+  return GINT_TO_POINTER(content_kept);
+}
+
+Test(logmsg_slab, blocks_freed_by_the_owner_are_reused)
+{
+  cr_assert(GPOINTER_TO_INT(_run_in_worker(_local_free_and_alloc, NULL)));
+}
+
+Test(logmsg_slab, blocks_freed_by_other_threads_are_returned_to_the_owner)
+{
+  cr_assert(GPOINTER_TO_INT(_run_in_worker(_remote_free_and_alloc, NULL)));
+}
+
+Test(logmsg_slab, realloc_keeps_content_across_size_classes)
+{
+  cr_assert(GPOINTER_TO_INT(_run_in_worker(_realloc_keeps_content, NULL)));
+}
+
+Test(logmsg_slab, non_worker_threads_can_allocate_and_free_messages)
+{
+  LogMessage *msg = log_msg_new_empty();
+
+  log_msg_set_value(msg, LM_V_MESSAGE, "foobar", -1);
+  _run_in_worker(_free_block, log_msg_slab_alloc(16));
+  log_msg_unref(msg);
+}
+
+static void
+setup(void)
+{
+  /* G_SLICE=always-malloc disables caching */
+  g_unsetenv("G_SLICE");
+  app_startup();
+  main_loop_worker_allocate_thread_space(2);
+  main_loop_worker_finalize_thread_space();
+}
+
+static void
+teardown(void)
+{
+  app_shutdown();
+}
+
+TestSuite(logmsg_slab, .init = setup, .fini = teardown);
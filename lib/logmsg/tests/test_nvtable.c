@@ -140,6 +140,51 @@ Test(nvtable, test_nv_registry)
   nv_registry_free(reg);
 }
 
+#define TEST_LOOKUP_THREADS 4
+#define TEST_LOOKUP_NAMES 4096
+
+static gpointer
+_resolve_names(gpointer user_data)
+{
+  NVRegistry *reg = (NVRegistry *) user_data;
+
+  for (gint i = 0; i < TEST_LOOKUP_NAMES; i++)
+    {
+      gchar dyn_name[16];
+
+      g_snprintf(dyn_name, sizeof(dyn_name), "DYN%05d", i);
+      NVHandle handle = nv_registry_alloc_handle(reg, dyn_name);
+      g_assert(handle != 0);
+      g_assert(nv_registry_get_handle(reg, dyn_name) == handle);
+      g_assert(strcmp(nv_registry_get_handle_name(reg, handle, NULL), dyn_name) == 0);
+    }
+  return NULL;
+}
+
+Test(nvtable, test_nv_registry_lookups_are_consistent_while_names_are_registered)
+{
+  const gchar *builtins[] = { "BUILTIN1", "BUILTIN2", "BUILTIN3", NULL };
+  NVRegistry *reg = nv_registry_new(builtins, NVHANDLE_MAX_VALUE);
+  GThread *threads[TEST_LOOKUP_THREADS];
+
+  /* the threads register the same names concurrently, which grows the lookup index */
+  for (gint i = 0; i < TEST_LOOKUP_THREADS; i++)
+    threads[i] = g_thread_new(NULL, _resolve_names, reg);
+  for (gint i = 0; i < TEST_LOOKUP_THREADS; i++)
+    g_thread_join(threads[i]);
+
+  cr_assert_eq(reg->names->len, TEST_LOOKUP_NAMES + 3);
+  cr_assert_eq(nv_registry_get_handle(reg, "BUILTIN2"), 2);
+  cr_assert_eq(nv_registry_get_handle(reg, "unknown"), 0);
+
+  nv_registry_add_alias(reg, 2, "ALIAS");
+  cr_assert_eq(nv_registry_get_handle(reg, "ALIAS"), 2);
+  nv_registry_add_alias(reg, 3, "ALIAS");
+  cr_assert_eq(nv_registry_get_handle(reg, "ALIAS"), 3);
+
+  nv_registry_free(reg);
+}
+
 /*
  *  - NVTable direct values
  *    - set/get static NV entries
@@ -1166,3 +1211,154 @@ Test(nvtable, test_nvtable_compact_skips_unset_values)
 
   nv_table_unref(tab2);
 }
+
+static NVTable *
+_construct_layered_parent(void)
+{
+  const gchar *indirect_nv_name = "indirect-name";
+  NVTable *parent = nv_table_new(STATIC_VALUES, STATIC_VALUES, 1024);
+
+  nv_table_add_value(parent, STATIC_HANDLE, STATIC_NAME, strlen(STATIC_NAME), "static-foo", 10, 0, NULL);
+  nv_table_add_value(parent, DYN_HANDLE, DYN_NAME, strlen(DYN_NAME), "dyn-foo", 7, 0, NULL);
+  nv_table_add_value_indirect(parent, DYN_HANDLE+1, indirect_nv_name, strlen(indirect_nv_name),
+                              &(NVReferencedSlice)
+  {
+    STATIC_HANDLE, 1, 5
+  }, 0, NULL);
+  return parent;
+}
+
+Test(nvtable, test_nvtable_layered_lookups_fall_through_to_the_parent)
+{
+  NVTable *parent = _construct_layered_parent();
+  NVTable *layer = nv_table_clone_layered(parent, 0);
+
+  cr_assert(layer->layered);
+  cr_assert(nv_table_get_parent(layer) == parent);
+  cr_assert(layer->size < parent->size, "a layer should be smaller than its parent");
+
+  assert_nvtable(layer, STATIC_HANDLE, "static-foo", 10);
+  assert_nvtable(layer, DYN_HANDLE, "dyn-foo", 7);
+  assert_nvtable(layer, DYN_HANDLE+1, "tatic", 5);
+  cr_assert_null(nv_table_get_value(layer, DYN_HANDLE+2, NULL, NULL));
+
+  /* a layer of a layer is a copy sharing the same parent */
+  NVTable *copy = nv_table_clone_layered(layer, 0);
+  cr_assert(nv_table_get_parent(copy) == parent);
+  assert_nvtable(copy, DYN_HANDLE, "dyn-foo", 7);
+
+  nv_table_unref(copy);
+  nv_table_unref(layer);
+  nv_table_unref(parent);
+}
+
+Test(nvtable, test_nvtable_layered_changes_do_not_leak_into_the_parent)
+{
+  NVTable *parent = _construct_layered_parent();
+  NVTable *layer = nv_table_clone_layered(parent, 0);
+  gboolean new_entry;
+
+  cr_assert(nv_table_add_value(layer, DYN_HANDLE, DYN_NAME, strlen(DYN_NAME), "dyn-bar", 7, 0, &new_entry));
+  cr_assert_not(new_entry, "overriding an inherited value should not create a new entry");
+  cr_assert(nv_table_add_value(layer, DYN_HANDLE+2, "new-name", 8, "new-value", 9, 0, &new_entry));
+  cr_assert(new_entry);
+  cr_assert(nv_table_unset_value(layer, STATIC_HANDLE));
+
+  assert_nvtable(layer, DYN_HANDLE, "dyn-bar", 7);
+  assert_nvtable(layer, DYN_HANDLE+2, "new-value", 9);
+  cr_assert_not(nv_table_is_value_set(layer, STATIC_HANDLE));
+
+  assert_nvtable(parent, STATIC_HANDLE, "static-foo", 10);
+  assert_nvtable(parent, DYN_HANDLE, "dyn-foo", 7);
+  cr_assert_null(nv_table_get_value(parent, DYN_HANDLE+2, NULL, NULL));
+
+  nv_table_unref(layer);
+  nv_table_unref(parent);
+}
+
+Test(nvtable, test_nvtable_layered_references_to_inherited_values_are_kept)
+{
+  NVTable *parent = _construct_layered_parent();
+  NVTable *layer = nv_table_clone_layered(parent, 0);
+
+  /* DYN_HANDLE+1 in the parent refers to STATIC_HANDLE, which is changed in the layer */
+  cr_assert(nv_table_add_value(layer, STATIC_HANDLE, STATIC_NAME, strlen(STATIC_NAME), "STATIC-BAR", 10, 0, NULL));
+  assert_nvtable(layer, STATIC_HANDLE, "STATIC-BAR", 10);
+  assert_nvtable(layer, DYN_HANDLE+1, "tatic", 5);
+
+  /* indirect values in the layer referring to inherited values */
+  cr_assert(nv_table_add_value_indirect(layer, DYN_HANDLE+2, "indirect2", 9,
+                                        &(NVReferencedSlice)
+  {
+    DYN_HANDLE, 4, 3
+  }, 0, NULL));
+  assert_nvtable(layer, DYN_HANDLE+2, "foo", 3);
+  cr_assert(nv_table_add_value(layer, DYN_HANDLE, DYN_NAME, strlen(DYN_NAME), "dyn-bar", 7, 0, NULL));
+  assert_nvtable(layer, DYN_HANDLE+2, "foo", 3);
+
+  assert_nvtable(parent, STATIC_HANDLE, "static-foo", 10);
+  assert_nvtable(parent, DYN_HANDLE, "dyn-foo", 7);
+
+  nv_table_unref(layer);
+  nv_table_unref(parent);
+}
+
+static gboolean
+_count_entries(NVHandle handle, NVEntry *entry, NVIndexEntry *index_entry, gpointer user_data)
+{
+  gint *count = (gint *) user_data;
+
+  if (!entry->unset)
+    (*count)++;
+  return FALSE;
+}
+
+Test(nvtable, test_nvtable_layered_foreach_iterates_over_the_merged_view)
+{
+  NVTable *parent = _construct_layered_parent();
+  NVTable *layer = nv_table_clone_layered(parent, 0);
+  gint count = 0;
+
+  nv_table_add_value(layer, DYN_HANDLE, DYN_NAME, strlen(DYN_NAME), "dyn-bar", 7, 0, NULL);
+  nv_table_add_value(layer, DYN_HANDLE+2, "new-name", 8, "new-value", 9, 0, NULL);
+  nv_table_unset_value(layer, DYN_HANDLE+1);
+
+  nv_table_foreach_entry(layer, _count_entries, &count);
+  cr_assert_eq(count, 3);
+
+  NVTable *flat = nv_table_compact(layer);
+  cr_assert_not(flat->layered);
+  assert_nvtable(flat, STATIC_HANDLE, "static-foo", 10);
+  assert_nvtable(flat, DYN_HANDLE, "dyn-bar", 7);
+  assert_nvtable(flat, DYN_HANDLE+2, "new-value", 9);
+  cr_assert_not(nv_table_is_value_set(flat, DYN_HANDLE+1));
+
+  nv_table_unref(flat);
+  nv_table_unref(layer);
+  nv_table_unref(parent);
+}
+
+Test(nvtable, test_nvtable_layered_realloc_flattens_large_layers)
+{
+  NVTable *parent = _construct_layered_parent();
+  NVTable *layer = nv_table_clone_layered(parent, 0);
+  gchar value[128];
+
+  memset(value, 'x', sizeof(value));
+  for (NVHandle handle = DYN_HANDLE+2; layer->layered; handle++)
+    {
+      gchar name[16];
+
+      g_snprintf(name, sizeof(name), "name%d", handle);
+      while (!nv_table_add_value(layer, handle, name, strlen(name), value, sizeof(value), 0, NULL))
+        cr_assert(nv_table_realloc(layer, &layer));
+    }
+
+  assert_nvtable(layer, STATIC_HANDLE, "static-foo", 10);
+  assert_nvtable(layer, DYN_HANDLE, "dyn-foo", 7);
+  assert_nvtable(layer, DYN_HANDLE+1, "tatic", 5);
+  assert_nvtable(layer, DYN_HANDLE+2, value, sizeof(value));
+
+  nv_table_unref(layer);
+  nv_table_unref(parent);
+}
@@ -79,6 +79,9 @@
 
 #define PIF_PRIVATE(x)       ((x) << 16)
 
+/* maximum number of messages passed to log_pipe_queue_batch() at once */
+#define LOG_PIPE_MAX_BATCH_SIZE 64
+
 /**
  *
  * Processing pipeline
@@ -334,6 +337,9 @@ struct _LogPipe
   void (*free_fn)(LogPipe *self);
   void (*notify)(LogPipe *self, gint notify_code, gpointer user_data);
   GList *info;
+
+  /* optional, processes a batch of independent messages at once, see log_pipe_queue_batch() */
+  void (*queue_batch)(LogPipe *self, LogMessage **msgs, const LogPathOptions *path_options, gint num_msgs);
 };
 
 /*
@@ -491,6 +497,29 @@ log_pipe_queue(LogPipe *s, LogMessage *msg, const LogPathOptions *path_options)
 
 }
 
+/*
+ * Queues a batch of independent messages, @path_options is an array with
+ * an element for each message.  If the pipe has no batch implementation,
+ * or the per-message processing in log_pipe_queue() is needed, the
+ * messages are queued one by one.
+ */
+static inline void
+log_pipe_queue_batch(LogPipe *s, LogMessage **msgs, const LogPathOptions *path_options, gint num_msgs)
+{
+  g_assert((s->flags & PIF_INITIALIZED) != 0);
+  g_assert(num_msgs <= LOG_PIPE_MAX_BATCH_SIZE);
+
+  if (!s->queue_batch || G_UNLIKELY(pipe_single_step_hook) ||
+      (s->flags & (PIF_HARD_FLOW_CONTROL | PIF_JUNCTION_END | PIF_CONDITIONAL_MIDPOINT)))
+    {
+      for (gint i = 0; i < num_msgs; i++)
+        log_pipe_queue(s, msgs[i], &path_options[i]);
+      return;
+    }
+
+  s->queue_batch(s, msgs, path_options, num_msgs);
+}
+
 static inline LogPipe *
 log_pipe_clone(LogPipe *self)
 {
@@ -587,6 +587,10 @@ log_proto_buffered_server_prepare(LogProtoServer *s, GIOCondition *cond, gint *t
 {
   LogProtoBufferedServer *self = (LogProtoBufferedServer *) s;
 
+  /* the transport has already read data from the fd, polling would not signal it */
+  if (log_transport_has_pending_input(self->super.transport))
+    return LPPA_FORCE_SCHEDULE_FETCH;
+
   *cond = self->super.transport->cond;
 
   /* if there's no pending I/O in the transport layer, then we want to do a read */
@@ -76,11 +76,18 @@ log_proto_client_options_get_timeout(LogProtoClientOptions *options)
   return options->timeout;
 }
 
+void
+log_proto_client_options_set_batch_size(LogProtoClientOptions *options, gint batch_size)
+{
+  options->batch_size = batch_size;
+}
+
 void
 log_proto_client_options_defaults(LogProtoClientOptions *options)
 {
   options->drop_input = FALSE;
   options->timeout = 0;
+  options->batch_size = 0;
 }
 
 void
@@ -54,6 +54,9 @@ log_proto_framed_client_post(LogProtoClient *s, LogMessage *logmsg, guchar *msg,
       msg_len = 9999999;
     }
 
+  if (self->super.batch)
+    return log_proto_text_client_post_batched(s, msg, msg_len, consumed);
+
   status = LPS_SUCCESS;
   while (status == LPS_SUCCESS && !(*consumed) && self->super.partial == NULL)
     {
@@ -83,5 +86,6 @@ log_proto_framed_client_new(LogTransport *transport, const LogProtoClientOptions
   log_proto_text_client_init(&self->super, transport, options);
   self->super.super.post = log_proto_framed_client_post;
   self->super.state = LPFCS_FRAME_SEND;
+  log_proto_text_client_enable_batching(&self->super, TRUE);
   return &self->super.super;
 }
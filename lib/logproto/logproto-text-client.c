@@ -25,6 +25,165 @@
 #include "messages.h"
 
 #include <errno.h>
+#include <limits.h>
+#include <sys/uio.h>
+#include <sys/socket.h>
+
+#define FRAME_HEADER_MAX_LEN 16
+
+/*
+ * Messages are collected here by post() and are written using a single
+ * writev() call once the batch is full or when the writer flushes.  Each
+ * message occupies iov_per_msg consecutive elements of iov (the frame
+ * header, if any, and the payload).  If the transport accepts only a part
+ * of the batch, the unwritten part is kept and the elements are adjusted
+ * in place, so datagram boundaries (sendmmsg()) are preserved as well.
+ */
+struct _LogProtoTextClientBatch
+{
+  gint size;
+  gint iov_per_msg;
+  /* number of messages in the batch */
+  gint count;
+  /* number of messages already written and acked */
+  gint written;
+  /* the first element of iov that is not written completely */
+  gint iov_pos;
+  struct iovec *iov;
+  guchar **msgs;
+  gchar *frame_headers;
+};
+
+static LogProtoTextClientBatch *
+_batch_new(gint size, gboolean framed)
+{
+  LogProtoTextClientBatch *self = g_new0(LogProtoTextClientBatch, 1);
+
+  self->iov_per_msg = framed ? 2 : 1;
+  self->size = size;
+#ifdef IOV_MAX
+  if (self->size * self->iov_per_msg > IOV_MAX)
+    self->size = IOV_MAX / self->iov_per_msg;
+#endif
+  self->iov = g_new(struct iovec, self->size * self->iov_per_msg);
+  self->msgs = g_new(guchar *, self->size);
+  if (framed)
+    self->frame_headers = g_new(gchar, self->size * FRAME_HEADER_MAX_LEN);
+  return self;
+}
+
+static void
+_batch_drop_messages(LogProtoTextClientBatch *self)
+{
+  for (gint i = self->written; i < self->count; i++)
+    g_free(self->msgs[i]);
+  self->count = self->written = self->iov_pos = 0;
+}
+
+static void
+_batch_free(LogProtoTextClientBatch *self)
+{
+  _batch_drop_messages(self);
+  g_free(self->iov);
+  g_free(self->msgs);
+  g_free(self->frame_headers);
+  g_free(self);
+}
+
+static inline gboolean
+_batch_is_empty(LogProtoTextClientBatch *self)
+{
+  return self->count == 0;
+}
+
+static inline gboolean
+_batch_is_full(LogProtoTextClientBatch *self)
+{
+  return self->count == self->size;
+}
+
+static void
+_batch_append(LogProtoTextClientBatch *self, guchar *msg, gsize msg_len)
+{
+  struct iovec *iov = &self->iov[self->count * self->iov_per_msg];
+
+  if (self->frame_headers)
+    {
+      gchar *frame_header = &self->frame_headers[self->count * FRAME_HEADER_MAX_LEN];
+
+      iov->iov_base = frame_header;
+      iov->iov_len = g_snprintf(frame_header, FRAME_HEADER_MAX_LEN, "%" G_GSIZE_FORMAT " ", msg_len);
+      iov++;
+    }
+  iov->iov_base = msg;
+  iov->iov_len = msg_len;
+  self->msgs[self->count++] = msg;
+}
+
+/* returns the number of messages completed by writing @len bytes */
+static gint
+_batch_consume(LogProtoTextClientBatch *self, gsize len)
+{
+  gint iov_count = self->count * self->iov_per_msg;
+
+  while (self->iov_pos < iov_count && len >= self->iov[self->iov_pos].iov_len)
+    {
+      len -= self->iov[self->iov_pos].iov_len;
+      self->iov_pos++;
+    }
+
+  if (len > 0)
+    {
+      struct iovec *partial = &self->iov[self->iov_pos];
+
+      partial->iov_base = ((guchar *) partial->iov_base) + len;
+      partial->iov_len -= len;
+    }
+
+  gint completed = self->iov_pos / self->iov_per_msg;
+  gint num_written = completed - self->written;
+
+  for (gint i = self->written; i < completed; i++)
+    g_free(self->msgs[i]);
+  self->written = completed;
+
+  if (self->written == self->count)
+    self->count = self->written = self->iov_pos = 0;
+  return num_written;
+}
+
+static LogProtoStatus
+log_proto_text_client_flush_batch(LogProtoTextClient *self)
+{
+  LogProtoTextClientBatch *batch = self->batch;
+
+  if (_batch_is_empty(batch))
+    return LPS_SUCCESS;
+
+  gint iov_count = batch->count * batch->iov_per_msg;
+  gssize rc = log_transport_writev(self->super.transport, &batch->iov[batch->iov_pos], iov_count - batch->iov_pos);
+  if (rc < 0)
+    {
+      if (errno != EAGAIN && errno != EINTR)
+        {
+          msg_error("I/O error occurred while writing",
+                    evt_tag_int("fd", self->super.transport->fd),
+                    evt_tag_error(EVT_TAG_OSERROR));
+
+          /* the unwritten messages are still on the backlog, LogWriter
+           * rewinds them when it sees the error */
+          _batch_drop_messages(batch);
+          return LPS_ERROR;
+        }
+      return LPS_PARTIAL;
+    }
+
+  gint num_written = _batch_consume(batch, rc);
+  if (num_written > 0)
+    log_proto_client_msg_ack(&self->super, num_written);
+
+  return _batch_is_empty(batch) ? LPS_SUCCESS : LPS_PARTIAL;
+}
 
 static gboolean
 log_proto_text_client_prepare(LogProtoClient *s, gint *fd, GIOCondition *cond, gint *timeout)
@@ -38,7 +197,7 @@ log_proto_text_client_prepare(LogProtoClient *s, gint *fd, GIOCondition *cond, g
   if (*cond == 0)
     *cond = G_IO_OUT;
 
-  const gboolean pending_write = self->partial != NULL;
+  const gboolean pending_write = self->partial != NULL || (self->batch && !_batch_is_empty(self->batch));
 
   if (!pending_write && s->options->timeout > 0)
     *timeout = s->options->timeout;
@@ -79,6 +238,9 @@ log_proto_text_client_flush(LogProtoClient *s)
   LogProtoTextClient *self = (LogProtoTextClient *) s;
   gint rc;
 
+  if (self->batch)
+    return log_proto_text_client_flush_batch(self);
+
   if (!self->partial)
     {
       return LPS_SUCCESS;
@@ -137,6 +299,36 @@ log_proto_text_client_submit_write(LogProtoClient *s, guchar *msg, gsize msg_len
 }
 
 
+/*
+ * Batched counterpart of log_proto_text_client_post(): the message is
+ * only added to the batch, which is written when it becomes full or when
+ * the caller flushes.  LPS_PARTIAL is returned as long as the batch holds
+ * messages that were not written yet, so that the caller rewinds its
+ * backlog if the connection is lost before they are sent.
+ */
+LogProtoStatus
+log_proto_text_client_post_batched(LogProtoClient *s, guchar *msg, gsize msg_len, gboolean *consumed)
+{
+  LogProtoTextClient *self = (LogProtoTextClient *) s;
+  LogProtoTextClientBatch *batch = self->batch;
+
+  *consumed = FALSE;
+  if (_batch_is_full(batch))
+    {
+      /* the batch is only partially written, wait until it drains */
+      const LogProtoStatus status = log_proto_text_client_flush_batch(self);
+      if (status != LPS_SUCCESS)
+        return status;
+    }
+
+  _batch_append(batch, msg, msg_len);
+  *consumed = TRUE;
+
+  if (!_batch_is_full(batch))
+    return LPS_PARTIAL;
+  return log_proto_text_client_flush_batch(self);
+}
+
 /*
  * log_proto_text_client_post:
  * @msg: formatted log message to send (this might be consumed by this function)
@@ -153,6 +345,9 @@ log_proto_text_client_post(LogProtoClient *s, LogMessage *logmsg, guchar *msg, g
 {
   LogProtoTextClient *self = (LogProtoTextClient *) s;
 
+  if (self->batch)
+    return log_proto_text_client_post_batched(s, msg, msg_len, consumed);
+
   /* try to flush already buffered data */
   *consumed = FALSE;
   const LogProtoStatus status = log_proto_text_client_flush(s);
@@ -189,9 +384,41 @@ log_proto_text_client_free(LogProtoClient *s)
   if (self->partial_free)
     self->partial_free(self->partial);
   self->partial = NULL;
+  if (self->batch)
+    _batch_free(self->batch);
   log_proto_client_free_method(s);
 };
 
+static gboolean
+_is_dgram_transport(LogTransport *transport)
+{
+  gint sock_type;
+  socklen_t len = sizeof(sock_type);
+
+  if (getsockopt(transport->fd, SOL_SOCKET, SO_TYPE, &sock_type, &len) < 0)
+    return FALSE;
+  return sock_type == SOCK_DGRAM;
+}
+
+/*
+ * Batching is only possible if the transport can write multiple buffers
+ * at once, and if batch-size is larger than 1.  @framed means that each
+ * message is prefixed by an octet-counting frame header.  Datagram
+ * transports send each buffer as a separate datagram, which would split
+ * the frame header from the message, so framed batching is stream only.
+ */
+void
+log_proto_text_client_enable_batching(LogProtoTextClient *self, gboolean framed)
+{
+  if (!self->super.transport->writev || self->super.options->batch_size <= 1)
+    return;
+
+  if (framed && _is_dgram_transport(self->super.transport))
+    return;
+
+  self->batch = _batch_new(self->super.options->batch_size, framed);
+}
+
 void
 log_proto_text_client_init(LogProtoTextClient *self, LogTransport *transport, const LogProtoClientOptions *options)
 {
@@ -212,5 +439,6 @@ log_proto_text_client_new(LogTransport *transport, const LogProtoClientOptions *
   LogProtoTextClient *self = g_new0(LogProtoTextClient, 1);
 
   log_proto_text_client_init(self, transport, options);
+  log_proto_text_client_enable_batching(self, FALSE);
   return &self->super;
 }
@@ -26,6 +26,8 @@
 
 #include "logproto-client.h"
 
+typedef struct _LogProtoTextClientBatch LogProtoTextClientBatch;
+
 typedef struct _LogProtoTextClient
 {
   LogProtoClient super;
@@ -33,10 +35,14 @@ typedef struct _LogProtoTextClient
   guchar *partial;
   GDestroyNotify partial_free;
   gsize partial_len, partial_pos;
+  /* messages collected by post() to be sent using a single writev(), NULL if not batching */
+  LogProtoTextClientBatch *batch;
 } LogProtoTextClient;
 
 LogProtoStatus log_proto_text_client_submit_write(LogProtoClient *s, guchar *msg, gsize msg_len,
                                                   GDestroyNotify msg_free, gint next_state);
+LogProtoStatus log_proto_text_client_post_batched(LogProtoClient *s, guchar *msg, gsize msg_len, gboolean *consumed);
+void log_proto_text_client_enable_batching(LogProtoTextClient *self, gboolean framed);
 void log_proto_text_client_init(LogProtoTextClient *self, LogTransport *transport,
                                 const LogProtoClientOptions *options);
 LogProtoClient *log_proto_text_client_new(LogTransport *transport, const LogProtoClientOptions *options);
@@ -0,0 +1,291 @@
+/*
+ * Copyright (c) 2024 Balabit
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+ *
+ * As an additional exemption you are allowed to compile & link against the
+ * OpenSSL libraries as published by the OpenSSL project. See the file
+ * COPYING for details.
+ *
+ */
+
+#include <criterion/criterion.h>
+
+#include "logproto/logproto-text-client.h"
+#include "logproto/logproto-framed-client.h"
+#include "transport/transport-socket.h"
+#include "apphook.h"
+
+#include <errno.h>
+#include <fcntl.h>
+#include <signal.h>
+#include <string.h>
+#include <sys/socket.h>
+#include <unistd.h>
+
+static LogProtoClientOptions options;
+static gint num_acked;
+static gint num_rewinds;
+static gint fds[2];
+
+static void
+_ack(gint num_msg_acked, gpointer user_data)
+{
+  num_acked += num_msg_acked;
+}
+
+static void
+_rewind(gpointer user_data)
+{
+  num_rewinds++;
+}
+
+static LogProtoClient *
+_construct_client(LogProtoClient *(*construct)(LogTransport *, const LogProtoClientOptions *),
+                  gint sock_type, gint batch_size)
+{
+  LogProtoClientFlowControlFuncs flow_control_funcs = { _ack, _rewind, NULL };
+
+  cr_assert_eq(socketpair(AF_UNIX, sock_type, 0, fds), 0);
+  fcntl(fds[0], F_SETFL, O_NONBLOCK);
+  fcntl(fds[1], F_SETFL, O_NONBLOCK);
+
+  LogTransport *transport = sock_type == SOCK_STREAM
+                            ? log_transport_stream_socket_new(fds[0])
+                            : log_transport_dgram_socket_new(fds[0]);
+
+  log_proto_client_options_set_batch_size(&options, batch_size);
+  LogProtoClient *proto = construct(transport, &options);
+  log_proto_client_set_client_flow_control(proto, &flow_control_funcs);
+  return proto;
+}
+
+static LogProtoStatus
+_post(LogProtoClient *proto, const gchar *msg, gboolean *consumed)
+{
+  guchar *buf = (guchar *) g_strdup(msg);
+  LogProtoStatus status = log_proto_client_post(proto, NULL, buf, strlen(msg), consumed);
+
+  if (!*consumed)
+    g_free(buf);
+  return status;
+}
+
+static void
+_assert_post(LogProtoClient *proto, const gchar *msg)
+{
+  gboolean consumed;
+  LogProtoStatus status = _post(proto, msg, &consumed);
+
+  cr_assert(consumed);
+  cr_assert(status == LPS_SUCCESS || status == LPS_PARTIAL);
+}
+
+static GString *
+_read_available(GString *result)
+{
+  gchar buf[4096];
+  gssize rc;
+
+  while ((rc = read(fds[1], buf, sizeof(buf))) > 0)
+    g_string_append_len(result, buf, rc);
+  return result;
+}
+
+Test(logproto_client_batch, messages_are_written_when_the_batch_is_full)
+{
+  LogProtoClient *proto = _construct_client(log_proto_text_client_new, SOCK_STREAM, 3);
+  GString *received = g_string_new("");
+
+  _assert_post(proto, "foo\n");
+  _assert_post(proto, "bar\n");
+  cr_assert_eq(num_acked, 0);
+  cr_assert_str_empty(_read_available(received)->str);
+
+  _assert_post(proto, "baz\n");
+  cr_assert_eq(num_acked, 3);
+  cr_assert_str_eq(_read_available(received)->str, "foo\nbar\nbaz\n");
+
+  g_string_free(received, TRUE);
+  log_proto_client_free(proto);
+  close(fds[1]);
+}
+
+Test(logproto_client_batch, flush_writes_an_incomplete_batch)
+{
+  LogProtoClient *proto = _construct_client(log_proto_text_client_new, SOCK_STREAM, 100);
+  GString *received = g_string_new("");
+  gint fd;
+  GIOCondition cond;
+  gint timeout;
+
+  _assert_post(proto, "foo\n");
+  _assert_post(proto, "bar\n");
+  cr_assert(log_proto_client_prepare(proto, &fd, &cond, &timeout), "unwritten batch should be a pending write");
+
+  cr_assert_eq(log_proto_client_flush(proto), LPS_SUCCESS);
+  cr_assert_eq(num_acked, 2);
+  cr_assert_not(log_proto_client_prepare(proto, &fd, &cond, &timeout));
+  cr_assert_str_eq(_read_available(received)->str, "foo\nbar\n");
+
+  g_string_free(received, TRUE);
+  log_proto_client_free(proto);
+  close(fds[1]);
+}
+
+Test(logproto_client_batch, framed_messages_get_their_own_frame_header)
+{
+  LogProtoClient *proto = _construct_client(log_proto_framed_client_new, SOCK_STREAM, 2);
+  GString *received = g_string_new("");
+
+  _assert_post(proto, "foo");
+  _assert_post(proto, "foobar");
+  cr_assert_eq(num_acked, 2);
+  cr_assert_str_eq(_read_available(received)->str, "3 foo6 foobar");
+
+  g_string_free(received, TRUE);
+  log_proto_client_free(proto);
+  close(fds[1]);
+}
+
+Test(logproto_client_batch, datagram_boundaries_are_kept)
+{
+  LogProtoClient *proto = _construct_client(log_proto_text_client_new, SOCK_DGRAM, 3);
+  const gchar *messages[] = { "first", "second", "third" };
+  gchar buf[64];
+
+  if (!proto->transport->writev)
+    {
+      log_proto_client_free(proto);
+      close(fds[1]);
+      cr_skip_test("sendmmsg() is not supported");
+    }
+
+  for (gint i = 0; i < G_N_ELEMENTS(messages); i++)
+    _assert_post(proto, messages[i]);
+  cr_assert_eq(num_acked, 3);
+
+  for (gint i = 0; i < G_N_ELEMENTS(messages); i++)
+    {
+      gssize rc = recv(fds[1], buf, sizeof(buf), 0);
+      cr_assert_eq(rc, strlen(messages[i]));
+      cr_assert(memcmp(buf, messages[i], rc) == 0);
+    }
+
+  log_proto_client_free(proto);
+  close(fds[1]);
+}
+
+Test(logproto_client_batch, partial_writes_are_continued_and_acked_by_message)
+{
+  LogProtoClient *proto = _construct_client(log_proto_framed_client_new, SOCK_STREAM, 16);
+  GString *expected = g_string_new("");
+  GString *received = g_string_new("");
+  gint sndbuf = 4096;
+  gint num_messages = 0;
+
+  setsockopt(fds[0], SOL_SOCKET, SO_SNDBUF, &sndbuf, sizeof(sndbuf));
+
+  for (gint i = 0; i < 64; i++)
+    {
+      gchar *msg = g_strdup_printf("%d-%0*d", i, 3000, 0);
+      gboolean consumed = FALSE;
+
+      while (!consumed)
+        {
+          LogProtoStatus status = _post(proto, msg, &consumed);
+          cr_assert_neq(status, LPS_ERROR);
+
+          /* the batch is only partially written, its size limit is not exceeded */
+          cr_assert_leq(num_messages - num_acked, 16);
+          if (!consumed)
+            _read_available(received);
+        }
+      g_string_append_printf(expected, "%" G_GSIZE_FORMAT " %s", strlen(msg), msg);
+      num_messages++;
+      g_free(msg);
+    }
+
+  while (log_proto_client_flush(proto) == LPS_PARTIAL || received->len < expected->len)
+    _read_available(received);
+
+  cr_assert_eq(num_acked, num_messages);
+  cr_assert_eq(num_rewinds, 0);
+  cr_assert_eq(received->len, expected->len);
+  cr_assert(memcmp(received->str, expected->str, expected->len) == 0);
+
+  g_string_free(expected, TRUE);
+  g_string_free(received, TRUE);
+  log_proto_client_free(proto);
+  close(fds[1]);
+}
+
+Test(logproto_client_batch, write_error_drops_the_batch_and_leaves_the_rewind_to_the_writer)
+{
+  LogProtoClient *proto = _construct_client(log_proto_text_client_new, SOCK_STREAM, 2);
+  gboolean consumed;
+
+  signal(SIGPIPE, SIG_IGN);
+  close(fds[1]);
+
+  _assert_post(proto, "foo\n");
+  cr_assert_eq(_post(proto, "bar\n", &consumed), LPS_ERROR);
+  cr_assert_eq(num_acked, 0);
+  cr_assert_eq(num_rewinds, 0);
+  cr_assert_eq(log_proto_client_flush(proto), LPS_SUCCESS);
+
+  log_proto_client_free(proto);
+}
+
+Test(logproto_client_batch, no_batching_without_writev_support_or_batch_size)
+{
+  LogProtoClient *proto = _construct_client(log_proto_text_client_new, SOCK_STREAM, 1);
+
+  _assert_post(proto, "foo\n");
+  cr_assert_eq(num_acked, 1);
+  cr_assert_null(((LogProtoTextClient *) proto)->batch);
+
+  log_proto_client_free(proto);
+  close(fds[1]);
+}
+
+Test(logproto_client_batch, no_batching_for_framed_clients_on_datagram_transports)
+{
+  LogProtoClient *proto = _construct_client(log_proto_framed_client_new, SOCK_DGRAM, 16);
+
+  cr_assert_null(((LogProtoTextClient *) proto)->batch);
+  _assert_post(proto, "foo");
+  cr_assert_eq(num_acked, 1);
+
+  log_proto_client_free(proto);
+  close(fds[1]);
+}
+
+static void
+setup(void)
+{
+  app_startup();
+  log_proto_client_options_defaults(&options);
+  num_acked = 0;
+  num_rewinds = 0;
+}
+
+static void
+teardown(void)
+{
+  app_shutdown();
+}
+
+TestSuite(logproto_client_batch, .init = setup, .fini = teardown);
@@ -71,6 +71,30 @@ QueueType log_queue_fifo_type = "FIFO";
  *   - the head of the queue is only manipulated from the output thread
  *   - the tail of the queue is only manipulated from the input threads
  *
+ * Lockless mode (opt-in):
+ *   - the wait queue is extended by a bounded multi-producer,
+ *     single-consumer ring of LogMessageQueueNode pointers.  Input threads
+ *     reserve a contiguous range of slots for their whole input queue with
+ *     a single CAS and publish the nodes one by one, the output thread
+ *     moves published nodes to the output queue without taking the lock.
+ *
+ *   - if the ring is full, input threads fall back to the locked wait
+ *     queue and set the "overflow" flag.  While the flag is set, all input
+ *     threads use the locked wait queue, and the output thread only touches
+ *     the wait queue once the ring is fully drained, so the per-thread
+ *     ordering of messages is kept.  The flag is cleared by the output
+ *     thread once both have been drained.
+ *
+ *   - the flag is set whenever anything is put on the wait queue, so the
+ *     output thread only takes the lock if the flag is set, refilling the
+ *     output queue from the ring is lockless.
+ *
+ *   - as input threads do not serialize on the lock, they reserve their
+ *     share of log-fifo-size with a CAS on the "admitted" counter of the
+ *     ring, which counts the messages reserved on the ring the same way as
+ *     the limit does.  The output thread releases them as it drains the
+ *     ring.
+ *
  */
 
 typedef struct _InputQueue
@@ -89,6 +113,35 @@ typedef struct _OverflowQueue
   gint non_flow_controlled_len;
 } OverflowQueue;
 
+#define WAIT_RING_MIN_CAPACITY 1024
+#define WAIT_RING_MAX_CAPACITY 65536
+#define WAIT_RING_CACHE_LINE_SIZE 64
+
+/* the padding members keep the consumer and the producer side on separate cache lines */
+typedef struct _WaitRing
+{
+  /* read-only after init */
+  LogMessageQueueNode **slots;
+  guint capacity;
+  guint mask;
+  /* flow-controlled messages are included in the log_fifo_size limit */
+  gboolean legacy_fifo_size;
+  gchar _pad_ro[WAIT_RING_CACHE_LINE_SIZE];
+
+  /* written by the output thread only */
+  guint head;
+  gchar _pad_head[WAIT_RING_CACHE_LINE_SIZE];
+
+  /* written by the input threads: tail is reserved using CAS, published
+   * counts the slots whose nodes are already visible */
+  guint tail;
+  guint published;
+  gint non_flow_controlled_len;
+  gint admitted_len;
+  gint overflow;
+  gchar _pad_tail[WAIT_RING_CACHE_LINE_SIZE];
+} WaitRing;
+
 typedef struct _LogQueueFifo
 {
   LogQueue super;
@@ -98,6 +151,9 @@ typedef struct _LogQueueFifo
   OverflowQueue wait_queue;
   OverflowQueue backlog_queue; /* entries that were sent but not acked yet */
 
+  /* only allocated in lockless mode */
+  WaitRing wait_ring;
+
   gint log_fifo_size;
 
   /* legacy: flow-controlled messages are included in the log_fifo_size limit */
@@ -134,17 +190,140 @@ iv_list_update_msg_size(LogQueueFifo *self, struct iv_list_head *head)
   }
 }
 
+static inline gboolean
+_is_lockless(LogQueueFifo *self)
+{
+  return self->wait_ring.slots != NULL;
+}
+
+/* only counts published nodes, slots that are reserved but not yet filled
+ * are not there yet.  The output thread may take a node before its
+ * producer bumps published, hence the clamp. */
+static inline guint
+_wait_ring_get_length(WaitRing *self)
+{
+  gint len = (gint) ((guint) g_atomic_int_get(&self->published) - (guint) g_atomic_int_get(&self->head));
+
+  return len > 0 ? len : 0;
+}
+
+/*
+ * Can be called from any of the input threads.  Reserves room for the
+ * whole input queue with a single CAS and publishes the nodes into the
+ * reserved slots.  Returns FALSE if the ring does not have enough free
+ * slots, in which case the input queue is left untouched.
+ */
+static gboolean
+_wait_ring_push_batch(WaitRing *self, InputQueue *input_queue)
+{
+  guint tail;
+
+  if (input_queue->len > self->capacity)
+    return FALSE;
+
+  do
+    {
+      tail = g_atomic_int_get(&self->tail);
+
+      /* head can only move forward, so a stale value is on the safe side */
+      if (tail - g_atomic_int_get(&self->head) + input_queue->len > self->capacity)
+        return FALSE;
+    }
+  while (!g_atomic_int_compare_and_exchange(&self->tail, tail, tail + input_queue->len));
+
+  guint len = input_queue->len;
+
+  /* NOTE: the safe iterator fetches the next node before the current one
+   * is published, the output thread may relink the node right after
+   * g_atomic_pointer_set() */
+  struct iv_list_head *ilh, *ilh2;
+  iv_list_for_each_safe(ilh, ilh2, &input_queue->items)
+  {
+    LogMessageQueueNode *node = iv_list_entry(ilh, LogMessageQueueNode, list);
+    g_atomic_pointer_set(&self->slots[tail & self->mask], node);
+    tail++;
+  }
+  INIT_IV_LIST_HEAD(&input_queue->items);
+
+  g_atomic_int_add(&self->non_flow_controlled_len, input_queue->non_flow_controlled_len);
+  g_atomic_int_add(&self->published, len);
+
+  return TRUE;
+}
+
+/*
+ * Can only run from the output thread.  Moves the published nodes to
+ * @queue.  Returns TRUE if the ring became empty, FALSE if there are slots
+ * reserved by input threads that are not published yet.
+ */
+static gboolean
+_wait_ring_pop_all(WaitRing *self, OverflowQueue *queue)
+{
+  guint head = self->head;
+  guint tail = g_atomic_int_get(&self->tail);
+  gint non_flow_controlled_len = 0;
+  gint len = 0;
+
+  while (head != tail)
+    {
+      LogMessageQueueNode *node = g_atomic_pointer_get(&self->slots[head & self->mask]);
+
+      if (!node)
+        break;
+
+      self->slots[head & self->mask] = NULL;
+      iv_list_add_tail(&node->list, &queue->items);
+      queue->len++;
+
+      if (!node->flow_control_requested)
+        non_flow_controlled_len++;
+
+      len++;
+      head++;
+    }
+
+  queue->non_flow_controlled_len += non_flow_controlled_len;
+  g_atomic_int_add(&self->non_flow_controlled_len, -non_flow_controlled_len);
+  g_atomic_int_add(&self->admitted_len, -(self->legacy_fifo_size ? len : non_flow_controlled_len));
+
+  /* publishes the NULL-ed slots to the input threads */
+  g_atomic_int_set(&self->head, head);
+
+  return head == tail;
+}
+
+static void
+_wait_ring_init(WaitRing *self, gint log_fifo_size, gboolean legacy_fifo_size)
+{
+  guint capacity = WAIT_RING_MIN_CAPACITY;
+
+  while (capacity < (guint) log_fifo_size && capacity < WAIT_RING_MAX_CAPACITY)
+    capacity <<= 1;
+
+  self->capacity = capacity;
+  self->mask = capacity - 1;
+  self->legacy_fifo_size = legacy_fifo_size;
+  self->slots = g_new0(LogMessageQueueNode *, capacity);
+}
+
 static gint64
 log_queue_fifo_get_length(LogQueue *s)
 {
   LogQueueFifo *self = (LogQueueFifo *) s;
 
+  if (_is_lockless(self))
+    return self->wait_queue.len + self->output_queue.len + _wait_ring_get_length(&self->wait_ring);
+
   return self->wait_queue.len + self->output_queue.len;
 }
 
 static gint64
 log_queue_fifo_get_non_flow_controlled_length(LogQueueFifo *self)
 {
+  if (_is_lockless(self))
+    return self->wait_queue.non_flow_controlled_len + self->output_queue.non_flow_controlled_len
+           + g_atomic_int_get(&self->wait_ring.non_flow_controlled_len);
+
   return self->wait_queue.non_flow_controlled_len + self->output_queue.non_flow_controlled_len;
 }
 
@@ -261,9 +440,16 @@ log_queue_fifo_calculate_num_of_messages_to_drop(LogQueueFifo *self, InputQueue
   return TRUE;
 }
 
-/* move items from the per-thread input queue to the lock-protected "wait" queue */
+static inline void
+log_queue_fifo_account_input_for_move(LogQueueFifo *self, gint thread_index)
+{
+  log_queue_queued_messages_add(&self->super, self->input_queues[thread_index].len);
+  iv_list_update_msg_size(self, &self->input_queues[thread_index].items);
+}
+
+/* drop the overflowing items of the per-thread input queue and account the rest, lock must be held */
 static void
-log_queue_fifo_move_input_unlocked(LogQueueFifo *self, gint thread_index)
+log_queue_fifo_prepare_input_for_move(LogQueueFifo *self, gint thread_index)
 {
   gint num_of_messages_to_drop;
   gboolean drop_messages = log_queue_fifo_calculate_num_of_messages_to_drop(self, &self->input_queues[thread_index],
@@ -275,9 +461,63 @@ log_queue_fifo_move_input_unlocked(LogQueueFifo *self, gint thread_index)
       log_queue_fifo_drop_messages_from_input_queue(self, &self->input_queues[thread_index], num_of_messages_to_drop);
     }
 
-  log_queue_queued_messages_add(&self->super, self->input_queues[thread_index].len);
-  iv_list_update_msg_size(self, &self->input_queues[thread_index].items);
+  log_queue_fifo_account_input_for_move(self, thread_index);
+}
+
+/*
+ * Lockless variant of log_queue_fifo_prepare_input_for_move().  The input
+ * threads reserve their share of log-fifo-size with a CAS, so concurrent
+ * input threads cannot overshoot the limit together.  Returns the number
+ * of reserved messages, which is released by the caller if the input
+ * ends up on the wait queue instead of the ring.
+ */
+static gint
+log_queue_fifo_prepare_input_for_move_lockless(LogQueueFifo *self, gint thread_index)
+{
+  InputQueue *input_queue = &self->input_queues[thread_index];
+  gint input_queue_len;
+  gint queue_len;
+
+  /* racy with the output thread only, see log_queue_fifo_calculate_num_of_messages_to_drop() */
+  if (G_UNLIKELY(self->use_legacy_fifo_size))
+    {
+      input_queue_len = input_queue->len;
+      queue_len = self->wait_queue.len + self->output_queue.len;
+    }
+  else
+    {
+      input_queue_len = input_queue->non_flow_controlled_len;
+      queue_len = self->wait_queue.non_flow_controlled_len + self->output_queue.non_flow_controlled_len;
+    }
+
+  gint admitted_len, reserved;
+  do
+    {
+      admitted_len = g_atomic_int_get(&self->wait_ring.admitted_len);
+      reserved = CLAMP(self->log_fifo_size - queue_len - admitted_len, 0, input_queue_len);
+    }
+  while (!g_atomic_int_compare_and_exchange(&self->wait_ring.admitted_len, admitted_len, admitted_len + reserved));
+
+  if (reserved < input_queue_len)
+    log_queue_fifo_drop_messages_from_input_queue(self, input_queue, input_queue_len - reserved);
+
+  log_queue_fifo_account_input_for_move(self, thread_index);
+  return reserved;
+}
 
+/* lock must be held, see the "Lockless mode" comment at the top */
+static inline void
+_mark_wait_queue_used(LogQueueFifo *self)
+{
+  if (_is_lockless(self))
+    g_atomic_int_set(&self->wait_ring.overflow, TRUE);
+}
+
+/* lock must be held */
+static void
+log_queue_fifo_splice_input_to_wait_queue(LogQueueFifo *self, gint thread_index)
+{
+  _mark_wait_queue_used(self);
   iv_list_splice_tail_init(&self->input_queues[thread_index].items, &self->wait_queue.items);
   self->wait_queue.len += self->input_queues[thread_index].len;
   self->wait_queue.non_flow_controlled_len += self->input_queues[thread_index].non_flow_controlled_len;
@@ -285,6 +525,73 @@ log_queue_fifo_move_input_unlocked(LogQueueFifo *self, gint thread_index)
   self->input_queues[thread_index].non_flow_controlled_len = 0;
 }
 
+/* move items from the per-thread input queue to the lock-protected "wait" queue */
+static void
+log_queue_fifo_move_input_unlocked(LogQueueFifo *self, gint thread_index)
+{
+  log_queue_fifo_prepare_input_for_move(self, thread_index);
+  log_queue_fifo_splice_input_to_wait_queue(self, thread_index);
+}
+
+static inline gboolean
+_try_push_input_to_wait_ring(LogQueueFifo *self, gint thread_index)
+{
+  if (g_atomic_int_get(&self->wait_ring.overflow))
+    return FALSE;
+
+  if (!_wait_ring_push_batch(&self->wait_ring, &self->input_queues[thread_index]))
+    return FALSE;
+
+  self->input_queues[thread_index].len = 0;
+  self->input_queues[thread_index].non_flow_controlled_len = 0;
+  return TRUE;
+}
+
+/*
+ * The output thread registers its push notify callback before checking
+ * the length of the queue (see log_queue_check_items()), and we check
+ * the callback after the nodes became visible, so at least one of the
+ * two sides notices the other.
+ */
+static inline void
+_push_notify_lockless(LogQueueFifo *self)
+{
+  if (!g_atomic_pointer_get(&self->super.parallel_push_notify))
+    return;
+
+  g_mutex_lock(&self->super.lock);
+  log_queue_push_notify(&self->super);
+  g_mutex_unlock(&self->super.lock);
+}
+
+/* lockless variant of log_queue_fifo_move_input(), lock is only taken if the ring is full */
+static void
+log_queue_fifo_move_input_lockless(LogQueueFifo *self, gint thread_index)
+{
+  gint reserved = log_queue_fifo_prepare_input_for_move_lockless(self, thread_index);
+
+  if (_try_push_input_to_wait_ring(self, thread_index))
+    {
+      _push_notify_lockless(self);
+      return;
+    }
+
+  g_mutex_lock(&self->super.lock);
+
+  /* the output thread may have cleared the overflow flag or made room in
+   * the meantime, the decision is final only under the lock */
+  if (!_try_push_input_to_wait_ring(self, thread_index))
+    {
+      g_atomic_int_set(&self->wait_ring.overflow, TRUE);
+      log_queue_fifo_splice_input_to_wait_queue(self, thread_index);
+
+      /* counted by the wait queue from now on */
+      g_atomic_int_add(&self->wait_ring.admitted_len, -reserved);
+    }
+  log_queue_push_notify(&self->super);
+  g_mutex_unlock(&self->super.lock);
+}
+
 /* move items from the per-thread input queue to the lock-protected
  * "wait" queue, but grabbing locks first. This is registered as a
  * callback to be called when the input worker thread finishes its
@@ -299,10 +606,17 @@ log_queue_fifo_move_input(gpointer user_data)
   thread_index = main_loop_worker_get_thread_index();
   g_assert(thread_index >= 0);
 
-  g_mutex_lock(&self->super.lock);
-  log_queue_fifo_move_input_unlocked(self, thread_index);
-  log_queue_push_notify(&self->super);
-  g_mutex_unlock(&self->super.lock);
+  if (_is_lockless(self))
+    {
+      log_queue_fifo_move_input_lockless(self, thread_index);
+    }
+  else
+    {
+      g_mutex_lock(&self->super.lock);
+      log_queue_fifo_move_input_unlocked(self, thread_index);
+      log_queue_push_notify(&self->super);
+      g_mutex_unlock(&self->super.lock);
+    }
   self->input_queues[thread_index].finish_cb_registered = FALSE;
   log_queue_unref(&self->super);
   return NULL;
@@ -420,6 +734,7 @@ log_queue_fifo_push_tail(LogQueue *s, LogMessage *msg, const LogPathOptions *pat
 
   iv_list_add_tail(&node->list, &self->wait_queue.items);
   self->wait_queue.len++;
+  _mark_wait_queue_used(self);
 
   if (!path_options->flow_control_requested)
     self->wait_queue.non_flow_controlled_len++;
@@ -433,19 +748,115 @@ log_queue_fifo_push_tail(LogQueue *s, LogMessage *msg, const LogPathOptions *pat
   log_msg_unref(msg);
 }
 
+/*
+ * Batched variant of log_queue_fifo_push_tail().  Input threads use their
+ * per-thread input queues, which are flushed once per poll iteration
+ * anyway, otherwise the lock is only taken once for the whole batch.
+ *
+ * NOTE: It consumes the references passed by the caller.
+ */
+static void
+log_queue_fifo_push_tail_batch(LogQueue *s, LogMessage **msgs, const LogPathOptions *path_options, gint count)
+{
+  LogQueueFifo *self = (LogQueueFifo *) s;
+  gint thread_index = main_loop_worker_get_thread_index();
+  gsize memory_usage = 0;
+  gint queued = 0;
+
+  if (thread_index >= 0 && thread_index < self->num_input_queues)
+    {
+      for (gint i = 0; i < count; i++)
+        log_queue_fifo_push_tail(s, msgs[i], &path_options[i]);
+      return;
+    }
+
+  g_mutex_lock(&self->super.lock);
+  for (gint i = 0; i < count; i++)
+    {
+      LogMessage *msg = msgs[i];
+
+      if (_message_has_to_be_dropped(self, &path_options[i]))
+        {
+          log_queue_dropped_messages_inc(&self->super);
+          g_mutex_unlock(&self->super.lock);
+
+          _drop_message(msg, &path_options[i]);
+
+          msg_debug("Destination queue full, dropping message",
+                    evt_tag_int("queue_len", log_queue_fifo_get_length(&self->super)),
+                    evt_tag_int("log_fifo_size", self->log_fifo_size),
+                    evt_tag_str("persist_name", self->super.persist_name));
+          g_mutex_lock(&self->super.lock);
+          continue;
+        }
+
+      log_msg_write_protect(msg);
+      LogMessageQueueNode *node = log_msg_alloc_queue_node(msg, &path_options[i]);
+
+      iv_list_add_tail(&node->list, &self->wait_queue.items);
+      self->wait_queue.len++;
+      _mark_wait_queue_used(self);
+
+      if (!path_options[i].flow_control_requested)
+        self->wait_queue.non_flow_controlled_len++;
+
+      memory_usage += log_msg_get_size(msg);
+      queued++;
+
+      /* the queue node holds its own reference */
+      log_msg_unref(msg);
+    }
+
+  if (queued > 0)
+    {
+      log_queue_queued_messages_add(&self->super, queued);
+      log_queue_memory_usage_add(&self->super, memory_usage);
+      log_queue_push_notify(&self->super);
+    }
+  g_mutex_unlock(&self->super.lock);
+}
+
 /*
  * Can only run from the output thread.
  */
 static inline void
 _move_items_from_wait_queue_to_output_queue(LogQueueFifo *self)
 {
+  /* items on the ring are older than the ones on the wait queue if they
+   * come from the same input thread, so we only touch the wait queue once
+   * the ring was drained */
+  if (_is_lockless(self))
+    {
+      if (!_wait_ring_pop_all(&self->wait_ring, &self->output_queue))
+        return;
+
+      /* nothing was put on the wait queue, no need for the lock */
+      if (!g_atomic_int_get(&self->wait_ring.overflow))
+        return;
+    }
+
   /* slow path, output queue is empty, get some elements from the wait queue */
   g_mutex_lock(&self->super.lock);
+
+  /* the ring was found drained before taking the lock, but an input thread
+   * may have published a batch since then and put its next batch on the
+   * wait queue, which must not overtake the one on the ring.  Input
+   * threads only use the wait queue under the lock, so a ring drained
+   * under the lock has nothing older than the wait queue. */
+  if (_is_lockless(self) && !_wait_ring_pop_all(&self->wait_ring, &self->output_queue))
+    {
+      g_mutex_unlock(&self->super.lock);
+      return;
+    }
+
   iv_list_splice_tail_init(&self->wait_queue.items, &self->output_queue.items);
-  self->output_queue.len = self->wait_queue.len;
-  self->output_queue.non_flow_controlled_len = self->wait_queue.non_flow_controlled_len;
+  self->output_queue.len += self->wait_queue.len;
+  self->output_queue.non_flow_controlled_len += self->wait_queue.non_flow_controlled_len;
   self->wait_queue.len = 0;
   self->wait_queue.non_flow_controlled_len = 0;
+
+  if (_is_lockless(self))
+    g_atomic_int_set(&self->wait_ring.overflow, FALSE);
   g_mutex_unlock(&self->super.lock);
 }
 
@@ -474,32 +885,19 @@ log_queue_fifo_peek_head(LogQueue *s)
 /*
  * Can only run from the output thread.
  *
- * NOTE: this returns a reference which the caller must take care to free.
+ * Moves the head of the output queue to the backlog, the caller is
+ * responsible for updating the queued and memory_usage counters.
  */
-static LogMessage *
-log_queue_fifo_pop_head(LogQueue *s, LogPathOptions *path_options)
+static inline LogMessage *
+_pop_output_queue_head(LogQueueFifo *self, LogPathOptions *path_options)
 {
-  LogQueueFifo *self = (LogQueueFifo *) s;
   LogMessageQueueNode *node;
-  LogMessage *msg = NULL;
+  LogMessage *msg;
 
   if (self->output_queue.len == 0)
     _move_items_from_wait_queue_to_output_queue(self);
 
-  if (self->output_queue.len > 0)
-    {
-      node = iv_list_entry(self->output_queue.items.next, LogMessageQueueNode, list);
-
-      msg = node->msg;
-      path_options->ack_needed = node->ack_needed;
-      self->output_queue.len--;
-
-      if (!node->flow_control_requested)
-        self->output_queue.non_flow_controlled_len--;
-
-      iv_list_del_init(&node->list);
-    }
-  else
+  if (self->output_queue.len == 0)
     {
       /* no items either on the wait queue nor the output queue.
        *
@@ -511,8 +909,17 @@ log_queue_fifo_pop_head(LogQueue *s, LogPathOptions *path_options)
        */
       return NULL;
     }
-  log_queue_queued_messages_dec(&self->super);
-  log_queue_memory_usage_sub(&self->super, log_msg_get_size(msg));
+
+  node = iv_list_entry(self->output_queue.items.next, LogMessageQueueNode, list);
+
+  msg = node->msg;
+  path_options->ack_needed = node->ack_needed;
+  self->output_queue.len--;
+
+  if (!node->flow_control_requested)
+    self->output_queue.non_flow_controlled_len--;
+
+  iv_list_del_init(&node->list);
 
   /* push to backlog */
   log_msg_ref(msg);
@@ -525,6 +932,58 @@ log_queue_fifo_pop_head(LogQueue *s, LogPathOptions *path_options)
   return msg;
 }
 
+/*
+ * Can only run from the output thread.
+ *
+ * NOTE: this returns a reference which the caller must take care to free.
+ */
+static LogMessage *
+log_queue_fifo_pop_head(LogQueue *s, LogPathOptions *path_options)
+{
+  LogQueueFifo *self = (LogQueueFifo *) s;
+  LogMessage *msg = _pop_output_queue_head(self, path_options);
+
+  if (!msg)
+    return NULL;
+
+  log_queue_queued_messages_dec(&self->super);
+  log_queue_memory_usage_sub(&self->super, log_msg_get_size(msg));
+
+  return msg;
+}
+
+/*
+ * Can only run from the output thread.
+ *
+ * NOTE: this returns references which the caller must take care to free.
+ */
+static gint
+log_queue_fifo_pop_head_batch(LogQueue *s, LogMessage **msgs, LogPathOptions *path_options, gint max_count)
+{
+  LogQueueFifo *self = (LogQueueFifo *) s;
+  gsize memory_usage = 0;
+  gint count = 0;
+
+  while (count < max_count)
+    {
+      LogMessage *msg = _pop_output_queue_head(self, &path_options[count]);
+
+      if (!msg)
+        break;
+
+      memory_usage += log_msg_get_size(msg);
+      msgs[count++] = msg;
+    }
+
+  if (count > 0)
+    {
+      log_queue_queued_messages_sub(&self->super, count);
+      log_queue_memory_usage_sub(&self->super, memory_usage);
+    }
+
+  return count;
+}
+
 /*
  * Can only run from the output thread.
  */
@@ -686,6 +1145,13 @@ log_queue_fifo_free(LogQueue *s)
       log_queue_fifo_free_queue(&self->input_queues[i].items);
     }
 
+  if (_is_lockless(self))
+    {
+      gboolean drained = _wait_ring_pop_all(&self->wait_ring, &self->output_queue);
+      g_assert(drained);
+      g_free(self->wait_ring.slots);
+    }
+
   log_queue_fifo_free_queue(&self->wait_queue.items);
   log_queue_fifo_free_queue(&self->output_queue.items);
   log_queue_fifo_free_queue(&self->backlog_queue.items);
@@ -717,6 +1183,8 @@ log_queue_fifo_new(gint log_fifo_size, const gchar *persist_name, gint stats_lev
   self->super.keep_on_reload = log_queue_fifo_keep_on_reload;
   self->super.push_tail = log_queue_fifo_push_tail;
   self->super.pop_head = log_queue_fifo_pop_head;
+  self->super.push_tail_batch = log_queue_fifo_push_tail_batch;
+  self->super.pop_head_batch = log_queue_fifo_pop_head_batch;
   self->super.peek_head = log_queue_fifo_peek_head;
   self->super.ack_backlog = log_queue_fifo_ack_backlog;
   self->super.rewind_backlog = log_queue_fifo_rewind_backlog;
@@ -758,6 +1226,23 @@ log_queue_fifo_legacy_new(gint log_fifo_size, const gchar *persist_name, gint st
   return &self->super;
 }
 
+/*
+ * Switches the wait queue to the lockless mode, input threads only take
+ * the lock if the ring is full.  Must be called right after construction,
+ * before the queue is used.
+ */
+void
+log_queue_fifo_set_lockless(LogQueue *s)
+{
+  LogQueueFifo *self = (LogQueueFifo *) s;
+
+  g_assert(log_queue_has_type(s, log_queue_fifo_type));
+  if (_is_lockless(self))
+    return;
+
+  _wait_ring_init(&self->wait_ring, self->log_fifo_size, self->use_legacy_fifo_size);
+}
+
 QueueType
 log_queue_fifo_get_type(void)
 {
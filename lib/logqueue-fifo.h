@@ -33,6 +33,7 @@ LogQueue *log_queue_fifo_new(gint log_fifo_size, const gchar *persist_name, gint
 LogQueue *log_queue_fifo_legacy_new(gint log_fifo_size, const gchar *persist_name, gint stats_level,
                                     StatsClusterKeyBuilder *driver_sck_builder,
                                     StatsClusterKeyBuilder *queue_sck_builder);
+void log_queue_fifo_set_lockless(LogQueue *s);
 
 QueueType log_queue_fifo_get_type(void);
 
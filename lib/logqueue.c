@@ -87,6 +87,62 @@ log_queue_dropped_messages_inc(LogQueue *self)
   stats_counter_inc(self->metrics.shared.dropped_messages);
 }
 
+gboolean
+log_queue_prefetch_fill(LogQueuePrefetch *self, LogQueue *queue, gint max_count, gboolean ignore_throttle)
+{
+  g_assert(log_queue_prefetch_get_pending(self) == 0);
+
+  if (self->window == 0)
+    self->window = LOG_QUEUE_PREFETCH_SIZE;
+  else if (self->len == self->window)
+    self->window = MIN(self->window * 2, LOG_QUEUE_PREFETCH_SIZE);
+
+  max_count = queue->costly_rewind ? 1 : CLAMP(max_count, 1, self->window);
+
+  if (ignore_throttle)
+    self->len = log_queue_pop_head_batch_ignore_throttle(queue, self->msgs, self->path_options, max_count);
+  else
+    self->len = log_queue_pop_head_batch(queue, self->msgs, self->path_options, max_count);
+  self->pos = 0;
+  self->throttled = !ignore_throttle;
+
+  return self->len > 0;
+}
+
+/* puts back the messages that were popped, but not handed out yet */
+void
+log_queue_prefetch_rewind(LogQueuePrefetch *self, LogQueue *queue)
+{
+  gint pending = log_queue_prefetch_get_pending(self);
+
+  if (pending == 0)
+    return;
+
+  log_queue_rewind_backlog(queue, pending);
+  log_queue_prefetch_discard(self, queue);
+}
+
+/* drops the messages not handed out yet, e.g. after they were rewound by log_queue_rewind_backlog_all() */
+void
+log_queue_prefetch_discard(LogQueuePrefetch *self, LogQueue *queue)
+{
+  gint pending = log_queue_prefetch_get_pending(self);
+
+  if (pending > 0)
+    {
+      /* the consumer could not keep up with the batch, pop only as much next time */
+      self->window = MAX(self->pos, 1);
+
+      if (self->throttled)
+        log_queue_refund_throttle(queue, pending);
+    }
+
+  for (gint i = self->pos; i < self->len; i++)
+    log_msg_unref(self->msgs[i]);
+
+  self->len = self->pos = 0;
+}
+
 /*
  * When this is called, it is assumed that the output thread is currently
  * not running (since this is the function that wakes it up), thus we can
@@ -160,12 +216,17 @@ log_queue_check_items(LogQueue *self, gint *timeout, LogQueuePushNotifyFunc para
   if (self->parallel_push_data && self->parallel_push_data_destroy)
     self->parallel_push_data_destroy(self->parallel_push_data);
 
+  /* the callback is registered before the length is checked: queues that
+   * let producers in without self->lock (e.g. the lockless LogQueueFifo)
+   * check the callback after publishing their items, so one of the two
+   * sides is guaranteed to notice the other */
+  self->parallel_push_data = user_data;
+  self->parallel_push_data_destroy = user_data_destroy;
+  g_atomic_pointer_set(&self->parallel_push_notify, parallel_push_notify);
+
   num_elements = log_queue_get_length(self);
   if (num_elements == 0)
     {
-      self->parallel_push_notify = parallel_push_notify;
-      self->parallel_push_data = user_data;
-      self->parallel_push_data_destroy = user_data_destroy;
       g_mutex_unlock(&self->lock);
       return FALSE;
     }
@@ -176,6 +237,7 @@ log_queue_check_items(LogQueue *self, gint *timeout, LogQueuePushNotifyFunc para
 
   self->parallel_push_notify = NULL;
   self->parallel_push_data = NULL;
+  self->parallel_push_data_destroy = NULL;
 
   g_mutex_unlock(&self->lock);
 
@@ -26,6 +26,7 @@
 #define LOGQUEUE_H_INCLUDED
 
 #include "logmsg/logmsg.h"
+#include "logpipe.h"
 #include "stats/stats-registry.h"
 #include "stats/stats-cluster-key-builder.h"
 
@@ -33,6 +34,32 @@ typedef void (*LogQueuePushNotifyFunc)(gpointer user_data);
 
 typedef struct _LogQueue LogQueue;
 
+#define LOG_QUEUE_PREFETCH_SIZE 32
+
+/*
+ * Consumer side helper around log_queue_pop_head_batch(): messages are
+ * popped from the queue in batches, but handed out one by one.  Popped
+ * messages are already on the backlog of the queue, so the ones not handed
+ * out yet have to be returned (using log_queue_prefetch_rewind()) before
+ * the consumer rewinds anything else.
+ *
+ * The number of messages popped at once adapts to the consumer: it shrinks
+ * to the number of messages actually handed out whenever some had to be
+ * rewound, and doubles every time a whole batch was consumed.  Queues where
+ * rewinding is not cheap (see LogQueue.costly_rewind) are not prefetched
+ * from, messages are popped one by one.
+ */
+typedef struct _LogQueuePrefetch
+{
+  LogMessage *msgs[LOG_QUEUE_PREFETCH_SIZE];
+  LogPathOptions path_options[LOG_QUEUE_PREFETCH_SIZE];
+  gint len;
+  gint pos;
+  /* 0 means LOG_QUEUE_PREFETCH_SIZE, so a zero initialized struct is usable */
+  gint window;
+  gboolean throttled;
+} LogQueuePrefetch;
+
 typedef const char *QueueType;
 
 typedef struct _LogQueueMetrics
@@ -68,6 +95,9 @@ struct _LogQueue
 
   gchar *persist_name;
 
+  /* rewinding may have to re-read the messages (e.g. from disk), see LogQueuePrefetch */
+  gboolean costly_rewind;
+
   LogQueueMetrics metrics;
 
   GMutex lock;
@@ -81,6 +111,11 @@ struct _LogQueue
   gboolean (*is_empty_racy)(LogQueue *self);
   void (*push_tail)(LogQueue *self, LogMessage *msg, const LogPathOptions *path_options);
   LogMessage *(*pop_head)(LogQueue *self, LogPathOptions *path_options);
+
+  /* optional, emulated with push_tail/pop_head if not implemented */
+  void (*push_tail_batch)(LogQueue *self, LogMessage **msgs, const LogPathOptions *path_options, gint count);
+  gint (*pop_head_batch)(LogQueue *self, LogMessage **msgs, LogPathOptions *path_options, gint max_count);
+
   LogMessage *(*peek_head)(LogQueue *self);
   void (*ack_backlog)(LogQueue *self, gint n);
   void (*rewind_backlog)(LogQueue *self, guint rewind_count);
@@ -134,6 +169,74 @@ log_queue_pop_head(LogQueue *self, LogPathOptions *path_options)
   return msg;
 }
 
+/*
+ * Pushes @count messages at once, @path_options is an array with one
+ * element for each message.  The references of the messages are consumed.
+ */
+static inline void
+log_queue_push_tail_batch(LogQueue *self, LogMessage **msgs, const LogPathOptions *path_options, gint count)
+{
+  if (self->push_tail_batch)
+    {
+      self->push_tail_batch(self, msgs, path_options, count);
+      return;
+    }
+
+  for (gint i = 0; i < count; i++)
+    self->push_tail(self, msgs[i], &path_options[i]);
+}
+
+static inline gint
+_log_queue_pop_head_batch(LogQueue *self, LogMessage **msgs, LogPathOptions *path_options, gint max_count)
+{
+  if (self->pop_head_batch)
+    return self->pop_head_batch(self, msgs, path_options, max_count);
+
+  gint count = 0;
+  while (count < max_count && (msgs[count] = self->pop_head(self, &path_options[count])))
+    count++;
+
+  return count;
+}
+
+/*
+ * Pops at most @max_count messages into @msgs, @path_options must have
+ * room for @max_count elements.  Returns the number of messages popped,
+ * each of them is a reference the caller must take care to free.
+ */
+static inline gint
+log_queue_pop_head_batch(LogQueue *self, LogMessage **msgs, LogPathOptions *path_options, gint max_count)
+{
+  if (self->throttle)
+    {
+      if (self->throttle_buckets == 0)
+        return 0;
+      max_count = MIN(max_count, self->throttle_buckets);
+    }
+
+  gint count = _log_queue_pop_head_batch(self, msgs, path_options, max_count);
+
+  if (self->throttle_buckets > 0)
+    self->throttle_buckets -= count;
+
+  return count;
+}
+
+/* gives back the throttle tokens of messages that were popped, but put back to the queue */
+static inline void
+log_queue_refund_throttle(LogQueue *self, gint count)
+{
+  if (self->throttle)
+    self->throttle_buckets = MIN(self->throttle, self->throttle_buckets + count);
+}
+
+static inline gint
+log_queue_pop_head_batch_ignore_throttle(LogQueue *self, LogMessage **msgs, LogPathOptions *path_options,
+                                         gint max_count)
+{
+  return _log_queue_pop_head_batch(self, msgs, path_options, max_count);
+}
+
 static inline LogMessage *
 log_queue_peek_head(LogQueue *self)
 {
@@ -201,6 +304,28 @@ log_queue_has_type(LogQueue *self, QueueType type)
   return g_strcmp0(self->type, type) == 0;
 }
 
+static inline gint
+log_queue_prefetch_get_pending(LogQueuePrefetch *self)
+{
+  return self->len - self->pos;
+}
+
+gboolean log_queue_prefetch_fill(LogQueuePrefetch *self, LogQueue *queue, gint max_count, gboolean ignore_throttle);
+void log_queue_prefetch_rewind(LogQueuePrefetch *self, LogQueue *queue);
+void log_queue_prefetch_discard(LogQueuePrefetch *self, LogQueue *queue);
+
+/* returns a reference, just like log_queue_pop_head() */
+static inline LogMessage *
+log_queue_prefetch_pop(LogQueuePrefetch *self, LogQueue *queue, LogPathOptions *path_options, gint max_count,
+                       gboolean ignore_throttle)
+{
+  if (self->pos == self->len && !log_queue_prefetch_fill(self, queue, max_count, ignore_throttle))
+    return NULL;
+
+  *path_options = self->path_options[self->pos];
+  return self->msgs[self->pos++];
+}
+
 void log_queue_memory_usage_add(LogQueue *self, gsize value);
 void log_queue_memory_usage_sub(LogQueue *self, gsize value);
 
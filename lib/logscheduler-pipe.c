@@ -21,6 +21,7 @@
  *
  */
 #include "logscheduler-pipe.h"
+#include "cfg-tree.h"
 
 LogSchedulerOptions *
 log_scheduler_pipe_get_scheduler_options(LogPipe *s)
@@ -39,7 +40,14 @@ _init(LogPipe *s)
     return FALSE;
 
   if (!self->scheduler)
-    self->scheduler = log_scheduler_new(&self->scheduler_options, self->super.pipe_next);
+    {
+      gchar location[256];
+
+      self->scheduler = log_scheduler_new(&self->scheduler_options, self->super.pipe_next);
+      if (s->expr_node)
+        log_scheduler_set_stats_id(self->scheduler,
+                                   log_expr_node_format_location(s->expr_node, location, sizeof(location)));
+    }
 
   log_scheduler_init(self->scheduler);
 
@@ -23,6 +23,10 @@
 
 #include "logscheduler.h"
 #include "template/eval.h"
+#include "stats/stats-registry.h"
+#include "stats/stats-cluster-key-builder.h"
+
+#include <string.h>
 
 static void
 _reinject_message(LogPipe *front_pipe, LogMessage *msg, const LogPathOptions *path_options)
@@ -38,13 +42,12 @@ _reinject_message(LogPipe *front_pipe, LogMessage *msg, const LogPathOptions *pa
 /* LogSchedulerBatch */
 
 LogSchedulerBatch *
-_batch_new(struct iv_list_head *elements)
+_batch_new(void)
 {
   LogSchedulerBatch *batch = g_new0(LogSchedulerBatch, 1);
 
   INIT_IV_LIST_HEAD(&batch->elements);
   INIT_IV_LIST_HEAD(&batch->list);
-  iv_list_splice_tail(elements, &batch->elements);
   return batch;
 }
 
@@ -56,13 +59,123 @@ _batch_free(LogSchedulerBatch *batch)
 
 /* LogSchedulerPartition */
 
+/* takes all queued batches off the partition, must be called with batches_lock held */
 static void
-_work(gpointer s, gpointer arg)
+_partition_take_batches(LogSchedulerPartition *partition, struct iv_list_head *batches)
+{
+  iv_list_splice_tail_init(&partition->batches, batches);
+  partition->num_queued_messages = 0;
+  stats_counter_set(partition->metrics.queued, 0);
+}
+
+static void
+_queue_messages_in_batch(LogPipe *front_pipe, LogMessage **msgs, LogPathOptions *path_options, gint num_msgs)
+{
+  LogMessage *queued_msgs[LOG_PIPE_MAX_BATCH_SIZE];
+
+  /* the pipe may replace the elements of the array (e.g. making them writable) */
+  memcpy(queued_msgs, msgs, num_msgs * sizeof(msgs[0]));
+  log_pipe_queue_batch(front_pipe, queued_msgs, path_options, num_msgs);
+
+  for (gint i = 0; i < num_msgs; i++)
+    log_msg_unref(msgs[i]);
+}
+
+/*
+ * Pipes able to process a batch of messages at once (e.g. filters) get
+ * the messages in chunks of LOG_PIPE_MAX_BATCH_SIZE.  The refcache is
+ * not used in this case, as it only works with a single message at a time.
+ */
+static void
+_partition_process_batch_at_once(LogSchedulerPartition *partition, LogSchedulerBatch *batch)
+{
+  LogPipe *front_pipe = partition->scheduler->front_pipe;
+  LogMessage *msgs[LOG_PIPE_MAX_BATCH_SIZE];
+  LogPathOptions path_options[LOG_PIPE_MAX_BATCH_SIZE];
+  struct iv_list_head *ilh, *next;
+  gint num_msgs = 0;
+
+  iv_list_for_each_safe(ilh, next, &batch->elements)
+  {
+    LogMessageQueueNode *node = iv_list_entry(ilh, LogMessageQueueNode, list);
+
+    iv_list_del(&node->list);
+
+    msgs[num_msgs] = log_msg_ref(node->msg);
+    path_options[num_msgs] = (LogPathOptions) LOG_PATH_OPTIONS_INIT;
+    path_options[num_msgs].ack_needed = node->ack_needed;
+    path_options[num_msgs].flow_control_requested = node->flow_control_requested;
+    num_msgs++;
+
+    log_msg_free_queue_node(node);
+
+    if (num_msgs == LOG_PIPE_MAX_BATCH_SIZE)
+      {
+        _queue_messages_in_batch(front_pipe, msgs, path_options, num_msgs);
+        num_msgs = 0;
+      }
+  }
+
+  if (num_msgs > 0)
+    _queue_messages_in_batch(front_pipe, msgs, path_options, num_msgs);
+}
+
+static void
+_partition_process_batch(LogSchedulerPartition *partition, LogSchedulerBatch *batch)
+{
+  LogPipe *front_pipe = partition->scheduler->front_pipe;
+  struct iv_list_head *ilh, *next;
+
+  stats_counter_set(partition->metrics.latency, (g_get_monotonic_time() - batch->queued_at) / 1000);
+
+  if (front_pipe && front_pipe->queue_batch)
+    {
+      _partition_process_batch_at_once(partition, batch);
+      stats_counter_add(partition->metrics.processed, batch->num_messages);
+      return;
+    }
+
+  iv_list_for_each_safe(ilh, next, &batch->elements)
+  {
+    LogMessageQueueNode *node = iv_list_entry(ilh, LogMessageQueueNode, list);
+
+    iv_list_del(&node->list);
+
+    LogMessage *msg = log_msg_ref(node->msg);
+
+    LogPathOptions path_options = LOG_PATH_OPTIONS_INIT;
+    path_options.ack_needed = node->ack_needed;
+    path_options.flow_control_requested = node->flow_control_requested;
+
+    log_msg_free_queue_node(node);
+
+    log_msg_refcache_start_consumer(msg, &path_options);
+    _reinject_message(front_pipe, msg, &path_options);
+    log_msg_unref(msg);
+    log_msg_refcache_stop();
+  }
+  stats_counter_add(partition->metrics.processed, batch->num_messages);
+}
+
+static void
+_partition_process_batches(LogSchedulerPartition *partition, struct iv_list_head *batches)
 {
-  LogSchedulerPartition *partition = (LogSchedulerPartition *) s;
   struct iv_list_head *ilh, *next;
-  struct iv_list_head *ilh2, *next2;
 
+  iv_list_for_each_safe(ilh, next, batches)
+  {
+    /* remove the first batch from the batches list */
+    LogSchedulerBatch *batch = iv_list_entry(ilh, LogSchedulerBatch, list);
+    iv_list_del(&batch->list);
+
+    _partition_process_batch(partition, batch);
+    _batch_free(batch);
+  }
+}
+
+static void
+_partition_drain(LogSchedulerPartition *partition)
+{
   /* batches_lock protects the batches list itself.  We take off partitions
    * one-by-one under the protection of the lock */
 
@@ -70,40 +183,65 @@ _work(gpointer s, gpointer arg)
   while (!iv_list_empty(&partition->batches))
     {
       struct iv_list_head batches = IV_LIST_HEAD_INIT(batches);
-      iv_list_splice_init(&partition->batches, &batches);
+      _partition_take_batches(partition, &batches);
 
       g_mutex_unlock(&partition->batches_lock);
 
-      iv_list_for_each_safe(ilh, next, &batches)
-      {
-        /* remove the first batch from the batches list */
-        LogSchedulerBatch *batch = iv_list_entry(ilh, LogSchedulerBatch, list);
-        iv_list_del(&batch->list);
+      _partition_process_batches(partition, &batches);
 
-        iv_list_for_each_safe(ilh2, next2, &batch->elements)
-        {
-          LogMessageQueueNode *node = iv_list_entry(ilh2, LogMessageQueueNode, list);
+      g_mutex_lock(&partition->batches_lock);
+    }
+  g_mutex_unlock(&partition->batches_lock);
+}
 
-          iv_list_del(&node->list);
+/*
+ * Take over the whole backlog of a partition whose own job is busy
+ * processing an earlier set of batches.  Its job notices the empty list
+ * when it finishes and completes normally.  As the batches of a partition
+ * may then be processed in parallel, this is only used when there's no
+ * partition-key(), i.e. when ordering between messages does not matter.
+ *
+ * Only called once our own list is drained, our own work comes first.
+ */
+static gboolean
+_partition_steal_batches(LogSchedulerPartition *partition, struct iv_list_head *batches)
+{
+  LogScheduler *scheduler = partition->scheduler;
+  gint num_partitions = scheduler->options->num_partitions;
 
-          LogMessage *msg = log_msg_ref(node->msg);
+  for (gint i = 1; i < num_partitions; i++)
+    {
+      LogSchedulerPartition *victim = &scheduler->partitions[(partition->index + i) % num_partitions];
 
-          LogPathOptions path_options = LOG_PATH_OPTIONS_INIT;
-          path_options.ack_needed = node->ack_needed;
-          path_options.flow_control_requested = node->flow_control_requested;
+      g_mutex_lock(&victim->batches_lock);
+      if (victim->flush_running && !iv_list_empty(&victim->batches))
+        {
+          _partition_take_batches(victim, batches);
+          g_mutex_unlock(&victim->batches_lock);
+          stats_counter_inc(partition->metrics.stolen);
+          return TRUE;
+        }
+      g_mutex_unlock(&victim->batches_lock);
+    }
+  return FALSE;
+}
 
-          log_msg_free_queue_node(node);
+static void
+_work(gpointer s, gpointer arg)
+{
+  LogSchedulerPartition *partition = (LogSchedulerPartition *) s;
+  LogSchedulerOptions *options = partition->scheduler->options;
 
-          log_msg_refcache_start_consumer(msg, &path_options);
-          _reinject_message(partition->front_pipe, msg, &path_options);
-          log_msg_unref(msg);
-          log_msg_refcache_stop();
-        }
-        _batch_free(batch);
-      }
-      g_mutex_lock(&partition->batches_lock);
+  _partition_drain(partition);
+  if (!options->work_stealing)
+    return;
+
+  struct iv_list_head batches = IV_LIST_HEAD_INIT(batches);
+  while (_partition_steal_batches(partition, &batches))
+    {
+      _partition_process_batches(partition, &batches);
+      _partition_drain(partition);
     }
-  g_mutex_unlock(&partition->batches_lock);
 }
 
 static void
@@ -128,11 +266,45 @@ _complete(gpointer s, gpointer arg)
     main_loop_io_worker_job_submit(&partition->io_job, NULL);
 }
 
+/*
+ * An idle partition has no job running, so it would never get to steal
+ * anything.  Whenever a batch is queued to a busy partition, start the job
+ * of an idle one: it finds its own list empty and goes on stealing.
+ */
+static void
+_wake_up_idle_partition(LogSchedulerPartition *busy_partition)
+{
+  LogScheduler *scheduler = busy_partition->scheduler;
+  gint num_partitions = scheduler->options->num_partitions;
+
+  for (gint i = 1; i < num_partitions; i++)
+    {
+      LogSchedulerPartition *partition = &scheduler->partitions[(busy_partition->index + i) % num_partitions];
+      gboolean trigger_flush = FALSE;
+
+      g_mutex_lock(&partition->batches_lock);
+      if (!partition->flush_running)
+        {
+          trigger_flush = TRUE;
+          partition->flush_running = TRUE;
+        }
+      g_mutex_unlock(&partition->batches_lock);
+
+      if (trigger_flush)
+        {
+          main_loop_io_worker_job_submit_continuation(&partition->io_job, NULL);
+          return;
+        }
+    }
+}
+
 static void
 _partition_add_batch(LogSchedulerPartition *partition, LogSchedulerBatch *batch)
 {
   gboolean trigger_flush = FALSE;
 
+  batch->queued_at = g_get_monotonic_time();
+
   g_mutex_lock(&partition->batches_lock);
   if (!partition->flush_running &&
       iv_list_empty(&partition->batches))
@@ -141,17 +313,84 @@ _partition_add_batch(LogSchedulerPartition *partition, LogSchedulerBatch *batch)
       partition->flush_running = TRUE;
     }
   iv_list_add_tail(&batch->list, &partition->batches);
+  partition->num_queued_messages += batch->num_messages;
+  stats_counter_set(partition->metrics.queued, partition->num_queued_messages);
   g_mutex_unlock(&partition->batches_lock);
 
   if (trigger_flush)
     {
       main_loop_io_worker_job_submit_continuation(&partition->io_job, NULL);
     }
+  else if (partition->scheduler->options->work_stealing)
+    {
+      _wake_up_idle_partition(partition);
+    }
+}
 
+static void
+_register_counter(StatsClusterKeyBuilder *kb, const gchar *name, StatsClusterKey **key, StatsCounterItem **counter)
+{
+  stats_cluster_key_builder_set_name(kb, name);
+  *key = stats_cluster_key_builder_build_single(kb);
+  stats_register_counter(STATS_LEVEL1, *key, SC_TYPE_SINGLE_VALUE, counter);
+}
+
+static void
+_unregister_counter(StatsClusterKey **key, StatsCounterItem **counter)
+{
+  if (!*key)
+    return;
+
+  stats_unregister_counter(*key, SC_TYPE_SINGLE_VALUE, counter);
+  stats_cluster_key_free(*key);
+  *key = NULL;
+}
+
+static void
+_partition_register_stats(LogSchedulerPartition *partition)
+{
+  gchar partition_index[16];
+
+  g_snprintf(partition_index, sizeof(partition_index), "%d", partition->index);
+
+  StatsClusterKeyBuilder *kb = stats_cluster_key_builder_new();
+  stats_cluster_key_builder_add_label(kb, stats_cluster_label("id", partition->scheduler->stats_id ? : ""));
+  stats_cluster_key_builder_add_label(kb, stats_cluster_label("partition", partition_index));
+
+  stats_lock();
+  {
+    _register_counter(kb, "parallelize_partition_queued_events",
+                      &partition->metrics.queued_key, &partition->metrics.queued);
+    _register_counter(kb, "parallelize_partition_processed_events_total",
+                      &partition->metrics.processed_key, &partition->metrics.processed);
+    _register_counter(kb, "parallelize_partition_stolen_batches_total",
+                      &partition->metrics.stolen_key, &partition->metrics.stolen);
+
+    /* time between handing over a batch to the partition and starting to process it */
+    stats_cluster_key_builder_set_unit(kb, SCU_MILLISECONDS);
+    _register_counter(kb, "parallelize_partition_latency_seconds",
+                      &partition->metrics.latency_key, &partition->metrics.latency);
+  }
+  stats_unlock();
+
+  stats_cluster_key_builder_free(kb);
+}
+
+static void
+_partition_unregister_stats(LogSchedulerPartition *partition)
+{
+  stats_lock();
+  {
+    _unregister_counter(&partition->metrics.queued_key, &partition->metrics.queued);
+    _unregister_counter(&partition->metrics.processed_key, &partition->metrics.processed);
+    _unregister_counter(&partition->metrics.stolen_key, &partition->metrics.stolen);
+    _unregister_counter(&partition->metrics.latency_key, &partition->metrics.latency);
+  }
+  stats_unlock();
 }
 
 static void
-_partition_init(LogSchedulerPartition *partition, LogPipe *front_pipe)
+_partition_init(LogSchedulerPartition *partition, LogScheduler *scheduler, gint index)
 {
   main_loop_io_worker_job_init(&partition->io_job);
   partition->io_job.user_data = partition;
@@ -160,7 +399,8 @@ _partition_init(LogSchedulerPartition *partition, LogPipe *front_pipe)
   partition->io_job.engage = NULL;
   partition->io_job.release = NULL;
 
-  partition->front_pipe = front_pipe;
+  partition->scheduler = scheduler;
+  partition->index = index;
 
   INIT_IV_LIST_HEAD(&partition->batches);
   g_mutex_init(&partition->batches_lock);
@@ -202,12 +442,12 @@ _flush_batch(gpointer s)
 
   for (gint partition_index = 0; partition_index < self->options->num_partitions; partition_index++)
     {
-      if (iv_list_empty(&thread_state->batch_by_partition[partition_index]))
+      /* hand over the batch accumulated in batch_by_partition */
+      LogSchedulerBatch *batch = thread_state->batch_by_partition[partition_index];
+      if (!batch)
         continue;
 
-      /* form the new batch, hand over the accumulated elements in batch_by_partition */
-      LogSchedulerBatch *batch = _batch_new(&thread_state->batch_by_partition[partition_index]);
-      INIT_IV_LIST_HEAD(&thread_state->batch_by_partition[partition_index]);
+      thread_state->batch_by_partition[partition_index] = NULL;
 
       /* add the new batch to the target partition */
 
@@ -230,40 +470,57 @@ _queue_thread(LogScheduler *self, LogSchedulerThreadState *thread_state, LogMess
 
   guint partition_index = _get_partition_index(self, thread_state, msg);
 
+  LogSchedulerBatch *batch = thread_state->batch_by_partition[partition_index];
+  if (!batch)
+    {
+      batch = _batch_new();
+      thread_state->batch_by_partition[partition_index] = batch;
+    }
+
   LogMessageQueueNode *node;
   node = log_msg_alloc_queue_node(msg, path_options);
-  iv_list_add_tail(&node->list, &thread_state->batch_by_partition[partition_index]);
+  iv_list_add_tail(&node->list, &batch->elements);
+  batch->num_messages++;
   thread_state->num_messages++;
   log_msg_unref(msg);
 }
 
 
 static void
-_thread_state_init(LogScheduler *self, LogSchedulerThreadState *state)
+_thread_state_init(LogScheduler *self, LogSchedulerThreadState *state, LogSchedulerBatch **batch_by_partition)
 {
   worker_batch_callback_init(&state->batch_callback);
   state->batch_callback.func = _flush_batch;
   state->batch_callback.user_data = self;
 
-  for (gint i = 0; i < self->options->num_partitions; i++)
-    INIT_IV_LIST_HEAD(&state->batch_by_partition[i]);
+  state->batch_by_partition = batch_by_partition;
 }
 
 static void
 _init_thread_states(LogScheduler *self)
 {
+  gint num_partitions = self->options->num_partitions;
+
+  self->pending_batches = g_new0(LogSchedulerBatch *, self->num_threads * num_partitions);
   for (gint i = 0; i < self->num_threads; i++)
     {
-      _thread_state_init(self, &self->thread_states[i]);
+      _thread_state_init(self, &self->thread_states[i], &self->pending_batches[i * num_partitions]);
     }
 }
 
+static void
+_free_thread_states(LogScheduler *self)
+{
+  g_free(self->pending_batches);
+}
+
 static void
 _init_partitions(LogScheduler *self)
 {
+  self->partitions = g_new0(LogSchedulerPartition, self->options->num_partitions);
   for (gint i = 0; i < self->options->num_partitions; i++)
     {
-      _partition_init(&self->partitions[i], self->front_pipe);
+      _partition_init(&self->partitions[i], self, i);
     }
 }
 
@@ -274,17 +531,22 @@ _free_partitions(LogScheduler *self)
     {
       _partition_clear(&self->partitions[i]);
     }
+  g_free(self->partitions);
 }
 
 gboolean
 log_scheduler_init(LogScheduler *self)
 {
+  for (gint i = 0; i < self->options->num_partitions; i++)
+    _partition_register_stats(&self->partitions[i]);
   return TRUE;
 }
 
 void
 log_scheduler_deinit(LogScheduler *self)
 {
+  for (gint i = 0; i < self->options->num_partitions; i++)
+    _partition_unregister_stats(&self->partitions[i]);
 }
 
 void
@@ -324,6 +586,8 @@ log_scheduler_free(LogScheduler *self)
 {
   log_pipe_unref(self->front_pipe);
   _free_partitions(self);
+  _free_thread_states(self);
+  g_free(self->stats_id);
   g_free(self);
 }
 
@@ -367,11 +631,19 @@ void
 log_scheduler_free(LogScheduler *self)
 {
   log_pipe_unref(self->front_pipe);
+  g_free(self->stats_id);
   g_free(self);
 }
 
 #endif
 
+void
+log_scheduler_set_stats_id(LogScheduler *self, const gchar *stats_id)
+{
+  g_free(self->stats_id);
+  self->stats_id = g_strdup(stats_id);
+}
+
 void
 log_scheduler_options_set_partition_key_ref(LogSchedulerOptions *options, LogTemplate *partition_key)
 {
@@ -384,6 +656,7 @@ log_scheduler_options_defaults(LogSchedulerOptions *options)
 {
   options->num_partitions = -1;
   options->partition_key = NULL;
+  options->work_stealing = FALSE;
 }
 
 gboolean
@@ -393,6 +666,12 @@ log_scheduler_options_init(LogSchedulerOptions *options, GlobalConfig *cfg)
     options->num_partitions = 0;
   if (options->num_partitions > LOGSCHEDULER_MAX_PARTITIONS)
     options->num_partitions = LOGSCHEDULER_MAX_PARTITIONS;
+  if (options->work_stealing && options->partition_key)
+    {
+      msg_warning("WARNING: parallelize(work-stealing(yes)) is ignored when partition-key() is set, "
+                  "as it would break the ordering of messages within a partition");
+      options->work_stealing = FALSE;
+    }
   return TRUE;
 }
 
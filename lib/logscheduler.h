@@ -27,31 +27,52 @@
 #include "logpipe.h"
 #include "mainloop-io-worker.h"
 #include "template/templates.h"
+#include "stats/stats-cluster.h"
 
 #include <iv_list.h>
 #include <iv_event.h>
 
-#define LOGSCHEDULER_MAX_PARTITIONS 16
+/* partitions above the number of worker threads would never run in parallel */
+#define LOGSCHEDULER_MAX_PARTITIONS MAIN_LOOP_MAX_WORKER_THREADS
+
+typedef struct _LogScheduler LogScheduler;
 
 typedef struct _LogSchedulerBatch
 {
   struct iv_list_head elements;
   struct iv_list_head list;
+  gsize num_messages;
+  gint64 queued_at;
 } LogSchedulerBatch;
 
 typedef struct _LogSchedulerPartition
 {
   GMutex batches_lock;
   struct iv_list_head batches;
+  gsize num_queued_messages;
   gboolean flush_running;
   MainLoopIOWorkerJob io_job;
-  LogPipe *front_pipe;
+  LogScheduler *scheduler;
+  gint index;
+
+  struct
+  {
+    StatsClusterKey *queued_key;
+    StatsClusterKey *processed_key;
+    StatsClusterKey *latency_key;
+    StatsClusterKey *stolen_key;
+    StatsCounterItem *queued;
+    StatsCounterItem *processed;
+    StatsCounterItem *latency;
+    StatsCounterItem *stolen;
+  } metrics;
 } LogSchedulerPartition;
 
 typedef struct _LogSchedulerThreadState
 {
   WorkerBatchCallback batch_callback;
-  struct iv_list_head batch_by_partition[LOGSCHEDULER_MAX_PARTITIONS];
+  /* batches being collected by this thread, indexed by partition, NULL if empty */
+  LogSchedulerBatch **batch_by_partition;
 
   guint64 num_messages;
   gint last_partition;
@@ -61,16 +82,19 @@ typedef struct _LogSchedulerOptions
 {
   gint num_partitions;
   LogTemplate *partition_key;
+  gboolean work_stealing;
 } LogSchedulerOptions;
 
-typedef struct _LogScheduler
+struct _LogScheduler
 {
   LogPipe *front_pipe;
   LogSchedulerOptions *options;
+  gchar *stats_id;
   gint num_threads;
-  LogSchedulerPartition partitions[LOGSCHEDULER_MAX_PARTITIONS];
+  LogSchedulerPartition *partitions;
+  LogSchedulerBatch **pending_batches;
   LogSchedulerThreadState thread_states[];
-} LogScheduler;
+};
 
 gboolean log_scheduler_init(LogScheduler *self);
 void log_scheduler_deinit(LogScheduler *self);
@@ -78,6 +102,7 @@ void log_scheduler_deinit(LogScheduler *self);
 void log_scheduler_push(LogScheduler *self, LogMessage *msg, const LogPathOptions *path_options);
 LogScheduler *log_scheduler_new(LogSchedulerOptions *options, LogPipe *front_pipe);
 void log_scheduler_free(LogScheduler *self);
+void log_scheduler_set_stats_id(LogScheduler *self, const gchar *stats_id);
 
 void log_scheduler_options_set_partition_key_ref(LogSchedulerOptions *options, LogTemplate *partition_key);
 void log_scheduler_options_defaults(LogSchedulerOptions *options);
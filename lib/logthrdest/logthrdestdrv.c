@@ -120,30 +120,36 @@ log_threaded_dest_worker_drop_messages(LogThreadedDestWorker *self, gint batch_s
 void
 log_threaded_dest_worker_rewind_messages(LogThreadedDestWorker *self, gint batch_size)
 {
+  /* prefetched messages are at the end of the backlog, they have to go back first */
+  log_queue_prefetch_rewind(&self->prefetch, self->queue);
   log_queue_rewind_backlog(self->queue, batch_size);
   self->rewound_batch_size = self->batch_size;
   self->batch_size -= batch_size;
 }
 
 static gchar *
-_format_queue_persist_name(LogThreadedDestWorker *self)
+_format_queue_persist_name_for_index(LogThreadedDestDriver *owner, gint worker_index)
 {
-  LogPipe *owner = &self->owner->super.super.super;
-
-  if (self->worker_index == 0)
+  if (worker_index == 0)
     {
       /* the first worker uses the legacy persist name, e.g.  to be able to
        * recover the queue previously used.  */
-      return g_strdup(log_pipe_get_persist_name(owner));
+      return g_strdup(log_pipe_get_persist_name(&owner->super.super.super));
     }
   else
     {
       return g_strdup_printf("%s.%d.queue",
-                             log_pipe_get_persist_name(owner),
-                             self->worker_index);
+                             log_pipe_get_persist_name(&owner->super.super.super),
+                             worker_index);
     }
 }
 
+static gchar *
+_format_queue_persist_name(LogThreadedDestWorker *self)
+{
+  return _format_queue_persist_name_for_index(self->owner, self->worker_index);
+}
+
 
 static gboolean
 _should_flush_now(LogThreadedDestWorker *self)
@@ -436,9 +442,32 @@ _should_flush_due_to_partition_key_change(LogThreadedDestWorker *self, LogMessag
   return should_flush;
 }
 
+static inline gint
+_calculate_prefetch_size(LogThreadedDestWorker *self)
+{
+  /* peeking at the head of the queue only works without prefetching */
+  if (_flush_on_worker_partition_key_change_enabled(self))
+    return 1;
+
+  gint prefetch_size = LOG_QUEUE_PREFETCH_SIZE;
+
+  if (self->rewound_batch_size)
+    prefetch_size = MIN(self->rewound_batch_size, prefetch_size);
+
+  /* don't pop more than what fits into the current batch */
+  if (self->enable_batching && self->owner->batch_lines > 0)
+    prefetch_size = MIN(MAX(self->owner->batch_lines - self->batch_size, 1), prefetch_size);
+
+  return prefetch_size;
+}
+
 /* NOTE: runs in the worker thread, whenever items on our queue are
  * available. It iterates all elements on the queue, however will terminate
- * if the mainloop requests that we exit. */
+ * if the mainloop requests that we exit.
+ *
+ * Messages are popped from the queue in batches (see LogQueuePrefetch),
+ * the ones not inserted by the time we return are put back to the queue.
+ */
 static void
 _perform_inserts(LogThreadedDestWorker *self)
 {
@@ -477,7 +506,8 @@ _perform_inserts(LogThreadedDestWorker *self)
             }
         }
 
-      LogMessage *msg = log_queue_pop_head(self->queue, &path_options);
+      LogMessage *msg = log_queue_prefetch_pop(&self->prefetch, self->queue, &path_options,
+                                               _calculate_prefetch_size(self), FALSE);
       if (!msg)
         {
           scratch_buffers_reclaim_marked(mark);
@@ -510,6 +540,7 @@ flush_error:
 
       iv_invalidate_now();
     }
+  log_queue_prefetch_rewind(&self->prefetch, self->queue);
   self->rewound_batch_size = 0;
 }
 
@@ -1339,6 +1370,44 @@ _format_seqnum_persist_name(LogThreadedDestDriver *self)
   return persist_name;
 }
 
+/*
+ * Each worker has its own queue, with disk-buffer() each of them is stored
+ * in a separate file, referenced from the persist file.  If the number of
+ * workers is decreased, the files of the removed workers are not
+ * processed anymore, make this visible.
+ */
+static void
+_warn_about_queue_files_of_removed_workers(LogThreadedDestDriver *self)
+{
+  GlobalConfig *cfg = log_pipe_get_config(&self->super.super.super);
+
+  if (!cfg->state)
+    return;
+
+  for (gint worker_index = MAX(self->num_workers, 1); ; worker_index++)
+    {
+      gchar *persist_name = _format_queue_persist_name_for_index(self, worker_index);
+      gchar *filename = persist_state_lookup_string(cfg->state, persist_name, NULL, NULL);
+
+      if (!filename)
+        {
+          g_free(persist_name);
+          break;
+        }
+
+      if (g_file_test(filename, G_FILE_TEST_IS_REGULAR))
+        msg_warning("WARNING: the queue file of a removed worker is not processed, "
+                    "increase workers() or process the remaining messages with dqtool",
+                    evt_tag_str("filename", filename),
+                    evt_tag_str("persist_name", persist_name),
+                    evt_tag_int("workers", self->num_workers),
+                    log_pipe_location_tag(&self->super.super.super));
+
+      g_free(filename);
+      g_free(persist_name);
+    }
+}
+
 static gboolean
 _create_workers(LogThreadedDestDriver *self, gint stats_level, StatsClusterKeyBuilder *driver_sck_builder)
 {
@@ -1355,6 +1424,7 @@ _create_workers(LogThreadedDestDriver *self, gint stats_level, StatsClusterKeyBu
         return FALSE;
     }
 
+  _warn_about_queue_files_of_removed_workers(self);
   return TRUE;
 }
 
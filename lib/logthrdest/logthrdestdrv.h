@@ -104,6 +104,8 @@ struct _LogThreadedDestWorker
     GString *last_key;
   } partitioning;
 
+  LogQueuePrefetch prefetch;
+
   struct
   {
     StatsClusterKey *output_event_bytes_sc_key;
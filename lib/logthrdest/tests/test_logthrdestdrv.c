@@ -25,11 +25,14 @@
 #include "libtest/grab-logging.h"
 #include "libtest/stopwatch.h"
 #include "libtest/cr_template.h"
+#include "libtest/persist_lib.h"
 
 #include "logthrdest/logthrdestdrv.h"
 #include "mainloop-worker.h"
 #include "apphook.h"
 
+#include <unistd.h>
+
 typedef struct TestThreadedDestDriver
 {
   LogThreadedDestDriver super;
@@ -806,6 +809,39 @@ Test(logthrdestdrv, test_explicit_ack_accept)
   cr_assert(dd->super.shared_seq_num == 11, "%d", dd->super.shared_seq_num);
 }
 
+Test(logthrdestdrv, queue_files_of_removed_workers_are_warned_about)
+{
+  GlobalConfig *cfg = main_loop_get_current_config(main_loop);
+  const gchar *removed_worker_queue_file = "test_logthrdestdrv_removed_worker.qf";
+  const gchar *unused_queue_file = "test_logthrdestdrv_unused.qf";
+
+  cr_assert(g_file_set_contents(removed_worker_queue_file, "", 0, NULL));
+  cr_assert(g_file_set_contents(unused_queue_file, "", 0, NULL));
+
+  cfg->state = clean_and_create_persist_state_for_test("test_logthrdestdrv.persist");
+  persist_state_alloc_string(cfg->state, "persist-name.2.queue", removed_worker_queue_file, -1);
+  /* not reached, as there is no queue file for the 3rd worker */
+  persist_state_alloc_string(cfg->state, "persist-name.4.queue", unused_queue_file, -1);
+
+  TestThreadedDestDriver *two_workers_dd = test_threaded_dd_new(cfg);
+  log_threaded_dest_driver_set_num_workers(&two_workers_dd->super.super.super, 2);
+
+  start_grabbing_messages();
+  cr_assert(log_pipe_init(&two_workers_dd->super.super.super.super));
+  assert_grabbed_log_contains("the queue file of a removed worker is not processed");
+  assert_grabbed_log_contains(removed_worker_queue_file);
+  cr_assert_not(find_grabbed_message(unused_queue_file));
+  stop_grabbing_messages();
+
+  log_pipe_deinit(&two_workers_dd->super.super.super.super);
+  log_pipe_unref(&two_workers_dd->super.super.super.super);
+
+  cancel_and_destroy_persist_state(cfg->state);
+  cfg->state = NULL;
+  unlink(removed_worker_queue_file);
+  unlink(unused_queue_file);
+}
+
 MainLoopOptions main_loop_options = {0};
 
 static void
@@ -66,6 +66,7 @@ struct _LogWriter
 {
   LogPipe super;
   LogQueue *queue;
+  LogQueuePrefetch prefetch;
   guint32 flags:31;
   gint32 seq_num;
   gboolean partial_write;
@@ -173,6 +174,9 @@ void
 log_writer_msg_rewind(LogWriter *self)
 {
   log_queue_rewind_backlog_all(self->queue);
+
+  /* prefetched messages were on the backlog too, they are back in the queue now */
+  log_queue_prefetch_discard(&self->prefetch, self->queue);
 }
 
 static void
@@ -1282,7 +1286,18 @@ log_writer_write_message(LogWriter *self, LogMessage *msg, LogPathOptions *path_
       msg_debug("Can't send the message rewind backlog",
                 evt_tag_printf("message", "%s", self->line_buffer->str));
 
-      log_queue_rewind_backlog(self->queue, 1);
+      if (*write_error)
+        {
+          /* messages posted earlier may not have been written either,
+           * the proto leaves rewinding them to us */
+          log_writer_msg_rewind(self);
+        }
+      else
+        {
+          /* the prefetched messages are behind this one in the backlog */
+          log_queue_prefetch_rewind(&self->prefetch, self->queue);
+          log_queue_rewind_backlog(self->queue, 1);
+        }
 
       log_msg_unref(msg);
       msg_set_context(NULL);
@@ -1295,10 +1310,7 @@ log_writer_write_message(LogWriter *self, LogMessage *msg, LogPathOptions *path_
 static inline LogMessage *
 log_writer_queue_pop_message(LogWriter *self, LogPathOptions *path_options, gboolean force_flush)
 {
-  if (force_flush)
-    return log_queue_pop_head_ignore_throttle(self->queue, path_options);
-  else
-    return log_queue_pop_head(self->queue, path_options);
+  return log_queue_prefetch_pop(&self->prefetch, self->queue, path_options, LOG_QUEUE_PREFETCH_SIZE, force_flush);
 }
 
 static inline gboolean
@@ -1359,6 +1371,7 @@ log_writer_flush(LogWriter *self, LogWriterFlushMode flush_mode)
       if (!write_error)
         stats_counter_inc(self->metrics.written_messages);
     }
+  log_queue_prefetch_rewind(&self->prefetch, self->queue);
 
   if (write_error)
     return FALSE;
@@ -1938,6 +1951,7 @@ log_writer_options_defaults(LogWriterOptions *options)
 {
   options->template = NULL;
   options->flush_lines = -1;
+  options->batch_writes = FALSE;
   log_template_options_defaults(&options->template_options);
   options->time_reopen = -1;
   options->suppress = -1;
@@ -1992,6 +2006,8 @@ log_writer_options_init(LogWriterOptions *options, GlobalConfig *cfg, guint32 op
 
   if (options->flush_lines == -1)
     options->flush_lines = cfg->flush_lines;
+  if (options->batch_writes)
+    log_proto_client_options_set_batch_size(&options->proto_options.super, options->flush_lines);
   if (options->suppress == -1)
     options->suppress = cfg->suppress;
   if (options->time_reopen == -1)
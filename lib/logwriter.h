@@ -56,6 +56,8 @@ typedef struct _LogWriterOptions
 
   /* minimum number of entries to trigger a flush */
   gint flush_lines;
+  /* send the messages of a flush using a single writev() */
+  gboolean batch_writes;
 
   LogTemplate *template;
   LogTemplate *file_template;
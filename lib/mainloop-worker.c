@@ -27,6 +27,7 @@
 #include "apphook.h"
 #include "messages.h"
 #include "scratch-buffers.h"
+#include "stats/stats-counter.h"
 #include "atomic.h"
 
 #include <iv.h>
@@ -442,6 +443,7 @@ main_loop_worker_finalize_thread_space(void)
 {
   main_loop_max_workers = main_loop_estimated_number_of_workers;
   main_loop_estimated_number_of_workers = 0;
+  stats_counter_set_thread_index_func(main_loop_worker_get_thread_index, main_loop_max_workers);
 }
 
 static void
@@ -191,6 +191,8 @@ _determine_payload_size(MsgFormatOptions *parse_options, const guchar *data, gsi
 
   if ((parse_options->flags & LP_STORE_RAW_MESSAGE))
     payload_size = length * 4;
+  else if ((parse_options->flags & LP_ZERO_COPY))
+    payload_size = length + 256;
   else
     payload_size = length * 2;
 
@@ -319,6 +321,7 @@ CfgFlagHandler msg_format_flag_handlers[] =
   { "guess-timezone",             CFH_SET, offsetof(MsgFormatOptions, flags), LP_GUESS_TIMEZONE },
   { "no-header",                  CFH_SET, offsetof(MsgFormatOptions, flags), LP_NO_HEADER },
   { "no-rfc3164-fallback",        CFH_SET, offsetof(MsgFormatOptions, flags), LP_NO_RFC3164_FALLBACK },
+  { "zero-copy",                  CFH_SET, offsetof(MsgFormatOptions, flags), LP_ZERO_COPY },
   { NULL },
 };
 
@@ -59,6 +59,8 @@ enum
   LP_GUESS_TIMEZONE = 0x1000,
   LP_NO_HEADER = 0x2000,
   LP_NO_RFC3164_FALLBACK = 0x4000,
+  /* store the raw message once and reference the parsed fields from it instead of copying them */
+  LP_ZERO_COPY = 0x8000,
 };
 
 typedef struct _MsgFormatHandler MsgFormatHandler;
@@ -204,6 +204,46 @@ serialize_read_uint8(SerializeArchive *archive, guint8 *value)
   return FALSE;
 }
 
+/* variable length (LEB128) encoding, 7 bits per byte, least significant group first */
+static inline gboolean
+serialize_write_varint(SerializeArchive *archive, guint64 value)
+{
+  guint8 buf[10];
+  gsize len = 0;
+
+  do
+    {
+      buf[len] = value & 0x7F;
+      value >>= 7;
+      if (value)
+        buf[len] |= 0x80;
+      len++;
+    }
+  while (value);
+  return serialize_archive_write_bytes(archive, (gchar *) buf, len);
+}
+
+static inline gboolean
+serialize_read_varint(SerializeArchive *archive, guint64 *value)
+{
+  guint64 result = 0;
+  guint8 n;
+
+  for (gint shift = 0; shift < 64; shift += 7)
+    {
+      if (!serialize_read_uint8(archive, &n))
+        return FALSE;
+
+      result |= ((guint64) (n & 0x7F)) << shift;
+      if ((n & 0x80) == 0)
+        {
+          *value = result;
+          return TRUE;
+        }
+    }
+  return FALSE;
+}
+
 
 static inline gboolean
 serialize_write_blob(SerializeArchive *archive, const void *blob, gsize len)
@@ -29,6 +29,33 @@
 
 #define STATS_COUNTER_MAX_VALUE G_MAXSIZE
 
+#define STATS_COUNTER_SHARD_SIZE 64
+
+/*
+ * Sharded counters: hot counters are updated by all worker threads, which
+ * makes the cache line holding them bounce between CPUs.  A sharded counter
+ * has a separate cell for each worker thread (indexed by the
+ * worker thread index), each on its own cache line, and only
+ * the owner thread ever writes its cell.  The value of the counter is the
+ * sum of the embedded value and the cells, threads without a thread index
+ * update the embedded value atomically.
+ *
+ * The price is memory: a sharded counter takes a cache line per worker
+ * thread, e.g. about 16kB per counter with 256 worker threads.
+ */
+typedef union _StatsCounterShard
+{
+  atomic_gssize value;
+  gchar __pad[STATS_COUNTER_SHARD_SIZE];
+} StatsCounterShard;
+
+typedef struct _StatsCounterShards
+{
+  gint num_shards;
+  /* cache line aligned, points into the same allocation */
+  StatsCounterShard *cells;
+} StatsCounterShards;
+
 typedef struct _StatsCounterItem
 {
   union
@@ -36,6 +63,8 @@ typedef struct _StatsCounterItem
     atomic_gssize value;
     atomic_gssize *value_ref;
   };
+  /* NULL unless sharded, borrowed from the aliased counter for aliases */
+  StatsCounterShards *shards;
   gchar *name;
   gint type;
   gboolean external;
@@ -48,13 +77,70 @@ stats_counter_read_only(StatsCounterItem *counter)
   return counter->external;
 }
 
+/*
+ * The thread index used to pick a shard is supplied by the mainloop (see
+ * main_loop_worker_finalize_thread_space()), stats does not depend on the
+ * mainloop itself.  Until then, no counters are sharded.
+ */
+typedef gint (*StatsCounterThreadIndexFunc)(void);
+
+extern StatsCounterThreadIndexFunc stats_counter_get_thread_index;
+
+void stats_counter_set_thread_index_func(StatsCounterThreadIndexFunc func, gint num_threads);
+gint stats_counter_get_max_number_of_threads(void);
+
+StatsCounterShards *stats_counter_shards_new(gint num_shards);
+
+static inline void
+stats_counter_shards_free(StatsCounterShards *self)
+{
+  g_free(self);
+}
+
+static inline gssize
+stats_counter_shards_sum(StatsCounterShards *self)
+{
+  gssize sum = 0;
+
+  for (gint i = 0; i < self->num_shards; i++)
+    sum += atomic_gssize_get(&self->cells[i].value);
+  return sum;
+}
+
+static inline atomic_gssize *
+stats_counter_shards_get_own_cell(StatsCounterShards *self)
+{
+  gint thread_index = stats_counter_get_thread_index();
+
+  if (thread_index < 0 || thread_index >= self->num_shards)
+    return NULL;
+  return &self->cells[thread_index].value;
+}
+
+static inline void
+_stats_counter_add(StatsCounterItem *counter, gssize add)
+{
+  if (counter->shards)
+    {
+      atomic_gssize *cell = stats_counter_shards_get_own_cell(counter->shards);
+
+      if (cell)
+        {
+          /* we are the only writer of this cell, no need for a locked add */
+          atomic_gssize_set(cell, atomic_gssize_racy_get(cell) + add);
+          return;
+        }
+    }
+  atomic_gssize_add(&counter->value, add);
+}
+
 static inline void
 stats_counter_add(StatsCounterItem *counter, gssize add)
 {
   if (counter)
     {
       g_assert(!stats_counter_read_only(counter));
-      atomic_gssize_add(&counter->value, add);
+      _stats_counter_add(counter, add);
     }
 }
 
@@ -64,7 +150,7 @@ stats_counter_sub(StatsCounterItem *counter, gssize sub)
   if (counter)
     {
       g_assert(!stats_counter_read_only(counter));
-      atomic_gssize_sub(&counter->value, sub);
+      _stats_counter_add(counter, -1 * sub);
     }
 }
 
@@ -74,7 +160,7 @@ stats_counter_inc(StatsCounterItem *counter)
   if (counter)
     {
       g_assert(!stats_counter_read_only(counter));
-      atomic_gssize_inc(&counter->value);
+      _stats_counter_add(counter, 1);
     }
 }
 
@@ -84,15 +170,25 @@ stats_counter_dec(StatsCounterItem *counter)
   if (counter)
     {
       g_assert(!stats_counter_read_only(counter));
-      atomic_gssize_dec(&counter->value);
+      _stats_counter_add(counter, -1);
     }
 }
 
+/* NOTE: for sharded counters the cells are left alone (they are only
+ * written by their owners), the embedded value compensates for them
+ * instead.  The compensation uses a snapshot of the cells, so it is only
+ * exact if no owner thread updates the counter at the same time: updates
+ * racing with the set may or may not show up in the result, just as with
+ * resetting a plain counter.  Resetting counters (stats-ctl reset) accepts
+ * that, anything else must only set a sharded counter while its owner
+ * threads are not updating it. */
 static inline void
 stats_counter_set(StatsCounterItem *counter, gsize value)
 {
   if (counter && !stats_counter_read_only(counter))
     {
+      if (counter->shards)
+        value -= stats_counter_shards_sum(counter->shards);
       atomic_gssize_set(&counter->value, value);
     }
 }
@@ -108,6 +204,9 @@ stats_counter_get(StatsCounterItem *counter)
         result = atomic_gssize_get_unsigned(&counter->value);
       else
         result = atomic_gssize_get_unsigned(counter->value_ref);
+
+      if (counter->shards)
+        result += stats_counter_shards_sum(counter->shards);
     }
   return result;
 }
@@ -130,6 +229,8 @@ stats_counter_get_name(StatsCounterItem *counter)
 static inline void
 stats_counter_clear(StatsCounterItem *counter)
 {
+  if (!counter->external)
+    stats_counter_shards_free(counter->shards);
   g_free(counter->name);
   memset(counter, 0, sizeof(*counter));
 }
@@ -24,8 +24,42 @@
 #include "stats/stats-registry.h"
 #include "stats/stats-query.h"
 #include "cfg.h"
+#include "apphook.h"
+#include "tls-support.h"
 #include <string.h>
 
+/* upper limit of cluster handles cached by a single thread */
+#define STATS_DYNAMIC_CLUSTER_CACHE_SIZE 1024
+
+typedef struct _StatsDynamicClusterCacheEntry
+{
+  StatsCluster *sc;
+  StatsCounterItem *processed;
+  StatsCounterItem *stamp;
+} StatsDynamicClusterCacheEntry;
+
+/*
+ * The cache of a thread is only ever used by its owner, except for
+ * stats_flush_dynamic_counter_caches(), that's what the lock is for, it
+ * is not contended otherwise.  Lock order: stats_lock() first.
+ */
+typedef struct _StatsDynamicClusterCache
+{
+  GMutex lock;
+  GHashTable *entries;
+} StatsDynamicClusterCache;
+
+TLS_BLOCK_START
+{
+  StatsDynamicClusterCache *dynamic_cluster_cache;
+}
+TLS_BLOCK_END;
+
+#define dynamic_cluster_cache __tls_deref(dynamic_cluster_cache)
+
+/* all per-thread caches, protected by stats_lock() */
+static GList *dynamic_cluster_caches;
+
 typedef struct _StatsClusterContainer
 {
   GHashTable *static_clusters;
@@ -142,6 +176,55 @@ _update_counter_name_if_needed(StatsCounterItem *counter, StatsCluster *sc, gint
     counter->name = _construct_counter_item_name(sc, type);
 }
 
+static gint
+_no_thread_index(void)
+{
+  return -1;
+}
+
+StatsCounterThreadIndexFunc stats_counter_get_thread_index = _no_thread_index;
+static gint stats_counter_max_threads;
+
+void
+stats_counter_set_thread_index_func(StatsCounterThreadIndexFunc func, gint num_threads)
+{
+  stats_counter_get_thread_index = func ? : _no_thread_index;
+  stats_counter_max_threads = func ? num_threads : 0;
+}
+
+gint
+stats_counter_get_max_number_of_threads(void)
+{
+  return stats_counter_max_threads;
+}
+
+StatsCounterShards *
+stats_counter_shards_new(gint num_shards)
+{
+  StatsCounterShards *self = g_malloc0(sizeof(StatsCounterShards) + (num_shards + 1) * sizeof(StatsCounterShard));
+  guintptr cells = (guintptr) (self + 1);
+
+  cells = (cells + STATS_COUNTER_SHARD_SIZE - 1) & ~((guintptr) STATS_COUNTER_SHARD_SIZE - 1);
+  self->cells = (StatsCounterShard *) cells;
+  self->num_shards = num_shards;
+  return self;
+}
+
+/* dynamic counters are too many to shard, and stamps are read directly */
+static void
+_shard_counter_if_needed(StatsCounterItem *counter, gint type, gboolean dynamic)
+{
+  gint num_shards = stats_counter_get_max_number_of_threads();
+
+  if (counter->shards || dynamic || type == SC_TYPE_STAMP || num_shards < 2)
+    return;
+
+  if (!stats_sharded_counters_enabled())
+    return;
+
+  counter->shards = stats_counter_shards_new(num_shards);
+}
+
 static StatsCluster *
 _register_counter(gint stats_level, const StatsClusterKey *sc_key, gint type,
                   gboolean dynamic, StatsCounterItem **counter)
@@ -160,6 +243,7 @@ _register_counter(gint stats_level, const StatsClusterKey *sc_key, gint type,
       (*counter)->external = FALSE;
       (*counter)->type = type;
       _update_counter_name_if_needed(*counter, sc, type);
+      _shard_counter_if_needed(*counter, type, dynamic);
     }
   else
     {
@@ -238,7 +322,11 @@ stats_register_external_counter(gint stats_level, const StatsClusterKey *sc_key,
 StatsCluster *
 stats_register_alias_counter(gint level, const StatsClusterKey *sc_key, gint type, StatsCounterItem *aliased_counter)
 {
-  return stats_register_external_counter(level, sc_key, type, &aliased_counter->value);
+  StatsCluster *sc = stats_register_external_counter(level, sc_key, type, &aliased_counter->value);
+
+  if (sc)
+    stats_cluster_get_counter(sc, type)->shards = aliased_counter->shards;
+  return sc;
 }
 
 StatsCluster *
@@ -275,6 +363,154 @@ stats_register_and_increment_dynamic_counter(gint stats_level, const StatsCluste
   stats_unregister_dynamic_counter(handle, SC_TYPE_PROCESSED, &counter);
 }
 
+static void
+_free_dynamic_cluster_cache_entry(StatsDynamicClusterCacheEntry *entry)
+{
+  g_assert(stats_locked);
+
+  stats_unregister_dynamic_counter(entry->sc, SC_TYPE_PROCESSED, &entry->processed);
+  g_free(entry);
+}
+
+/* must be called with stats_lock() held */
+static void
+_flush_dynamic_cluster_cache(StatsDynamicClusterCache *cache)
+{
+  g_assert(stats_locked);
+
+  g_mutex_lock(&cache->lock);
+  g_hash_table_remove_all(cache->entries);
+  g_mutex_unlock(&cache->lock);
+}
+
+static StatsDynamicClusterCache *
+_get_dynamic_cluster_cache(void)
+{
+  if (dynamic_cluster_cache)
+    return dynamic_cluster_cache;
+
+  StatsDynamicClusterCache *cache = g_new0(StatsDynamicClusterCache, 1);
+
+  g_mutex_init(&cache->lock);
+  cache->entries = g_hash_table_new_full((GHashFunc) stats_cluster_key_hash,
+                                         (GEqualFunc) stats_cluster_key_equal,
+                                         NULL, (GDestroyNotify) _free_dynamic_cluster_cache_entry);
+  stats_lock();
+  dynamic_cluster_caches = g_list_prepend(dynamic_cluster_caches, cache);
+  stats_unlock();
+
+  dynamic_cluster_cache = cache;
+  return cache;
+}
+
+static void
+_free_dynamic_cluster_cache(gpointer user_data)
+{
+  StatsDynamicClusterCache *cache = dynamic_cluster_cache;
+
+  if (!cache)
+    return;
+
+  stats_lock();
+  dynamic_cluster_caches = g_list_remove(dynamic_cluster_caches, cache);
+  _flush_dynamic_cluster_cache(cache);
+  stats_unlock();
+
+  g_hash_table_destroy(cache->entries);
+  g_mutex_clear(&cache->lock);
+  g_free(cache);
+  dynamic_cluster_cache = NULL;
+}
+
+/* must be called with stats_lock() held */
+static StatsDynamicClusterCacheEntry *
+_register_dynamic_cluster_cache_entry(gint stats_level, const StatsClusterKey *sc_key)
+{
+  StatsDynamicClusterCacheEntry *entry = g_new0(StatsDynamicClusterCacheEntry, 1);
+
+  entry->sc = stats_register_dynamic_counter(stats_level, sc_key, SC_TYPE_PROCESSED, &entry->processed);
+  if (!entry->sc)
+    {
+      g_free(entry);
+      return NULL;
+    }
+
+  /* the stamp stays alive as long as we keep the cluster registered */
+  StatsCounterItem *stamp;
+  stats_register_associated_counter(entry->sc, SC_TYPE_STAMP, &stamp);
+  entry->stamp = stamp;
+  stats_unregister_dynamic_counter(entry->sc, SC_TYPE_STAMP, &stamp);
+
+  return entry;
+}
+
+static void
+_increment_dynamic_cluster_cache_entry(StatsDynamicClusterCacheEntry *entry, time_t timestamp)
+{
+  stats_counter_inc(entry->processed);
+  if (timestamp >= 0)
+    stats_counter_set(entry->stamp, timestamp);
+}
+
+/*
+ * stats_increment_dynamic_counter
+ * @timestamp: if non-negative, an associated timestamp will be set
+ *
+ * Same as stats_register_and_increment_dynamic_counter(), but must be
+ * called without holding stats_lock().  Cluster handles are cached per
+ * thread, so incrementing a cluster that the current thread has already
+ * seen does not take the global lock, only the (uncontended) lock of the
+ * thread's own cache.
+ *
+ * Cached handles keep their clusters registered, which would prevent
+ * pruning, so stats_flush_dynamic_counter_caches() drops the caches of all
+ * threads, including idle ones, before the stats timer prunes expired
+ * clusters.
+ */
+void
+stats_increment_dynamic_counter(gint stats_level, const StatsClusterKey *sc_key, time_t timestamp)
+{
+  if (!stats_check_level(stats_level))
+    return;
+
+  StatsDynamicClusterCache *cache = _get_dynamic_cluster_cache();
+
+  g_mutex_lock(&cache->lock);
+  StatsDynamicClusterCacheEntry *entry = g_hash_table_lookup(cache->entries, sc_key);
+  if (entry)
+    {
+      _increment_dynamic_cluster_cache_entry(entry, timestamp);
+      g_mutex_unlock(&cache->lock);
+      return;
+    }
+  g_mutex_unlock(&cache->lock);
+
+  stats_lock();
+  entry = _register_dynamic_cluster_cache_entry(stats_level, sc_key);
+  if (entry)
+    {
+      g_mutex_lock(&cache->lock);
+      if (g_hash_table_size(cache->entries) >= STATS_DYNAMIC_CLUSTER_CACHE_SIZE)
+        g_hash_table_remove_all(cache->entries);
+
+      /* the key is owned by the cluster, which we keep registered */
+      g_hash_table_insert(cache->entries, &entry->sc->key, entry);
+      _increment_dynamic_cluster_cache_entry(entry, timestamp);
+      g_mutex_unlock(&cache->lock);
+    }
+  stats_unlock();
+}
+
+/* must be called with stats_lock() held */
+void
+stats_flush_dynamic_counter_caches(void)
+{
+  g_assert(stats_locked);
+
+  for (GList *l = dynamic_cluster_caches; l; l = l->next)
+    _flush_dynamic_cluster_cache((StatsDynamicClusterCache *) l->data);
+}
+
 /**
  * stats_register_associated_counter:
  * @sc: the dynamic counter that was registered with stats_register_dynamic_counter
@@ -512,11 +748,16 @@ stats_registry_init(void)
                                              (GDestroyNotify) stats_cluster_free);
 
   g_mutex_init(&stats_mutex);
+
+  register_application_thread_deinit_hook(_free_dynamic_cluster_cache, NULL);
 }
 
 void
 stats_registry_deinit(void)
 {
+  /* worker threads are gone by now, only our own cache is left */
+  _free_dynamic_cluster_cache(NULL);
+
   g_hash_table_destroy(stats_cluster_container.static_clusters);
   g_hash_table_destroy(stats_cluster_container.dynamic_clusters);
   stats_cluster_container.static_clusters = NULL;
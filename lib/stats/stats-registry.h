@@ -46,6 +46,8 @@ StatsCluster *stats_register_counter_and_index(gint level, const StatsClusterKey
 StatsCluster *stats_register_dynamic_counter(gint stats_level, const StatsClusterKey *sc_key, gint type,
                                              StatsCounterItem **counter);
 void stats_register_and_increment_dynamic_counter(gint stats_level, const StatsClusterKey *sc_key, time_t timestamp);
+void stats_increment_dynamic_counter(gint stats_level, const StatsClusterKey *sc_key, time_t timestamp);
+void stats_flush_dynamic_counter_caches(void);
 void stats_register_associated_counter(StatsCluster *handle, gint type, StatsCounterItem **counter);
 void stats_unregister_counter(const StatsClusterKey *sc_key, gint type, StatsCounterItem **counter);
 void stats_unregister_external_counter(const StatsClusterKey *sc_key, gint type,
@@ -69,5 +71,6 @@ void stats_registry_deinit(void);
 gboolean stats_check_dynamic_clusters_limit(guint number_of_clusters);
 gint stats_number_of_dynamic_clusters_limit(void);
 CfgYesNoAuto stats_syslog_stats(void);
+gboolean stats_sharded_counters_enabled(void);
 
 #endif
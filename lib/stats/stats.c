@@ -160,6 +160,9 @@ stats_publish_and_prune_counters(StatsOptions *options)
     st.stats_event = msg_event_create(EVT_PRI_INFO, "Log statistics", NULL);
 
   stats_lock();
+  /* clusters cached by worker threads can only expire once they are dropped
+   * from the caches */
+  stats_flush_dynamic_counter_caches();
   stats_foreach_cluster_remove(stats_format_and_prune_cluster, &st);
   stats_unlock();
 
@@ -261,6 +264,7 @@ stats_options_defaults(StatsOptions *options)
   options->lifetime = 600;
   options->max_dynamic = -1;
   options->syslog_stats = CYNA_AUTO;
+  options->sharded_counters = FALSE;
 }
 
 gboolean
@@ -297,3 +301,11 @@ stats_syslog_stats(void)
     return (stats_options->syslog_stats);
   return CYNA_AUTO;
 }
+
+gboolean
+stats_sharded_counters_enabled(void)
+{
+  if (stats_options)
+    return stats_options->sharded_counters;
+  return FALSE;
+}
@@ -36,6 +36,7 @@ typedef struct _StatsOptions
   gint lifetime;
   gint max_dynamic;
   CfgYesNoAuto syslog_stats;
+  gboolean sharded_counters;
 } StatsOptions;
 
 enum
@@ -83,3 +83,104 @@ Test(stats_dynamic_clusters, register_limited)
   stats_unlock();
 }
 
+
+typedef struct
+{
+  GMutex lock;
+  GCond cond;
+  gboolean incremented;
+  gboolean exit;
+} IdleIncrementerState;
+
+/* increments a dynamic counter, then stays idle until told to exit */
+static gpointer
+_idle_incrementer(gpointer user_data)
+{
+  IdleIncrementerState *state = (IdleIncrementerState *) user_data;
+  StatsClusterKey sc_key;
+
+  app_thread_start();
+  stats_cluster_logpipe_key_legacy_set(&sc_key, SCS_HOST | SCS_SENDER, NULL, "idlehost");
+  stats_increment_dynamic_counter(0, &sc_key, -1);
+
+  g_mutex_lock(&state->lock);
+  state->incremented = TRUE;
+  g_cond_signal(&state->cond);
+  while (!state->exit)
+    g_cond_wait(&state->cond, &state->lock);
+  g_mutex_unlock(&state->lock);
+
+  app_thread_stop();
+  return NULL;
+}
+
+Test(stats_dynamic_clusters, cached_increment_keeps_the_cluster_until_flushed)
+{
+  StatsOptions stats_opts;
+  stats_options_defaults(&stats_opts);
+  stats_opts.level = 3;
+  stats_reinit(&stats_opts);
+
+  StatsClusterKey sc_key;
+  stats_cluster_logpipe_key_legacy_set(&sc_key, SCS_HOST | SCS_SENDER, NULL, "testhost1");
+  for (gint i = 0; i < 3; i++)
+    stats_increment_dynamic_counter(0, &sc_key, 10 + i);
+
+  stats_lock();
+  {
+    StatsCluster *sc = stats_get_cluster(&sc_key);
+    cr_assert_not_null(sc);
+    cr_expect_not(stats_cluster_is_orphaned(sc));
+    cr_expect_eq(stats_counter_get(stats_get_counter(&sc_key, SC_TYPE_PROCESSED)), 3);
+    cr_expect_eq(stats_counter_get(stats_get_counter(&sc_key, SC_TYPE_STAMP)), 12);
+
+    stats_flush_dynamic_counter_caches();
+    cr_expect(stats_cluster_is_orphaned(sc));
+    cr_expect_eq(stats_counter_get(stats_get_counter(&sc_key, SC_TYPE_PROCESSED)), 3);
+  }
+  stats_unlock();
+
+  /* registered again on the next increment */
+  stats_increment_dynamic_counter(0, &sc_key, -1);
+  stats_lock();
+  cr_expect_not(stats_cluster_is_orphaned(stats_get_cluster(&sc_key)));
+  cr_expect_eq(stats_counter_get(stats_get_counter(&sc_key, SC_TYPE_PROCESSED)), 4);
+  stats_unlock();
+}
+
+Test(stats_dynamic_clusters, caches_of_idle_threads_are_flushed_too)
+{
+  StatsOptions stats_opts;
+  stats_options_defaults(&stats_opts);
+  stats_opts.level = 3;
+  stats_reinit(&stats_opts);
+
+  IdleIncrementerState state = { 0 };
+  g_mutex_init(&state.lock);
+  g_cond_init(&state.cond);
+
+  GThread *thread = g_thread_new("idle-incrementer", _idle_incrementer, &state);
+  g_mutex_lock(&state.lock);
+  while (!state.incremented)
+    g_cond_wait(&state.cond, &state.lock);
+  g_mutex_unlock(&state.lock);
+
+  StatsClusterKey sc_key;
+  stats_cluster_logpipe_key_legacy_set(&sc_key, SCS_HOST | SCS_SENDER, NULL, "idlehost");
+
+  stats_lock();
+  cr_expect_not(stats_cluster_is_orphaned(stats_get_cluster(&sc_key)));
+  /* the thread is still alive, but idle, its cache is released nevertheless */
+  stats_flush_dynamic_counter_caches();
+  cr_expect(stats_cluster_is_orphaned(stats_get_cluster(&sc_key)));
+  stats_unlock();
+
+  g_mutex_lock(&state.lock);
+  state.exit = TRUE;
+  g_cond_signal(&state.cond);
+  g_mutex_unlock(&state.lock);
+  g_thread_join(thread);
+
+  g_mutex_clear(&state.lock);
+  g_cond_clear(&state.cond);
+}
@@ -0,0 +1,158 @@
+/*
+ * Copyright (c) 2024 Balabit
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+ *
+ * As an additional exemption you are allowed to compile & link against the
+ * OpenSSL libraries as published by the OpenSSL project. See the file
+ * COPYING for details.
+ *
+ */
+
+#include <criterion/criterion.h>
+
+#include "apphook.h"
+#include "mainloop-worker.h"
+#include "stats/stats-cluster-single.h"
+#include "stats/stats-counter.h"
+#include "stats/stats-registry.h"
+#include "timeutils/misc.h"
+
+#include <iv.h>
+
+#define WORKERS 16
+#define INCREMENTS_PER_WORKER 1000
+#define PERFORMANCE_INCREMENTS_PER_WORKER 1000000
+
+static StatsOptions stats_opts;
+static gint increments_per_worker = INCREMENTS_PER_WORKER;
+
+static gpointer
+_increment_counter(gpointer user_data)
+{
+  StatsCounterItem *counter = user_data;
+
+  iv_init();
+  main_loop_worker_thread_start(MLW_ASYNC_WORKER);
+  for (gint i = 0; i < increments_per_worker; i++)
+    stats_counter_inc(counter);
+  main_loop_worker_thread_stop();
+  iv_deinit();
+  return NULL;
+}
+
+static glong
+_run_workers(StatsCounterItem *counter)
+{
+  GThread *workers[WORKERS];
+  struct timespec start, end;
+
+  clock_gettime(CLOCK_MONOTONIC, &start);
+  for (gint i = 0; i < WORKERS; i++)
+    workers[i] = g_thread_new(NULL, _increment_counter, counter);
+  for (gint i = 0; i < WORKERS; i++)
+    g_thread_join(workers[i]);
+  clock_gettime(CLOCK_MONOTONIC, &end);
+
+  return timespec_diff_usec(&end, &start);
+}
+
+static StatsCounterItem *
+_register_counter(const gchar *name, gboolean sharded)
+{
+  StatsCounterItem *counter = NULL;
+  StatsClusterKey sc_key;
+
+  stats_opts.sharded_counters = sharded;
+  stats_lock();
+  stats_cluster_single_key_set(&sc_key, name, NULL, 0);
+  stats_register_counter(0, &sc_key, SC_TYPE_SINGLE_VALUE, &counter);
+  stats_unlock();
+  return counter;
+}
+
+Test(stats_sharded_counters, counters_are_only_sharded_when_enabled)
+{
+  cr_assert_null(_register_counter("plain", FALSE)->shards);
+  cr_assert_not_null(_register_counter("sharded", TRUE)->shards);
+}
+
+Test(stats_sharded_counters, value_is_the_sum_of_all_cells)
+{
+  StatsCounterItem *counter = _register_counter("sharded", TRUE);
+
+  /* the main thread has no thread index, it updates the embedded value */
+  stats_counter_add(counter, 5);
+  _run_workers(counter);
+  cr_assert_eq(stats_counter_get(counter), (gsize) WORKERS * INCREMENTS_PER_WORKER + 5);
+
+  stats_counter_set(counter, 10);
+  cr_assert_eq(stats_counter_get(counter), 10);
+  stats_counter_dec(counter);
+  cr_assert_eq(stats_counter_get(counter), 9);
+}
+
+Test(stats_sharded_counters, alias_of_a_sharded_counter_sees_all_cells)
+{
+  StatsCounterItem *counter = _register_counter("sharded", TRUE);
+  StatsClusterKey sc_key;
+
+  stats_lock();
+  stats_cluster_single_key_set(&sc_key, "sharded_alias", NULL, 0);
+  StatsCluster *sc = stats_register_alias_counter(0, &sc_key, SC_TYPE_SINGLE_VALUE, counter);
+  StatsCounterItem *alias_counter = stats_cluster_get_counter(sc, SC_TYPE_SINGLE_VALUE);
+  stats_unlock();
+
+  _run_workers(counter);
+  cr_assert_eq(stats_counter_get(alias_counter), (gsize) WORKERS * INCREMENTS_PER_WORKER);
+
+  stats_lock();
+  stats_unregister_alias_counter(&sc_key, SC_TYPE_SINGLE_VALUE, counter);
+  stats_unlock();
+  cr_assert_not_null(counter->shards);
+}
+
+/* compares a single shared counter with a sharded one, both updated by all workers */
+Test(stats_sharded_counters, increment_performance)
+{
+  increments_per_worker = PERFORMANCE_INCREMENTS_PER_WORKER;
+
+  StatsCounterItem *plain = _register_counter("plain", FALSE);
+  StatsCounterItem *sharded = _register_counter("sharded", TRUE);
+
+  glong plain_usec = _run_workers(plain);
+  glong sharded_usec = _run_workers(sharded);
+
+  printf("%-20s workers=%d, %.2f increments/sec\n", "plain counter", WORKERS,
+         (double) WORKERS * increments_per_worker * USEC_PER_SEC / plain_usec);
+  printf("%-20s workers=%d, %.2f increments/sec\n", "sharded counter", WORKERS,
+         (double) WORKERS * increments_per_worker * USEC_PER_SEC / sharded_usec);
+
+  cr_assert_eq(stats_counter_get(plain), stats_counter_get(sharded));
+}
+
+static void
+setup(void)
+{
+  app_startup();
+
+  stats_options_defaults(&stats_opts);
+  stats_reinit(&stats_opts);
+
+  main_loop_worker_allocate_thread_space(WORKERS);
+  main_loop_worker_finalize_thread_space();
+}
+
+TestSuite(stats_sharded_counters, .init = setup, .fini = app_shutdown);
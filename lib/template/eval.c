@@ -56,21 +56,21 @@ _should_render(const gchar *value, LogMessageValueType value_type, LogMessageVal
 }
 
 static void
-log_template_append_elem_value(LogTemplate *self, LogTemplateElem *e, LogTemplateEvalOptions *options,
-                               LogMessage *msg, LogMessageValueType *type, GString *result)
+log_template_append_value(LogTemplate *self, LogTemplateInstr *instr, LogMessage *msg,
+                          LogMessageValueType *type, GString *result)
 {
   const gchar *value = NULL;
   gssize value_len = -1;
   LogMessageValueType value_type = LM_VT_NONE;
 
-  value = log_msg_get_value_with_type(msg, e->value_handle, &value_len, &value_type);
+  value = log_msg_get_value_with_type(msg, instr->value.handle, &value_len, &value_type);
   if (value && _should_render(value, value_type, self->type_hint))
     {
       g_string_append_len(result, value, value_len);
     }
-  else if (e->default_value)
+  else if (instr->value.default_value)
     {
-      g_string_append_len(result, e->default_value, -1);
+      g_string_append_len(result, instr->value.default_value, -1);
       value_type = LM_VT_STRING;
     }
   else if (value_type == LM_VT_BYTES || value_type == LM_VT_PROTOBUF)
@@ -81,25 +81,22 @@ log_template_append_elem_value(LogTemplate *self, LogTemplateElem *e, LogTemplat
 }
 
 static void
-log_template_append_elem_macro(LogTemplate *self, LogTemplateElem *e, LogTemplateEvalOptions *options,
-                               LogMessage *msg, LogMessageValueType *type, GString *result)
+log_template_append_macro(LogTemplate *self, LogTemplateInstr *instr, LogTemplateEvalOptions *options,
+                          LogMessage *msg, LogMessageValueType *type, GString *result)
 {
   gint len = result->len;
   LogMessageValueType value_type = LM_VT_NONE;
 
-  if (e->macro)
-    {
-      log_macro_expand(e->macro, options, msg, result, &value_type);
-      if (len == result->len && e->default_value)
-        g_string_append(result, e->default_value);
-      *type = _propagate_type(*type, value_type);
-    }
+  log_macro_expand(instr->macro.id, options, msg, result, &value_type);
+  if (len == result->len && instr->macro.default_value)
+    g_string_append(result, instr->macro.default_value);
+  *type = _propagate_type(*type, value_type);
 }
 
 static void
-log_template_append_elem_func(LogTemplate *self, LogTemplateElem *e, LogTemplateEvalOptions *options,
-                              LogMessage **messages, gint num_messages, gint msg_ndx,
-                              LogMessageValueType *type, GString *result)
+log_template_append_func(LogTemplate *self, LogTemplateElem *e, LogTemplateEvalOptions *options,
+                         LogMessage **messages, gint num_messages, gint msg_ndx,
+                         LogMessageValueType *type, GString *result)
 {
   LogTemplateInvokeArgs args =
   {
@@ -122,49 +119,50 @@ log_template_append_elem_func(LogTemplate *self, LogTemplateElem *e, LogTemplate
   *type = _propagate_type(*type, value_type);
 }
 
-void
-log_template_append_format_value_and_type_with_context(LogTemplate *self, LogMessage **messages, gint num_messages,
-                                                       LogTemplateEvalOptions *options,
-                                                       GString *result, LogMessageValueType *type)
+/* outputs longer than this are not considered when sizing the result buffer */
+#define LOG_TEMPLATE_MAX_LENGTH_ESTIMATE 16384
+
+static inline void
+_reserve_result_buffer(LogTemplate *self, GString *result)
 {
-  LogTemplateElem *e;
-  LogMessageValueType t = LM_VT_NONE;
-  gboolean first_elem = TRUE;
-  GString *target_buffer = result;
+  gsize estimate = (gsize) g_atomic_int_get(&self->length_estimate);
 
-  if (!options->opts)
+  if (result->len + estimate >= result->allocated_len)
     {
-      /* try the configuration first */
+      gsize len = result->len;
 
-      if (self->cfg)
-        options->opts = &self->cfg->template_options;
-      else
-        options->opts = log_template_get_global_template_options();
+      g_string_set_size(result, len + estimate);
+      g_string_truncate(result, len);
     }
+}
 
-  gboolean escape = (self->escape || (self->top_level && options->opts->escape));
-  if (escape)
-    target_buffer = scratch_buffers_alloc();
+static inline void
+_learn_result_length(LogTemplate *self, gsize length)
+{
+  /* only written when growing, so the shared template is not written on
+   * every evaluation.  A lost update from a concurrent thread is harmless. */
+  if (length > (gsize) g_atomic_int_get(&self->length_estimate))
+    g_atomic_int_set(&self->length_estimate, MIN(length, LOG_TEMPLATE_MAX_LENGTH_ESTIMATE));
+}
+
+static void
+_run_program(LogTemplate *self, LogMessage **messages, gint num_messages, LogTemplateEvalOptions *options,
+             gboolean escape, GString *result, LogMessageValueType *type)
+{
+  LogTemplateProgram *program = self->program;
+  GString *target_buffer = escape ? scratch_buffers_alloc() : result;
 
-  for (GList *p = self->compiled_template; p; p = g_list_next(p), first_elem = FALSE)
+  for (gint i = 0; i < program->num_instrs; i++)
     {
+      LogTemplateInstr *instr = &program->instrs[i];
       gint msg_ndx;
 
-      if (!first_elem)
+      if (instr->opcode == LTI_TEXT)
         {
-          /* this is the 2nd elem in the compiled template, we are
-           * concatenating multiple elements, convert the value to string */
-
-          t = LM_VT_STRING;
-        }
-
-      e = (LogTemplateElem *) p->data;
-      if (e->text)
-        {
-          g_string_append_len(result, e->text, e->text_len);
           /* concatenating literal text */
-          if (e->text_len)
-            t = LM_VT_STRING;
+          g_string_append_len(result, instr->text.str, instr->text.len);
+          *type = LM_VT_STRING;
+          continue;
         }
 
       /* NOTE: msg_ref is 1 larger than the index specified by the user in
@@ -173,31 +171,31 @@ log_template_append_format_value_and_type_with_context(LogTemplate *self, LogMes
        *
        * msg_ref == 0 means that the user didn't specify msg_ref
        * msg_ref >= 1 means that the user supplied the given msg_ref, 1 is equal to @0 */
-      if (e->msg_ref > num_messages)
+      if (instr->msg_ref > num_messages)
         {
           /* msg_ref out of range, we expand to empty string without evaluating the element */
-          t = LM_VT_STRING;
+          *type = LM_VT_STRING;
           continue;
         }
-      msg_ndx = num_messages - e->msg_ref;
+      msg_ndx = num_messages - instr->msg_ref;
 
       /* value and macro can't understand a context, assume that no msg_ref means @0 */
-      if (e->msg_ref == 0)
+      if (instr->msg_ref == 0)
         msg_ndx--;
 
       if (escape)
         g_string_truncate(target_buffer, 0);
 
-      switch (e->type)
+      switch (instr->opcode)
         {
-        case LTE_VALUE:
-          log_template_append_elem_value(self, e, options, messages[msg_ndx], &t, target_buffer);
+        case LTI_VALUE:
+          log_template_append_value(self, instr, messages[msg_ndx], type, target_buffer);
           break;
-        case LTE_MACRO:
-          log_template_append_elem_macro(self, e, options, messages[msg_ndx], &t, target_buffer);
+        case LTI_MACRO:
+          log_template_append_macro(self, instr, options, messages[msg_ndx], type, target_buffer);
           break;
-        case LTE_FUNC:
-          log_template_append_elem_func(self, e, options, messages, num_messages, msg_ndx, &t, target_buffer);
+        case LTI_FUNC:
+          log_template_append_func(self, instr->func, options, messages, num_messages, msg_ndx, type, target_buffer);
           break;
         default:
           g_assert_not_reached();
@@ -210,12 +208,47 @@ log_template_append_format_value_and_type_with_context(LogTemplate *self, LogMes
             options->escape(result, target_buffer->str, target_buffer->len);
           else
             log_template_default_escape_method(result, target_buffer->str, target_buffer->len);
-          t = LM_VT_STRING;
+          *type = LM_VT_STRING;
+        }
+    }
+}
+
+static void
+_append_format(LogTemplate *self, LogMessage **messages, gint num_messages, LogTemplateEvalOptions *options,
+               GString *result, LogMessageValueType *type)
+{
+  LogTemplateProgram *program = self->program;
+  LogMessageValueType t = LM_VT_NONE;
+  gsize initial_len = result->len;
+  gboolean escape = (self->escape || (self->top_level && options->opts->escape));
+
+  /* when concatenating multiple elements, the value is converted to string */
+  if (program->num_elems > 1)
+    t = LM_VT_STRING;
+
+  switch (program->kind)
+    {
+    case LTP_LITERAL:
+      g_string_append_len(result, program->instrs[0].text.str, program->instrs[0].text.len);
+      t = LM_VT_STRING;
+      break;
+    case LTP_VALUE:
+      if (!escape)
+        {
+          log_template_append_value(self, &program->instrs[0], messages[num_messages - 1], &t, result);
+          break;
         }
+    /* fallthrough */
+    default:
+      _reserve_result_buffer(self, result);
+      _run_program(self, messages, num_messages, options, escape, result, &t);
+      _learn_result_length(self, result->len - initial_len);
+      break;
     }
+
   if (type)
     {
-      if (first_elem && t == LM_VT_NONE)
+      if (t == LM_VT_NONE)
         {
           /* empty template string, use LM_VT_STRING before applying the type-cast */
           t = LM_VT_STRING;
@@ -228,6 +261,96 @@ log_template_append_format_value_and_type_with_context(LogTemplate *self, LogMes
     }
 }
 
+static inline guint64
+_mix_hash(guint64 hash, guint64 value)
+{
+  hash ^= value + 0x9e3779b97f4a7c15ULL + (hash << 6) + (hash >> 2);
+  return hash;
+}
+
+static inline guint64
+_mix_hash_str(guint64 hash, const gchar *value)
+{
+  return _mix_hash(hash, value ? g_str_hash(value) : 0);
+}
+
+/* Destinations pass their own copy of the template options and their own
+ * sequence number, so the key is built from the values the output depends
+ * on, letting destinations with the same settings share the result. */
+static guint64
+_hash_eval_options(LogTemplate *self, const LogTemplateEvalOptions *options)
+{
+  const LogTemplateOptions *opts = options->opts;
+  guint64 hash = 0;
+
+  hash = _mix_hash(hash, opts->ts_format);
+  hash = _mix_hash(hash, opts->frac_digits);
+  hash = _mix_hash(hash, opts->use_fqdn);
+  hash = _mix_hash(hash, opts->escape);
+  hash = _mix_hash(hash, opts->on_error);
+  for (gint i = 0; i < LTZ_MAX; i++)
+    hash = _mix_hash_str(hash, opts->time_zone[i]);
+
+  hash = _mix_hash(hash, options->tz);
+  if (self->uses_seqnum)
+    hash = _mix_hash(hash, options->seq_num);
+  hash = _mix_hash(hash, GPOINTER_TO_SIZE(options->escape));
+  hash = _mix_hash(hash, options->context_id_type);
+  hash = _mix_hash_str(hash, options->context_id);
+  return hash;
+}
+
+/* the result is stored along the message, so every destination rendering
+ * the same template for the same message can reuse it.  Once write
+ * protected, a message cannot change, rewrites on a path work on a clone,
+ * which starts with an empty cache. */
+static void
+_append_format_cached(LogTemplate *self, LogMessage *msg, LogTemplateEvalOptions *options,
+                      GString *result, LogMessageValueType *type)
+{
+  guint64 key = _hash_eval_options(self, options);
+  LogMessageValueType t;
+  const gchar *value;
+  gssize value_len;
+
+  value = log_msg_lookup_cached_value(msg, self->cache_id, key, &value_len, &t);
+  if (!value)
+    {
+      gsize initial_len = result->len;
+
+      _append_format(self, &msg, 1, options, result, &t);
+      log_msg_store_cached_value(msg, self->cache_id, key, result->str + initial_len, result->len - initial_len, t);
+    }
+  else
+    {
+      g_string_append_len(result, value, value_len);
+    }
+
+  if (type)
+    *type = t;
+}
+
+void
+log_template_append_format_value_and_type_with_context(LogTemplate *self, LogMessage **messages, gint num_messages,
+                                                       LogTemplateEvalOptions *options,
+                                                       GString *result, LogMessageValueType *type)
+{
+  if (!options->opts)
+    {
+      /* try the configuration first */
+
+      if (self->cfg)
+        options->opts = &self->cfg->template_options;
+      else
+        options->opts = log_template_get_global_template_options();
+    }
+
+  if (self->cache && num_messages == 1 && log_msg_is_write_protected(messages[0]))
+    _append_format_cached(self, messages[0], options, result, type);
+  else
+    _append_format(self, messages, num_messages, options, result, type);
+}
+
 void
 log_template_append_format_with_context(LogTemplate *self, LogMessage **messages, gint num_messages,
                                         LogTemplateEvalOptions *options,
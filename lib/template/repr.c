@@ -182,3 +182,105 @@ log_template_elem_free_list(GList *l)
     }
   g_list_free(l);
 }
+
+static LogTemplateInstr *
+_emit_instr(LogTemplateProgram *self)
+{
+  return &self->instrs[self->num_instrs++];
+}
+
+static guint8
+_calculate_program_kind(LogTemplateProgram *self)
+{
+  if (self->num_instrs != 1)
+    return LTP_GENERIC;
+
+  LogTemplateInstr *instr = &self->instrs[0];
+  if (instr->opcode == LTI_TEXT)
+    return LTP_LITERAL;
+  if (instr->opcode == LTI_VALUE && instr->msg_ref == 0)
+    return LTP_VALUE;
+  return LTP_GENERIC;
+}
+
+LogTemplateProgram *
+log_template_program_new(GList *elems)
+{
+  LogTemplateProgram *self;
+  LogTemplateInstr *text = NULL;
+  gsize literals_len = 0;
+  gint max_instrs = 0;
+
+  for (GList *l = elems; l; l = l->next)
+    {
+      LogTemplateElem *e = (LogTemplateElem *) l->data;
+
+      literals_len += e->text_len;
+      max_instrs += 2;
+    }
+
+  self = g_malloc0(sizeof(LogTemplateProgram) + max_instrs * sizeof(LogTemplateInstr));
+  self->literals = g_malloc(literals_len + 1);
+
+  gchar *literals_end = self->literals;
+  for (GList *l = elems; l; l = l->next)
+    {
+      LogTemplateElem *e = (LogTemplateElem *) l->data;
+
+      self->num_elems++;
+      if (e->text_len > 0)
+        {
+          /* merge with the text of the previous elem if nothing was in between */
+          if (!text)
+            {
+              text = _emit_instr(self);
+              text->opcode = LTI_TEXT;
+              text->text.str = literals_end;
+              text->text.len = 0;
+            }
+          memcpy(literals_end, e->text, e->text_len);
+          literals_end += e->text_len;
+          text->text.len += e->text_len;
+        }
+
+      if (log_template_elem_is_literal_string(e))
+        continue;
+
+      LogTemplateInstr *instr = _emit_instr(self);
+      instr->msg_ref = e->msg_ref;
+      switch (e->type)
+        {
+        case LTE_VALUE:
+          instr->opcode = LTI_VALUE;
+          instr->value.handle = e->value_handle;
+          instr->value.default_value = e->default_value;
+          break;
+        case LTE_MACRO:
+          instr->opcode = LTI_MACRO;
+          instr->macro.id = e->macro;
+          instr->macro.default_value = e->default_value;
+          break;
+        case LTE_FUNC:
+          instr->opcode = LTI_FUNC;
+          instr->func = e;
+          break;
+        default:
+          g_assert_not_reached();
+        }
+      text = NULL;
+    }
+  *literals_end = 0;
+
+  self->kind = _calculate_program_kind(self);
+  return self;
+}
+
+void
+log_template_program_free(LogTemplateProgram *self)
+{
+  if (!self)
+    return;
+
+  g_free(self->literals);
+  g_free(self);
+}
@@ -70,5 +70,70 @@ log_template_elem_is_literal_string(const LogTemplateElem *self)
 
 void log_template_elem_free_list(GList *el);
 
+/*
+ * The list of LogTemplateElem instances is lowered into a flat array of
+ * instructions for evaluation: the literal text parts become separate
+ * LTI_TEXT instructions (adjacent ones merged), the rest carry what is
+ * needed to evaluate them directly, without dereferencing the elem.
+ *
+ * The program does not own the elems, it is only valid as long as the
+ * list it was compiled from.
+ */
+enum
+{
+  LTI_TEXT,
+  LTI_VALUE,
+  LTI_MACRO,
+  LTI_FUNC
+};
+
+enum
+{
+  /* anything not covered below */
+  LTP_GENERIC,
+  /* a single literal text */
+  LTP_LITERAL,
+  /* a single name-value reference without text and msg_ref, e.g. $NAME */
+  LTP_VALUE,
+};
+
+typedef struct _LogTemplateInstr
+{
+  guint8 opcode;
+  guint16 msg_ref;
+  union
+  {
+    struct
+    {
+      const gchar *str;
+      gsize len;
+    } text;
+    struct
+    {
+      NVHandle handle;
+      const gchar *default_value;
+    } value;
+    struct
+    {
+      guint id;
+      const gchar *default_value;
+    } macro;
+    LogTemplateElem *func;
+  };
+} LogTemplateInstr;
+
+struct _LogTemplateProgram
+{
+  guint8 kind;
+  /* number of elems the program was compiled from */
+  gint num_elems;
+  gint num_instrs;
+  gchar *literals;
+  LogTemplateInstr instrs[];
+};
+
+LogTemplateProgram *log_template_program_new(GList *elems);
+void log_template_program_free(LogTemplateProgram *self);
+
 
 #endif
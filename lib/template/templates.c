@@ -30,6 +30,8 @@
 #include "timeutils/format.h"
 #include "cfg.h"
 
+#include <string.h>
+
 gboolean
 log_template_is_literal_string(const LogTemplate *self)
 {
@@ -181,12 +183,79 @@ _calculate_if_trivial(LogTemplate *self)
     }
 }
 
+/* The arguments of template functions are compiled into templates of
+ * their own and value-pairs scopes are expanded at runtime, so these are
+ * looked up in the template string, not in the compiled form.  Matches
+ * are conservative: a false positive only costs cache sharing or an
+ * explicit template-cache(no). */
+static const gchar *
+_find_reference(LogTemplate *self, const gchar *references[])
+{
+  if (!self->template_str)
+    return NULL;
+
+  for (gint i = 0; references[i]; i++)
+    {
+      if (strstr(self->template_str, references[i]))
+        return references[i];
+    }
+  return NULL;
+}
+
+static gboolean
+_calculate_if_uses_seqnum(LogTemplate *self)
+{
+  static const gchar *seqnum_references[] =
+  {
+    "SEQNUM",
+    "selected-macros",
+    "all-macros",
+    "everything",
+    NULL
+  };
+
+  return _find_reference(self, seqnum_references) != NULL;
+}
+
+/* the output of these depends on more than the message */
+static const gchar *
+_find_volatile_reference(LogTemplate *self)
+{
+  static const gchar *volatile_references[] =
+  {
+    /* current time */
+    "$C_",
+    "${C_",
+    /* value-pairs scopes containing the current time */
+    "all-macros",
+    "scope everything",
+    "scope=everything",
+    ",everything",
+    /* functions with state or side effects */
+    "$(uuid",
+    "$(iterate",
+    "$(python",
+    "$(slog",
+    NULL
+  };
+
+  return _find_reference(self, volatile_references);
+}
+
+static gint log_template_cache_id_counter;
+
 static void
 log_template_reset_compiled(LogTemplate *self)
 {
+  /* results cached for the previous program must not be found */
+  self->cache_id = (guint32) g_atomic_int_add(&log_template_cache_id_counter, 1);
+  log_template_program_free(self->program);
+  self->program = NULL;
   log_template_elem_free_list(self->compiled_template);
   self->compiled_template = NULL;
   self->trivial = FALSE;
+  self->uses_seqnum = FALSE;
+  self->length_estimate = 0;
 }
 
 gboolean
@@ -206,8 +275,10 @@ log_template_compile(LogTemplate *self, const gchar *template, GError **error)
   result = log_template_compiler_compile(&compiler, &self->compiled_template, error);
   log_template_compiler_clear(&compiler);
 
+  self->program = log_template_program_new(self->compiled_template);
   self->literal = _calculate_if_literal(self);
   self->trivial = _calculate_if_trivial(self);
+  self->uses_seqnum = _calculate_if_uses_seqnum(self);
   return result;
 }
 
@@ -284,6 +355,7 @@ log_template_compile_literal_string(LogTemplate *self, const gchar *literal)
   self->template_str = g_strdup(literal);
   self->compiled_template = g_list_append(self->compiled_template,
                                           log_template_elem_new_macro(literal, M_NONE, NULL, 0));
+  self->program = log_template_program_new(self->compiled_template);
 
   /* double check that the representation here is actually considered trivial. It should be. */
   g_assert(_calculate_if_trivial(self));
@@ -298,6 +370,35 @@ log_template_set_escape(LogTemplate *self, gboolean enable)
   self->escape = enable;
 }
 
+/* the first result rendered from a write protected message is reused by
+ * every later evaluation of the same template with the same evaluation
+ * options, see log_template_validate_cache() */
+void
+log_template_set_cache(LogTemplate *self, gboolean enable)
+{
+  self->cache = enable;
+}
+
+/* caching is only correct if the output depends on the message alone */
+gboolean
+log_template_validate_cache(LogTemplate *self, GError **error)
+{
+  g_return_val_if_fail(error == NULL || *error == NULL, FALSE);
+
+  if (!self->cache)
+    return TRUE;
+
+  const gchar *reference = _find_volatile_reference(self);
+  if (reference)
+    {
+      g_set_error(error, LOG_TEMPLATE_ERROR, LOG_TEMPLATE_ERROR_COMPILE,
+                  "template-cache() cannot be enabled, the output of the template depends on more than the message, "
+                  "found: %s", reference);
+      return FALSE;
+    }
+  return TRUE;
+}
+
 gboolean
 log_template_set_type_hint(LogTemplate *self, const gchar *type_hint, GError **error)
 {
@@ -374,6 +475,7 @@ log_template_new(GlobalConfig *cfg, const gchar *name)
     self->type_hint = LM_VT_NONE;
   self->explicit_type_hint = LM_VT_NONE;
   self->top_level = TRUE;
+  self->program = log_template_program_new(NULL);
   return self;
 }
 
@@ -51,8 +51,16 @@ struct _LogTemplate
   gchar *name;
   gchar *template_str;
   GList *compiled_template;
+  /* compiled_template lowered to a flat instruction array, see repr.h */
+  LogTemplateProgram *program;
   GlobalConfig *cfg;
-  guint top_level:1, escape:1, def_inline:1, trivial:1, literal:1;
+  guint top_level:1, escape:1, def_inline:1, trivial:1, literal:1, cache:1, uses_seqnum:1;
+  /* identifies the compiled template in the per-message render cache */
+  guint32 cache_id;
+
+  /* the largest output length seen so far (capped), used to size the
+   * result buffer before rendering, updated with atomic ops */
+  gint length_estimate;
 
   /* This value stores the type-hint the user _explicitly_ specified.  If
    * this is an automatic cast to string (in compat mode), this would be
@@ -69,6 +77,8 @@ struct _LogTemplate
 /* appends the formatted output into result */
 
 void log_template_set_escape(LogTemplate *self, gboolean enable);
+void log_template_set_cache(LogTemplate *self, gboolean enable);
+gboolean log_template_validate_cache(LogTemplate *self, GError **error);
 gboolean log_template_set_type_hint(LogTemplate *self, const gchar *hint, GError **error);
 void log_template_set_type_hint_value(LogTemplate *self, LogMessageValueType type);
 gboolean log_template_compile(LogTemplate *self, const gchar *template_str, GError **error);
@@ -795,6 +795,134 @@ Test(template, test_log_template_with_escaping_produces_string_even_if_the_value
   g_string_free(formatted_value, TRUE);
 }
 
+Test(template, test_cached_template_result_is_reused_until_the_message_is_cloned)
+{
+  LogTemplate *template = compile_template("${APP.VALUE} $(echo ${APP.VALUE})");
+  LogMessage *msg = create_sample_message();
+  LogPathOptions path_options = LOG_PATH_OPTIONS_INIT;
+  GString *result = g_string_new("");
+  LogMessageValueType type;
+  LogMessageCachedValue *cached_values;
+
+  log_template_set_cache(template, TRUE);
+
+  /* writable messages are not cached */
+  log_template_format(template, msg, &DEFAULT_TEMPLATE_EVAL_OPTIONS, result);
+  cr_assert_str_eq(result->str, "value value");
+  cr_assert_null(log_msg_lookup_cached_value(msg, template->cache_id, 0, NULL, NULL));
+  cr_assert_null(msg->cached_values);
+
+  log_msg_write_protect(msg);
+  log_template_format_value_and_type(template, msg, &DEFAULT_TEMPLATE_EVAL_OPTIONS, result, &type);
+  cr_assert_str_eq(result->str, "value value");
+  cr_assert_eq(type, LM_VT_STRING);
+  cached_values = msg->cached_values;
+  cr_assert_not_null(cached_values);
+
+  /* the second evaluation is served from the cache, nothing new is stored */
+  g_string_truncate(result, 0);
+  log_template_append_format(template, msg, &DEFAULT_TEMPLATE_EVAL_OPTIONS, result);
+  cr_assert_str_eq(result->str, "value value");
+  cr_assert_eq(msg->cached_values, cached_values);
+
+  /* a rewrite on a branch works on a clone, which has its own cache */
+  LogMessage *modified = log_msg_ref(msg);
+  log_msg_make_writable(&modified, &path_options);
+  log_msg_set_value_by_name(modified, "APP.VALUE", "changed", -1);
+  log_msg_write_protect(modified);
+
+  log_template_format(template, modified, &DEFAULT_TEMPLATE_EVAL_OPTIONS, result);
+  cr_assert_str_eq(result->str, "changed changed");
+  log_template_format(template, msg, &DEFAULT_TEMPLATE_EVAL_OPTIONS, result);
+  cr_assert_str_eq(result->str, "value value");
+
+  /* recompiling the template invalidates its cached results */
+  log_template_compile(template, "${APP.VALUE}!", NULL);
+  log_template_format(template, msg, &DEFAULT_TEMPLATE_EVAL_OPTIONS, result);
+  cr_assert_str_eq(result->str, "value!");
+
+  log_msg_unref(modified);
+  log_msg_unref(msg);
+  log_template_unref(template);
+  g_string_free(result, TRUE);
+}
+
+Test(template, test_cached_template_result_is_shared_by_writers_with_the_same_options)
+{
+  LogTemplate *template = compile_template("$R_ISODATE");
+  LogMessage *msg = create_sample_message();
+  GString *result = g_string_new("");
+  LogMessageCachedValue *cached_values;
+
+  /* each writer has its own copy of the template options and its own seq_num */
+  LogTemplateOptions writer_a_options = configuration->template_options;
+  LogTemplateOptions writer_b_options = configuration->template_options;
+  LogTemplateOptions writer_c_options = configuration->template_options;
+  writer_c_options.frac_digits = 6;
+
+  LogTemplateEvalOptions writer_a = {&writer_a_options, LTZ_LOCAL, 1, NULL, LM_VT_STRING};
+  LogTemplateEvalOptions writer_b = {&writer_b_options, LTZ_LOCAL, 2, NULL, LM_VT_STRING};
+  LogTemplateEvalOptions writer_c = {&writer_c_options, LTZ_LOCAL, 3, NULL, LM_VT_STRING};
+
+  log_template_set_cache(template, TRUE);
+  log_msg_write_protect(msg);
+
+  log_template_format(template, msg, &writer_a, result);
+  cr_assert_str_eq(result->str, "2006-02-11T19:58:35.639+01:00");
+  cached_values = msg->cached_values;
+  cr_assert_not_null(cached_values);
+
+  log_template_format(template, msg, &writer_b, result);
+  cr_assert_str_eq(result->str, "2006-02-11T19:58:35.639+01:00");
+  cr_assert_eq(msg->cached_values, cached_values, "writers with the same options should share the cached result");
+
+  log_template_format(template, msg, &writer_c, result);
+  cr_assert_str_eq(result->str, "2006-02-11T19:58:35.639000+01:00");
+  cr_assert_neq(msg->cached_values, cached_values);
+
+  /* the sequence number is part of the key once the template uses it */
+  log_template_compile(template, "$SEQNUM $R_ISODATE", NULL);
+  log_template_format(template, msg, &writer_a, result);
+  cr_assert_str_eq(result->str, "1 2006-02-11T19:58:35.639+01:00");
+  cached_values = msg->cached_values;
+  log_template_format(template, msg, &writer_b, result);
+  cr_assert_str_eq(result->str, "2 2006-02-11T19:58:35.639+01:00");
+  cr_assert_neq(msg->cached_values, cached_values);
+
+  log_msg_unref(msg);
+  log_template_unref(template);
+  g_string_free(result, TRUE);
+}
+
+static void
+assert_template_cache_rejected(const gchar *template_str)
+{
+  LogTemplate *template = compile_template(template_str);
+  GError *error = NULL;
+
+  log_template_set_cache(template, TRUE);
+  cr_assert_not(log_template_validate_cache(template, &error), "template-cache() accepted for %s", template_str);
+  cr_assert_not_null(error);
+  g_clear_error(&error);
+
+  log_template_set_cache(template, FALSE);
+  cr_assert(log_template_validate_cache(template, NULL));
+  log_template_unref(template);
+}
+
+Test(template, test_template_cache_is_rejected_for_templates_not_depending_on_the_message_alone)
+{
+  assert_template_cache_rejected("$C_ISODATE $MSG");
+  assert_template_cache_rejected("${C_UNIXTIME}");
+  assert_template_cache_rejected("$(echo $C_HOUR)");
+  assert_template_cache_rejected("$(iterate $(+ 1 $_) 0)");
+
+  LogTemplate *template = compile_template("$R_ISODATE $(echo ${APP.VALUE})");
+  log_template_set_cache(template, TRUE);
+  cr_assert(log_template_validate_cache(template, NULL));
+  log_template_unref(template);
+}
+
 Test(template, test_bytes_and_protobuf_types_are_rendered_when_necessary)
 {
   cfg_set_version_without_validation(configuration, VERSION_VALUE_4_0);
@@ -377,6 +377,51 @@ Test(template_compile, test_unknown_function)
                            type = LTE_MACRO, msg_ref = 0);
 }
 
+Test(template_compile, test_program_of_a_single_value_reference)
+{
+  assert_template_compile("${APP.VALUE}");
+
+  cr_assert_eq(template->program->kind, LTP_VALUE);
+  cr_assert_eq(template->program->num_instrs, 1);
+  cr_assert_eq(template->program->instrs[0].opcode, LTI_VALUE);
+  cr_assert_eq(template->program->instrs[0].value.handle, log_msg_get_value_handle("APP.VALUE"));
+}
+
+Test(template_compile, test_program_of_a_literal)
+{
+  assert_template_compile("foo bar");
+
+  cr_assert_eq(template->program->kind, LTP_LITERAL);
+  cr_assert_eq(template->program->num_instrs, 1);
+  cr_assert_eq(template->program->instrs[0].opcode, LTI_TEXT);
+  cr_assert_eq(template->program->instrs[0].text.len, 7);
+  cr_assert(memcmp(template->program->instrs[0].text.str, "foo bar", 7) == 0);
+}
+
+Test(template_compile, test_program_splits_text_from_the_elements)
+{
+  LogTemplateInstr *instrs;
+
+  assert_template_compile("foo ${APP.VALUE} ${MESSAGE:-default}@@12");
+
+  cr_assert_eq(template->program->kind, LTP_GENERIC);
+  cr_assert_eq(template->program->num_elems, 3);
+  cr_assert_eq(template->program->num_instrs, 5);
+
+  instrs = template->program->instrs;
+  cr_assert_eq(instrs[0].opcode, LTI_TEXT);
+  cr_assert_eq(instrs[0].text.len, 4);
+  cr_assert_eq(instrs[1].opcode, LTI_VALUE);
+  cr_assert_eq(instrs[2].opcode, LTI_TEXT);
+  cr_assert_eq(instrs[2].text.len, 1);
+  cr_assert_eq(instrs[3].opcode, LTI_MACRO);
+  cr_assert_eq(instrs[3].macro.id, M_MESSAGE);
+  cr_assert_str_eq(instrs[3].macro.default_value, "default");
+  cr_assert_eq(instrs[4].opcode, LTI_TEXT);
+  cr_assert_eq(instrs[4].text.len, 3);
+  cr_assert(memcmp(instrs[4].text.str, "@12", 3) == 0);
+}
+
 static void
 setup(void)
 {
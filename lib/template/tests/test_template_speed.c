@@ -53,6 +53,11 @@ Test(template_speed, test_template_speed)
   perftest_template("$(echo $MSG)\n");
   perftest_template("$(+ $FACILITY_NUM $FACILITY_NUM)\n");
   perftest_template("$DATE $FACILITY.$PRIORITY $HOST $MSGHDR$MSG $SEQNO\n");
+  perftest_template("${ISODATE} ${HOST} ${MSGHDR}${MESSAGE}\n");
+  perftest_template("<${PRI}>1 ${ISODATE} ${HOST:--} ${PROGRAM:--} ${PID:--} ${MSGID:--} ${SDATA:--} ${MESSAGE}\n");
+  perftest_template("${MESSAGE}");
+  perftest_template("${APP.VALUE}");
+  perftest_template("literal text only\n");
   perftest_template("${APP.VALUE} ${APP.VALUE2}\n");
   perftest_template("$DATE ${HOST:--} ${PROGRAM:--} ${PID:--} ${MSGID:--} ${SDATA:--} $MSG\n");
 
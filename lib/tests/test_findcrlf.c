@@ -26,6 +26,7 @@
 #include "find-crlf.h"
 #include <stdio.h>
 #include <stdlib.h>
+#include <string.h>
 
 struct findcrlf_params
 {
@@ -150,18 +151,62 @@ ParameterizedTestParameters(findcrlf, test)
   return cr_make_param_array(struct findcrlf_params, params, sizeof (params) / sizeof(struct findcrlf_params));
 }
 
-ParameterizedTest(struct findcrlf_params *params, findcrlf, test)
+static void
+_assert_eom(struct findcrlf_params *params, FindCrlfImplementation implementation)
 {
+  if (!find_crlf_set_implementation(implementation))
+    return;
+
   gchar *eom = find_cr_or_lf_or_nul(params->msg, params->msg_len);
 
   cr_expect_not(params->eom_ofs == -1 && eom != NULL,
-                "EOM returned is not NULL, which was expected. eom_ofs=%d, eom=%s\n",
-                (gint) params->eom_ofs, eom);
+                "EOM returned is not NULL, which was expected. eom_ofs=%d, eom=%s, implementation=%d\n",
+                (gint) params->eom_ofs, eom, implementation);
 
   if (params->eom_ofs == -1)
     return;
 
   cr_expect_not(eom - params->msg != params->eom_ofs,
-                "EOM is at wrong location. msg=%s, eom_ofs=%d, eom=%s\n",
-                params->msg, (gint) params->eom_ofs, eom);
+                "EOM is at wrong location. msg=%s, eom_ofs=%d, eom=%s, implementation=%d\n",
+                params->msg, (gint) params->eom_ofs, eom, implementation);
+}
+
+ParameterizedTest(struct findcrlf_params *params, findcrlf, test)
+{
+  _assert_eom(params, FIND_CRLF_SCALAR);
+  _assert_eom(params, FIND_CRLF_SSE2);
+  _assert_eom(params, FIND_CRLF_AVX2);
+  find_crlf_set_implementation(find_crlf_get_best_implementation());
+}
+
+/* the SIMD implementations work on 16/32 byte blocks, check each position in long buffers */
+Test(findcrlf, test_terminator_at_every_position_of_long_lines)
+{
+  const gchar terminators[] = { '\r', '\n', '\0' };
+  gchar buffer[128];
+
+  for (FindCrlfImplementation implementation = FIND_CRLF_SCALAR; implementation <= FIND_CRLF_AVX2; implementation++)
+    {
+      if (!find_crlf_set_implementation(implementation))
+        continue;
+
+      for (gint i = 0; i < G_N_ELEMENTS(terminators); i++)
+        {
+          for (gint pos = 0; pos < sizeof(buffer); pos++)
+            {
+              memset(buffer, 'a', sizeof(buffer));
+              buffer[pos] = terminators[i];
+
+              cr_assert_eq(find_cr_or_lf_or_nul(buffer, sizeof(buffer)), buffer + pos,
+                           "implementation=%d, pos=%d", implementation, pos);
+              cr_assert_eq(find_lf_or_nul((guchar *) buffer, sizeof(buffer)),
+                           terminators[i] == '\r' ? NULL : (guchar *) buffer + pos,
+                           "implementation=%d, pos=%d", implementation, pos);
+            }
+        }
+
+      memset(buffer, 'a', sizeof(buffer));
+      cr_assert_null(find_cr_or_lf_or_nul(buffer, sizeof(buffer)));
+    }
+  find_crlf_set_implementation(find_crlf_get_best_implementation());
 }
@@ -0,0 +1,160 @@
+/*
+ * Copyright (c) 2024 Balabit
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+ *
+ * As an additional exemption you are allowed to compile & link against the
+ * OpenSSL libraries as published by the OpenSSL project. See the file
+ * COPYING for details.
+ *
+ */
+
+#include <criterion/criterion.h>
+
+#include "find-crlf.h"
+#include "timeutils/misc.h"
+
+#include <stdio.h>
+#include <string.h>
+
+/*
+ * Line framing benchmark: splits a buffer of newline terminated lines the
+ * same way LogProtoTextServer does, with each of the implementations
+ * supported by the CPU.  The throughput measurements are *_performance
+ * tests, by default only a small buffer is split to check the results.
+ */
+
+#define BUFFER_SIZE (4 * 1024 * 1024)
+#define ITERATIONS 20
+#define SMALL_BUFFER_SIZE (64 * 1024)
+
+static const gchar *implementation_names[] = { "scalar", "sse2", "avx2" };
+
+static gchar *
+_fill_buffer(const gchar *line, gsize buffer_size)
+{
+  gchar *buffer = g_malloc(buffer_size);
+  gsize line_len = strlen(line);
+  gsize pos = 0;
+
+  for (; pos + line_len + 1 <= buffer_size; pos += line_len + 1)
+    {
+      memcpy(buffer + pos, line, line_len);
+      buffer[pos + line_len] = '\n';
+    }
+  memset(buffer + pos, 'x', buffer_size - pos);
+  return buffer;
+}
+
+static gchar *
+_generate_json_line(gsize len)
+{
+  GString *line = g_string_new("{");
+
+  for (gint i = 0; line->len < len; i++)
+    g_string_append_printf(line, "\"key%d\":\"value%d-lorem ipsum dolor sit amet\",", i, i);
+  g_string_append(line, "\"last\":0}");
+  return g_string_free(line, FALSE);
+}
+
+static gsize
+_split_lines(const gchar *buffer, gsize buffer_size)
+{
+  gsize lines = 0;
+  const guchar *pos = (const guchar *) buffer;
+  const guchar *end = pos + buffer_size;
+  const guchar *eol;
+
+  while ((eol = find_lf_or_nul(pos, end - pos)))
+    {
+      lines++;
+      pos = eol + 1;
+    }
+  return lines;
+}
+
+static void
+_run_benchmark(const gchar *name, const gchar *line)
+{
+  gchar *buffer = _fill_buffer(line, BUFFER_SIZE);
+  gsize expected_lines = BUFFER_SIZE / (strlen(line) + 1);
+
+  for (FindCrlfImplementation implementation = FIND_CRLF_SCALAR; implementation <= FIND_CRLF_AVX2; implementation++)
+    {
+      struct timespec start, end;
+      gsize lines = 0;
+
+      if (!find_crlf_set_implementation(implementation))
+        continue;
+
+      clock_gettime(CLOCK_MONOTONIC, &start);
+      for (gint i = 0; i < ITERATIONS; i++)
+        lines += _split_lines(buffer, BUFFER_SIZE);
+      clock_gettime(CLOCK_MONOTONIC, &end);
+
+      glong diff = timespec_diff_usec(&end, &start);
+      printf("%-20s %-8s line_len=%zu, %.2f MiB/sec, %.2f lines/sec\n", name,
+             implementation_names[implementation], strlen(line),
+             (double) BUFFER_SIZE * ITERATIONS / (1024 * 1024) * USEC_PER_SEC / diff,
+             (double) lines * USEC_PER_SEC / diff);
+      cr_assert_eq(lines, expected_lines * ITERATIONS);
+    }
+
+  find_crlf_set_implementation(find_crlf_get_best_implementation());
+  g_free(buffer);
+}
+
+#define SYSLOG_LINE "<13>1 2024-01-01T00:00:00+00:00 localhost prog 1234 - - a short syslog message"
+
+static void
+_assert_lines_are_split(const gchar *line)
+{
+  gchar *buffer = _fill_buffer(line, SMALL_BUFFER_SIZE);
+  gsize expected_lines = SMALL_BUFFER_SIZE / (strlen(line) + 1);
+
+  for (FindCrlfImplementation implementation = FIND_CRLF_SCALAR; implementation <= FIND_CRLF_AVX2; implementation++)
+    {
+      if (!find_crlf_set_implementation(implementation))
+        continue;
+
+      cr_assert_eq(_split_lines(buffer, SMALL_BUFFER_SIZE), expected_lines,
+                   "implementation %s split a wrong number of lines", implementation_names[implementation]);
+    }
+
+  find_crlf_set_implementation(find_crlf_get_best_implementation());
+  g_free(buffer);
+}
+
+Test(findcrlf_perf, every_implementation_splits_all_lines)
+{
+  gchar *line = _generate_json_line(4096);
+
+  _assert_lines_are_split(SYSLOG_LINE);
+  _assert_lines_are_split(line);
+  g_free(line);
+}
+
+Test(findcrlf_perf, short_syslog_lines_performance)
+{
+  _run_benchmark("syslog lines", SYSLOG_LINE);
+}
+
+Test(findcrlf_perf, multi_kb_json_lines_performance)
+{
+  gchar *line = _generate_json_line(4096);
+
+  _run_benchmark("json lines", line);
+  g_free(line);
+}
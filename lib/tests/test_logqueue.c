@@ -226,7 +226,8 @@ Test(logqueue, test_zero_diskbuf_alternating_send_acks)
   log_queue_unref(q);
 }
 
-Test(logqueue, test_with_threads)
+static void
+_run_threaded_test(gboolean lockless)
 {
   LogQueue *q;
   GThread *thread_feed[FEEDERS], *thread_consume;
@@ -235,10 +236,13 @@ Test(logqueue, test_with_threads)
 
   main_loop_worker_allocate_thread_space(FEEDERS * 2);
   main_loop_worker_finalize_thread_space();
+  sum_time = 0;
   for (i = 0; i < TEST_RUNS; i++)
     {
       fprintf(stderr, "starting testrun: %d\n", i);
       q = log_queue_fifo_new(MESSAGES_SUM, NULL, STATS_LEVEL0, NULL, NULL);
+      if (lockless)
+        log_queue_fifo_set_lockless(q);
 
       for (j = 0; j < FEEDERS; j++)
         {
@@ -262,6 +266,16 @@ Test(logqueue, test_with_threads)
   fprintf(stderr, "Feed speed: %.2lf\n", (double) TEST_RUNS * MESSAGES_SUM * 1000000 / sum_time);
 }
 
+Test(logqueue, test_with_threads)
+{
+  _run_threaded_test(FALSE);
+}
+
+Test(logqueue, test_with_threads_lockless)
+{
+  _run_threaded_test(TRUE);
+}
+
 Test(logqueue, log_queue_fifo_rewind_all_and_memory_usage)
 {
   StatsClusterKeyBuilder *driver_sck_builder = stats_cluster_key_builder_new();
@@ -382,6 +396,223 @@ Test(logqueue, log_queue_fifo_should_drop_only_non_flow_controlled_messages_thre
   log_queue_unref(q);
 }
 
+Test(logqueue, log_queue_fifo_should_drop_only_non_flow_controlled_messages_lockless,
+     .description = "Flow-controlled messages should never be dropped (using the lockless wait queue)")
+{
+  gint fifo_size = 5;
+
+  main_loop_worker_allocate_thread_space(1);
+  main_loop_worker_finalize_thread_space();
+
+  StatsClusterKeyBuilder *driver_sck_builder = stats_cluster_key_builder_new();
+  StatsClusterKeyBuilder *queue_sck_builder = stats_cluster_key_builder_new();
+  LogQueue *q = log_queue_fifo_new(fifo_size, NULL, STATS_LEVEL0, driver_sck_builder, queue_sck_builder);
+  log_queue_fifo_set_lockless(q);
+  stats_cluster_key_builder_free(driver_sck_builder);
+  stats_cluster_key_builder_free(queue_sck_builder);
+
+  GThread *thread = g_thread_new(NULL, _flow_control_feed_thread, q);
+  g_thread_join(thread);
+
+  cr_assert_eq(stats_counter_get(q->metrics.shared.dropped_messages), 3);
+
+  gint queued_messages = stats_counter_get(q->metrics.shared.queued_messages);
+  cr_assert_eq(log_queue_get_length(q), queued_messages);
+  send_some_messages(q, queued_messages, TRUE);
+
+  cr_assert_eq(fed_messages, acked_messages,
+               "did not receive enough acknowledgements: fed_messages=%d, acked_messages=%d",
+               fed_messages, acked_messages);
+
+  log_queue_unref(q);
+}
+
+static void
+_feed_numbered_messages(LogQueue *q, gint first, gint n)
+{
+  LogPathOptions path_options = LOG_PATH_OPTIONS_INIT;
+  path_options.flow_control_requested = TRUE;
+
+  for (gint i = first; i < first + n; i++)
+    {
+      LogMessage *msg = log_msg_new_empty();
+      gchar seq[16];
+
+      g_snprintf(seq, sizeof(seq), "%d", i);
+      log_msg_set_value_by_name(msg, "SEQ", seq, -1);
+      log_queue_push_tail(q, msg, &path_options);
+    }
+  main_loop_worker_invoke_batch_callbacks();
+}
+
+static gpointer
+_ring_overflow_feed_thread(gpointer args)
+{
+  LogQueue *q = args;
+
+  iv_init();
+  main_loop_worker_thread_start(MLW_ASYNC_WORKER);
+
+  /* fits into the ring */
+  _feed_numbered_messages(q, 0, 500);
+  /* overflows the ring, goes to the locked wait queue */
+  _feed_numbered_messages(q, 500, 2000);
+  /* the ring has room, but the overflow flag is still set */
+  _feed_numbered_messages(q, 2500, 10);
+
+  main_loop_worker_thread_stop();
+  iv_deinit();
+  return NULL;
+}
+
+Test(logqueue, log_queue_fifo_lockless_keeps_order_when_the_ring_overflows)
+{
+  main_loop_worker_allocate_thread_space(1);
+  main_loop_worker_finalize_thread_space();
+
+  LogQueue *q = log_queue_fifo_new(10000, NULL, STATS_LEVEL0, NULL, NULL);
+  log_queue_fifo_set_lockless(q);
+
+  GThread *thread = g_thread_new(NULL, _ring_overflow_feed_thread, q);
+  g_thread_join(thread);
+
+  cr_assert_eq(log_queue_get_length(q), 2510);
+
+  LogPathOptions path_options = LOG_PATH_OPTIONS_INIT;
+  for (gint i = 0; i < 2510; i++)
+    {
+      LogMessage *msg = log_queue_pop_head(q, &path_options);
+      cr_assert_not_null(msg);
+      cr_assert_eq(atoi(log_msg_get_value_by_name(msg, "SEQ", NULL)), i);
+      log_msg_unref(msg);
+    }
+  cr_assert_null(log_queue_pop_head(q, &path_options));
+  log_queue_ack_backlog(q, 2510);
+
+  log_queue_unref(q);
+}
+
+static gpointer
+_fifo_size_feed_thread(gpointer args)
+{
+  LogQueue *q = args;
+  LogPathOptions path_options = LOG_PATH_OPTIONS_INIT;
+
+  iv_init();
+  main_loop_worker_thread_start(MLW_ASYNC_WORKER);
+
+  for (gint batch = 0; batch < 10; batch++)
+    {
+      for (gint i = 0; i < 20; i++)
+        log_queue_push_tail(q, log_msg_new_empty(), &path_options);
+      main_loop_worker_invoke_batch_callbacks();
+    }
+
+  main_loop_worker_thread_stop();
+  iv_deinit();
+  return NULL;
+}
+
+Test(logqueue, log_queue_fifo_lockless_input_threads_do_not_overshoot_fifo_size)
+{
+  const gint fifo_size = 50;
+  const gint num_threads = 4;
+  GThread *threads[num_threads];
+
+  main_loop_worker_allocate_thread_space(num_threads);
+  main_loop_worker_finalize_thread_space();
+
+  LogQueue *q = log_queue_fifo_new(fifo_size, NULL, STATS_LEVEL0, NULL, NULL);
+  log_queue_fifo_set_lockless(q);
+
+  for (gint i = 0; i < num_threads; i++)
+    threads[i] = g_thread_new(NULL, _fifo_size_feed_thread, q);
+  for (gint i = 0; i < num_threads; i++)
+    g_thread_join(threads[i]);
+
+  cr_assert_eq(log_queue_get_length(q), fifo_size);
+
+  LogPathOptions path_options = LOG_PATH_OPTIONS_INIT;
+  LogMessage *msg;
+  while ((msg = log_queue_pop_head(q, &path_options)))
+    log_msg_unref(msg);
+  log_queue_ack_backlog(q, fifo_size);
+
+  log_queue_unref(q);
+}
+
+Test(logqueue, log_queue_fifo_batch_push_pop_and_prefetch_rewind)
+{
+  LogPathOptions path_options = LOG_PATH_OPTIONS_INIT;
+  LogMessage *msgs[10];
+
+  LogQueue *q = log_queue_fifo_new(OVERFLOW_SIZE, NULL, STATS_LEVEL0, NULL, NULL);
+
+  path_options.flow_control_requested = TRUE;
+  for (gint i = 0; i < 10; i++)
+    {
+      gchar seq[16];
+
+      msgs[i] = log_msg_new_empty();
+      g_snprintf(seq, sizeof(seq), "%d", i);
+      log_msg_set_value_by_name(msgs[i], "SEQ", seq, -1);
+    }
+  log_queue_push_tail_batch(q, msgs, &path_options, 10);
+  cr_assert_eq(log_queue_get_length(q), 10);
+
+  LogQueuePrefetch prefetch = { 0 };
+  LogMessage *msg = log_queue_prefetch_pop(&prefetch, q, &path_options, 4, FALSE);
+  cr_assert_eq(atoi(log_msg_get_value_by_name(msg, "SEQ", NULL)), 0);
+  cr_assert_eq(log_queue_prefetch_get_pending(&prefetch), 3);
+  cr_assert_eq(log_queue_get_length(q), 6);
+  log_msg_unref(msg);
+
+  /* the pending messages go back to the queue, the consumed one stays on the backlog */
+  log_queue_prefetch_rewind(&prefetch, q);
+  cr_assert_eq(log_queue_prefetch_get_pending(&prefetch), 0);
+  cr_assert_eq(log_queue_get_length(q), 9);
+  log_queue_ack_backlog(q, 1);
+
+  LogPathOptions popped_path_options[10];
+  cr_assert_eq(log_queue_pop_head_batch(q, msgs, popped_path_options, 10), 9);
+  for (gint i = 0; i < 9; i++)
+    {
+      cr_assert_eq(atoi(log_msg_get_value_by_name(msgs[i], "SEQ", NULL)), i + 1);
+      log_msg_unref(msgs[i]);
+    }
+  cr_assert_eq(log_queue_get_length(q), 0);
+  log_queue_ack_backlog(q, 9);
+
+  log_queue_unref(q);
+}
+
+Test(logqueue, prefetch_pops_one_by_one_from_queues_with_costly_rewind)
+{
+  LogPathOptions path_options = LOG_PATH_OPTIONS_INIT;
+  LogQueuePrefetch prefetch = { 0 };
+
+  LogQueue *q = log_queue_fifo_new(OVERFLOW_SIZE, NULL, STATS_LEVEL0, NULL, NULL);
+  q->costly_rewind = TRUE;
+
+  path_options.flow_control_requested = TRUE;
+  for (gint i = 0; i < 10; i++)
+    log_queue_push_tail(q, log_msg_new_empty(), &path_options);
+
+  LogMessage *msg = log_queue_prefetch_pop(&prefetch, q, &path_options, LOG_QUEUE_PREFETCH_SIZE, FALSE);
+  cr_assert_not_null(msg);
+  cr_assert_eq(log_queue_prefetch_get_pending(&prefetch), 0);
+  cr_assert_eq(log_queue_get_length(q), 9);
+  log_msg_unref(msg);
+
+  log_queue_ack_backlog(q, 1);
+  log_queue_rewind_backlog_all(q);
+  while ((msg = log_queue_pop_head(q, &path_options)))
+    log_msg_unref(msg);
+  log_queue_ack_backlog(q, 9);
+
+  log_queue_unref(q);
+}
+
 Test(logqueue, log_queue_fifo_multiple_queues)
 {
   const gint fifo_size = 1;
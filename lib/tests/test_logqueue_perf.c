@@ -0,0 +1,154 @@
+/*
+ * Copyright (c) 2024 Balabit
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+ *
+ * As an additional exemption you are allowed to compile & link against the
+ * OpenSSL libraries as published by the OpenSSL project. See the file
+ * COPYING for details.
+ *
+ */
+
+#include <criterion/criterion.h>
+
+#include "logqueue.h"
+#include "logqueue-fifo.h"
+#include "apphook.h"
+#include "cfg.h"
+#include "mainloop-worker.h"
+#include "timeutils/misc.h"
+
+#include <iv.h>
+
+/*
+ * Contention benchmark for the wait queue of LogQueueFifo: many input
+ * threads flushing small batches (one batch per poll iteration, like a
+ * busy afsocket source with a lot of connections) into the same queue,
+ * consumed by a single output thread.
+ */
+
+#define FEEDERS 16
+#define BATCH_SIZE 16
+#define MESSAGES_PER_FEEDER 100000
+#define MESSAGES_SUM (FEEDERS * MESSAGES_PER_FEEDER)
+
+static gint feeders_running;
+
+static gpointer
+_feed(gpointer args)
+{
+  LogQueue *q = args;
+  LogPathOptions path_options = LOG_PATH_OPTIONS_INIT;
+  LogMessage *tmpl;
+
+  iv_init();
+  main_loop_worker_thread_start(MLW_ASYNC_WORKER);
+
+  path_options.flow_control_requested = TRUE;
+  tmpl = log_msg_new_empty();
+  for (gint i = 0; i < MESSAGES_PER_FEEDER; i++)
+    {
+      LogMessage *msg = log_msg_clone_cow(tmpl, &path_options);
+
+      log_queue_push_tail(q, msg, &path_options);
+      if ((i % BATCH_SIZE) == BATCH_SIZE - 1)
+        main_loop_worker_invoke_batch_callbacks();
+    }
+  main_loop_worker_invoke_batch_callbacks();
+  log_msg_unref(tmpl);
+
+  main_loop_worker_thread_stop();
+  iv_deinit();
+  g_atomic_int_dec_and_test(&feeders_running);
+  return NULL;
+}
+
+static void
+_consume(LogQueue *q)
+{
+  LogPathOptions path_options = LOG_PATH_OPTIONS_INIT;
+  gint msg_count = 0;
+
+  while (msg_count < MESSAGES_SUM)
+    {
+      LogMessage *msg = log_queue_pop_head(q, &path_options);
+
+      if (!msg)
+        {
+          cr_assert(g_atomic_int_get(&feeders_running) > 0 || log_queue_get_length(q) > 0,
+                    "Messages lost, msg_count=%d", msg_count);
+          continue;
+        }
+
+      log_msg_unref(msg);
+      log_queue_ack_backlog(q, 1);
+      msg_count++;
+    }
+}
+
+static void
+_run_benchmark(const gchar *name, gboolean lockless)
+{
+  GThread *feeders[FEEDERS];
+  struct timespec start, end;
+
+  LogQueue *q = log_queue_fifo_new(MESSAGES_SUM, NULL, STATS_LEVEL0, NULL, NULL);
+  if (lockless)
+    log_queue_fifo_set_lockless(q);
+
+  feeders_running = FEEDERS;
+  clock_gettime(CLOCK_MONOTONIC, &start);
+  for (gint i = 0; i < FEEDERS; i++)
+    feeders[i] = g_thread_new(NULL, _feed, q);
+
+  _consume(q);
+
+  for (gint i = 0; i < FEEDERS; i++)
+    g_thread_join(feeders[i]);
+  clock_gettime(CLOCK_MONOTONIC, &end);
+
+  glong diff = timespec_diff_usec(&end, &start);
+  printf("%-20s feeders=%d, batch=%d, %.2f msg/sec\n", name, FEEDERS, BATCH_SIZE,
+         (double) MESSAGES_SUM * USEC_PER_SEC / diff);
+
+  cr_assert_eq(log_queue_get_length(q), 0);
+  log_queue_unref(q);
+}
+
+static void
+setup(void)
+{
+  app_startup();
+  configuration = cfg_new_snippet();
+  cr_assert(cfg_init(configuration), "cfg_init failed!");
+
+  main_loop_worker_allocate_thread_space(FEEDERS);
+  main_loop_worker_finalize_thread_space();
+}
+
+static void
+teardown(void)
+{
+  cfg_free(configuration);
+  app_shutdown();
+}
+
+TestSuite(logqueue_perf, .init = setup, .fini = teardown);
+
+Test(logqueue_perf, wait_queue_contention_performance)
+{
+  _run_benchmark("locked wait queue", FALSE);
+  _run_benchmark("lockless wait queue", TRUE);
+}
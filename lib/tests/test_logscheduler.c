@@ -106,6 +106,47 @@ Test(logscheduler, test_log_scheduler_can_be_constructed)
   _destroy_test_pipe(test_pipe);
 }
 
+Test(logscheduler, test_log_scheduler_partitions_are_not_limited_to_16)
+{
+  LogSchedulerOptions options;
+  TestPipe *test_pipe = _construct_test_pipe();
+  LogScheduler *s;
+
+  log_scheduler_options_defaults(&options);
+  options.num_partitions = 64;
+  options.work_stealing = TRUE;
+  cr_assert(log_scheduler_options_init(&options, configuration));
+  cr_assert_eq(options.num_partitions, 64);
+  cr_assert(options.work_stealing);
+
+  s = log_scheduler_new(&options, &test_pipe->super);
+  log_scheduler_set_stats_id(s, "#buffer:1:1");
+  cr_assert(log_scheduler_init(s));
+
+  LogMessage *msg = create_sample_message();
+  LogPathOptions path_options = LOG_PATH_OPTIONS_INIT;
+  log_scheduler_push(s, msg, &path_options);
+  cr_assert(test_pipe->messages_count == 1);
+
+  log_scheduler_deinit(s);
+  log_scheduler_free(s);
+  log_scheduler_options_destroy(&options);
+  _destroy_test_pipe(test_pipe);
+}
+
+Test(logscheduler, test_work_stealing_is_disabled_with_partition_key)
+{
+  LogSchedulerOptions options;
+
+  log_scheduler_options_defaults(&options);
+  options.num_partitions = 4;
+  options.work_stealing = TRUE;
+  log_scheduler_options_set_partition_key_ref(&options, compile_template("$HOST"));
+  cr_assert(log_scheduler_options_init(&options, configuration));
+  cr_assert_not(options.work_stealing);
+  log_scheduler_options_destroy(&options);
+}
+
 static void
 setup(void)
 {
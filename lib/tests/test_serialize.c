@@ -56,3 +56,27 @@ Test(serialize, test_serialize)
   serialize_read_string(a, value);
   cr_assert_str_eq(value->str, "tarkabarka");
 }
+
+Test(serialize, test_serialize_varint)
+{
+  GString *stream = g_string_new("");
+  guint64 values[] = { 0, 1, 127, 128, 300, G_MAXUINT32, G_MAXUINT64 };
+  guint64 value;
+
+  SerializeArchive *a = serialize_string_archive_new(stream);
+
+  for (gint i = 0; i < G_N_ELEMENTS(values); i++)
+    serialize_write_varint(a, values[i]);
+
+  cr_assert_eq(stream->len, 1 + 1 + 1 + 2 + 2 + 5 + 10);
+
+  for (gint i = 0; i < G_N_ELEMENTS(values); i++)
+    {
+      cr_assert(serialize_read_varint(a, &value));
+      cr_assert_eq(value, values[i]);
+    }
+  cr_assert_not(serialize_read_varint(a, &value));
+
+  serialize_archive_free(a);
+  g_string_free(stream, TRUE);
+}
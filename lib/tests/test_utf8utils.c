@@ -55,6 +55,13 @@ ParameterizedTestParameters(test_utf8utils, test_escaped_binary)
     {"\"text\"", "\\\"te\\xt\\\"", "\"x", -1},
     {"\xc3""\xa1 non zero terminated", "\\xc3", NULL, 1},
     {"\xc3""\xa1 non zero terminated", "á", NULL, 2},
+    /* longer runs of plain ASCII, around the boundaries of the vectorized scan */
+    {"0123456789abcdef\n0123456789abcdef", "0123456789abcdef\\n0123456789abcdef", NULL, -1},
+    {"0123456789abcde\"0123456789abcdef\"", "0123456789abcde\\\"0123456789abcdef\\\"", "\"", -1},
+    {"0123456789abcdef0123456789abcdefá\\x", "0123456789abcdef0123456789abcdefá\\\\x", NULL, -1},
+    {"0123456789abcdef0123456789abcdef\x7f", "0123456789abcdef0123456789abcdef\x7f", NULL, -1},
+    {"0123456789abcdef0123456789abcdef\x01", "0123456789abcdef0123456789abcdef\\x01", NULL, -1},
+    {"0123456789abcdef0123456789abcdef", "0123456789abcdef0123", NULL, 20},
   };
 
   return cr_make_param_array(StringValueList, string_value_list,
@@ -38,6 +38,8 @@ struct _LogTransport
   gssize (*read)(LogTransport *self, gpointer buf, gsize count, LogTransportAuxData *aux);
   gssize (*write)(LogTransport *self, const gpointer buf, gsize count);
   gssize (*writev)(LogTransport *self, struct iovec *iov, gint iov_count);
+  /* TRUE if data was already read from fd but not yet returned by read(), polling fd would not signal it */
+  gboolean (*has_pending_input)(LogTransport *self);
   void (*free_fn)(LogTransport *self);
 };
 
@@ -59,6 +61,12 @@ log_transport_read(LogTransport *self, gpointer buf, gsize count, LogTransportAu
   return self->read(self, buf, count, aux);
 }
 
+static inline gboolean
+log_transport_has_pending_input(LogTransport *self)
+{
+  return self->has_pending_input && self->has_pending_input(self);
+}
+
 void log_transport_init_instance(LogTransport *s, gint fd);
 void log_transport_free_method(LogTransport *s);
 void log_transport_free(LogTransport *s);
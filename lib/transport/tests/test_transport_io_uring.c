@@ -0,0 +1,260 @@
+/*
+ * Copyright (c) 2024 Balabit
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+ *
+ * As an additional exemption you are allowed to compile & link against the
+ * OpenSSL libraries as published by the OpenSSL project. See the file
+ * COPYING for details.
+ *
+ */
+
+#include <criterion/criterion.h>
+
+#include "transport/transport-io-uring.h"
+#include "transport/transport-udp-socket.h"
+#include "logproto/logproto-text-server.h"
+#include "gsockaddr.h"
+#include "apphook.h"
+#include "cfg.h"
+
+#include <sys/socket.h>
+#include <netinet/in.h>
+#include <arpa/inet.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#define SKIP_IF_UNSUPPORTED() \
+  do { \
+    if (!log_transport_io_uring_is_supported()) \
+      cr_skip_test("io_uring is not supported by this build or by the running kernel"); \
+  } while (0)
+
+/* completions are delivered asynchronously, wait for them a bit */
+static gssize
+_read(LogTransport *transport, gpointer buf, gsize buflen, LogTransportAuxData *aux)
+{
+  gssize rc;
+
+  for (gint i = 0; i < 1000; i++)
+    {
+      rc = log_transport_read(transport, buf, buflen, aux);
+      if (rc >= 0 || errno != EAGAIN)
+        break;
+      g_usleep(1000);
+    }
+  return rc;
+}
+
+Test(transport_io_uring, stream_socket)
+{
+  gint fds[2];
+  gchar buf[4];
+  GString *received = g_string_new("");
+
+  SKIP_IF_UNSUPPORTED();
+  cr_assert_eq(socketpair(AF_UNIX, SOCK_STREAM, 0, fds), 0);
+  fcntl(fds[0], F_SETFL, O_NONBLOCK);
+
+  LogTransport *transport = log_transport_stream_socket_new(fds[0]);
+  cr_assert(log_transport_socket_enable_io_uring((LogTransportSocket *) transport));
+  cr_assert_not_null(log_transport_io_uring_construct_poll_events(transport));
+
+  cr_assert_eq(write(fds[1], "foo\nbar\n", 8), 8);
+
+  /* smaller reads than the received chunk */
+  while (received->len < 8)
+    {
+      gssize rc = _read(transport, buf, sizeof(buf), NULL);
+      cr_assert_gt(rc, 0);
+      g_string_append_len(received, buf, rc);
+    }
+  cr_assert_str_eq(received->str, "foo\nbar\n");
+
+  close(fds[1]);
+  cr_assert_eq(_read(transport, buf, sizeof(buf), NULL), 0, "EOF is expected");
+
+  g_string_free(received, TRUE);
+  log_transport_free(transport);
+}
+
+Test(transport_io_uring, udp_socket)
+{
+  const gchar *datagrams[] = { "first", "", "second" };
+  struct sockaddr_in addr;
+  socklen_t addr_len = sizeof(addr);
+  gchar buf[1024];
+  gchar peer[64];
+
+  SKIP_IF_UNSUPPORTED();
+
+  gint fd = socket(AF_INET, SOCK_DGRAM, 0);
+  memset(&addr, 0, sizeof(addr));
+  addr.sin_family = AF_INET;
+  addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+  cr_assert(bind(fd, (struct sockaddr *) &addr, sizeof(addr)) == 0);
+  cr_assert(getsockname(fd, (struct sockaddr *) &addr, &addr_len) == 0);
+  fcntl(fd, F_SETFL, O_NONBLOCK);
+
+  LogTransport *transport = log_transport_udp_socket_new(fd);
+  cr_assert(log_transport_socket_enable_io_uring((LogTransportSocket *) transport));
+
+  gint sender = socket(AF_INET, SOCK_DGRAM, 0);
+  for (gint i = 0; i < G_N_ELEMENTS(datagrams); i++)
+    sendto(sender, datagrams[i], strlen(datagrams[i]), 0, (struct sockaddr *) &addr, sizeof(addr));
+  close(sender);
+
+  /* empty datagrams are skipped */
+  for (gint i = 0; i < G_N_ELEMENTS(datagrams); i += 2)
+    {
+      LogTransportAuxData aux;
+
+      log_transport_aux_data_init(&aux);
+      gssize rc = _read(transport, buf, sizeof(buf), &aux);
+      cr_assert_eq(rc, strlen(datagrams[i]));
+      cr_assert(memcmp(buf, datagrams[i], rc) == 0);
+      cr_assert_not_null(aux.peer_addr);
+      cr_assert_str_eq(g_sockaddr_format(aux.peer_addr, peer, sizeof(peer), GSA_ADDRESS_ONLY), "127.0.0.1");
+      cr_assert_not_null(aux.local_addr, "local address is expected to be extracted from IP_PKTINFO");
+      log_transport_aux_data_destroy(&aux);
+    }
+
+  log_transport_free(transport);
+}
+
+Test(transport_io_uring, regular_file_is_read_across_buffers)
+{
+  gchar filename[] = "test_transport_io_uring.XXXXXX";
+  gsize size = 200 * 1024 + 17;
+  gchar *content = g_malloc(size);
+  gchar *received = g_malloc(size);
+  gsize received_len = 0;
+  gchar buf[5000];
+
+  SKIP_IF_UNSUPPORTED();
+
+  for (gsize i = 0; i < size; i++)
+    content[i] = 'a' + i % 26;
+
+  gint fd = mkstemp(filename);
+  cr_assert(fd >= 0);
+  cr_assert_eq(write(fd, content, size), size);
+  /* start from a non-zero position, as if it was restored from the persist file */
+  lseek(fd, 3, SEEK_SET);
+  received_len = 3;
+  memcpy(received, content, 3);
+
+  LogTransport *transport = log_transport_io_uring_file_new(fd);
+  cr_assert_not_null(transport);
+
+  gssize rc;
+  while ((rc = log_transport_read(transport, buf, sizeof(buf), NULL)) > 0)
+    {
+      cr_assert_leq(received_len + rc, size);
+      memcpy(received + received_len, buf, rc);
+      received_len += rc;
+      cr_assert_eq(lseek(fd, 0, SEEK_CUR), received_len, "file position is expected to follow the reads");
+    }
+  cr_assert_eq(rc, -1);
+  cr_assert_eq(errno, EAGAIN, "EOF is expected to be reported as EAGAIN");
+  cr_assert_eq(received_len, size);
+  cr_assert(memcmp(received, content, size) == 0);
+
+  /* data appended later is read */
+  cr_assert_eq(pwrite(fd, "foo", 3, size), 3);
+  cr_assert_eq(log_transport_read(transport, buf, sizeof(buf), NULL), 3);
+  cr_assert(memcmp(buf, "foo", 3) == 0);
+
+  log_transport_free(transport);
+  unlink(filename);
+  g_free(content);
+  g_free(received);
+}
+
+/*
+ * LogReader never reads before the proto tells it to: it calls prepare(),
+ * polls the events constructed for the transport and only fetches once
+ * they fire.  Data sent before anything was read has to get through.
+ */
+Test(transport_io_uring, proto_server_receives_without_a_prior_read)
+{
+  LogProtoServerOptions options;
+  GlobalConfig *cfg = cfg_new_snippet();
+  gint fds[2];
+
+  SKIP_IF_UNSUPPORTED();
+  cr_assert_eq(socketpair(AF_UNIX, SOCK_STREAM, 0, fds), 0);
+  fcntl(fds[0], F_SETFL, O_NONBLOCK);
+
+  LogTransport *transport = log_transport_stream_socket_new(fds[0]);
+  cr_assert(log_transport_socket_enable_io_uring((LogTransportSocket *) transport));
+
+  log_proto_server_options_defaults(&options);
+  log_proto_server_options_init(&options, cfg);
+  LogProtoServer *proto = log_proto_text_server_new(transport, &options);
+
+  cr_assert_eq(write(fds[1], "foo\n", 4), 4);
+
+  LogProtoPrepareAction action = LPPA_POLL_IO;
+  for (gint i = 0; i < 1000 && action != LPPA_FORCE_SCHEDULE_FETCH; i++)
+    {
+      GIOCondition cond = 0;
+      gint timeout = -1;
+
+      action = log_proto_server_prepare(proto, &cond, &timeout);
+      if (action != LPPA_FORCE_SCHEDULE_FETCH)
+        g_usleep(1000);
+    }
+  cr_assert_eq(action, LPPA_FORCE_SCHEDULE_FETCH, "received data is not signalled to the reader");
+
+  const guchar *msg = NULL;
+  gsize msg_len = 0;
+  gboolean may_read = TRUE;
+  LogTransportAuxData aux;
+  Bookmark bookmark;
+
+  log_transport_aux_data_init(&aux);
+  cr_assert_eq(log_proto_server_fetch(proto, &msg, &msg_len, &may_read, &aux, &bookmark), LPS_SUCCESS);
+  cr_assert_eq(msg_len, 3);
+  cr_assert(memcmp(msg, "foo", 3) == 0);
+  log_transport_aux_data_destroy(&aux);
+
+  log_proto_server_free(proto);
+  log_proto_server_options_destroy(&options);
+  cfg_free(cfg);
+  close(fds[1]);
+}
+
+Test(transport_io_uring, fallback_without_support)
+{
+  if (log_transport_io_uring_is_supported())
+    cr_skip_test("io_uring is supported");
+
+  gint fds[2];
+  cr_assert_eq(socketpair(AF_UNIX, SOCK_STREAM, 0, fds), 0);
+
+  LogTransport *transport = log_transport_stream_socket_new(fds[0]);
+  cr_assert_not(log_transport_socket_enable_io_uring((LogTransportSocket *) transport));
+  cr_assert_null(log_transport_io_uring_construct_poll_events(transport));
+  cr_assert_null(log_transport_io_uring_file_new(fds[1]));
+
+  log_transport_free(transport);
+  close(fds[1]);
+}
+
+TestSuite(transport_io_uring, .init = app_startup, .fini = app_shutdown);
@@ -0,0 +1,185 @@
+/*
+ * Copyright (c) 2024 Balabit
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+ *
+ * As an additional exemption you are allowed to compile & link against the
+ * OpenSSL libraries as published by the OpenSSL project. See the file
+ * COPYING for details.
+ *
+ */
+#include <criterion/criterion.h>
+
+#include "transport/transport-udp-socket.h"
+#include "transport/transport-socket.h"
+#include "gsockaddr.h"
+#include "apphook.h"
+
+#include <sys/socket.h>
+#include <netinet/in.h>
+#include <arpa/inet.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <string.h>
+#include <unistd.h>
+
+static gint
+_create_bound_socket(struct sockaddr_in *addr)
+{
+  socklen_t addr_len = sizeof(*addr);
+  gint fd = socket(AF_INET, SOCK_DGRAM, 0);
+
+  cr_assert(fd >= 0);
+  memset(addr, 0, sizeof(*addr));
+  addr->sin_family = AF_INET;
+  addr->sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+  cr_assert(bind(fd, (struct sockaddr *) addr, sizeof(*addr)) == 0);
+  cr_assert(getsockname(fd, (struct sockaddr *) addr, &addr_len) == 0);
+  fcntl(fd, F_SETFL, O_NONBLOCK);
+  return fd;
+}
+
+static void
+_send_datagrams(const struct sockaddr_in *addr, const gchar **datagrams, gint count)
+{
+  gint fd = socket(AF_INET, SOCK_DGRAM, 0);
+
+  for (gint i = 0; i < count; i++)
+    {
+      gssize rc = sendto(fd, datagrams[i], strlen(datagrams[i]), 0, (const struct sockaddr *) addr, sizeof(*addr));
+      cr_assert_eq(rc, strlen(datagrams[i]));
+    }
+  close(fd);
+}
+
+static void
+_assert_read_datagram(LogTransport *transport, const gchar *expected)
+{
+  gchar buf[1024];
+  gchar peer[64];
+  LogTransportAuxData aux;
+
+  log_transport_aux_data_init(&aux);
+  gssize rc = log_transport_read(transport, buf, sizeof(buf), &aux);
+
+  cr_assert_eq(rc, strlen(expected), "unexpected datagram length, rc=%d, expected=%s", (gint) rc, expected);
+  cr_assert(memcmp(buf, expected, rc) == 0);
+  cr_assert_not_null(aux.peer_addr);
+  cr_assert_str_eq(g_sockaddr_format(aux.peer_addr, peer, sizeof(peer), GSA_ADDRESS_ONLY), "127.0.0.1");
+  cr_assert_not_null(aux.local_addr, "local address is expected to be extracted from IP_PKTINFO");
+  cr_assert_str_eq(g_sockaddr_format(aux.local_addr, peer, sizeof(peer), GSA_ADDRESS_ONLY), "127.0.0.1");
+  log_transport_aux_data_destroy(&aux);
+}
+
+static void
+_assert_no_more_datagrams(LogTransport *transport)
+{
+  gchar buf[1024];
+  LogTransportAuxData aux;
+
+  log_transport_aux_data_init(&aux);
+  cr_assert_eq(log_transport_read(transport, buf, sizeof(buf), &aux), -1);
+  cr_assert_eq(errno, EAGAIN);
+  log_transport_aux_data_destroy(&aux);
+}
+
+static void
+_test_receive(gint batch_size)
+{
+  const gchar *datagrams[] = { "first", "second", "third", "fourth", "fifth" };
+  struct sockaddr_in addr;
+  gint fd = _create_bound_socket(&addr);
+  LogTransport *transport = log_transport_udp_socket_new(fd);
+
+  if (!log_transport_dgram_socket_set_recv_batch_size((LogTransportSocket *) transport, batch_size))
+    {
+      cr_log_warn("recvmmsg() is not supported on this platform, batch_size=%d", batch_size);
+      log_transport_free(transport);
+      return;
+    }
+
+  _send_datagrams(&addr, datagrams, G_N_ELEMENTS(datagrams));
+
+  _assert_read_datagram(transport, "first");
+  _assert_read_datagram(transport, "second");
+  _assert_read_datagram(transport, "third");
+  _assert_read_datagram(transport, "fourth");
+  _assert_read_datagram(transport, "fifth");
+  cr_assert_not(log_transport_has_pending_input(transport));
+  _assert_no_more_datagrams(transport);
+
+  log_transport_free(transport);
+}
+
+Test(udp_recv_batch, datagrams_are_received_one_by_one_without_batching)
+{
+  _test_receive(1);
+}
+
+Test(udp_recv_batch, batches_smaller_than_the_number_of_datagrams)
+{
+  _test_receive(2);
+}
+
+Test(udp_recv_batch, batches_larger_than_the_number_of_datagrams)
+{
+  _test_receive(64);
+}
+
+Test(udp_recv_batch, empty_datagrams_are_skipped)
+{
+  const gchar *datagrams[] = { "first", "", "second" };
+  struct sockaddr_in addr;
+  gint fd = _create_bound_socket(&addr);
+  LogTransport *transport = log_transport_udp_socket_new(fd);
+
+  if (!log_transport_dgram_socket_set_recv_batch_size((LogTransportSocket *) transport, 16))
+    {
+      log_transport_free(transport);
+      return;
+    }
+
+  _send_datagrams(&addr, datagrams, G_N_ELEMENTS(datagrams));
+  _assert_read_datagram(transport, "first");
+  _assert_read_datagram(transport, "second");
+  _assert_no_more_datagrams(transport);
+
+  log_transport_free(transport);
+}
+
+Test(udp_recv_batch, pending_datagrams_are_signalled)
+{
+  const gchar *datagrams[] = { "first", "second" };
+  struct sockaddr_in addr;
+  gint fd = _create_bound_socket(&addr);
+  LogTransport *transport = log_transport_udp_socket_new(fd);
+
+  if (!log_transport_dgram_socket_set_recv_batch_size((LogTransportSocket *) transport, 16))
+    {
+      log_transport_free(transport);
+      return;
+    }
+
+  _send_datagrams(&addr, datagrams, G_N_ELEMENTS(datagrams));
+  cr_assert_not(log_transport_has_pending_input(transport));
+  _assert_read_datagram(transport, "first");
+  cr_assert(log_transport_has_pending_input(transport));
+  _assert_read_datagram(transport, "second");
+  cr_assert_not(log_transport_has_pending_input(transport));
+
+  log_transport_free(transport);
+}
+
+TestSuite(udp_recv_batch, .init = app_startup, .fini = app_shutdown);
@@ -0,0 +1,658 @@
+/*
+ * Copyright (c) 2024 Balabit
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+ *
+ * As an additional exemption you are allowed to compile & link against the
+ * OpenSSL libraries as published by the OpenSSL project. See the file
+ * COPYING for details.
+ *
+ */
+
+#include "transport/transport-io-uring.h"
+
+#if SYSLOG_NG_ENABLE_IO_URING
+
+#include "transport/transport-file.h"
+#include "poll-fd-events.h"
+#include "messages.h"
+
+#include <liburing.h>
+#include <sys/eventfd.h>
+#include <sys/socket.h>
+#include <sys/uio.h>
+#include <errno.h>
+#include <string.h>
+#include <unistd.h>
+
+#define IO_URING_QUEUE_DEPTH 8
+#define IO_URING_BUFFER_GROUP 0
+
+/*
+ * The buffers are allocated per connection, keep them small for stream
+ * sockets (a server may have thousands of connections), datagram buffers
+ * have to hold the largest possible datagram, the source address and the
+ * control messages.
+ */
+#define IO_URING_STREAM_BUFFERS 8
+#define IO_URING_STREAM_BUFFER_SIZE 4096
+#define IO_URING_DGRAM_BUFFERS 8
+#define IO_URING_DGRAM_CONTROL_SIZE 256
+#define IO_URING_DGRAM_BUFFER_SIZE (65536 + sizeof(struct io_uring_recvmsg_out) \
+                                    + sizeof(struct sockaddr_storage) + IO_URING_DGRAM_CONTROL_SIZE)
+
+#define IO_URING_FILE_BUFFER_SIZE (64 * 1024)
+
+struct _LogTransportIOUring
+{
+  struct io_uring ring;
+  gint event_fd;
+  gboolean dgram;
+
+  struct io_uring_buf_ring *buf_ring;
+  guchar *buffers;
+  gint num_buffers;
+  gsize buffer_size;
+
+  /* describes the layout of the buffers filled by recvmsg() */
+  struct msghdr msg;
+  gboolean armed;
+
+  /* the buffer of the last completion, partially returned by read() */
+  struct
+  {
+    guchar *data;
+    gsize len;
+    gsize pos;
+    gint bid;
+  } current;
+};
+
+static gboolean
+_setup_buffer_ring(struct io_uring *ring, struct io_uring_buf_ring **buf_ring, guchar *buffers,
+                   gint num_buffers, gsize buffer_size)
+{
+  gint ret;
+
+  *buf_ring = io_uring_setup_buf_ring(ring, num_buffers, IO_URING_BUFFER_GROUP, 0, &ret);
+  if (!*buf_ring)
+    return FALSE;
+
+  for (gint i = 0; i < num_buffers; i++)
+    io_uring_buf_ring_add(*buf_ring, buffers + i * buffer_size, buffer_size, i,
+                          io_uring_buf_ring_mask(num_buffers), i);
+  io_uring_buf_ring_advance(*buf_ring, num_buffers);
+  return TRUE;
+}
+
+/*
+ * Multishot receive needs Linux 6.0, so check that it actually works
+ * instead of relying on the opcode probe.
+ */
+static gboolean
+_probe_multishot_receive(struct io_uring *ring)
+{
+  struct io_uring_buf_ring *buf_ring;
+  guchar buffer[16];
+  gint fds[2];
+  gboolean supported = FALSE;
+
+  if (!_setup_buffer_ring(ring, &buf_ring, buffer, 1, sizeof(buffer)))
+    return FALSE;
+
+  if (socketpair(AF_UNIX, SOCK_STREAM, 0, fds) < 0)
+    goto exit;
+
+  if (write(fds[1], "x", 1) == 1)
+    {
+      struct io_uring_sqe *sqe = io_uring_get_sqe(ring);
+      struct io_uring_cqe *cqe;
+
+      io_uring_prep_recv_multishot(sqe, fds[0], NULL, 0, 0);
+      sqe->flags |= IOSQE_BUFFER_SELECT;
+      sqe->buf_group = IO_URING_BUFFER_GROUP;
+
+      if (io_uring_submit_and_wait(ring, 1) >= 0 && io_uring_peek_cqe(ring, &cqe) == 0)
+        {
+          supported = cqe->res == 1 && (cqe->flags & IORING_CQE_F_MORE);
+          io_uring_cqe_seen(ring, cqe);
+        }
+    }
+  close(fds[0]);
+  close(fds[1]);
+
+exit:
+  io_uring_free_buf_ring(ring, buf_ring, 1, IO_URING_BUFFER_GROUP);
+  return supported;
+}
+
+static gboolean
+_probe_io_uring(void)
+{
+  struct io_uring ring;
+
+  /* fails with ENOSYS or EPERM if io_uring is not available or disabled by the administrator */
+  if (io_uring_queue_init(IO_URING_QUEUE_DEPTH, &ring, 0) < 0)
+    return FALSE;
+
+  gboolean supported = _probe_multishot_receive(&ring);
+  io_uring_queue_exit(&ring);
+
+  msg_debug("io_uring support probed",
+            evt_tag_str("supported", supported ? "yes" : "no"));
+  return supported;
+}
+
+gboolean
+log_transport_io_uring_is_supported(void)
+{
+  static gsize probed;
+  static gboolean supported;
+
+  if (g_once_init_enter(&probed))
+    {
+      supported = _probe_io_uring();
+      g_once_init_leave(&probed, 1);
+    }
+  return supported;
+}
+
+/* sockets */
+
+static void
+_recycle_buffer(LogTransportIOUring *self, gint bid)
+{
+  io_uring_buf_ring_add(self->buf_ring, self->buffers + bid * self->buffer_size, self->buffer_size, bid,
+                        io_uring_buf_ring_mask(self->num_buffers), 0);
+  io_uring_buf_ring_advance(self->buf_ring, 1);
+}
+
+static void
+_release_current(LogTransportIOUring *self)
+{
+  _recycle_buffer(self, self->current.bid);
+  self->current.data = NULL;
+}
+
+static gboolean
+_arm_receive(LogTransportIOUring *self, gint fd)
+{
+  struct io_uring_sqe *sqe = io_uring_get_sqe(&self->ring);
+
+  if (self->dgram)
+    io_uring_prep_recvmsg_multishot(sqe, fd, &self->msg, 0);
+  else
+    io_uring_prep_recv_multishot(sqe, fd, NULL, 0, 0);
+  sqe->flags |= IOSQE_BUFFER_SELECT;
+  sqe->buf_group = IO_URING_BUFFER_GROUP;
+
+  gint rc = io_uring_submit(&self->ring);
+  if (rc < 0)
+    {
+      errno = -rc;
+      return FALSE;
+    }
+  self->armed = TRUE;
+  return TRUE;
+}
+
+static gboolean
+_peek_completion(LogTransportIOUring *self, gint *res, guint *flags)
+{
+  struct io_uring_cqe *cqe;
+
+  if (io_uring_peek_cqe(&self->ring, &cqe) != 0)
+    {
+      eventfd_t value;
+
+      /* reset the eventfd before checking again, so completions arriving
+       * after this point signal it again */
+      eventfd_read(self->event_fd, &value);
+      if (io_uring_peek_cqe(&self->ring, &cqe) != 0)
+        return FALSE;
+    }
+
+  *res = cqe->res;
+  *flags = cqe->flags;
+  io_uring_cqe_seen(&self->ring, cqe);
+  return TRUE;
+}
+
+/*
+ * Fetches the next received chunk into self->current.  Returns its
+ * length, 0 on EOF or -1 with errno set, EAGAIN if nothing was received.
+ */
+static gssize
+_receive(LogTransportIOUring *self, gint fd)
+{
+  gint res;
+  guint flags;
+
+  while (TRUE)
+    {
+      if (!self->armed && !_arm_receive(self, fd))
+        return -1;
+
+      if (!_peek_completion(self, &res, &flags))
+        {
+          errno = EAGAIN;
+          return -1;
+        }
+
+      if (!(flags & IORING_CQE_F_MORE))
+        self->armed = FALSE;
+
+      if (res == -ENOBUFS)
+        {
+          /* every buffer was in use, the previous completions have
+           * returned them by now, the receive is rearmed above */
+          continue;
+        }
+
+      if (res < 0)
+        {
+          errno = -res;
+          return -1;
+        }
+
+      if (!(flags & IORING_CQE_F_BUFFER))
+        {
+          /* EOF */
+          self->armed = TRUE;
+          return 0;
+        }
+
+      self->current.bid = flags >> IORING_CQE_BUFFER_SHIFT;
+      self->current.data = self->buffers + self->current.bid * self->buffer_size;
+      self->current.len = res;
+      self->current.pos = 0;
+      return res;
+    }
+}
+
+static gssize
+log_transport_io_uring_stream_read_method(LogTransport *s, gpointer buf, gsize buflen, LogTransportAuxData *aux)
+{
+  LogTransportSocket *self = (LogTransportSocket *) s;
+  LogTransportIOUring *io_uring = self->io_uring;
+
+  if (!io_uring->current.data)
+    {
+      gssize rc = _receive(io_uring, s->fd);
+      if (rc <= 0)
+        return rc;
+    }
+
+  gsize len = MIN(buflen, io_uring->current.len - io_uring->current.pos);
+  memcpy(buf, io_uring->current.data + io_uring->current.pos, len);
+  io_uring->current.pos += len;
+  if (io_uring->current.pos == io_uring->current.len)
+    _release_current(io_uring);
+
+  if (aux)
+    aux->proto = self->proto;
+  return len;
+}
+
+static gssize
+log_transport_io_uring_dgram_read_method(LogTransport *s, gpointer buf, gsize buflen, LogTransportAuxData *aux)
+{
+  LogTransportSocket *self = (LogTransportSocket *) s;
+  LogTransportIOUring *io_uring = self->io_uring;
+
+  while (TRUE)
+    {
+      gssize rc = _receive(io_uring, s->fd);
+      if (rc < 0)
+        return rc;
+
+      /* zero length datagrams carry no message, but they do not mean EOF either */
+      if (rc == 0)
+        continue;
+
+      struct io_uring_recvmsg_out *out = io_uring_recvmsg_validate(io_uring->current.data, rc, &io_uring->msg);
+      gsize payload_len = out ? io_uring_recvmsg_payload_length(out, rc, &io_uring->msg) : 0;
+
+      if (payload_len == 0)
+        {
+          _release_current(io_uring);
+          continue;
+        }
+
+      gsize len = MIN(buflen, payload_len);
+      memcpy(buf, io_uring_recvmsg_payload(out, &io_uring->msg), len);
+
+      struct msghdr msg = { 0 };
+      msg.msg_name = io_uring_recvmsg_name(out);
+      msg.msg_namelen = MIN(out->namelen, io_uring->msg.msg_namelen);
+      msg.msg_control = ((guchar *) msg.msg_name) + io_uring->msg.msg_namelen;
+      msg.msg_controllen = out->controllen;
+      msg.msg_flags = out->flags;
+      log_transport_socket_extract_aux_from_msghdr(self, &msg, aux);
+
+      _release_current(io_uring);
+      return len;
+    }
+}
+
+/*
+ * Only an armed receive signals the eventfd, so while it is not armed
+ * (e.g. the kernel terminated the multishot receive) the caller has to
+ * read() to rearm it instead of polling.
+ */
+static gboolean
+log_transport_io_uring_has_pending_input_method(LogTransport *s)
+{
+  LogTransportSocket *self = (LogTransportSocket *) s;
+
+  return !self->io_uring->armed || self->io_uring->current.data || io_uring_cq_ready(&self->io_uring->ring) > 0;
+}
+
+void
+log_transport_io_uring_free(LogTransportIOUring *self)
+{
+  if (self->buf_ring)
+    io_uring_free_buf_ring(&self->ring, self->buf_ring, self->num_buffers, IO_URING_BUFFER_GROUP);
+  /* cancels the pending receive, the buffers are not accessed after this */
+  io_uring_queue_exit(&self->ring);
+  if (self->event_fd >= 0)
+    close(self->event_fd);
+  g_free(self->buffers);
+  g_free(self);
+}
+
+static LogTransportIOUring *
+_io_uring_new(gboolean dgram)
+{
+  LogTransportIOUring *self = g_new0(LogTransportIOUring, 1);
+
+  self->dgram = dgram;
+  self->num_buffers = dgram ? IO_URING_DGRAM_BUFFERS : IO_URING_STREAM_BUFFERS;
+  self->buffer_size = dgram ? IO_URING_DGRAM_BUFFER_SIZE : IO_URING_STREAM_BUFFER_SIZE;
+  self->msg.msg_namelen = sizeof(struct sockaddr_storage);
+  self->msg.msg_controllen = IO_URING_DGRAM_CONTROL_SIZE;
+  self->event_fd = -1;
+
+  if (io_uring_queue_init(IO_URING_QUEUE_DEPTH, &self->ring, 0) < 0)
+    {
+      g_free(self);
+      return NULL;
+    }
+
+  self->buffers = g_malloc(self->num_buffers * self->buffer_size);
+  self->event_fd = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+
+  if (self->event_fd < 0
+      || io_uring_register_eventfd(&self->ring, self->event_fd) < 0
+      || !_setup_buffer_ring(&self->ring, &self->buf_ring, self->buffers, self->num_buffers, self->buffer_size))
+    {
+      log_transport_io_uring_free(self);
+      return NULL;
+    }
+  return self;
+}
+
+gboolean
+log_transport_socket_enable_io_uring(LogTransportSocket *self)
+{
+  gint sock_type;
+  socklen_t len = sizeof(sock_type);
+
+  if (!log_transport_io_uring_is_supported())
+    return FALSE;
+
+  if (getsockopt(self->super.fd, SOL_SOCKET, SO_TYPE, &sock_type, &len) < 0)
+    return FALSE;
+
+  self->io_uring = _io_uring_new(sock_type == SOCK_DGRAM);
+  if (!self->io_uring)
+    return FALSE;
+
+  /* the eventfd is polled instead of the socket, nothing would be
+   * received without a pending receive operation */
+  if (!_arm_receive(self->io_uring, self->super.fd))
+    {
+      log_transport_io_uring_free(self->io_uring);
+      self->io_uring = NULL;
+      return FALSE;
+    }
+
+  self->super.read = self->io_uring->dgram
+                     ? log_transport_io_uring_dgram_read_method
+                     : log_transport_io_uring_stream_read_method;
+  self->super.has_pending_input = log_transport_io_uring_has_pending_input_method;
+  return TRUE;
+}
+
+PollEvents *
+log_transport_io_uring_construct_poll_events(LogTransport *s)
+{
+  if (s->has_pending_input != log_transport_io_uring_has_pending_input_method)
+    return NULL;
+
+  return poll_fd_events_new(((LogTransportSocket *) s)->io_uring->event_fd);
+}
+
+/* regular files */
+
+typedef struct _IOUringReadBuffer
+{
+  guchar *data;
+  gint64 offset;
+  /* the result of the read, negative errno on error */
+  gssize len;
+  gsize pos;
+  gboolean in_flight;
+  gboolean ready;
+} IOUringReadBuffer;
+
+typedef struct _LogTransportIOUringFile
+{
+  LogTransport super;
+  struct io_uring ring;
+  gboolean fixed_buffers;
+  IOUringReadBuffer buffers[2];
+  gint current;
+  /* the file position of the next byte returned by read() */
+  gint64 position;
+  gboolean position_known;
+} LogTransportIOUringFile;
+
+static gboolean
+_submit_read(LogTransportIOUringFile *self, gint index, gint64 offset)
+{
+  IOUringReadBuffer *buffer = &self->buffers[index];
+  struct io_uring_sqe *sqe = io_uring_get_sqe(&self->ring);
+
+  if (self->fixed_buffers)
+    io_uring_prep_read_fixed(sqe, self->super.fd, buffer->data, IO_URING_FILE_BUFFER_SIZE, offset, index);
+  else
+    io_uring_prep_read(sqe, self->super.fd, buffer->data, IO_URING_FILE_BUFFER_SIZE, offset);
+  io_uring_sqe_set_data64(sqe, index);
+
+  gint rc = io_uring_submit(&self->ring);
+  if (rc < 0)
+    {
+      errno = -rc;
+      return FALSE;
+    }
+
+  buffer->offset = offset;
+  buffer->in_flight = TRUE;
+  buffer->ready = FALSE;
+  return TRUE;
+}
+
+static gboolean
+_wait_for_read(LogTransportIOUringFile *self, gint index)
+{
+  while (self->buffers[index].in_flight)
+    {
+      struct io_uring_cqe *cqe;
+      gint rc = io_uring_wait_cqe(&self->ring, &cqe);
+
+      if (rc == -EINTR)
+        continue;
+      if (rc < 0)
+        {
+          errno = -rc;
+          return FALSE;
+        }
+
+      IOUringReadBuffer *completed = &self->buffers[io_uring_cqe_get_data64(cqe)];
+      completed->len = cqe->res;
+      completed->pos = 0;
+      completed->in_flight = FALSE;
+      completed->ready = TRUE;
+      io_uring_cqe_seen(&self->ring, cqe);
+    }
+  return TRUE;
+}
+
+static void
+_reset_buffer(IOUringReadBuffer *buffer)
+{
+  buffer->ready = FALSE;
+  buffer->len = 0;
+  buffer->pos = 0;
+}
+
+/* EOF is reported as EAGAIN, like log_transport_file_read_and_ignore_eof_method() does */
+static gssize
+log_transport_io_uring_file_read_method(LogTransport *s, gpointer buf, gsize buflen, LogTransportAuxData *aux)
+{
+  LogTransportIOUringFile *self = (LogTransportIOUringFile *) s;
+
+  if (!self->position_known)
+    {
+      /* the position might have been restored from the persist file after construction */
+      self->position = lseek(s->fd, 0, SEEK_CUR);
+      if (self->position < 0)
+        return -1;
+      self->position_known = TRUE;
+    }
+
+  IOUringReadBuffer *current = &self->buffers[self->current];
+  if (!current->in_flight && !current->ready && !_submit_read(self, self->current, self->position))
+    return -1;
+
+  if (!_wait_for_read(self, self->current))
+    return -1;
+
+  if (current->len <= 0)
+    {
+      errno = current->len < 0 ? -current->len : EAGAIN;
+      _reset_buffer(current);
+      return -1;
+    }
+
+  /* the next chunk is read while this one is processed */
+  IOUringReadBuffer *next = &self->buffers[!self->current];
+  if (current->pos == 0 && current->len == IO_URING_FILE_BUFFER_SIZE && !next->in_flight && !next->ready)
+    _submit_read(self, !self->current, current->offset + current->len);
+
+  gsize len = MIN(buflen, current->len - current->pos);
+  memcpy(buf, current->data + current->pos, len);
+  current->pos += len;
+  self->position += len;
+
+  if (current->pos == current->len)
+    {
+      _reset_buffer(current);
+      self->current = !self->current;
+    }
+
+  /* the file position is used to detect EOF and it is saved with the persistent state */
+  lseek(s->fd, self->position, SEEK_SET);
+  return len;
+}
+
+static void
+log_transport_io_uring_file_free_method(LogTransport *s)
+{
+  LogTransportIOUringFile *self = (LogTransportIOUringFile *) s;
+
+  io_uring_queue_exit(&self->ring);
+  for (gint i = 0; i < G_N_ELEMENTS(self->buffers); i++)
+    g_free(self->buffers[i].data);
+  log_transport_free_method(s);
+}
+
+LogTransport *
+log_transport_io_uring_file_new(gint fd)
+{
+  LogTransportIOUringFile *self;
+  struct iovec iov[2];
+
+  if (!log_transport_io_uring_is_supported())
+    return NULL;
+
+  self = g_new0(LogTransportIOUringFile, 1);
+  if (io_uring_queue_init(IO_URING_QUEUE_DEPTH, &self->ring, 0) < 0)
+    {
+      g_free(self);
+      return NULL;
+    }
+
+  log_transport_init_instance(&self->super, fd);
+  self->super.read = log_transport_io_uring_file_read_method;
+  self->super.write = log_transport_file_write_method;
+  self->super.free_fn = log_transport_io_uring_file_free_method;
+
+  for (gint i = 0; i < G_N_ELEMENTS(self->buffers); i++)
+    {
+      self->buffers[i].data = g_malloc(IO_URING_FILE_BUFFER_SIZE);
+      iov[i].iov_base = self->buffers[i].data;
+      iov[i].iov_len = IO_URING_FILE_BUFFER_SIZE;
+    }
+
+  /* registering pins the buffers, which is subject to RLIMIT_MEMLOCK on older kernels */
+  self->fixed_buffers = io_uring_register_buffers(&self->ring, iov, G_N_ELEMENTS(iov)) == 0;
+  return &self->super;
+}
+
+#else
+
+gboolean
+log_transport_io_uring_is_supported(void)
+{
+  return FALSE;
+}
+
+gboolean
+log_transport_socket_enable_io_uring(LogTransportSocket *self)
+{
+  return FALSE;
+}
+
+void
+log_transport_io_uring_free(LogTransportIOUring *self)
+{
+  g_assert_not_reached();
+}
+
+PollEvents *
+log_transport_io_uring_construct_poll_events(LogTransport *s)
+{
+  return NULL;
+}
+
+LogTransport *
+log_transport_io_uring_file_new(gint fd)
+{
+  return NULL;
+}
+
+#endif
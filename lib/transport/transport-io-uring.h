@@ -0,0 +1,55 @@
+/*
+ * Copyright (c) 2024 Balabit
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+ *
+ * As an additional exemption you are allowed to compile & link against the
+ * OpenSSL libraries as published by the OpenSSL project. See the file
+ * COPYING for details.
+ *
+ */
+
+#ifndef TRANSPORT_TRANSPORT_IO_URING_H_INCLUDED
+#define TRANSPORT_TRANSPORT_IO_URING_H_INCLUDED 1
+
+#include "transport/transport-socket.h"
+#include "poll-events.h"
+
+/*
+ * io_uring based input for the socket and file transports.
+ *
+ * Sockets are read using a multishot receive operation into a ring of
+ * buffers provided to the kernel, so no system call is needed per read.
+ * Completions are signalled on an eventfd, which has to be polled instead
+ * of the socket, see log_transport_io_uring_construct_poll_events().
+ *
+ * Regular files are read ahead into two registered buffers: while the
+ * data of one is being processed, the next chunk is already being read.
+ *
+ * The write side of these transports is not changed.  Everything here
+ * fails gracefully (returning FALSE or NULL) if syslog-ng was compiled
+ * without liburing or the running kernel lacks the required features, in
+ * which case the caller should use the plain transport.
+ */
+
+gboolean log_transport_io_uring_is_supported(void);
+
+gboolean log_transport_socket_enable_io_uring(LogTransportSocket *self);
+void log_transport_io_uring_free(LogTransportIOUring *self);
+PollEvents *log_transport_io_uring_construct_poll_events(LogTransport *s);
+
+LogTransport *log_transport_io_uring_file_new(gint fd);
+
+#endif
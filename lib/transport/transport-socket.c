@@ -22,11 +22,13 @@
  */
 
 #include "transport-socket.h"
+#include "transport-io-uring.h"
 #include "messages.h"
 
 #include <errno.h>
 #include <string.h>
 #include <unistd.h>
+#include <sys/uio.h>
 
 static gint
 _determine_address_family(gint fd)
@@ -149,8 +151,9 @@ _parse_cmsg_to_aux(LogTransportSocket *self, struct msghdr *msg, LogTransportAux
 #define _parse_cmsg_to_aux(s, m, a)
 #endif
 
-static void
-_extract_from_msghdr_method(LogTransportSocket *self, struct msghdr *msg, LogTransportAuxData *aux)
+void
+log_transport_socket_extract_aux_from_msghdr(LogTransportSocket *self, struct msghdr *msg,
+                                             LogTransportAuxData *aux)
 {
   if (msg->msg_namelen && aux)
     log_transport_aux_data_set_peer_addr_ref(aux, g_sockaddr_new((struct sockaddr *) msg->msg_name, msg->msg_namelen));
@@ -187,7 +190,7 @@ log_transport_socket_read_method(LogTransport *s, gpointer buf, gsize buflen, Lo
   while (rc == -1 && errno == EINTR);
 
   if (rc > 0)
-    _extract_from_msghdr_method(self, &msg, aux);
+    log_transport_socket_extract_aux_from_msghdr(self, &msg, aux);
 
   return rc;
 }
@@ -232,6 +235,194 @@ log_transport_dgram_socket_read_method(LogTransport *s, gpointer buf, gsize bufl
   return rc;
 }
 
+#if SYSLOG_NG_HAVE_RECVMMSG
+
+/*
+ * Batched receive: a single recvmmsg() call fills a ring of datagram
+ * buffers, read() then returns them one-by-one, along with the aux data
+ * (peer/local address, timestamp) extracted from their own msghdr.
+ */
+
+#define RECV_BATCH_CTLBUF_SIZE 256
+
+/* datagram buffers are sized by the reader (log-msg-size), the number of
+ * slots actually used is limited so that a socket never holds more than
+ * this many bytes of buffers */
+#define RECV_BATCH_MAX_BUFFER_BYTES (1024 * 1024)
+
+struct _LogTransportSocketRecvBatch
+{
+  gint size;
+  /* number of slots used with the current buffer_size, at most size */
+  gint active;
+  gint count;
+  gint next;
+  gsize buffer_size;
+  guchar *buffers;
+  struct mmsghdr *msgs;
+  struct iovec *iovs;
+  struct sockaddr_storage *addrs;
+  gchar *ctlbufs;
+};
+
+static LogTransportSocketRecvBatch *
+_recv_batch_new(gint size)
+{
+  LogTransportSocketRecvBatch *self = g_new0(LogTransportSocketRecvBatch, 1);
+
+  self->size = size;
+  self->msgs = g_new0(struct mmsghdr, size);
+  self->iovs = g_new0(struct iovec, size);
+  self->addrs = g_new0(struct sockaddr_storage, size);
+  self->ctlbufs = g_malloc0(size * RECV_BATCH_CTLBUF_SIZE);
+  return self;
+}
+
+static void
+_recv_batch_free(LogTransportSocketRecvBatch *self)
+{
+  g_free(self->buffers);
+  g_free(self->msgs);
+  g_free(self->iovs);
+  g_free(self->addrs);
+  g_free(self->ctlbufs);
+  g_free(self);
+}
+
+/* the kernel updates the length fields, they need to be reset before each call */
+static void
+_recv_batch_prepare(LogTransportSocketRecvBatch *self, gsize buffer_size)
+{
+  if (self->buffer_size != buffer_size)
+    {
+      self->active = CLAMP(RECV_BATCH_MAX_BUFFER_BYTES / buffer_size, 1, self->size);
+      g_free(self->buffers);
+      self->buffers = g_malloc(self->active * buffer_size);
+      self->buffer_size = buffer_size;
+    }
+
+  for (gint i = 0; i < self->active; i++)
+    {
+      struct msghdr *msg = &self->msgs[i].msg_hdr;
+
+      self->iovs[i].iov_base = self->buffers + i * buffer_size;
+      self->iovs[i].iov_len = buffer_size;
+
+      msg->msg_name = &self->addrs[i];
+      msg->msg_namelen = sizeof(self->addrs[i]);
+      msg->msg_iov = &self->iovs[i];
+      msg->msg_iovlen = 1;
+      msg->msg_control = self->ctlbufs + i * RECV_BATCH_CTLBUF_SIZE;
+      msg->msg_controllen = RECV_BATCH_CTLBUF_SIZE;
+      msg->msg_flags = 0;
+    }
+  self->count = self->next = 0;
+}
+
+static gssize
+_recv_batch_fill(LogTransportSocket *self, gsize buflen)
+{
+  LogTransportSocketRecvBatch *batch = self->recv_batch;
+  gint rc;
+
+  _recv_batch_prepare(batch, buflen);
+  do
+    {
+      rc = recvmmsg(self->super.fd, batch->msgs, batch->active, 0, NULL);
+    }
+  while (rc == -1 && errno == EINTR);
+
+  if (rc > 0)
+    batch->count = rc;
+  return rc;
+}
+
+static gboolean
+log_transport_dgram_socket_has_pending_input_method(LogTransport *s)
+{
+  LogTransportSocket *self = (LogTransportSocket *) s;
+
+  return self->recv_batch->next < self->recv_batch->count;
+}
+
+static gssize
+log_transport_dgram_socket_read_batched_method(LogTransport *s, gpointer buf, gsize buflen, LogTransportAuxData *aux)
+{
+  LogTransportSocket *self = (LogTransportSocket *) s;
+  LogTransportSocketRecvBatch *batch = self->recv_batch;
+
+  while (TRUE)
+    {
+      if (batch->next >= batch->count)
+        {
+          gssize rc = _recv_batch_fill(self, buflen);
+
+          if (rc == 0)
+            errno = EAGAIN;
+          if (rc <= 0)
+            return -1;
+        }
+
+      gint i = batch->next++;
+      struct mmsghdr *mmsg = &batch->msgs[i];
+
+      /* DGRAM sockets should never return EOF, skip empty datagrams */
+      if (mmsg->msg_len == 0)
+        continue;
+
+      gsize len = MIN(mmsg->msg_len, buflen);
+      memcpy(buf, batch->iovs[i].iov_base, len);
+      log_transport_socket_extract_aux_from_msghdr(self, &mmsg->msg_hdr, aux);
+      return len;
+    }
+}
+
+gboolean
+log_transport_dgram_socket_set_recv_batch_size(LogTransportSocket *self, gint batch_size)
+{
+  if (self->recv_batch)
+    {
+      _recv_batch_free(self->recv_batch);
+      self->recv_batch = NULL;
+    }
+
+  if (batch_size <= 1)
+    {
+      self->super.read = log_transport_dgram_socket_read_method;
+      self->super.has_pending_input = NULL;
+      return TRUE;
+    }
+
+  self->recv_batch = _recv_batch_new(batch_size);
+  self->super.read = log_transport_dgram_socket_read_batched_method;
+  self->super.has_pending_input = log_transport_dgram_socket_has_pending_input_method;
+  return TRUE;
+}
+
+#else
+
+gboolean
+log_transport_dgram_socket_set_recv_batch_size(LogTransportSocket *self, gint batch_size)
+{
+  return batch_size <= 1;
+}
+
+#endif
+
+void
+log_transport_dgram_socket_free_method(LogTransport *s)
+{
+  LogTransportSocket *self = (LogTransportSocket *) s;
+
+#if SYSLOG_NG_HAVE_RECVMMSG
+  if (self->recv_batch)
+    _recv_batch_free(self->recv_batch);
+#endif
+  if (self->io_uring)
+    log_transport_io_uring_free(self->io_uring);
+  log_transport_free_method(s);
+}
+
 static gssize
 log_transport_dgram_socket_write_method(LogTransport *s, const gpointer buf, gsize buflen)
 {
@@ -253,12 +444,70 @@ log_transport_dgram_socket_write_method(LogTransport *s, const gpointer buf, gsi
   return rc;
 }
 
+#if SYSLOG_NG_HAVE_SENDMMSG
+
+#define SEND_BATCH_CHUNK_SIZE 64
+
+/*
+ * Unlike writev() on a stream, each element of @iov is sent as a separate
+ * datagram.  The return value is the sum of the lengths of the datagrams
+ * sent, which is always on a datagram boundary.
+ */
+static gssize
+log_transport_dgram_socket_writev_method(LogTransport *s, struct iovec *iov, gint iov_count)
+{
+  struct mmsghdr msgs[SEND_BATCH_CHUNK_SIZE];
+  gssize sum = 0;
+  gint sent = 0;
+
+  while (sent < iov_count)
+    {
+      gint chunk = MIN(iov_count - sent, SEND_BATCH_CHUNK_SIZE);
+      gint rc;
+
+      memset(msgs, 0, chunk * sizeof(msgs[0]));
+      for (gint i = 0; i < chunk; i++)
+        {
+          msgs[i].msg_hdr.msg_iov = &iov[sent + i];
+          msgs[i].msg_hdr.msg_iovlen = 1;
+        }
+
+      do
+        {
+          rc = sendmmsg(s->fd, msgs, chunk, 0);
+        }
+      while (rc == -1 && errno == EINTR);
+
+      if (rc < 0)
+        {
+          /* see log_transport_dgram_socket_write_method() about ENOBUFS */
+          if (errno != ENOBUFS)
+            return sum > 0 ? sum : -1;
+          rc = 1;
+        }
+
+      for (gint i = 0; i < rc; i++)
+        sum += iov[sent + i].iov_len;
+      sent += rc;
+
+      if (rc < chunk)
+        break;
+    }
+  return sum;
+}
+
+#endif
+
 void
 log_transport_dgram_socket_init_instance(LogTransportSocket *self, gint fd)
 {
   log_transport_socket_init_instance(self, fd);
   self->super.read = log_transport_dgram_socket_read_method;
   self->super.write = log_transport_dgram_socket_write_method;
+#if SYSLOG_NG_HAVE_SENDMMSG
+  self->super.writev = log_transport_dgram_socket_writev_method;
+#endif
+  self->super.free_fn = log_transport_dgram_socket_free_method;
 }
 
 LogTransport *
@@ -270,11 +519,28 @@ log_transport_dgram_socket_new(gint fd)
   return &self->super;
 }
 
+static gssize
+log_transport_stream_socket_writev_method(LogTransport *s, struct iovec *iov, gint iov_count)
+{
+  gssize rc;
+
+  do
+    {
+      rc = writev(s->fd, iov, iov_count);
+    }
+  while (rc == -1 && errno == EINTR);
+  return rc;
+}
+
 void
 log_transport_stream_socket_free_method(LogTransport *s)
 {
+  LogTransportSocket *self = (LogTransportSocket *) s;
+
   if (s->fd != -1)
     shutdown(s->fd, SHUT_RDWR);
+  if (self->io_uring)
+    log_transport_io_uring_free(self->io_uring);
   log_transport_free_method(s);
 }
 
@@ -282,6 +548,7 @@ void
 log_transport_stream_socket_init_instance(LogTransportSocket *self, gint fd)
 {
   log_transport_socket_init_instance(self, fd);
+  self->super.writev = log_transport_stream_socket_writev_method;
   self->super.free_fn = log_transport_stream_socket_free_method;
 }
 
@@ -27,6 +27,9 @@
 
 #include "logtransport.h"
 
+typedef struct _LogTransportSocketRecvBatch LogTransportSocketRecvBatch;
+typedef struct _LogTransportIOUring LogTransportIOUring;
+
 typedef struct _LogTransportSocket LogTransportSocket;
 struct _LogTransportSocket
 {
@@ -34,12 +37,18 @@ struct _LogTransportSocket
   gint address_family;
   gint proto;
   void (*parse_cmsg)(LogTransportSocket *self, struct cmsghdr *cmsg, LogTransportAuxData *aux);
+  LogTransportSocketRecvBatch *recv_batch;
+  LogTransportIOUring *io_uring;
 };
 
 void log_transport_socket_parse_cmsg_method(LogTransportSocket *s, struct cmsghdr *cmsg, LogTransportAuxData *aux);
+void log_transport_socket_extract_aux_from_msghdr(LogTransportSocket *self, struct msghdr *msg,
+                                                  LogTransportAuxData *aux);
 
 void log_transport_dgram_socket_init_instance(LogTransportSocket *self, gint fd);
 LogTransport *log_transport_dgram_socket_new(gint fd);
+gboolean log_transport_dgram_socket_set_recv_batch_size(LogTransportSocket *self, gint batch_size);
+void log_transport_dgram_socket_free_method(LogTransport *s);
 
 void log_transport_stream_socket_init_instance(LogTransportSocket *self, gint fd);
 void log_transport_stream_socket_free_method(LogTransport *s);
@@ -24,6 +24,11 @@
 #include "utf8utils.h"
 #include "str-utils.h"
 
+#if defined(__x86_64__) && (defined(__clang__) || __GNUC__ >= 5)
+#define UTF8UTILS_X86_SIMD 1
+#include <immintrin.h>
+#endif
+
 static inline gboolean
 _is_character_unsafe(gunichar uchar, const gchar *unsafe_chars)
 {
@@ -109,6 +114,51 @@ _append_escaped_utf8_character(GString *escaped_output, const gchar **raw,
   return *raw - char_ptr;
 }
 
+static inline gboolean
+_is_plain_ascii_character(guchar c, gchar unsafe_char)
+{
+  return c >= 0x20 && c < 0x80 && c != '\\' && c != (guchar) unsafe_char;
+}
+
+/*
+ * Returns the length of the leading run of characters that
+ * _append_escaped_utf8_character() would reproduce as is: printable ASCII,
+ * except the backslash and unsafe_char.  Such runs are the common case
+ * (format-json values and keys), these are copied in one go instead of
+ * being decoded and appended character by character.
+ */
+static gsize
+_find_plain_ascii_prefix(const gchar *raw, gsize raw_len, gchar unsafe_char)
+{
+  gsize i = 0;
+
+#if UTF8UTILS_X86_SIMD
+  const __m128i space = _mm_set1_epi8(0x20);
+  const __m128i backslash = _mm_set1_epi8('\\');
+  const __m128i unsafe = _mm_set1_epi8(unsafe_char);
+
+  for (; i + sizeof(__m128i) <= raw_len; i += sizeof(__m128i))
+    {
+      __m128i v = _mm_loadu_si128((const __m128i *) (raw + i));
+
+      /* signed comparison, matches both control characters and bytes >= 0x80 */
+      __m128i special = _mm_or_si128(_mm_cmplt_epi8(v, space),
+                                     _mm_or_si128(_mm_cmpeq_epi8(v, backslash), _mm_cmpeq_epi8(v, unsafe)));
+      guint mask = _mm_movemask_epi8(special);
+
+      if (mask)
+        return i + __builtin_ctz(mask);
+    }
+#endif
+
+  for (; i < raw_len; i++)
+    {
+      if (!_is_plain_ascii_character(raw[i], unsafe_char))
+        break;
+    }
+  return i;
+}
+
 static void
 _append_unsafe_utf8_as_escaped_with_specific_length(GString *escaped_output, const gchar *raw,
                                                     gsize raw_len,
@@ -118,9 +168,28 @@ _append_unsafe_utf8_as_escaped_with_specific_length(GString *escaped_output, con
 {
   const gchar *raw_end = raw + raw_len;
 
+  if (unsafe_chars && unsafe_chars[0] && unsafe_chars[1])
+    {
+      /* more than one unsafe character, no fast path */
+      while (raw < raw_end)
+        _append_escaped_utf8_character(escaped_output, &raw, raw_end - raw, unsafe_chars,
+                                       control_format, invalid_format);
+      return;
+    }
+
+  /* the backslash is escaped anyway, so it is a fine placeholder for no unsafe characters */
+  gchar unsafe_char = (unsafe_chars && unsafe_chars[0]) ? unsafe_chars[0] : '\\';
+
   while (raw < raw_end)
-    _append_escaped_utf8_character(escaped_output, &raw, raw_end - raw, unsafe_chars,
-                                   control_format, invalid_format);
+    {
+      gsize plain_len = _find_plain_ascii_prefix(raw, raw_end - raw, unsafe_char);
+
+      g_string_append_len(escaped_output, raw, plain_len);
+      raw += plain_len;
+      if (raw < raw_end)
+        _append_escaped_utf8_character(escaped_output, &raw, raw_end - raw, unsafe_chars,
+                                       control_format, invalid_format);
+    }
 }
 
 static void
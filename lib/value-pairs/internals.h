@@ -28,6 +28,8 @@
 #include "syslog-ng.h"
 #include "atomic.h"
 
+typedef struct _VPNameCache VPNameCache;
+
 struct _ValuePairs
 {
   GAtomicCounter ref_cnt;
@@ -47,6 +49,11 @@ struct _ValuePairs
    * strings to avoid leaking type information to callers */
   gboolean cast_to_strings;
   gboolean explicit_cast_to_strings;
+
+  /* per NVHandle selection verdicts, filled lazily while formatting messages */
+  VPNameCache *name_cache;
+  GList *retired_name_caches;
+  GMutex name_cache_lock;
 };
 
 
@@ -267,6 +267,50 @@ Test(value_pairs, test_transformers)
   g_ptr_array_free(transformers, TRUE);
 }
 
+static void
+_assert_selected_keys(ValuePairs *vp, LogMessage *msg, const gchar *expected)
+{
+  GList *vp_keys_list = NULL;
+  gboolean test_key_found = FALSE;
+  gpointer args[] = { &vp_keys_list, &test_key_found };
+
+  LogTemplateEvalOptions options = {&template_options, LTZ_LOCAL, 11, NULL, LM_VT_STRING};
+  value_pairs_foreach(vp, vp_keys_foreach, msg, &options, args);
+  assert_keys_match_expected("none", vp_keys_list, expected);
+  g_list_foreach(vp_keys_list, (GFunc) g_free, NULL);
+  g_list_free(vp_keys_list);
+}
+
+Test(value_pairs, test_selection_is_cached_per_name_and_follows_new_names)
+{
+  ValuePairs *vp = value_pairs_new(configuration);
+  ValuePairsTransformSet *vpts = value_pairs_transform_set_new("*");
+  LogMessage *msg;
+
+  value_pairs_add_glob_pattern(vp, "t.*", TRUE);
+  value_pairs_add_glob_pattern(vp, "t.secret*", FALSE);
+  value_pairs_transform_set_add_func(vpts, value_pairs_new_transform_add_prefix("x_"));
+  value_pairs_add_transforms(vp, vpts);
+
+  msg = log_msg_new_empty();
+  log_msg_set_value_by_name(msg, "t.foo", "1", -1);
+  log_msg_set_value_by_name(msg, "t.secret1", "2", -1);
+  log_msg_set_value_by_name(msg, "u.foo", "3", -1);
+  _assert_selected_keys(vp, msg, "x_t.foo");
+  _assert_selected_keys(vp, msg, "x_t.foo");
+  log_msg_unref(msg);
+
+  /* names not seen before are evaluated as they show up */
+  msg = log_msg_new_empty();
+  log_msg_set_value_by_name(msg, "t.bar", "1", -1);
+  log_msg_set_value_by_name(msg, "t.foo", "1", -1);
+  log_msg_set_value_by_name(msg, "t.secret2", "2", -1);
+  _assert_selected_keys(vp, msg, "x_t.bar,x_t.foo");
+  log_msg_unref(msg);
+
+  value_pairs_unref(vp);
+}
+
 Test(value_pairs, test_transformer_shift_levels)
 {
   /* test the value-pair transformators */
@@ -129,6 +129,73 @@ Test(value_pairs_walker, prefix_dat)
   log_msg_unref(msg);
 };
 
+static gboolean
+_record_obj_start(const gchar *name,
+                  const gchar *prefix, gpointer *prefix_data,
+                  const gchar *prev, gpointer *prev_data,
+                  gpointer user_data)
+{
+  GString *events = (GString *) user_data;
+
+  g_string_append_printf(events, "%s{", prefix ? : "");
+  return FALSE;
+}
+
+static gboolean
+_record_obj_end(const gchar *name,
+                const gchar *prefix, gpointer *prefix_data,
+                const gchar *prev, gpointer *prev_data,
+                gpointer user_data)
+{
+  GString *events = (GString *) user_data;
+
+  g_string_append_c(events, '}');
+  return FALSE;
+}
+
+static gboolean
+_record_value(const gchar *name, const gchar *prefix,
+              LogMessageValueType type, const gchar *value, gsize value_len,
+              gpointer *prefix_data, gpointer user_data)
+{
+  GString *events = (GString *) user_data;
+
+  g_string_append_printf(events, "%s=%.*s,", name, (gint) value_len, value);
+  return FALSE;
+}
+
+Test(value_pairs_walker, containers_are_started_and_ended_around_values)
+{
+  ValuePairs *vp;
+  LogMessage *msg;
+  LogTemplate *template;
+  GString *events = g_string_new("");
+
+  log_template_options_init(&template_options, cfg);
+
+  vp = value_pairs_new(cfg);
+  value_pairs_add_glob_pattern(vp, "t.*", TRUE);
+
+  /* explicit pairs are added last, they override name-value pairs of the same name */
+  template = log_template_new(cfg, NULL);
+  log_template_compile(template, "override", NULL);
+  value_pairs_add_pair(vp, "t.b", template);
+  log_template_unref(template);
+
+  msg = log_msg_new_empty();
+  log_msg_set_value_by_name(msg, "t.a.x", "1", -1);
+  log_msg_set_value_by_name(msg, "t.a.y", "2", -1);
+  log_msg_set_value_by_name(msg, "t.b", "3", -1);
+  log_msg_set_value_by_name(msg, "t.c.z", "4", -1);
+
+  LogTemplateEvalOptions options = {&template_options, LTZ_LOCAL, 0, NULL, LM_VT_STRING};
+  value_pairs_walk(vp, _record_obj_start, _record_value, _record_obj_end, msg, &options, 0, events);
+  cr_assert_str_eq(events->str, "{t{t.c{z=4,}b=override,t.a{y=2,x=1,}}}");
+
+  g_string_free(events, TRUE);
+  value_pairs_unref(vp);
+  log_msg_unref(msg);
+}
 
 void
 setup(void)
@@ -31,6 +31,7 @@
 #include "cfg-parser.h"
 #include "string-list.h"
 #include "scratch-buffers.h"
+#include "str-utils.h"
 #include "cfg.h"
 
 #include <ctype.h>
@@ -45,6 +46,9 @@ typedef struct
 {
   gchar *name;
   LogTemplate *template;
+
+  /* name after applying the transforms, see vp_update_builtin_list_of_values() */
+  gchar *output_name;
 } VPPairConf;
 
 typedef struct
@@ -52,16 +56,19 @@ typedef struct
   /* we don't own any of the fields here, it is assumed that allocations are
    * managed by the caller */
 
-  GString *name;
+  const gchar *name;
   GString *value;
   LogMessageValueType type_hint;
+
+  /* insertion order, later values override earlier ones with the same name */
+  guint seq;
 } VPResultValue;
 
 typedef struct
 {
-  GTree *result_tree;
+  GCompareFunc compare_func;
 
-  /* array of VPResultValue instances */
+  /* array of VPResultValue instances, sorted by vp_results_sort() */
   GArray *values;
 } VPResults;
 
@@ -92,6 +99,31 @@ typedef struct
   gint id;
 } ValuePairSpec;
 
+/* a macro or name-value pair selected by the scopes/patterns, along with its transformed name */
+typedef struct
+{
+  const ValuePairSpec *spec;
+  gchar *output_name;
+} VPBuiltin;
+
+/* selection verdict of a single name-value pair, cached by NVHandle */
+typedef struct
+{
+  gboolean include;
+  gchar *output_name;
+} VPNameVerdict;
+
+struct _VPNameCache
+{
+  guint size;
+  VPNameVerdict *verdicts[];
+};
+
+#define VP_NAME_CACHE_INITIAL_SIZE 256
+
+/* shared by all excluded names, as they don't need an output name */
+static VPNameVerdict vp_name_excluded = { FALSE, NULL };
+
 static ValuePairSpec rfc3164[] =
 {
   /* there's one macro named DATE that'll be expanded specially */
@@ -169,6 +201,7 @@ vp_pair_conf_new(const gchar *key, LogTemplate *value)
 
   p->name = g_strdup(key);
   p->template = log_template_ref(value);
+  p->output_name = NULL;
   return p;
 }
 
@@ -177,64 +210,257 @@ vp_pair_conf_free(VPPairConf *vpc)
 {
   log_template_unref(vpc->template);
   g_free(vpc->name);
+  g_free(vpc->output_name);
   g_free(vpc);
 }
 
 static void
-vp_result_value_init(VPResultValue *rv, GString *name, LogMessageValueType type_hint, GString *value)
+vp_result_value_init(VPResultValue *rv, const gchar *name, LogMessageValueType type_hint, GString *value, guint seq)
 {
   rv->type_hint = type_hint;
   rv->name = name;
   rv->value = value;
+  rv->seq = seq;
 }
 
 static void
 vp_results_init(VPResults *results, GCompareFunc compare_func)
 {
   results->values = g_array_sized_new(FALSE, FALSE, sizeof(VPResultValue), 16);
-  results->result_tree = g_tree_new_full((GCompareDataFunc) compare_func, NULL,
-                                         NULL, NULL);
+  results->compare_func = compare_func;
 }
 
 static void
 vp_results_deinit(VPResults *results)
 {
-  g_tree_destroy(results->result_tree);
   g_array_free(results->values, TRUE);
 }
 
 static void
-vp_results_insert(VPResults *results, GString *name, LogMessageValueType type_hint, GString *value)
+vp_results_insert(VPResults *results, const gchar *name, LogMessageValueType type_hint, GString *value)
 {
   VPResultValue *rv;
   gint ndx = results->values->len;
 
   g_array_set_size(results->values, ndx + 1);
   rv = &g_array_index(results->values, VPResultValue, ndx);
-  vp_result_value_init(rv, name, type_hint, value);
-  /* GTree takes over ownership of name */
-  g_tree_insert(results->result_tree, name->str, GINT_TO_POINTER(ndx));
+  vp_result_value_init(rv, name, type_hint, value, ndx);
 }
 
-static GString *
-vp_transform_apply (ValuePairs *vp, const gchar *key)
+static gint
+vp_results_cmp(gconstpointer a, gconstpointer b, gpointer user_data)
 {
-  gint i;
-  GString *result = scratch_buffers_alloc();
+  const VPResultValue *rv_a = (const VPResultValue *) a;
+  const VPResultValue *rv_b = (const VPResultValue *) b;
+  GCompareFunc compare_func = (GCompareFunc) user_data;
+  gint r = compare_func(rv_a->name, rv_b->name);
 
-  g_string_assign(result, key);
+  if (r != 0)
+    return r;
+  return rv_a->seq < rv_b->seq ? -1 : (rv_a->seq > rv_b->seq);
+}
 
-  if (vp->transforms->len == 0)
-    return result;
+/*
+ * Sorts the collected values by name in a single pass and drops the
+ * duplicates, keeping the value added last, just like a tree keyed by name
+ * would.  This is cheaper than maintaining a balanced tree with a node
+ * allocation for each and every pair of each and every message.
+ */
+static void
+vp_results_sort(VPResults *results)
+{
+  GArray *values = results->values;
+  guint i, kept = 0;
 
-  for (i = 0; i < vp->transforms->len; i++)
+  if (values->len < 2)
+    return;
+
+  g_array_sort_with_data(values, vp_results_cmp, results->compare_func);
+
+  for (i = 0; i < values->len; i++)
+    {
+      VPResultValue *rv = &g_array_index(values, VPResultValue, i);
+
+      if (i + 1 < values->len &&
+          results->compare_func(rv->name, g_array_index(values, VPResultValue, i + 1).name) == 0)
+        continue;
+
+      if (kept != i)
+        g_array_index(values, VPResultValue, kept) = *rv;
+      kept++;
+    }
+  g_array_set_size(values, kept);
+}
+
+static gchar *
+vp_transform_name(ValuePairs *vp, const gchar *name)
+{
+  GString *result = g_string_new(name);
+
+  for (guint i = 0; i < vp->transforms->len; i++)
     {
       ValuePairsTransformSet *t = (ValuePairsTransformSet *) g_ptr_array_index(vp->transforms, i);
 
       value_pairs_transform_set_apply(t, result);
     }
 
-  return result;
+  return g_string_free(result, FALSE);
+}
+
+static VPBuiltin *
+vp_builtin_new(ValuePairs *vp, const ValuePairSpec *spec)
+{
+  VPBuiltin *self = g_new(VPBuiltin, 1);
+
+  self->spec = spec;
+  self->output_name = vp_transform_name(vp, spec->name);
+  return self;
+}
+
+static void
+vp_builtin_free(VPBuiltin *self)
+{
+  g_free(self->output_name);
+  g_free(self);
+}
+
+/*******************************************************************************
+ * Name-value pair selection cache
+ *
+ * Whether a name-value pair is selected (scopes and glob patterns) and the
+ * name it is emitted under (transforms) only depend on its name, so these
+ * are evaluated once per NVHandle and cached in an array indexed by the
+ * handle.  The array is filled lazily, as new dynamic names show up.
+ *
+ * Lookups are lock free: verdicts are never changed once published, and
+ * the array is replaced by a larger copy when it has to grow.  Replaced
+ * arrays are kept until the ValuePairs instance is freed, as concurrent
+ * lookups might still be using them.
+ *******************************************************************************/
+
+static gboolean
+vp_is_name_selected(ValuePairs *vp, NVHandle handle, const gchar *name)
+{
+  guint j;
+  gboolean inc;
+
+  inc = (name[0] == '.' && (vp->scopes & VPS_DOT_NV_PAIRS)) ||
+        (name[0] != '.' && (vp->scopes & VPS_NV_PAIRS)) ||
+        (log_msg_is_handle_sdata(handle) && (vp->scopes & (VPS_SDATA + VPS_RFC5424)));
+
+  for (j = 0; j < vp->patterns->len; j++)
+    {
+      VPPatternSpec *vps = (VPPatternSpec *) g_ptr_array_index(vp->patterns, j);
+      if (vp_pattern_spec_eval(vps, name))
+        inc = vps->include;
+    }
+
+  return inc;
+}
+
+static VPNameVerdict *
+vp_name_verdict_new(ValuePairs *vp, NVHandle handle, const gchar *name)
+{
+  if (!vp_is_name_selected(vp, handle, name))
+    return &vp_name_excluded;
+
+  VPNameVerdict *self = g_new(VPNameVerdict, 1);
+
+  self->include = TRUE;
+  self->output_name = vp_transform_name(vp, name);
+  return self;
+}
+
+static void
+vp_name_verdict_free(VPNameVerdict *self)
+{
+  if (self == &vp_name_excluded)
+    return;
+
+  g_free(self->output_name);
+  g_free(self);
+}
+
+static VPNameCache *
+vp_name_cache_grow(ValuePairs *vp, NVHandle handle)
+{
+  VPNameCache *old_cache = vp->name_cache;
+  guint size = old_cache ? old_cache->size : VP_NAME_CACHE_INITIAL_SIZE;
+  VPNameCache *cache;
+
+  while (size <= handle)
+    size *= 2;
+
+  cache = g_malloc0(sizeof(VPNameCache) + size * sizeof(cache->verdicts[0]));
+  cache->size = size;
+
+  if (old_cache)
+    {
+      memcpy(cache->verdicts, old_cache->verdicts, old_cache->size * sizeof(cache->verdicts[0]));
+      vp->retired_name_caches = g_list_prepend(vp->retired_name_caches, old_cache);
+    }
+  g_atomic_pointer_set(&vp->name_cache, cache);
+  return cache;
+}
+
+static const VPNameVerdict *
+vp_name_cache_insert(ValuePairs *vp, NVHandle handle, const gchar *name)
+{
+  VPNameVerdict *verdict = vp_name_verdict_new(vp, handle, name);
+  VPNameCache *cache;
+
+  g_mutex_lock(&vp->name_cache_lock);
+  cache = vp->name_cache;
+  if (!cache || handle >= cache->size)
+    cache = vp_name_cache_grow(vp, handle);
+
+  if (cache->verdicts[handle])
+    {
+      /* another thread was faster */
+      vp_name_verdict_free(verdict);
+      verdict = cache->verdicts[handle];
+    }
+  else
+    {
+      g_atomic_pointer_set(&cache->verdicts[handle], verdict);
+    }
+  g_mutex_unlock(&vp->name_cache_lock);
+  return verdict;
+}
+
+static inline const VPNameVerdict *
+vp_name_cache_lookup(ValuePairs *vp, NVHandle handle, const gchar *name)
+{
+  VPNameCache *cache = (VPNameCache *) g_atomic_pointer_get(&vp->name_cache);
+
+  if (G_LIKELY(cache && handle < cache->size))
+    {
+      VPNameVerdict *verdict = (VPNameVerdict *) g_atomic_pointer_get(&cache->verdicts[handle]);
+
+      if (G_LIKELY(verdict))
+        return verdict;
+    }
+  return vp_name_cache_insert(vp, handle, name);
+}
+
+/* only called while the configuration is being built or freed, no lookups can run concurrently */
+static void
+vp_name_cache_clear(ValuePairs *vp)
+{
+  VPNameCache *cache = vp->name_cache;
+
+  if (cache)
+    {
+      for (guint i = 0; i < cache->size; i++)
+        {
+          if (cache->verdicts[i])
+            vp_name_verdict_free(cache->verdicts[i]);
+        }
+      g_free(cache);
+      vp->name_cache = NULL;
+    }
+  g_list_free_full(vp->retired_name_caches, g_free);
+  vp->retired_name_caches = NULL;
 }
 
 /* runs over the name-value pairs requested by the user (e.g. with value_pairs_add_pair) */
@@ -257,7 +483,7 @@ vp_pairs_foreach(gpointer data, gpointer user_data)
     return;
   if (vp->cast_to_strings && vpc->template->explicit_type_hint == LM_VT_NONE)
     type = LM_VT_STRING;
-  vp_results_insert(results, vp_transform_apply(vp, vpc->name), type, sb);
+  vp_results_insert(results, vpc->output_name, type, sb);
 }
 
 /* runs over the LogMessage nv-pairs, and inserts them unless excluded */
@@ -268,8 +494,7 @@ vp_msg_nvpairs_foreach(NVHandle handle, const gchar *name,
 {
   ValuePairs *vp = ((gpointer *)user_data)[0];
   VPResults *results = ((gpointer *)user_data)[5];
-  guint j;
-  gboolean inc;
+  const VPNameVerdict *verdict;
   GString *sb;
 
   if (vp->omit_empty_values && value_len == 0)
@@ -278,18 +503,8 @@ vp_msg_nvpairs_foreach(NVHandle handle, const gchar *name,
   if ((type == LM_VT_BYTES || type == LM_VT_PROTOBUF) && !vp->include_bytes)
     return FALSE;
 
-  inc = (name[0] == '.' && (vp->scopes & VPS_DOT_NV_PAIRS)) ||
-        (name[0] != '.' && (vp->scopes & VPS_NV_PAIRS)) ||
-        (log_msg_is_handle_sdata(handle) && (vp->scopes & (VPS_SDATA + VPS_RFC5424)));
-
-  for (j = 0; j < vp->patterns->len; j++)
-    {
-      VPPatternSpec *vps = (VPPatternSpec *) g_ptr_array_index(vp->patterns, j);
-      if (vp_pattern_spec_eval(vps, name))
-        inc = vps->include;
-    }
-
-  if (!inc)
+  verdict = vp_name_cache_lookup(vp, handle, name);
+  if (!verdict->include)
     return FALSE;
 
   sb = scratch_buffers_alloc();
@@ -299,7 +514,7 @@ vp_msg_nvpairs_foreach(NVHandle handle, const gchar *name,
   if (vp->cast_to_strings)
     type = LM_VT_STRING;
 
-  vp_results_insert(results, vp_transform_apply(vp, name), type, sb);
+  vp_results_insert(results, verdict->output_name, type, sb);
 
   return FALSE;
 }
@@ -331,7 +546,7 @@ vp_merge_other_set(ValuePairs *vp, ValuePairSpec *set, gboolean exclude)
       if (!vp_find_in_set(vp, set[i].name, exclude))
         continue;
 
-      g_ptr_array_add(vp->builtins, &set[i]);
+      g_ptr_array_add(vp->builtins, vp_builtin_new(vp, &set[i]));
     }
 }
 
@@ -350,10 +565,24 @@ vp_merge_set(ValuePairs *vp, ValuePairSpec *set)
 }
 
 
+/*
+ * Called whenever the configuration of ValuePairs changes: everything that
+ * only depends on the configuration (the selected macros, the transformed
+ * names) is computed here, instead of for each message.
+ */
 static void
 vp_update_builtin_list_of_values(ValuePairs *vp)
 {
   g_ptr_array_set_size(vp->builtins, 0);
+  vp_name_cache_clear(vp);
+
+  for (guint i = 0; i < vp->vpairs->len; i++)
+    {
+      VPPairConf *vpc = (VPPairConf *) g_ptr_array_index(vp->vpairs, i);
+
+      g_free(vpc->output_name);
+      vpc->output_name = vp_transform_name(vp, vpc->name);
+    }
 
   if (vp->patterns->len > 0)
     vp_merge_macros(vp);
@@ -379,7 +608,8 @@ vp_merge_builtins(ValuePairs *vp, VPResults *results, LogMessage *msg, LogTempla
 
   for (i = 0; i < vp->builtins->len; i++)
     {
-      ValuePairSpec *spec = (ValuePairSpec *) g_ptr_array_index(vp->builtins, i);
+      VPBuiltin *builtin = (VPBuiltin *) g_ptr_array_index(vp->builtins, i);
+      const ValuePairSpec *spec = builtin->spec;
       LogMessageValueType type;
 
       sb = scratch_buffers_alloc();
@@ -410,34 +640,29 @@ vp_merge_builtins(ValuePairs *vp, VPResults *results, LogMessage *msg, LogTempla
       if (vp->cast_to_strings)
         type = LM_VT_STRING;
 
-      vp_results_insert(results, vp_transform_apply(vp, spec->name), type, sb);
+      vp_results_insert(results, builtin->output_name, type, sb);
     }
 }
 
 static gboolean
-vp_foreach_helper(const gchar *name, gpointer ndx_as_pointer, gpointer data)
+vp_results_foreach(VPResults *results, VPForeachFunc func, gpointer user_data)
 {
-  VPResults *results = ((gpointer *)data)[0];
-  gint ndx = GPOINTER_TO_INT(ndx_as_pointer);
-  VPResultValue *rv = &g_array_index(results->values, VPResultValue, ndx);
-  VPForeachFunc func = ((gpointer *)data)[1];
-  gpointer user_data = ((gpointer *)data)[2];
-  gboolean *r = ((gpointer *)data)[3];
-
-  gboolean success = !func(name, rv->type_hint,
-                           rv->value->str,
-                           rv->value->len, user_data);
-
-  *r &= success;
-
-  if (!success)
+  for (guint i = 0; i < results->values->len; i++)
     {
-      msg_trace("value_pairs_foreach: callback indicates failure",
-                evt_tag_str("name", name),
-                evt_tag_mem("value", rv->value->str, rv->value->len),
-                evt_tag_int("type", rv->type_hint));
+      VPResultValue *rv = &g_array_index(results->values, VPResultValue, i);
+
+      if (func(rv->name, rv->type_hint,
+               rv->value->str,
+               rv->value->len, user_data))
+        {
+          msg_trace("value_pairs_foreach: callback indicates failure",
+                    evt_tag_str("name", rv->name),
+                    evt_tag_mem("value", rv->value->str, rv->value->len),
+                    evt_tag_int("type", rv->type_hint));
+          return FALSE;
+        }
     }
-  return !*r;
+  return TRUE;
 }
 
 
@@ -448,9 +673,8 @@ value_pairs_foreach_sorted (ValuePairs *vp, VPForeachFunc func,
                             gpointer user_data)
 {
   gpointer args[] = { vp, func, msg, options, user_data, NULL};
-  gboolean result = TRUE;
+  gboolean result;
   VPResults results;
-  gpointer helper_args[] = { &results, func, user_data, &result };
   ScratchBuffersMarker mark;
 
   scratch_buffers_mark(&mark);
@@ -470,7 +694,8 @@ value_pairs_foreach_sorted (ValuePairs *vp, VPForeachFunc func,
   g_ptr_array_foreach(vp->vpairs, (GFunc)vp_pairs_foreach, args);
 
   /* Aaand we run it through the callback! */
-  g_tree_foreach(results.result_tree, (GTraverseFunc)vp_foreach_helper, helper_args);
+  vp_results_sort(&results);
+  result = vp_results_foreach(&results, func, user_data);
   vp_results_deinit(&results);
   scratch_buffers_reclaim_marked(mark);
 
@@ -489,20 +714,41 @@ value_pairs_foreach(ValuePairs *vp, VPForeachFunc func,
 /*******************************************************************************
  * vp_stack (represented by vp_stack_t)
  *
- * A not very generic stack implementation used by vp_walker.
+ * A not very generic stack implementation used by vp_walker.  Popped
+ * elements are not freed but kept for reuse by the next push at the same
+ * depth, so once the walk has reached its maximum depth, containers are
+ * started and ended without allocating memory.
  *******************************************************************************/
 
 #define VP_STACK_INITIAL_SIZE 16
 
+typedef struct
+{
+  GString *key;
+  GString *prefix;
+
+  gpointer data;
+} vp_walk_stack_data_t;
+
 typedef struct
 {
   GPtrArray *elems;
+  guint height;
 } vp_stack_t;
 
+static void
+vp_walker_free_stack_data(vp_walk_stack_data_t *t)
+{
+  g_string_free(t->key, TRUE);
+  g_string_free(t->prefix, TRUE);
+  g_free(t);
+}
+
 static void
 vp_stack_init(vp_stack_t *stack)
 {
-  stack->elems = g_ptr_array_sized_new(VP_STACK_INITIAL_SIZE);
+  stack->elems = g_ptr_array_new_full(VP_STACK_INITIAL_SIZE, (GDestroyNotify) vp_walker_free_stack_data);
+  stack->height = 0;
 }
 
 static void
@@ -511,36 +757,44 @@ vp_stack_destroy(vp_stack_t *stack)
   g_ptr_array_free(stack->elems, TRUE);
 }
 
-static void
-vp_stack_push(vp_stack_t *stack, gpointer data)
+static vp_walk_stack_data_t *
+vp_stack_push(vp_stack_t *stack)
 {
-  g_ptr_array_add(stack->elems, data);
+  vp_walk_stack_data_t *t;
+
+  if (stack->height == stack->elems->len)
+    {
+      t = g_new0(vp_walk_stack_data_t, 1);
+      t->key = g_string_sized_new(32);
+      t->prefix = g_string_sized_new(64);
+      g_ptr_array_add(stack->elems, t);
+    }
+  t = (vp_walk_stack_data_t *) g_ptr_array_index(stack->elems, stack->height);
+  stack->height++;
+  t->data = NULL;
+  return t;
 }
 
-static gpointer
+static vp_walk_stack_data_t *
 vp_stack_peek(vp_stack_t *stack)
 {
-  if (stack->elems->len == 0)
+  if (stack->height == 0)
     return NULL;
 
-  return g_ptr_array_index(stack->elems, stack->elems->len - 1);
+  return (vp_walk_stack_data_t *) g_ptr_array_index(stack->elems, stack->height - 1);
 }
 
-static gpointer
+static void
 vp_stack_pop(vp_stack_t *stack)
 {
-  gpointer data = NULL;
-
-  data = vp_stack_peek(stack);
-  if (data)
-    g_ptr_array_remove_index(stack->elems, stack->elems->len - 1);
-  return data;
+  g_assert(stack->height > 0);
+  stack->height--;
 }
 
 static guint
 vp_stack_height(vp_stack_t *stack)
 {
-  return stack->elems->len;
+  return stack->height;
 }
 
 /*******************************************************************************
@@ -552,12 +806,9 @@ vp_stack_height(vp_stack_t *stack)
 
 typedef struct
 {
-  gchar *key;
-  gchar *prefix;
-  gint prefix_len;
-
-  gpointer data;
-} vp_walk_stack_data_t;
+  const gchar *start;
+  gsize len;
+} vp_walk_token_t;
 
 typedef struct
 {
@@ -569,73 +820,36 @@ typedef struct
   vp_stack_t stack;
   gchar key_delimiter;
 
-  /* tokenizer state */
-  GPtrArray *tokens;
+  /* tokenizer state, array of vp_walk_token_t pointing into the name being walked */
+  GArray *tokens;
+  GString *key;
 } vp_walk_state_t;
 
-static vp_walk_stack_data_t *
-vp_walker_stack_push (vp_stack_t *stack,
-                      gchar *key, gchar *prefix)
-{
-  vp_walk_stack_data_t *nt = g_new(vp_walk_stack_data_t, 1);
-
-  nt->key = key;
-  nt->prefix = prefix;
-  nt->prefix_len = strlen(nt->prefix);
-  nt->data = NULL;
-
-  vp_stack_push(stack, nt);
-  return nt;
-}
-
-static vp_walk_stack_data_t *
-vp_walker_stack_peek(vp_stack_t *stack)
-{
-  return (vp_walk_stack_data_t *) vp_stack_peek(stack);
-}
-
-static vp_walk_stack_data_t *
-vp_walker_stack_pop(vp_stack_t *stack)
-{
-  return (vp_walk_stack_data_t *) vp_stack_pop(stack);
-}
-
-static void
-vp_walker_free_stack_data(vp_walk_stack_data_t *t)
-{
-  g_free(t->key);
-  g_free(t->prefix);
-  g_free(t);
-}
-
 static void
 vp_walker_stack_unwind_containers_until(vp_walk_state_t *state,
                                         const gchar *name)
 {
   vp_walk_stack_data_t *t;
 
-  while ((t = vp_walker_stack_pop(&state->stack)) != NULL)
+  while ((t = vp_stack_peek(&state->stack)) != NULL)
     {
       vp_walk_stack_data_t *p;
 
-      if (name && strncmp(name, t->prefix, t->prefix_len) == 0)
-        {
-          /* This one matched, put it back, PUT IT BACK! */
-          vp_stack_push(&state->stack, t);
-          break;
-        }
+      /* This one matches, keep it */
+      if (name && strncmp(name, t->prefix->str, t->prefix->len) == 0)
+        break;
 
-      p = vp_walker_stack_peek(&state->stack);
+      vp_stack_pop(&state->stack);
+      p = vp_stack_peek(&state->stack);
 
       if (p)
-        state->obj_end(t->key, t->prefix, &t->data,
-                       p->prefix, &p->data,
+        state->obj_end(t->key->str, t->prefix->str, &t->data,
+                       p->prefix->str, &p->data,
                        state->user_data);
       else
-        state->obj_end(t->key, t->prefix, &t->data,
+        state->obj_end(t->key->str, t->prefix->str, &t->data,
                        NULL, NULL,
                        state->user_data);
-      vp_walker_free_stack_data(t);
     }
 }
 
@@ -664,7 +878,9 @@ vp_walker_skip_sdata_enterprise_id(const gchar *name)
 static void
 _extract_token(vp_walk_state_t *state, const gchar *token_start, gsize token_len)
 {
-  g_ptr_array_add(state->tokens, g_strndup(token_start, token_len));
+  vp_walk_token_t token = { token_start, token_len };
+
+  g_array_append_val(state->tokens, token);
 }
 
 static void
@@ -757,81 +973,67 @@ _extract_tokens_with_custom_delimiter(vp_walk_state_t *state, const gchar *name)
     _extract_token(state, token_start, token_end - token_start);
 }
 
-static GPtrArray *
+static vp_walk_token_t *
 vp_walker_split_name_to_tokens(vp_walk_state_t *state, const gchar *name)
 {
-  state->tokens = g_ptr_array_sized_new(VP_STACK_INITIAL_SIZE);
+  g_array_set_size(state->tokens, 0);
 
   if (state->key_delimiter == '.')
     _extract_tokens_with_default_delimiter(state, name);
   else
     _extract_tokens_with_custom_delimiter(state, name);
 
-  if (state->tokens->len == 0)
-    {
-      g_ptr_array_free(state->tokens, TRUE);
-      return NULL;
-    }
-
-  return state->tokens;
+  return &g_array_index(state->tokens, vp_walk_token_t, 0);
 }
 
-static gchar *
-vp_walker_name_combine_prefix(vp_walk_state_t *state, GPtrArray *tokens, gint until)
+static void
+vp_walker_name_combine_prefix(vp_walk_state_t *state, GString *prefix, vp_walk_token_t *tokens, gint until)
 {
-  GString *s = scratch_buffers_alloc();
-  gchar *str;
   gint i;
 
+  g_string_truncate(prefix, 0);
   for (i = 0; i < until; i++)
     {
-      g_string_append(s, g_ptr_array_index(tokens, i));
-      g_string_append_c(s, state->key_delimiter);
+      g_string_append_len(prefix, tokens[i].start, tokens[i].len);
+      g_string_append_c(prefix, state->key_delimiter);
     }
-  g_string_append(s, g_ptr_array_index(tokens, until));
-
-  str = g_strdup(s->str);
-  return str;
+  g_string_append_len(prefix, tokens[until].start, tokens[until].len);
 }
 
-static gchar *
+static const gchar *
 vp_walker_start_containers_for_name(vp_walk_state_t *state,
                                     const gchar *name)
 {
-  GPtrArray *tokens;
-  gchar *key = NULL;
+  vp_walk_token_t *tokens;
   guint i, start;
 
   tokens = vp_walker_split_name_to_tokens(state, name);
+  if (state->tokens->len == 0)
+    return name;
 
   start = vp_stack_height(&state->stack);
-  for (i = start; i < tokens->len - 1; i++)
+  for (i = start; i < state->tokens->len - 1; i++)
     {
       vp_walk_stack_data_t *p, *nt;
 
-      p = vp_walker_stack_peek(&state->stack);
-      nt = vp_walker_stack_push(&state->stack,
-                                g_strdup(g_ptr_array_index(tokens, i)),
-                                vp_walker_name_combine_prefix(state, tokens, i));
+      p = vp_stack_peek(&state->stack);
+      nt = vp_stack_push(&state->stack);
+      g_string_assign_len(nt->key, tokens[i].start, tokens[i].len);
+      vp_walker_name_combine_prefix(state, nt->prefix, tokens, i);
 
       if (p)
-        state->obj_start(nt->key, nt->prefix, &nt->data,
-                         p->prefix, &p->data,
+        state->obj_start(nt->key->str, nt->prefix->str, &nt->data,
+                         p->prefix->str, &p->data,
                          state->user_data);
       else
-        state->obj_start(nt->key, nt->prefix, &nt->data,
+        state->obj_start(nt->key->str, nt->prefix->str, &nt->data,
                          NULL, NULL, state->user_data);
     }
 
-  /* The last token is the key (well, second to last, last being
-     NULL), so treat that normally. */
-  key = g_ptr_array_index(tokens, tokens->len - 1);
-  g_ptr_array_index(tokens, tokens->len - 1) = NULL;
-
-  g_ptr_array_foreach(tokens, (GFunc)g_free, NULL);
-  g_ptr_array_free(tokens, TRUE);
-
-  return key;
+  /* The last token is the key, so treat that normally. */
+  vp_walk_token_t *last = &tokens[state->tokens->len - 1];
+  g_string_assign_len(state->key, last->start, last->len);
+  return state->key->str;
 }
 
 static gboolean
@@ -840,27 +1042,22 @@ value_pairs_walker(const gchar *name, LogMessageValueType type, const gchar *val
 {
   vp_walk_state_t *state = (vp_walk_state_t *)user_data;
   vp_walk_stack_data_t *data;
-  gchar *key;
-  gboolean result;
+  const gchar *key;
 
   vp_walker_stack_unwind_containers_until(state, name);
   key = vp_walker_start_containers_for_name(state, name);
-  data = vp_walker_stack_peek(&state->stack);
+  data = vp_stack_peek(&state->stack);
 
   if (data != NULL)
-    result = state->process_value(key, data->prefix,
-                                  type, value, value_len,
-                                  &data->data,
-                                  state->user_data);
+    return state->process_value(key, data->prefix->str,
+                                type, value, value_len,
+                                &data->data,
+                                state->user_data);
   else
-    result = state->process_value(key, NULL,
-                                  type, value, value_len,
-                                  NULL,
-                                  state->user_data);
-
-  g_free(key);
-
-  return result;
+    return state->process_value(key, NULL,
+                                type, value, value_len,
+                                NULL,
+                                state->user_data);
 }
 
 static gint
@@ -889,6 +1086,8 @@ value_pairs_walk(ValuePairs *vp,
   state.obj_end = obj_end_func;
   state.process_value = process_value_func;
   state.key_delimiter = key_delimiter ? : '.';
+  state.tokens = g_array_sized_new(FALSE, FALSE, sizeof(vp_walk_token_t), VP_STACK_INITIAL_SIZE);
+  state.key = scratch_buffers_alloc();
   vp_stack_init(&state.stack);
 
   state.obj_start(NULL, NULL, NULL, NULL, NULL, user_data);
@@ -898,6 +1097,7 @@ value_pairs_walk(ValuePairs *vp,
   vp_walker_stack_unwind_all_containers(&state);
   state.obj_end(NULL, NULL, NULL, NULL, NULL, user_data);
   vp_stack_destroy(&state.stack);
+  g_array_free(state.tokens, TRUE);
 
   return result;
 }
@@ -991,10 +1191,11 @@ value_pairs_new(GlobalConfig *cfg)
 
   vp = g_new0(ValuePairs, 1);
   g_atomic_counter_set(&vp->ref_cnt, 1);
-  vp->builtins = g_ptr_array_new();
+  vp->builtins = g_ptr_array_new_with_free_func((GDestroyNotify) vp_builtin_free);
   vp->vpairs = g_ptr_array_new();
   vp->patterns = g_ptr_array_new();
   vp->transforms = g_ptr_array_new();
+  g_mutex_init(&vp->name_cache_lock);
   vp->cfg = cfg;
 
   if (cfg_is_config_version_older(cfg, VERSION_VALUE_4_0))
@@ -1045,6 +1246,8 @@ value_pairs_free (ValuePairs *vp)
     }
   g_ptr_array_free(vp->transforms, TRUE);
   g_ptr_array_free(vp->builtins, TRUE);
+  vp_name_cache_clear(vp);
+  g_mutex_clear(&vp->name_cache_lock);
   g_free(vp);
 }
 
@@ -283,6 +283,7 @@ file_opener_options_defaults(FileOpenerOptions *options)
   file_perm_options_defaults(&options->file_perm_options);
   options->create_dirs = -1;
   options->needs_privileges = FALSE;
+  options->io_uring = FALSE;
 }
 
 void
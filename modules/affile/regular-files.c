@@ -22,6 +22,7 @@
  */
 #include "file-specializations.h"
 #include "transport/transport-file.h"
+#include "transport/transport-io-uring.h"
 #include "logproto-file-writer.h"
 #include "messages.h"
 #include "ack-tracker/ack_tracker_factory.h"
@@ -49,9 +50,34 @@ _prepare_open(FileOpener *self, const gchar *name)
   return TRUE;
 }
 
+static LogTransport *
+_construct_io_uring_src_transport(gint fd)
+{
+  struct stat st;
+
+  /* reads are issued at explicit offsets, which only works for seekable files */
+  if (fstat(fd, &st) < 0 || !S_ISREG(st.st_mode))
+    return NULL;
+
+  LogTransport *transport = log_transport_io_uring_file_new(fd);
+  if (!transport)
+    {
+      msg_warning_once("WARNING: io-uring() is not supported by this syslog-ng build or by the running kernel, "
+                       "falling back to read()");
+    }
+  return transport;
+}
+
 static LogTransport *
 _construct_src_transport(FileOpener *self, gint fd)
 {
+  if (self->options->io_uring)
+    {
+      LogTransport *transport = _construct_io_uring_src_transport(fd);
+      if (transport)
+        return transport;
+    }
+
   LogTransport *transport = log_transport_file_new(fd);
 
   transport->read = log_transport_file_read_and_ignore_eof_method;
@@ -92,6 +92,8 @@ static CfgLexerKeyword afsocket_keywords[] =
   { "local_creds",        KW_SO_PASSCRED },   /* BSD specific alias */
   { "spoof_source",       KW_SPOOF_SOURCE },
   { "spoof_source_max_msglen", KW_SPOOF_SOURCE_MAX_MSGLEN },
+  { "udp_recv_batch_size", KW_UDP_RECV_BATCH_SIZE },
+  { "io_uring",           KW_IO_URING },
   { "transport",          KW_TRANSPORT },
   { "ip_protocol",        KW_IP_PROTOCOL },
   { "max_connections",    KW_MAX_CONNECTIONS },
@@ -30,6 +30,7 @@
 #include "stats/stats-cluster-key-builder.h"
 #include "mainloop.h"
 #include "poll-fd-events.h"
+#include "transport/transport-io-uring.h"
 #include "timeutils/misc.h"
 #include "afsocket-signals.h"
 
@@ -174,9 +175,14 @@ afsocket_sc_init(LogPipe *s)
           return FALSE;
         }
 
+      /* io_uring based transports signal their completions on their own fd */
+      PollEvents *poll_events = log_transport_io_uring_construct_poll_events(transport);
+      if (!poll_events)
+        poll_events = poll_fd_events_new(self->sock);
+
       self->reader = log_reader_new(s->cfg);
       log_pipe_set_options(&self->reader->super.super, &self->super.options);
-      log_reader_open(self->reader, proto, poll_fd_events_new(self->sock));
+      log_reader_open(self->reader, proto, poll_events);
       log_reader_set_peer_addr(self->reader, self->peer_addr);
       log_reader_set_local_addr(self->reader, self->local_addr);
     }
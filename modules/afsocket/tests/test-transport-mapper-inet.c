@@ -265,6 +265,20 @@ Test(transport_mapper_inet, test_network_transport_foo_apply_transport_sets_defa
   assert_transport_mapper_transport_name(transport_mapper, "rfc3164+foo");
 }
 
+Test(transport_mapper_inet, test_network_transport_udp_apply_accepts_udp_recv_batch_size)
+{
+  transport_mapper = transport_mapper_network_new();
+  transport_mapper_inet_set_udp_recv_batch_size(transport_mapper, 32);
+  assert_transport_mapper_apply(transport_mapper, "udp");
+}
+
+Test(transport_mapper_inet, test_network_transport_tcp_apply_fails_with_udp_recv_batch_size)
+{
+  transport_mapper = transport_mapper_network_new();
+  transport_mapper_inet_set_udp_recv_batch_size(transport_mapper, 32);
+  assert_transport_mapper_apply_fails(transport_mapper, "tcp");
+}
+
 Test(transport_mapper_inet, test_syslog_transport_udp_apply_transport_sets_defaults)
 {
   transport_mapper = transport_mapper_syslog_new();
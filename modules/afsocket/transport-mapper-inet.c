@@ -30,6 +30,8 @@
 #include "transport/transport-factory-tls.h"
 #include "transport/transport-factory-socket.h"
 #include "transport/transport-udp-socket.h"
+#include "transport/transport-socket.h"
+#include "transport/transport-io-uring.h"
 #include "secret-storage/secret-storage.h"
 
 #include <sys/types.h>
@@ -74,6 +76,18 @@ transport_mapper_inet_validate_tls_options(TransportMapperInet *self)
   return TRUE;
 }
 
+static gboolean
+transport_mapper_inet_validate_udp_recv_batch_size(TransportMapperInet *self)
+{
+  if (self->udp_recv_batch_size > 1 && self->super.sock_type != SOCK_DGRAM)
+    {
+      msg_error("udp-recv-batch-size() specified for a transport that is not datagram based",
+                evt_tag_str("transport", self->super.transport));
+      return FALSE;
+    }
+  return TRUE;
+}
+
 static gboolean
 transport_mapper_inet_apply_transport_method(TransportMapper *s, GlobalConfig *cfg)
 {
@@ -127,16 +141,46 @@ _construct_multitransport_with_plain_and_tls_factories(TransportMapperInet *self
   return transport;
 }
 
+static LogTransport *
+_construct_udp_transport(TransportMapperInet *self, gint fd)
+{
+  LogTransport *transport = log_transport_udp_socket_new(fd);
+
+  if (!log_transport_dgram_socket_set_recv_batch_size((LogTransportSocket *) transport, self->udp_recv_batch_size))
+    {
+      msg_warning_once("WARNING: udp-recv-batch-size() is not supported on this platform, "
+                       "datagrams are received one-by-one",
+                       evt_tag_int("udp_recv_batch_size", self->udp_recv_batch_size));
+    }
+  return transport;
+}
+
+static void
+_enable_io_uring(TransportMapperInet *self, LogTransport *transport)
+{
+  if (!log_transport_socket_enable_io_uring((LogTransportSocket *) transport))
+    {
+      msg_warning_once("WARNING: io-uring() is not supported by this syslog-ng build or by the running kernel, "
+                       "falling back to readiness based I/O");
+    }
+}
+
 static LogTransport *
 _construct_plain_tcp_transport(TransportMapperInet *self, gint fd)
 {
+  LogTransport *transport;
+
   if (self->super.create_multitransport)
     return _construct_multitransport_with_plain_tcp_factory(self, fd);
 
   if (self->super.sock_type == SOCK_DGRAM)
-    return log_transport_udp_socket_new(fd);
+    transport = _construct_udp_transport(self, fd);
   else
-    return log_transport_stream_socket_new(fd);
+    transport = log_transport_stream_socket_new(fd);
+
+  if (self->io_uring)
+    _enable_io_uring(self, transport);
+  return transport;
 }
 
 static LogTransport *
@@ -293,6 +337,7 @@ transport_mapper_inet_init_instance(TransportMapperInet *self, const gchar *tran
   self->super.async_init = transport_mapper_inet_async_init;
   self->super.free_fn = transport_mapper_inet_free_method;
   self->super.address_family = AF_INET;
+  self->udp_recv_batch_size = 1;
 }
 
 
@@ -429,6 +474,9 @@ transport_mapper_network_apply_transport(TransportMapper *s, GlobalConfig *cfg)
   if (!transport_mapper_inet_validate_tls_options(self))
     return FALSE;
 
+  if (!transport_mapper_inet_validate_udp_recv_batch_size(self))
+    return FALSE;
+
   return TRUE;
 }
 
@@ -508,6 +556,9 @@ transport_mapper_syslog_apply_transport(TransportMapper *s, GlobalConfig *cfg)
   if (!transport_mapper_inet_validate_tls_options(self))
     return FALSE;
 
+  if (!transport_mapper_inet_validate_udp_recv_batch_size(self))
+    return FALSE;
+
   return TRUE;
 }
 
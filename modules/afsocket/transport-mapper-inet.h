@@ -39,8 +39,13 @@ typedef struct _TransportMapperInet
   TLSContext *tls_context;
   TLSVerifier *tls_verifier;
   gpointer secret_store_cb_data;
+  gint udp_recv_batch_size;
+  gboolean io_uring;
 } TransportMapperInet;
 
+/* the kernel limits the number of datagrams returned by a single recvmmsg() call */
+#define TRANSPORT_MAPPER_INET_MAX_UDP_RECV_BATCH_SIZE 1024
+
 static inline void
 transport_mapper_inet_set_allow_compress(TransportMapper *s, gboolean value)
 {
@@ -51,6 +56,22 @@ transport_mapper_inet_set_allow_compress(TransportMapper *s, gboolean value)
     self->flags &= ~TMI_ALLOW_COMPRESS;
 }
 
+static inline void
+transport_mapper_inet_set_udp_recv_batch_size(TransportMapper *s, gint batch_size)
+{
+  TransportMapperInet *self = (TransportMapperInet *) s;
+
+  self->udp_recv_batch_size = batch_size;
+}
+
+static inline void
+transport_mapper_inet_set_io_uring(TransportMapper *s, gboolean value)
+{
+  TransportMapperInet *self = (TransportMapperInet *) s;
+
+  self->io_uring = value;
+}
+
 static inline gint
 transport_mapper_inet_get_server_port(const TransportMapper *self)
 {
@@ -0,0 +1,185 @@
+/*
+ * Copyright (c) 2024 Balabit
+ *
+ * This program is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License version 2 as published
+ * by the Free Software Foundation, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+ *
+ * As an additional exemption you are allowed to compile & link against the
+ * OpenSSL libraries as published by the OpenSSL project. See the file
+ * COPYING for details.
+ *
+ */
+
+#include "diskq-compression.h"
+
+#include <string.h>
+
+#ifdef SYSLOG_NG_HAVE_ZLIB
+#include <zlib.h>
+#endif
+
+#ifdef SYSLOG_NG_HAVE_ZSTD
+#include <zstd.h>
+#endif
+
+/* favour speed, the queue is on the hot path of the destination */
+#define ZLIB_COMPRESSION_LEVEL 1
+#define ZSTD_COMPRESSION_LEVEL 1
+
+static const gchar *compression_names[] =
+{
+  [DISKQ_COMPRESSION_NONE] = "none",
+  [DISKQ_COMPRESSION_ZLIB] = "zlib",
+  [DISKQ_COMPRESSION_ZSTD] = "zstd",
+};
+
+gboolean
+diskq_compression_lookup(const gchar *name, DiskQueueCompression *compression)
+{
+  for (gint i = 0; i < G_N_ELEMENTS(compression_names); i++)
+    {
+      if (strcmp(compression_names[i], name) == 0)
+        {
+          *compression = i;
+          return TRUE;
+        }
+    }
+  return FALSE;
+}
+
+const gchar *
+diskq_compression_name(DiskQueueCompression compression)
+{
+  if (compression >= G_N_ELEMENTS(compression_names))
+    return "unknown";
+  return compression_names[compression];
+}
+
+gboolean
+diskq_compression_is_supported(DiskQueueCompression compression)
+{
+  switch (compression)
+    {
+    case DISKQ_COMPRESSION_NONE:
+      return TRUE;
+#ifdef SYSLOG_NG_HAVE_ZLIB
+    case DISKQ_COMPRESSION_ZLIB:
+      return TRUE;
+#endif
+#ifdef SYSLOG_NG_HAVE_ZSTD
+    case DISKQ_COMPRESSION_ZSTD:
+      return TRUE;
+#endif
+    default:
+      return FALSE;
+    }
+}
+
+#ifdef SYSLOG_NG_HAVE_ZLIB
+static gboolean
+_zlib_compress(const gchar *data, gsize length, GString *result)
+{
+  gsize offset = result->len;
+  uLongf compressed_length = compressBound(length);
+
+  g_string_set_size(result, offset + compressed_length);
+  if (compress2((Bytef *) result->str + offset, &compressed_length, (const Bytef *) data, length,
+                ZLIB_COMPRESSION_LEVEL) != Z_OK)
+    return FALSE;
+
+  g_string_truncate(result, offset + compressed_length);
+  return TRUE;
+}
+
+static gboolean
+_zlib_decompress(const gchar *data, gsize length, gsize uncompressed_length, GString *result)
+{
+  gsize offset = result->len;
+  uLongf decompressed_length = uncompressed_length;
+
+  g_string_set_size(result, offset + uncompressed_length);
+  if (uncompress((Bytef *) result->str + offset, &decompressed_length, (const Bytef *) data, length) != Z_OK)
+    return FALSE;
+
+  return decompressed_length == uncompressed_length;
+}
+#endif
+
+#ifdef SYSLOG_NG_HAVE_ZSTD
+static gboolean
+_zstd_compress(const gchar *data, gsize length, GString *result)
+{
+  gsize offset = result->len;
+
+  g_string_set_size(result, offset + ZSTD_compressBound(length));
+  gsize compressed_length = ZSTD_compress(result->str + offset, ZSTD_compressBound(length), data, length,
+                                          ZSTD_COMPRESSION_LEVEL);
+  if (ZSTD_isError(compressed_length))
+    return FALSE;
+
+  g_string_truncate(result, offset + compressed_length);
+  return TRUE;
+}
+
+static gboolean
+_zstd_decompress(const gchar *data, gsize length, gsize uncompressed_length, GString *result)
+{
+  gsize offset = result->len;
+
+  g_string_set_size(result, offset + uncompressed_length);
+  gsize decompressed_length = ZSTD_decompress(result->str + offset, uncompressed_length, data, length);
+  if (ZSTD_isError(decompressed_length))
+    return FALSE;
+
+  return decompressed_length == uncompressed_length;
+}
+#endif
+
+/* appends the compressed form of data to result */
+gboolean
+diskq_compress(DiskQueueCompression compression, const gchar *data, gsize length, GString *result)
+{
+  switch (compression)
+    {
+#ifdef SYSLOG_NG_HAVE_ZLIB
+    case DISKQ_COMPRESSION_ZLIB:
+      return _zlib_compress(data, length, result);
+#endif
+#ifdef SYSLOG_NG_HAVE_ZSTD
+    case DISKQ_COMPRESSION_ZSTD:
+      return _zstd_compress(data, length, result);
+#endif
+    default:
+      return FALSE;
+    }
+}
+
+/* appends exactly uncompressed_length bytes to result, or fails */
+gboolean
+diskq_decompress(DiskQueueCompression compression, const gchar *data, gsize length,
+                 gsize uncompressed_length, GString *result)
+{
+  switch (compression)
+    {
+#ifdef SYSLOG_NG_HAVE_ZLIB
+    case DISKQ_COMPRESSION_ZLIB:
+      return _zlib_decompress(data, length, uncompressed_length, result);
+#endif
+#ifdef SYSLOG_NG_HAVE_ZSTD
+    case DISKQ_COMPRESSION_ZSTD:
+      return _zstd_decompress(data, length, uncompressed_length, result);
+#endif
+    default:
+      return FALSE;
+    }
+}
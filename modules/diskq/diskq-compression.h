@@ -0,0 +1,44 @@
+/*
+ * Copyright (c) 2024 Balabit
+ *
+ * This program is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License version 2 as published
+ * by the Free Software Foundation, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+ *
+ * As an additional exemption you are allowed to compile & link against the
+ * OpenSSL libraries as published by the OpenSSL project. See the file
+ * COPYING for details.
+ *
+ */
+
+#ifndef DISKQ_COMPRESSION_H_
+#define DISKQ_COMPRESSION_H_
+
+#include "syslog-ng.h"
+
+/* the values are stored in the disk-buffer file, do not renumber them */
+typedef enum
+{
+  DISKQ_COMPRESSION_NONE = 0,
+  DISKQ_COMPRESSION_ZLIB = 1,
+  DISKQ_COMPRESSION_ZSTD = 2,
+} DiskQueueCompression;
+
+gboolean diskq_compression_lookup(const gchar *name, DiskQueueCompression *compression);
+const gchar *diskq_compression_name(DiskQueueCompression compression);
+gboolean diskq_compression_is_supported(DiskQueueCompression compression);
+
+gboolean diskq_compress(DiskQueueCompression compression, const gchar *data, gsize length, GString *result);
+gboolean diskq_decompress(DiskQueueCompression compression, const gchar *data, gsize length,
+                          gsize uncompressed_length, GString *result);
+
+#endif /* DISKQ_COMPRESSION_H_ */
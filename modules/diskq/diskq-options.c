@@ -58,6 +58,12 @@ disk_queue_options_compaction_set(DiskQueueOptions *self, gboolean compaction)
   self->compaction = compaction;
 }
 
+void
+disk_queue_options_set_compact_format(DiskQueueOptions *self, gboolean compact_format)
+{
+  self->compact_format = compact_format;
+}
+
 void
 disk_queue_options_flow_control_window_bytes_set(DiskQueueOptions *self, gint flow_control_window_bytes)
 {
@@ -82,6 +88,48 @@ disk_queue_options_set_prealloc(DiskQueueOptions *self, gboolean prealloc)
   self->prealloc = prealloc;
 }
 
+void
+disk_queue_options_set_group_commit(DiskQueueOptions *self, gboolean group_commit)
+{
+  self->group_commit = group_commit;
+}
+
+void
+disk_queue_options_set_sync_records(DiskQueueOptions *self, gint sync_records)
+{
+  self->sync_records = sync_records;
+}
+
+void
+disk_queue_options_set_sync_bytes(DiskQueueOptions *self, gint64 sync_bytes)
+{
+  self->sync_bytes = sync_bytes;
+}
+
+void
+disk_queue_options_set_sync_interval(DiskQueueOptions *self, gint sync_interval)
+{
+  self->sync_interval = sync_interval;
+}
+
+void
+disk_queue_options_set_readahead_size(DiskQueueOptions *self, gint readahead_size)
+{
+  self->readahead_size = readahead_size;
+}
+
+gboolean
+disk_queue_options_set_compression(DiskQueueOptions *self, const gchar *compression)
+{
+  DiskQueueCompression value;
+
+  if (!diskq_compression_lookup(compression, &value) || !diskq_compression_is_supported(value))
+    return FALSE;
+
+  self->compression = value;
+  return TRUE;
+}
+
 void
 disk_queue_options_check_plugin_settings(DiskQueueOptions *self)
 {
@@ -134,6 +182,12 @@ disk_queue_options_set_default_options(DiskQueueOptions *self)
   self->dir = g_strdup(get_installation_path_for(SYSLOG_NG_PATH_LOCALSTATEDIR));
   self->truncate_size_ratio = -1;
   self->prealloc = -1;
+  self->group_commit = FALSE;
+  self->sync_records = 0;
+  self->sync_bytes = 0;
+  self->sync_interval = 0;
+  self->readahead_size = DEFAULT_READAHEAD_SIZE;
+  self->compression = DISKQ_COMPRESSION_NONE;
 }
 
 void
@@ -26,8 +26,10 @@
 
 #include "syslog-ng.h"
 #include "logmsg/logmsg-serialize.h"
+#include "diskq-compression.h"
 
 #define MIN_CAPACITY_BYTES 1024*1024
+#define DEFAULT_READAHEAD_SIZE 1024*1024
 
 typedef struct _DiskQueueOptions
 {
@@ -36,23 +38,37 @@ typedef struct _DiskQueueOptions
   gboolean read_only;
   gboolean reliable;
   gboolean compaction;
+  gboolean compact_format;
   gint flow_control_window_bytes;
   gint flow_control_window_size;
   gchar *dir;
   gdouble truncate_size_ratio;
   gboolean prealloc;
+  gboolean group_commit;
+  gint sync_records;
+  gint64 sync_bytes;
+  gint sync_interval;
+  gint readahead_size;
+  DiskQueueCompression compression;
 } DiskQueueOptions;
 
 void disk_queue_options_front_cache_size_set(DiskQueueOptions *self, gint front_cache_size);
 void disk_queue_options_capacity_bytes_set(DiskQueueOptions *self, gint64 capacity_bytes);
 void disk_queue_options_reliable_set(DiskQueueOptions *self, gboolean reliable);
 void disk_queue_options_compaction_set(DiskQueueOptions *self, gboolean compaction);
+void disk_queue_options_set_compact_format(DiskQueueOptions *self, gboolean compact_format);
 void disk_queue_options_flow_control_window_bytes_set(DiskQueueOptions *self, gint flow_control_window_bytes);
 void disk_queue_options_flow_control_window_size_set(DiskQueueOptions *self, gint flow_control_window_size);
 void disk_queue_options_check_plugin_settings(DiskQueueOptions *self);
 void disk_queue_options_set_dir(DiskQueueOptions *self, const gchar *dir);
 void disk_queue_options_set_truncate_size_ratio(DiskQueueOptions *self, gdouble truncate_size_ratio);
 void disk_queue_options_set_prealloc(DiskQueueOptions *self, gboolean prealloc);
+void disk_queue_options_set_group_commit(DiskQueueOptions *self, gboolean group_commit);
+void disk_queue_options_set_sync_records(DiskQueueOptions *self, gint sync_records);
+void disk_queue_options_set_sync_bytes(DiskQueueOptions *self, gint64 sync_bytes);
+void disk_queue_options_set_sync_interval(DiskQueueOptions *self, gint sync_interval);
+void disk_queue_options_set_readahead_size(DiskQueueOptions *self, gint readahead_size);
+gboolean disk_queue_options_set_compression(DiskQueueOptions *self, const gchar *compression);
 void disk_queue_options_set_default_options(DiskQueueOptions *self);
 void disk_queue_options_destroy(DiskQueueOptions *self);
 
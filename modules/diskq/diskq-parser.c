@@ -37,6 +37,7 @@ static CfgLexerKeyword diskq_keywords[] =
   { "capacity_bytes",    KW_CAPACITY_BYTES },
   { "reliable",          KW_RELIABLE },
   { "compaction",        KW_COMPACTION },
+  { "compact_format",    KW_COMPACT_FORMAT },
   { "mem_buf_size",              KW_FLOW_CONTROL_WINDOW_BYTES },
   { "flow_control_window_bytes", KW_FLOW_CONTROL_WINDOW_BYTES },
   { "qout_size",         KW_FRONT_CACHE_SIZE },
@@ -44,6 +45,12 @@ static CfgLexerKeyword diskq_keywords[] =
   { "dir",               KW_DIR },
   { "truncate_size_ratio", KW_TRUNCATE_SIZE_RATIO },
   { "prealloc",          KW_PREALLOC },
+  { "group_commit",      KW_GROUP_COMMIT },
+  { "sync_records",      KW_SYNC_RECORDS },
+  { "sync_bytes",        KW_SYNC_BYTES },
+  { "sync_interval",     KW_SYNC_INTERVAL },
+  { "readahead_size",    KW_READAHEAD_SIZE },
+  { "compression",       KW_COMPRESSION },
   { "stats",             KW_STATS },
   { "freq",              KW_FREQ },
   { NULL }
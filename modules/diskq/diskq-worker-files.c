@@ -0,0 +1,130 @@
+/*
+ * Copyright (c) 2024 Balabit
+ *
+ * This program is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License version 2 as published
+ * by the Free Software Foundation, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+ *
+ * As an additional exemption you are allowed to compile & link against the
+ * OpenSSL libraries as published by the OpenSSL project. See the file
+ * COPYING for details.
+ *
+ */
+
+#include "diskq-worker-files.h"
+
+#include <string.h>
+
+static void
+_worker_file_free(DiskqWorkerFile *self)
+{
+  g_free(self->filename);
+  g_free(self);
+}
+
+static gint
+_worker_file_compare(gconstpointer a, gconstpointer b)
+{
+  const DiskqWorkerFile *file_a = *(const DiskqWorkerFile **) a;
+  const DiskqWorkerFile *file_b = *(const DiskqWorkerFile **) b;
+
+  return file_a->worker_index - file_b->worker_index;
+}
+
+/*
+ * Threaded destinations use a separate queue for each of their workers.
+ * The first one uses the persist name of the destination, the Nth one
+ * uses "<persist-name>.N.queue".
+ */
+gchar *
+diskq_worker_files_get_destination(const gchar *persist_name, gint *worker_index)
+{
+  *worker_index = 0;
+
+  if (!g_str_has_suffix(persist_name, ".queue"))
+    return g_strdup(persist_name);
+
+  gchar *destination = g_strndup(persist_name, strlen(persist_name) - strlen(".queue"));
+  gchar *index_start = strrchr(destination, '.');
+  gchar *end;
+
+  if (!index_start)
+    goto not_a_worker;
+
+  gint64 index = g_ascii_strtoll(index_start + 1, &end, 10);
+  if (*end != '\0' || end == index_start + 1 || index <= 0)
+    goto not_a_worker;
+
+  *index_start = '\0';
+  *worker_index = index;
+  return destination;
+
+not_a_worker:
+  g_free(destination);
+  return g_strdup(persist_name);
+}
+
+typedef struct
+{
+  PersistState *state;
+  DiskqWorkerFileFilterFunc filter;
+  GHashTable *destinations;
+} DiskqWorkerFilesCollectState;
+
+static void
+_collect_worker_file(gchar *name, gint size, gpointer entry, gpointer user_data)
+{
+  DiskqWorkerFilesCollectState *collect_state = (DiskqWorkerFilesCollectState *) user_data;
+
+  if (!collect_state->filter(collect_state->state, name))
+    return;
+
+  DiskqWorkerFile *file = g_new0(DiskqWorkerFile, 1);
+  gchar *destination = diskq_worker_files_get_destination(name, &file->worker_index);
+  file->filename = persist_state_lookup_string(collect_state->state, name, NULL, NULL);
+
+  GPtrArray *files = g_hash_table_lookup(collect_state->destinations, destination);
+  if (!files)
+    {
+      files = g_ptr_array_new_with_free_func((GDestroyNotify) _worker_file_free);
+      g_hash_table_insert(collect_state->destinations, g_strdup(destination), files);
+    }
+  g_ptr_array_add(files, file);
+  g_free(destination);
+}
+
+static void
+_sort_worker_files(gpointer key, gpointer value, gpointer user_data)
+{
+  g_ptr_array_sort((GPtrArray *) value, _worker_file_compare);
+}
+
+/*
+ * Groups the disk-buffer files referenced from the persist file (the
+ * entries accepted by filter) by destination.  Maps each destination
+ * persist name to a GPtrArray of DiskqWorkerFile, ordered by worker index.
+ */
+GHashTable *
+diskq_worker_files_collect(PersistState *state, DiskqWorkerFileFilterFunc filter)
+{
+  DiskqWorkerFilesCollectState collect_state =
+  {
+    .state = state,
+    .filter = filter,
+    .destinations = g_hash_table_new_full(g_str_hash, g_str_equal, g_free, (GDestroyNotify) g_ptr_array_unref),
+  };
+
+  persist_state_foreach_entry(state, _collect_worker_file, &collect_state);
+  g_hash_table_foreach(collect_state.destinations, _sort_worker_files, NULL);
+
+  return collect_state.destinations;
+}
@@ -160,6 +160,7 @@ exit:
   if (queue)
     {
       log_queue_set_throttle(queue, dd->throttle);
+      log_queue_disk_start_sync_timer((LogQueueDisk *) queue);
 
       const gchar *qfile_name = log_queue_disk_get_filename(queue);
       diskq_global_metrics_file_acquired(qfile_name);
@@ -179,6 +180,7 @@ _release_queue(LogDestDriver *dd, LogQueue *queue)
   GlobalConfig *cfg = log_pipe_get_config(&dd->super.super);
   gboolean persistent;
 
+  log_queue_disk_stop_sync_timer((LogQueueDisk *) queue);
   log_queue_disk_stop(queue, &persistent);
   diskq_global_metrics_file_released(log_queue_disk_get_filename(queue));
 
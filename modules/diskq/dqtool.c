@@ -30,6 +30,7 @@
 #include "logqueue-disk.h"
 #include "logqueue-disk-reliable.h"
 #include "logqueue-disk-non-reliable.h"
+#include "diskq-worker-files.h"
 #include "logmsg/logmsg-serialize.h"
 #include "scratch-buffers.h"
 #include "mainloop.h"
@@ -51,6 +52,7 @@ gboolean relocate_all;
 gboolean display_version;
 gboolean assign_help;
 gboolean truncate_confirm;
+gint bench_readahead_size = -1;
 
 static GOptionEntry cat_options[] =
 {
@@ -72,6 +74,24 @@ static GOptionEntry truncate_options[] =
   { NULL, 0, 0, G_OPTION_ARG_NONE, NULL, NULL }
 };
 
+static GOptionEntry bench_options[] =
+{
+  {
+    "readahead-size", 'r', 0, G_OPTION_ARG_INT, &bench_readahead_size,
+    "Size of the chunks read ahead from the disk-buffer file, 0 disables read-ahead", "<bytes>"
+  },
+  { NULL, 0, 0, G_OPTION_ARG_NONE, NULL, NULL }
+};
+
+static GOptionEntry list_options[] =
+{
+  {
+    "persist", 'p', 0, G_OPTION_ARG_STRING, &persist_file_path,
+    "syslog-ng persist file", "<persist>"
+  },
+  { NULL, 0, 0, G_OPTION_ARG_NONE, NULL, NULL }
+};
+
 static GOptionEntry relocate_options[] =
 {
   {
@@ -254,6 +274,21 @@ dqtool_cat(int argc, char *argv[])
   return 0;
 }
 
+static void
+_print_compression_info(const gchar *filename, QDisk *qdisk)
+{
+  gint64 input_bytes = qdisk_get_compression_input_bytes(qdisk);
+  gint64 output_bytes = qdisk_get_compression_output_bytes(qdisk);
+
+  if (qdisk_get_compression(qdisk) == DISKQ_COMPRESSION_NONE || output_bytes == 0)
+    return;
+
+  printf("Disk-buffer %s compression: %s, written bytes: %" G_GINT64_FORMAT ", uncompressed: %" G_GINT64_FORMAT
+         ", ratio: %.2f\n",
+         filename, diskq_compression_name(qdisk_get_compression(qdisk)), output_bytes, input_bytes,
+         (gdouble) input_bytes / output_bytes);
+}
+
 static gint
 dqtool_info(int argc, char *argv[])
 {
@@ -267,10 +302,60 @@ dqtool_info(int argc, char *argv[])
       if (!open_queue(argv[i], &lq, &options, TRUE))
         continue;
 
+      _print_compression_info(argv[i], ((LogQueueDisk *) lq)->qdisk);
+
+      gboolean persistent;
+      log_queue_disk_stop(lq, &persistent);
+      log_queue_unref(lq);
+    }
+  return 0;
+}
+
+/*
+ * Replays the messages of the disk-buffer files the same way syslog-ng
+ * does after a restart (without modifying them) and measures the
+ * throughput.
+ */
+static gint
+dqtool_bench(int argc, char *argv[])
+{
+  for (gint i = optind; i < argc; i++)
+    {
+      LogPathOptions local_path_options = LOG_PATH_OPTIONS_INIT;
+      LogQueue *lq;
+      LogMessage *log_msg;
+      DiskQueueOptions options = {0};
+      disk_queue_options_set_default_options(&options);
+
+      if (bench_readahead_size >= 0)
+        disk_queue_options_set_readahead_size(&options, bench_readahead_size);
+
+      if (!open_queue(argv[i], &lq, &options, TRUE))
+        continue;
+
+      log_queue_rewind_backlog_all(lq);
+
+      gint64 num_bytes = qdisk_get_used_useful_space(((LogQueueDisk *) lq)->qdisk);
+      gint64 num_messages = 0;
+      gint64 start = g_get_monotonic_time();
+
+      while ((log_msg = log_queue_pop_head(lq, &local_path_options)) != NULL)
+        {
+          log_msg_unref(log_msg);
+          num_messages++;
+        }
+
+      gdouble elapsed = MAX(g_get_monotonic_time() - start, 1) / (gdouble) G_USEC_PER_SEC;
+      printf("Disk-buffer %s replayed, messages: %" G_GINT64_FORMAT ", bytes: %" G_GINT64_FORMAT
+             ", elapsed: %.3f s, %.0f msg/s, %.2f MiB/s\n",
+             argv[i], num_messages, num_bytes, elapsed,
+             num_messages / elapsed, num_bytes / elapsed / 1024.0 / 1024.0);
+
       gboolean persistent;
       log_queue_disk_stop(lq, &persistent);
       log_queue_unref(lq);
     }
+
   return 0;
 }
 
@@ -580,6 +665,65 @@ dqtool_relocate(int argc, char *argv[])
   return 0;
 }
 
+static void
+_print_worker_file(DiskqWorkerFile *file)
+{
+  LogQueue *lq;
+  DiskQueueOptions options = {0};
+  disk_queue_options_set_default_options(&options);
+
+  if (!open_queue(file->filename, &lq, &options, TRUE))
+    {
+      printf("  worker %d: %s, cannot be opened\n", file->worker_index, file->filename);
+      disk_queue_options_destroy(&options);
+      return;
+    }
+
+  printf("  worker %d: %s, messages: %" G_GINT64_FORMAT "\n", file->worker_index, file->filename,
+         log_queue_get_length(lq));
+
+  gboolean persistent;
+  log_queue_disk_stop(lq, &persistent);
+  log_queue_unref(lq);
+  disk_queue_options_destroy(&options);
+}
+
+static gint
+dqtool_list(int argc, char *argv[])
+{
+  if (!_validate_persist_file_path(persist_file_path))
+    return 1;
+
+  main_thread_handle = get_thread_id();
+
+  PersistState *state = persist_state_new(persist_file_path);
+  if (!state || !persist_state_start_dump(state))
+    {
+      fprintf(stderr, "Failed to load persist file %s\n", persist_file_path);
+      if (state)
+        persist_state_free(state);
+      return 1;
+    }
+
+  GHashTable *destinations = diskq_worker_files_collect(state, _is_persist_entry_holds_diskq_file);
+
+  GList *names = g_list_sort(g_hash_table_get_keys(destinations), (GCompareFunc) strcmp);
+  for (GList *l = names; l; l = l->next)
+    {
+      GPtrArray *files = g_hash_table_lookup(destinations, l->data);
+
+      printf("%s\n", (const gchar *) l->data);
+      for (guint i = 0; i < files->len; i++)
+        _print_worker_file(g_ptr_array_index(files, i));
+    }
+
+  g_list_free(names);
+  g_hash_table_destroy(destinations);
+  persist_state_cancel(state);
+  persist_state_free(state);
+  return 0;
+}
+
 static gboolean
 _assign_validate_options(const gchar *persist_file, const gchar *diskq_file)
 {
@@ -678,9 +822,11 @@ static struct
 {
   { "cat", cat_options, "Print the contents of a disk queue file", dqtool_cat },
   { "info", info_options, "Print infos about the given disk queue file", dqtool_info },
+  { "list", list_options, "List the disk queue files of each destination (and its workers) in a persist file", dqtool_list },
   { "relocate", relocate_options, "Relocate(rename) diskq file. Note that this option modifies the persist file.", dqtool_relocate },
   { "assign", assign_options, "Assign diskq file to the given persist file with the given persist name.", dqtool_assign },
   { "truncate", truncate_options, "Truncate unused space in abandoned disk queues", dqtool_truncate },
+  { "bench", bench_options, "Measure the replay throughput of disk queue files", dqtool_bench },
   { NULL, NULL },
 };
 
@@ -112,11 +112,41 @@ _serialize_and_write_message_to_disk(LogQueueDiskNonReliable *self, LogMessage *
   return success;
 }
 
+static gboolean
+_commit_disk_writes(LogQueueDiskNonReliable *self)
+{
+  gboolean committed = qdisk_commit(self->super.qdisk);
+
+  if (!committed)
+    msg_error("Failed to write messages to non-reliable disk-buffer, dropping messages",
+              evt_tag_str("filename", qdisk_get_filename(self->super.qdisk)),
+              evt_tag_str("persist_name", self->super.super.persist_name));
+
+  log_queue_disk_update_disk_related_counters(&self->super);
+  return committed;
+}
+
+/* messages written to the disk are acked only once they are committed */
+static inline void
+_finish_disk_write(LogQueueDiskNonReliable *self, LogMessage *msg, const LogPathOptions *path_options,
+                   gboolean committed)
+{
+  if (!committed)
+    {
+      log_queue_disk_drop_message(&self->super, msg, path_options);
+      return;
+    }
+
+  log_msg_ack(msg, path_options, AT_PROCESSED);
+  log_msg_unref(msg);
+}
+
 static void
 _move_messages_from_overflow(LogQueueDiskNonReliable *self)
 {
   LogMessage *msg;
   LogPathOptions path_options;
+  GQueue written = G_QUEUE_INIT;
   /* move away as much entries from the overflow area as possible */
   while (_flow_control_window_has_movable_message(self))
     {
@@ -134,10 +164,9 @@ _move_messages_from_overflow(LogQueueDiskNonReliable *self)
         {
           if (_serialize_and_write_message_to_disk(self, msg))
             {
-              log_queue_disk_update_disk_related_counters(&self->super);
               log_queue_memory_usage_sub(&self->super.super, log_msg_get_size(msg));
-              log_msg_ack(msg, &path_options, AT_PROCESSED);
-              log_msg_unref(msg);
+              g_queue_push_tail(&written, msg);
+              g_queue_push_tail(&written, LOG_PATH_OPTIONS_TO_POINTER(&path_options));
             }
           else
             {
@@ -151,6 +180,21 @@ _move_messages_from_overflow(LogQueueDiskNonReliable *self)
             }
         }
     }
+
+  if (g_queue_is_empty(&written))
+    return;
+
+  gboolean committed = _commit_disk_writes(self);
+  while (!g_queue_is_empty(&written))
+    {
+      msg = g_queue_pop_head(&written);
+      POINTER_TO_LOG_PATH_OPTIONS(g_queue_pop_head(&written), &path_options);
+
+      /* these were counted as queued while waiting in the flow_control_window */
+      if (!committed)
+        log_queue_queued_messages_dec(&self->super.super);
+      _finish_disk_write(self, msg, &path_options, committed);
+    }
 }
 
 static gboolean
@@ -302,48 +346,80 @@ success:
   return msg;
 }
 
+/* lock must be held */
 static LogMessage *
-_pop_head(LogQueue *s, LogPathOptions *path_options)
+_pop_head_unlocked(LogQueueDiskNonReliable *self, LogPathOptions *path_options)
 {
-  LogQueueDiskNonReliable *self = (LogQueueDiskNonReliable *)s;
-  LogMessage *msg = NULL;
-  gboolean stats_update = TRUE;
-
-  g_mutex_lock(&s->lock);
+  LogMessage *msg;
 
   if (self->front_cache->length > 0)
     {
       msg = _pop_head_front_cache(self, path_options);
       if (msg)
-        goto success;
+        return msg;
     }
 
   msg = log_queue_disk_read_message(&self->super, path_options);
   if (msg)
-    goto success;
+    return msg;
 
   if (self->flow_control_window->length > 0 && qdisk_is_read_only(self->super.qdisk))
-    msg = _pop_head_flow_control_window(self, path_options);
+    return _pop_head_flow_control_window(self, path_options);
 
-  if (!msg)
+  return NULL;
+}
+
+static gint
+_pop_head_batch(LogQueue *s, LogMessage **msgs, LogPathOptions *path_options, gint max_count)
+{
+  LogQueueDiskNonReliable *self = (LogQueueDiskNonReliable *)s;
+  gboolean stats_update = TRUE;
+  gint count = 0;
+
+  g_mutex_lock(&s->lock);
+
+  while (count < max_count)
     {
-      g_mutex_unlock(&s->lock);
-      return NULL;
+      LogMessage *msg = _pop_head_unlocked(self, &path_options[count]);
+
+      if (!msg)
+        break;
+
+      msgs[count++] = msg;
+
+      if (!_maybe_move_messages_among_queue_segments(self))
+        {
+          /* the queue was restarted, the queued counter is already reset */
+          stats_update = FALSE;
+          break;
+        }
     }
 
-success:
-  if (!_maybe_move_messages_among_queue_segments(self))
+  if (count == 0)
     {
-      stats_update = FALSE;
+      g_mutex_unlock(&s->lock);
+      return 0;
     }
 
   log_queue_disk_update_disk_related_counters(&self->super);
   g_mutex_unlock(&s->lock);
 
-  _push_tail_backlog(self, msg, path_options);
+  for (gint i = 0; i < count; i++)
+    _push_tail_backlog(self, msgs[i], &path_options[i]);
 
   if (stats_update)
-    log_queue_queued_messages_dec(s);
+    log_queue_queued_messages_sub(s, count);
+
+  return count;
+}
+
+static LogMessage *
+_pop_head(LogQueue *s, LogPathOptions *path_options)
+{
+  LogMessage *msg;
+
+  if (_pop_head_batch(s, &msg, path_options, 1) == 0)
+    return NULL;
 
   return msg;
 }
@@ -408,20 +484,65 @@ _push_tail_flow_control_window(LogQueueDiskNonReliable *self, LogMessage *msg, c
   /* no ack */
 }
 
+/* the message is acked by _finish_disk_write(), after the commit */
 static inline gboolean
 _push_tail_disk(LogQueueDiskNonReliable *self, LogMessage *msg, const LogPathOptions *path_options,
                 GString *serialized_msg)
 {
-  gboolean result = _ensure_serialized_and_write_to_disk(self, msg, serialized_msg);
-  if (result)
+  return _ensure_serialized_and_write_to_disk(self, msg, serialized_msg);
+}
+
+static gboolean
+_serialize_msg(LogQueueDiskNonReliable *self, LogMessage *msg, const LogPathOptions *path_options,
+               GString *serialized_msg)
+{
+  if (log_queue_disk_serialize_msg(&self->super, msg, serialized_msg))
+    return TRUE;
+
+  msg_error("Failed to serialize message for non-reliable disk-buffer, dropping message",
+            evt_tag_str("filename", qdisk_get_filename(self->super.qdisk)),
+            evt_tag_str("persist_name", self->super.super.persist_name));
+  log_queue_disk_drop_message(&self->super, msg, path_options);
+  return FALSE;
+}
+
+/* lock must be held, returns TRUE if the message was queued. Messages
+ * written to the disk have to be finished with _finish_disk_write() once
+ * they are committed.
+ */
+static gboolean
+_push_tail_unlocked(LogQueueDiskNonReliable *self, LogMessage *msg, const LogPathOptions *path_options,
+                    GString *serialized_msg, gboolean *written_to_disk)
+{
+  *written_to_disk = FALSE;
+
+  /* we push messages into queue segments in the following order: flow_control_window, disk, front_cache */
+  if (_can_push_to_front_cache(self))
     {
-      log_msg_ack(msg, path_options, AT_PROCESSED);
-      log_msg_unref(msg);
+      _push_tail_front_cache(self, msg, path_options);
+      return TRUE;
     }
 
-  log_queue_disk_update_disk_related_counters(&self->super);
+  if (self->flow_control_window->length != 0 || !_push_tail_disk(self, msg, path_options, serialized_msg))
+    {
+      if (HAS_SPACE_IN_QUEUE(self->flow_control_window))
+        {
+          _push_tail_flow_control_window(self, msg, path_options);
+          return TRUE;
+        }
 
-  return result;
+      msg_debug("Destination queue full, dropping message",
+                evt_tag_str("filename", qdisk_get_filename(self->super.qdisk)),
+                evt_tag_long("queue_len", log_queue_get_length(&self->super.super)),
+                evt_tag_int("flow_control_window_size", self->flow_control_window_size),
+                evt_tag_long("capacity_bytes", qdisk_get_maximum_size(self->super.qdisk)),
+                evt_tag_str("persist_name", self->super.super.persist_name));
+      log_queue_disk_drop_message(&self->super, msg, path_options);
+      return FALSE;
+    }
+
+  *written_to_disk = TRUE;
+  return TRUE;
 }
 
 static void
@@ -435,12 +556,8 @@ _push_tail(LogQueue *s, LogMessage *msg, const LogPathOptions *path_options)
   if (_is_msg_serialization_needed_hint(self))
     {
       serialized_msg = scratch_buffers_alloc_and_mark(&marker);
-      if (!log_queue_disk_serialize_msg(&self->super, msg, serialized_msg))
+      if (!_serialize_msg(self, msg, path_options, serialized_msg))
         {
-          msg_error("Failed to serialize message for non-reliable disk-buffer, dropping message",
-                    evt_tag_str("filename", qdisk_get_filename(self->super.qdisk)),
-                    evt_tag_str("persist_name", s->persist_name));
-          log_queue_disk_drop_message(&self->super, msg, path_options);
           scratch_buffers_reclaim_marked(marker);
           return;
         }
@@ -448,45 +565,103 @@ _push_tail(LogQueue *s, LogMessage *msg, const LogPathOptions *path_options)
 
   g_mutex_lock(&s->lock);
 
-  /* we push messages into queue segments in the following order: flow_control_window, disk, front_cache */
-  if (_can_push_to_front_cache(self))
-    {
-      _push_tail_front_cache(self, msg, path_options);
-      goto queued;
-    }
+  gboolean written_to_disk;
+  gboolean queued = _push_tail_unlocked(self, msg, path_options, serialized_msg, &written_to_disk);
 
-  if (self->flow_control_window->length != 0 || !_push_tail_disk(self, msg, path_options, serialized_msg))
+  if (written_to_disk)
     {
-      if (HAS_SPACE_IN_QUEUE(self->flow_control_window))
-        {
-          _push_tail_flow_control_window(self, msg, path_options);
-          goto queued;
-        }
+      gboolean committed = _commit_disk_writes(self);
 
-      msg_debug("Destination queue full, dropping message",
-                evt_tag_str("filename", qdisk_get_filename(self->super.qdisk)),
-                evt_tag_long("queue_len", log_queue_get_length(s)),
-                evt_tag_int("flow_control_window_size", self->flow_control_window_size),
-                evt_tag_long("capacity_bytes", qdisk_get_maximum_size(self->super.qdisk)),
-                evt_tag_str("persist_name", s->persist_name));
-      log_queue_disk_drop_message(&self->super, msg, path_options);
-      goto exit;
+      _finish_disk_write(self, msg, path_options, committed);
+      queued = committed;
     }
 
-queued:
-  log_queue_queued_messages_inc(s);
+  if (queued)
+    {
+      log_queue_queued_messages_inc(s);
 
-  /* this releases the queue's lock for a short time, which may violate the
-   * consistency of the disk-buffer, so it must be the last call under lock in this function
-   */
-  log_queue_push_notify(s);
+      /* this releases the queue's lock for a short time, which may violate the
+       * consistency of the disk-buffer, so it must be the last call under lock in this function
+       */
+      log_queue_push_notify(s);
+    }
 
-exit:
   g_mutex_unlock(&s->lock);
   if (serialized_msg)
     scratch_buffers_reclaim_marked(marker);
 }
 
+/*
+ * Messages are serialized outside of the lock in chunks (if the hint says
+ * they will end up on the disk), then each chunk is pushed under a single
+ * lock acquisition.
+ */
+static void
+_push_tail_batch(LogQueue *s, LogMessage **msgs, const LogPathOptions *path_options, gint count)
+{
+  LogQueueDiskNonReliable *self = (LogQueueDiskNonReliable *)s;
+
+  for (gint chunk_start = 0; chunk_start < count; chunk_start += LOG_QUEUE_DISK_BATCH_CHUNK_SIZE)
+    {
+      gint chunk_len = MIN(count - chunk_start, LOG_QUEUE_DISK_BATCH_CHUNK_SIZE);
+      GString *serialized_msgs[LOG_QUEUE_DISK_BATCH_CHUNK_SIZE] = { 0 };
+      gboolean dropped[LOG_QUEUE_DISK_BATCH_CHUNK_SIZE] = { 0 };
+      gboolean written_to_disk[LOG_QUEUE_DISK_BATCH_CHUNK_SIZE] = { 0 };
+      gboolean any_written_to_disk = FALSE;
+      ScratchBuffersMarker marker;
+      gint queued = 0;
+
+      scratch_buffers_mark(&marker);
+      if (_is_msg_serialization_needed_hint(self))
+        {
+          for (gint i = 0; i < chunk_len; i++)
+            {
+              gint msg_index = chunk_start + i;
+
+              serialized_msgs[i] = scratch_buffers_alloc();
+              dropped[i] = !_serialize_msg(self, msgs[msg_index], &path_options[msg_index], serialized_msgs[i]);
+            }
+        }
+
+      g_mutex_lock(&s->lock);
+      for (gint i = 0; i < chunk_len; i++)
+        {
+          gint msg_index = chunk_start + i;
+
+          if (!dropped[i] && _push_tail_unlocked(self, msgs[msg_index], &path_options[msg_index], serialized_msgs[i],
+                                                 &written_to_disk[i]))
+            queued++;
+          any_written_to_disk |= written_to_disk[i];
+        }
+
+      if (any_written_to_disk)
+        {
+          gboolean committed = _commit_disk_writes(self);
+
+          for (gint i = 0; i < chunk_len; i++)
+            {
+              gint msg_index = chunk_start + i;
+
+              if (!written_to_disk[i])
+                continue;
+
+              _finish_disk_write(self, msgs[msg_index], &path_options[msg_index], committed);
+              if (!committed)
+                queued--;
+            }
+        }
+
+      if (queued > 0)
+        {
+          log_queue_queued_messages_add(s, queued);
+          log_queue_push_notify(s);
+        }
+      g_mutex_unlock(&s->lock);
+
+      scratch_buffers_reclaim_marked(marker);
+    }
+}
+
 static void
 _empty_queue(LogQueueDiskNonReliable *self, GQueue *q)
 {
@@ -569,8 +744,10 @@ _set_logqueue_virtual_functions(LogQueue *s)
   s->rewind_backlog = _rewind_backlog;
   s->rewind_backlog_all = _rewind_backlog_all;
   s->pop_head = _pop_head;
+  s->pop_head_batch = _pop_head_batch;
   s->peek_head = _peek_head;
   s->push_tail = _push_tail;
+  s->push_tail_batch = _push_tail_batch;
   s->free_fn = _free;
 }
 
@@ -253,14 +253,12 @@ exit:
   return msg;
 }
 
+/* lock must be held */
 static LogMessage *
-_pop_head(LogQueue *s, LogPathOptions *path_options)
+_pop_head_unlocked(LogQueueDiskReliable *self, LogPathOptions *path_options, gboolean *qdisk_corrupt)
 {
-  LogQueueDiskReliable *self = (LogQueueDiskReliable *)s;
+  LogQueue *s = &self->super.super;
   LogMessage *msg = NULL;
-  gboolean qdisk_corrupt = FALSE;
-
-  g_mutex_lock(&s->lock);
 
   if (_is_next_message_in_flow_control_window(self))
     {
@@ -269,14 +267,14 @@ _pop_head(LogQueue *s, LogPathOptions *path_options)
       log_queue_memory_usage_sub(s, log_msg_get_size(msg));
 
       if (!_skip_message(&self->super))
-        qdisk_corrupt = TRUE;
+        *qdisk_corrupt = TRUE;
 
       /* push to backlog */
       log_msg_ref(msg);
       _push_to_memory_queue_tail(self->backlog, position, msg, path_options);
       log_queue_memory_usage_add(s, log_msg_get_size(msg));
 
-      goto exit;
+      return msg;
     }
 
   if (_is_next_message_in_front_cache(self))
@@ -289,27 +287,57 @@ _pop_head(LogQueue *s, LogPathOptions *path_options)
       log_queue_memory_usage_sub(s, log_msg_get_size(msg));
 
       if (!_skip_message(&self->super))
-        qdisk_corrupt = TRUE;
+        *qdisk_corrupt = TRUE;
 
-      goto exit;
+      return msg;
     }
 
-  msg = log_queue_disk_read_message(&self->super, path_options);
+  return log_queue_disk_read_message(&self->super, path_options);
+}
 
-exit:
-  if (!msg)
+static gint
+_pop_head_batch(LogQueue *s, LogMessage **msgs, LogPathOptions *path_options, gint max_count)
+{
+  LogQueueDiskReliable *self = (LogQueueDiskReliable *)s;
+  gboolean qdisk_corrupt = FALSE;
+  gint count = 0;
+
+  g_mutex_lock(&s->lock);
+
+  while (count < max_count && !qdisk_corrupt)
+    {
+      LogMessage *msg = _pop_head_unlocked(self, &path_options[count], &qdisk_corrupt);
+
+      if (!msg)
+        break;
+
+      msgs[count++] = msg;
+    }
+
+  if (count == 0)
     {
       g_mutex_unlock(&s->lock);
-      return NULL;
+      return 0;
     }
 
   log_queue_disk_update_disk_related_counters(&self->super);
-  log_queue_queued_messages_dec(s);
+  log_queue_queued_messages_sub(s, count);
 
   if (qdisk_corrupt)
     log_queue_disk_restart_corrupted(&self->super);
 
   g_mutex_unlock(&s->lock);
+  return count;
+}
+
+static LogMessage *
+_pop_head(LogQueue *s, LogPathOptions *path_options)
+{
+  LogMessage *msg;
+
+  if (_pop_head_batch(s, &msg, path_options, 1) == 0)
+    return NULL;
+
   return msg;
 }
 
@@ -326,26 +354,28 @@ _is_space_available_in_front_cache(LogQueueDiskReliable *self)
   return num_of_messages_in_front_cache < self->front_cache_size;
 }
 
-static void
-_push_tail(LogQueue *s, LogMessage *msg, const LogPathOptions *path_options)
+static gboolean
+_serialize_msg(LogQueueDiskReliable *self, LogMessage *msg, const LogPathOptions *path_options, GString *serialized)
 {
-  LogQueueDiskReliable *self = (LogQueueDiskReliable *)s;
-
-  ScratchBuffersMarker marker;
-  GString *serialized_msg = scratch_buffers_alloc_and_mark(&marker);
-  if (!log_queue_disk_serialize_msg(&self->super, msg, serialized_msg))
-    {
-      msg_error("Failed to serialize message for reliable disk-buffer, dropping message",
-                evt_tag_str("filename", qdisk_get_filename(self->super.qdisk)),
-                evt_tag_str("persist_name", s->persist_name));
-      log_queue_disk_drop_message(&self->super, msg, path_options);
-      scratch_buffers_reclaim_marked(marker);
-      return;
-    }
+  if (log_queue_disk_serialize_msg(&self->super, msg, serialized))
+    return TRUE;
+
+  msg_error("Failed to serialize message for reliable disk-buffer, dropping message",
+            evt_tag_str("filename", qdisk_get_filename(self->super.qdisk)),
+            evt_tag_str("persist_name", self->super.super.persist_name));
+  log_queue_disk_drop_message(&self->super, msg, path_options);
+  return FALSE;
+}
 
-  g_mutex_lock(&s->lock);
+/* lock must be held, returns TRUE if the message was written, it has to be
+ * finished with _finish_write() once the write is committed */
+static gboolean
+_write_serialized(LogQueueDiskReliable *self, LogMessage *msg, const LogPathOptions *path_options,
+                  GString *serialized_msg, gint64 *message_position)
+{
+  LogQueue *s = &self->super.super;
 
-  gint64 message_position = qdisk_get_next_tail_position(self->super.qdisk);
+  *message_position = qdisk_get_next_tail_position(self->super.qdisk);
   if (!qdisk_push_tail(self->super.qdisk, serialized_msg))
     {
       EVTTAG *suggestion = NULL;
@@ -365,14 +395,38 @@ _push_tail(LogQueue *s, LogMessage *msg, const LogPathOptions *path_options)
                 suggestion);
 
       log_queue_disk_drop_message(&self->super, msg, path_options);
-      scratch_buffers_reclaim_marked(marker);
-      g_mutex_unlock(&s->lock);
-      return;
+      return FALSE;
     }
 
+  return TRUE;
+}
+
+static gboolean
+_commit_writes(LogQueueDiskReliable *self)
+{
+  gboolean committed = qdisk_commit(self->super.qdisk);
+
+  if (!committed)
+    msg_error("Failed to write messages to reliable disk-buffer, dropping messages",
+              evt_tag_str("filename", qdisk_get_filename(self->super.qdisk)),
+              evt_tag_str("persist_name", self->super.super.persist_name));
+
   log_queue_disk_update_disk_related_counters(&self->super);
+  return committed;
+}
 
-  scratch_buffers_reclaim_marked(marker);
+/* lock must be held, returns TRUE if the message was queued */
+static gboolean
+_finish_write(LogQueueDiskReliable *self, LogMessage *msg, const LogPathOptions *path_options,
+              gint64 message_position, gboolean committed)
+{
+  LogQueue *s = &self->super.super;
+
+  if (!committed)
+    {
+      log_queue_disk_drop_message(&self->super, msg, path_options);
+      return FALSE;
+    }
 
   if (_is_reserved_buffer_size_reached(self))
     {
@@ -381,7 +435,7 @@ _push_tail(LogQueue *s, LogMessage *msg, const LogPathOptions *path_options)
        */
       _push_to_memory_queue_tail(self->flow_control_window, message_position, msg, path_options);
       log_queue_memory_usage_add(s, log_msg_get_size(msg));
-      goto exit;
+      return TRUE;
     }
 
   log_msg_ack(msg, path_options, AT_PROCESSED);
@@ -397,21 +451,109 @@ _push_tail(LogQueue *s, LogMessage *msg, const LogPathOptions *path_options)
       local_path_options.ack_needed = FALSE;
       _push_to_memory_queue_tail(self->front_cache, message_position, msg, &local_path_options);
       log_queue_memory_usage_add(s, log_msg_get_size(msg));
-      goto exit;
+      return TRUE;
     }
 
   log_msg_unref(msg);
+  return TRUE;
+}
 
-exit:
-  log_queue_queued_messages_inc(s);
+static void
+_push_tail(LogQueue *s, LogMessage *msg, const LogPathOptions *path_options)
+{
+  LogQueueDiskReliable *self = (LogQueueDiskReliable *)s;
+
+  ScratchBuffersMarker marker;
+  GString *serialized_msg = scratch_buffers_alloc_and_mark(&marker);
+  if (!_serialize_msg(self, msg, path_options, serialized_msg))
+    {
+      scratch_buffers_reclaim_marked(marker);
+      return;
+    }
+
+  g_mutex_lock(&s->lock);
+
+  gint64 message_position;
+  gboolean queued = FALSE;
+  if (_write_serialized(self, msg, path_options, serialized_msg, &message_position))
+    {
+      gboolean committed = _commit_writes(self);
+      queued = _finish_write(self, msg, path_options, message_position, committed);
+    }
+
+  scratch_buffers_reclaim_marked(marker);
+
+  if (queued)
+    {
+      log_queue_queued_messages_inc(s);
 
-  /* this releases the queue's lock for a short time, which may violate the
-   * consistency of the disk-buffer, so it must be the last call under lock in this function
-   */
-  log_queue_push_notify(s);
+      /* this releases the queue's lock for a short time, which may violate the
+       * consistency of the disk-buffer, so it must be the last call under lock in this function
+       */
+      log_queue_push_notify(s);
+    }
   g_mutex_unlock(&s->lock);
 }
 
+/*
+ * Messages are serialized outside of the lock, in chunks, then each chunk
+ * is written under a single lock acquisition.
+ */
+static void
+_push_tail_batch(LogQueue *s, LogMessage **msgs, const LogPathOptions *path_options, gint count)
+{
+  LogQueueDiskReliable *self = (LogQueueDiskReliable *)s;
+
+  for (gint chunk_start = 0; chunk_start < count; chunk_start += LOG_QUEUE_DISK_BATCH_CHUNK_SIZE)
+    {
+      gint chunk_len = MIN(count - chunk_start, LOG_QUEUE_DISK_BATCH_CHUNK_SIZE);
+      GString *serialized_msgs[LOG_QUEUE_DISK_BATCH_CHUNK_SIZE];
+      gint64 message_positions[LOG_QUEUE_DISK_BATCH_CHUNK_SIZE];
+      gboolean written[LOG_QUEUE_DISK_BATCH_CHUNK_SIZE] = { 0 };
+      ScratchBuffersMarker marker;
+      gint queued = 0;
+
+      scratch_buffers_mark(&marker);
+      for (gint i = 0; i < chunk_len; i++)
+        {
+          gint msg_index = chunk_start + i;
+
+          serialized_msgs[i] = scratch_buffers_alloc();
+          if (!_serialize_msg(self, msgs[msg_index], &path_options[msg_index], serialized_msgs[i]))
+            serialized_msgs[i] = NULL;
+        }
+
+      g_mutex_lock(&s->lock);
+      for (gint i = 0; i < chunk_len; i++)
+        {
+          gint msg_index = chunk_start + i;
+
+          written[i] = serialized_msgs[i]
+                       && _write_serialized(self, msgs[msg_index], &path_options[msg_index], serialized_msgs[i],
+                                            &message_positions[i]);
+        }
+
+      gboolean committed = _commit_writes(self);
+      for (gint i = 0; i < chunk_len; i++)
+        {
+          gint msg_index = chunk_start + i;
+
+          if (written[i]
+              && _finish_write(self, msgs[msg_index], &path_options[msg_index], message_positions[i], committed))
+            queued++;
+        }
+
+      if (queued > 0)
+        {
+          log_queue_queued_messages_add(s, queued);
+          log_queue_push_notify(s);
+        }
+      g_mutex_unlock(&s->lock);
+
+      scratch_buffers_reclaim_marked(marker);
+    }
+}
+
 static void
 _free(LogQueue *s)
 {
@@ -470,8 +612,10 @@ _set_logqueue_virtual_functions(LogQueue *s)
   s->rewind_backlog = _rewind_backlog;
   s->rewind_backlog_all = _rewind_backlog_all;
   s->pop_head = _pop_head;
+  s->pop_head_batch = _pop_head_batch;
   s->peek_head = _peek_head;
   s->push_tail = _push_tail;
+  s->push_tail_batch = _push_tail_batch;
   s->free_fn = _free;
 }
 
@@ -506,6 +650,8 @@ log_queue_disk_reliable_new(DiskQueueOptions *options, const gchar *filename, co
   self->backlog = g_queue_new();
   self->front_cache = g_queue_new();
   self->front_cache_size = options->front_cache_size;
+  /* rewound messages that are not kept in memory are read again from the disk */
+  self->super.super.costly_rewind = TRUE;
   _set_virtual_functions(self);
   return &self->super.super;
 }
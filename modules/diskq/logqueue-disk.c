@@ -31,6 +31,7 @@
 #include "reloc.h"
 #include "qdisk.h"
 #include "scratch-buffers.h"
+#include "timeutils/misc.h"
 
 #include <sys/types.h>
 #include <sys/stat.h>
@@ -82,6 +83,48 @@ log_queue_disk_start(LogQueue *s)
   return FALSE;
 }
 
+static void
+_arm_sync_timer(LogQueueDisk *self)
+{
+  iv_validate_now();
+  self->sync_timer.expires = iv_now;
+  timespec_add_msec(&self->sync_timer.expires, qdisk_get_options(self->qdisk)->sync_interval);
+  iv_timer_register(&self->sync_timer);
+}
+
+static void
+_sync_timer_expired(gpointer s)
+{
+  LogQueueDisk *self = (LogQueueDisk *) s;
+
+  g_mutex_lock(&self->super.lock);
+  qdisk_sync_if_interval_elapsed(self->qdisk);
+  g_mutex_unlock(&self->super.lock);
+
+  _arm_sync_timer(self);
+}
+
+/*
+ * sync-interval() is checked whenever records are written, this timer
+ * covers the records written right before the traffic stopped. It has to
+ * be started and stopped from the main thread.
+ */
+void
+log_queue_disk_start_sync_timer(LogQueueDisk *self)
+{
+  if (qdisk_get_options(self->qdisk)->sync_interval <= 0 || iv_timer_registered(&self->sync_timer))
+    return;
+
+  _arm_sync_timer(self);
+}
+
+void
+log_queue_disk_stop_sync_timer(LogQueueDisk *self)
+{
+  if (iv_timer_registered(&self->sync_timer))
+    iv_timer_unregister(&self->sync_timer);
+}
+
 const gchar *
 log_queue_disk_get_filename(LogQueue *s)
 {
@@ -117,6 +160,22 @@ _unregister_counters(LogQueueDisk *self)
 
         stats_cluster_key_free(self->metrics.disk_allocated_sc_key);
       }
+
+    if (self->metrics.compression_input_sc_key)
+      {
+        stats_unregister_counter(self->metrics.compression_input_sc_key, SC_TYPE_SINGLE_VALUE,
+                                 &self->metrics.compression_input);
+
+        stats_cluster_key_free(self->metrics.compression_input_sc_key);
+      }
+
+    if (self->metrics.compression_output_sc_key)
+      {
+        stats_unregister_counter(self->metrics.compression_output_sc_key, SC_TYPE_SINGLE_VALUE,
+                                 &self->metrics.compression_output);
+
+        stats_cluster_key_free(self->metrics.compression_output_sc_key);
+      }
   }
   stats_unlock();
 }
@@ -125,6 +184,7 @@ void
 log_queue_disk_free_method(LogQueueDisk *self)
 {
   g_assert(!qdisk_started(self->qdisk));
+  g_assert(!iv_timer_registered(&self->sync_timer));
   qdisk_free(self->qdisk);
 
   _unregister_counters(self);
@@ -137,6 +197,8 @@ log_queue_disk_update_disk_related_counters(LogQueueDisk *self)
 {
   stats_counter_set(self->metrics.disk_usage, B_TO_KiB(qdisk_get_used_useful_space(self->qdisk)));
   stats_counter_set(self->metrics.disk_allocated, B_TO_KiB(qdisk_get_file_size(self->qdisk)));
+  stats_counter_set(self->metrics.compression_input, B_TO_KiB(qdisk_get_compression_input_bytes(self->qdisk)));
+  stats_counter_set(self->metrics.compression_output, B_TO_KiB(qdisk_get_compression_output_bytes(self->qdisk)));
 }
 
 static gboolean
@@ -353,7 +415,8 @@ log_queue_disk_restart_corrupted(LogQueueDisk *self)
 }
 
 static void
-_register_counters(LogQueueDisk *self, gint stats_level, StatsClusterKeyBuilder *builder)
+_register_counters(LogQueueDisk *self, gint stats_level, StatsClusterKeyBuilder *builder,
+                   DiskQueueOptions *options)
 {
   if (!builder)
     return;
@@ -371,6 +434,16 @@ _register_counters(LogQueueDisk *self, gint stats_level, StatsClusterKeyBuilder
 
     stats_cluster_key_builder_set_name(builder, "disk_allocated_bytes");
     self->metrics.disk_allocated_sc_key = stats_cluster_key_builder_build_single(builder);
+
+    /* their ratio is the compression ratio of the records written to the file */
+    if (options->compression != DISKQ_COMPRESSION_NONE)
+      {
+        stats_cluster_key_builder_set_name(builder, "compression_input_bytes");
+        self->metrics.compression_input_sc_key = stats_cluster_key_builder_build_single(builder);
+
+        stats_cluster_key_builder_set_name(builder, "compression_output_bytes");
+        self->metrics.compression_output_sc_key = stats_cluster_key_builder_build_single(builder);
+      }
   }
   stats_cluster_key_builder_pop(builder);
 
@@ -382,6 +455,14 @@ _register_counters(LogQueueDisk *self, gint stats_level, StatsClusterKeyBuilder
                            &self->metrics.disk_usage);
     stats_register_counter(stats_level, self->metrics.disk_allocated_sc_key, SC_TYPE_SINGLE_VALUE,
                            &self->metrics.disk_allocated);
+
+    if (self->metrics.compression_input_sc_key)
+      {
+        stats_register_counter(stats_level, self->metrics.compression_input_sc_key, SC_TYPE_SINGLE_VALUE,
+                               &self->metrics.compression_input);
+        stats_register_counter(stats_level, self->metrics.compression_output_sc_key, SC_TYPE_SINGLE_VALUE,
+                               &self->metrics.compression_output);
+      }
   }
   stats_unlock();
 }
@@ -405,9 +486,15 @@ log_queue_disk_init_instance(LogQueueDisk *self, DiskQueueOptions *options, cons
   self->super.type = log_queue_disk_type;
 
   self->compaction = options->compaction;
+  self->compact_format = options->compact_format;
 
   self->qdisk = qdisk_new(options, qdisk_file_id, filename);
-  _register_counters(self, stats_level, queue_sck_builder);
+
+  IV_TIMER_INIT(&self->sync_timer);
+  self->sync_timer.cookie = self;
+  self->sync_timer.handler = _sync_timer_expired;
+
+  _register_counters(self, stats_level, queue_sck_builder, options);
 
   if (queue_sck_builder)
     stats_cluster_key_builder_pop(queue_sck_builder);
@@ -419,7 +506,14 @@ _serialize_msg(SerializeArchive *sa, gpointer user_data)
   LogQueueDisk *self = ((gpointer *) user_data)[0];
   LogMessage *msg = ((gpointer *) user_data)[1];
 
-  return log_msg_serialize(msg, sa, self->compaction ? LMSF_COMPACTION : 0);
+  guint32 flags = 0;
+
+  if (self->compaction)
+    flags |= LMSF_COMPACTION;
+  if (self->compact_format)
+    flags |= LMSF_COMPACT_FORMAT;
+
+  return log_msg_serialize(msg, sa, flags);
 }
 
 gboolean
@@ -437,6 +531,7 @@ log_queue_disk_serialize_msg(LogQueueDisk *self, LogMessage *msg, GString *seria
       return FALSE;
     }
 
+  qdisk_compress_record(self->qdisk, serialized);
   return TRUE;
 }
 
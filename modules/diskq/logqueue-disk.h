@@ -29,6 +29,11 @@
 #include "qdisk.h"
 #include "logmsg/logmsg-serialize.h"
 
+#include <iv.h>
+
+/* number of messages serialized outside of the lock by the batched push_tail() implementations */
+#define LOG_QUEUE_DISK_BATCH_CHUNK_SIZE 64
+
 typedef struct _LogQueueDisk LogQueueDisk;
 
 struct _LogQueueDisk
@@ -46,13 +51,20 @@ struct _LogQueueDisk
     StatsClusterKey *capacity_sc_key;
     StatsClusterKey *disk_usage_sc_key;
     StatsClusterKey *disk_allocated_sc_key;
+    StatsClusterKey *compression_input_sc_key;
+    StatsClusterKey *compression_output_sc_key;
 
     StatsCounterItem *capacity;
     StatsCounterItem *disk_usage;
     StatsCounterItem *disk_allocated;
+    StatsCounterItem *compression_input;
+    StatsCounterItem *compression_output;
   } metrics;
 
   gboolean compaction;
+  gboolean compact_format;
+  /* syncs the written records if no further writes do it, see sync-interval() */
+  struct iv_timer sync_timer;
   gboolean (*start)(LogQueueDisk *s);
   gboolean (*stop)(LogQueueDisk *s, gboolean *persistent);
   gboolean (*stop_corrupted)(LogQueueDisk *s);
@@ -68,6 +80,8 @@ void log_queue_disk_init_instance(LogQueueDisk *self, DiskQueueOptions *options,
                                   StatsClusterKeyBuilder *driver_sck_builder,
                                   StatsClusterKeyBuilder *queue_sck_builder);
 void log_queue_disk_restart_corrupted(LogQueueDisk *self);
+void log_queue_disk_start_sync_timer(LogQueueDisk *self);
+void log_queue_disk_stop_sync_timer(LogQueueDisk *self);
 void log_queue_disk_free_method(LogQueueDisk *self);
 
 void log_queue_disk_update_disk_related_counters(LogQueueDisk *self);
@@ -30,6 +30,8 @@
 #include "reloc.h"
 #include "compat/lfs.h"
 #include "scratch-buffers.h"
+#include "str-utils.h"
+#include "diskq-compression.h"
 
 #include <fcntl.h>
 #include <sys/stat.h>
@@ -49,9 +51,23 @@
 
 #define MAX_RECORD_LENGTH 100 * 1024 * 1024
 
+/*
+ * The highest bit of the record length marks compressed records, whose
+ * payload starts with the algorithm (1 byte) and the uncompressed length of
+ * the payload (4 bytes, big-endian), followed by the compressed data.
+ */
+#define QDISK_RECORD_COMPRESSED 0x80000000
+#define QDISK_COMPRESSED_RECORD_HEADER_LENGTH 5
+
+/* smaller records are not worth compressing */
+#define QDISK_COMPRESSION_MIN_LENGTH 128
+
+/* a pending group is written out early once it grows larger than this */
+#define QDISK_WRITE_BUFFER_FLUSH_THRESHOLD (1024 * 1024)
+
 #define PATH_QDISK              PATH_LOCALSTATEDIR
 
-#define QDISK_HDR_VERSION_CURRENT 3
+#define QDISK_HDR_VERSION_CURRENT 4
 
 #define QDISK_FILENAME_PREFIX "syslog-ng-"
 #define QDISK_FILENAME_IDX_FMT "%05d"
@@ -90,6 +106,12 @@ typedef union _QDiskFileHeader
 
     guint8 use_v1_wrap_condition;
     gint64 capacity_bytes;
+
+    /* the last algorithm records were compressed with and the total size
+     * of the records before and after compression */
+    guint8 compression;
+    gint64 compression_input_bytes;
+    gint64 compression_output_bytes;
   };
   gchar _pad2[QDISK_RESERVED_SPACE];
 } QDiskFileHeader;
@@ -102,6 +124,22 @@ struct _QDisk
   gint64 cached_file_size;
   QDiskFileHeader *hdr;
   DiskQueueOptions *options;
+
+  /* records pushed in group-commit mode, not yet written to the file */
+  GString *write_buffer;
+  gint64 write_buffer_ofs;
+  gint64 write_buffer_records;
+  /* a group failed to be written since the last qdisk_commit() */
+  gboolean write_failed;
+
+  /* written since the last fdatasync() */
+  gint64 unsynced_records;
+  gint64 unsynced_bytes;
+  gint64 last_sync_time;
+
+  /* a chunk of the file read ahead of the read and backlog heads */
+  GString *read_buffer;
+  gint64 read_buffer_ofs;
 };
 
 #define QDISK_ERROR qdisk_error_quark()
@@ -422,6 +460,16 @@ _possible_size_reduction_reaches_truncate_threshold(QDisk *self, gint64 expected
   return possible_size_reduction >= truncate_threshold;
 }
 
+static inline void
+_invalidate_read_buffer(QDisk *self, gint64 ofs, gint64 len)
+{
+  if (!self->read_buffer || self->read_buffer->len == 0)
+    return;
+
+  if (ofs < self->read_buffer_ofs + (gint64) self->read_buffer->len && self->read_buffer_ofs < ofs + len)
+    g_string_truncate(self->read_buffer, 0);
+}
+
 static void
 _maybe_truncate_file(QDisk *self, gint64 expected_size)
 {
@@ -434,6 +482,8 @@ _maybe_truncate_file(QDisk *self, gint64 expected_size)
 
   msg_debug("Truncating queue file", evt_tag_str("filename", self->filename), evt_tag_long("new size", expected_size));
 
+  _invalidate_read_buffer(self, expected_size, G_MAXINT64 - expected_size);
+
   if (ftruncate(self->fd, (off_t) expected_size) == 0)
     {
       self->cached_file_size = expected_size;
@@ -687,10 +737,203 @@ qdisk_get_next_tail_position(QDisk *self)
   return self->hdr->write_head;
 }
 
+static gboolean
+_is_sync_interval_elapsed(QDisk *self)
+{
+  if (self->options->sync_interval <= 0)
+    return FALSE;
+
+  return g_get_monotonic_time() - self->last_sync_time >= (gint64) self->options->sync_interval * 1000;
+}
+
+static gboolean
+_is_sync_policy_configured(QDisk *self)
+{
+  return self->options->sync_records > 0 || self->options->sync_bytes > 0 || self->options->sync_interval > 0;
+}
+
+static gboolean
+_is_sync_needed(QDisk *self)
+{
+  if (self->unsynced_records == 0)
+    return FALSE;
+
+  if (self->options->sync_records > 0 && self->unsynced_records >= self->options->sync_records)
+    return TRUE;
+
+  if (self->options->sync_bytes > 0 && self->unsynced_bytes >= self->options->sync_bytes)
+    return TRUE;
+
+  return _is_sync_interval_elapsed(self);
+}
+
+static void
+_sync_file(QDisk *self)
+{
+  if (fdatasync(self->fd) < 0)
+    msg_error("Error syncing disk-queue file",
+              evt_tag_str("filename", self->filename),
+              evt_tag_error("error"));
+
+  self->unsynced_records = 0;
+  self->unsynced_bytes = 0;
+  self->last_sync_time = g_get_monotonic_time();
+}
+
+static void
+_records_written(QDisk *self, gint64 num_records, gint64 num_bytes)
+{
+  self->unsynced_records += num_records;
+  self->unsynced_bytes += num_bytes;
+
+  if (_is_sync_needed(self))
+    _sync_file(self);
+}
+
+/*
+ * Syncs the records that were written since the last sync, if sync-interval()
+ * elapsed since then. Called periodically by the queue, so written records
+ * are synced even if no further records arrive.
+ */
+void
+qdisk_sync_if_interval_elapsed(QDisk *self)
+{
+  if (!qdisk_started(self) || self->unsynced_records == 0)
+    return;
+
+  if (_is_sync_interval_elapsed(self))
+    _sync_file(self);
+}
+
+static gboolean
+_flush_write_buffer(QDisk *self)
+{
+  if (!self->write_buffer || self->write_buffer->len == 0)
+    return TRUE;
+
+  _invalidate_read_buffer(self, self->write_buffer_ofs, self->write_buffer->len);
+  gboolean success = pwrite_strict(self->fd, self->write_buffer->str, self->write_buffer->len,
+                                   self->write_buffer_ofs);
+  if (!success)
+    {
+      msg_error("Error writing disk-queue file",
+                evt_tag_str("filename", self->filename),
+                evt_tag_long("offset", self->write_buffer_ofs),
+                evt_tag_long("length", self->write_buffer->len),
+                evt_tag_error("error"));
+
+      /* the header already counts the buffered records, forget them */
+      self->hdr->write_head = self->write_buffer_ofs;
+      self->hdr->length -= self->write_buffer_records;
+      self->write_failed = TRUE;
+    }
+
+  g_string_truncate(self->write_buffer, 0);
+  self->write_buffer_records = 0;
+  return success;
+}
+
+static gboolean
+_commit_write_buffer(QDisk *self)
+{
+  if (!self->write_buffer || self->write_buffer->len == 0)
+    return TRUE;
+
+  gint64 num_bytes = self->write_buffer->len;
+  gint64 num_records = self->write_buffer_records;
+
+  if (!_flush_write_buffer(self))
+    return FALSE;
+
+  _records_written(self, num_records, num_bytes);
+  return TRUE;
+}
+
+static gboolean
+_is_record_contiguous_with_write_buffer(QDisk *self)
+{
+  return self->write_buffer->len == 0
+         || self->write_buffer_ofs + self->write_buffer->len == self->hdr->write_head;
+}
+
+static gboolean
+_write_record(QDisk *self, GString *record)
+{
+  if (!self->options->group_commit)
+    {
+      _invalidate_read_buffer(self, self->hdr->write_head, record->len);
+      if (!pwrite_strict(self->fd, record->str, record->len, self->hdr->write_head))
+        {
+          msg_error("Error writing disk-queue file",
+                    evt_tag_error("error"));
+          return FALSE;
+        }
+      _records_written(self, 1, record->len);
+      return TRUE;
+    }
+
+  /* the record is written later, by qdisk_commit(), together with the
+   * rest of the group. The group has to be written out first if this
+   * record is placed elsewhere, e.g. after wrapping.
+   */
+  if (!self->write_buffer)
+    self->write_buffer = g_string_sized_new(QDISK_WRITE_BUFFER_FLUSH_THRESHOLD);
+
+  if (!_is_record_contiguous_with_write_buffer(self) && !_commit_write_buffer(self))
+    return FALSE;
+
+  if (self->write_buffer->len == 0)
+    self->write_buffer_ofs = self->hdr->write_head;
+
+  g_string_append_len(self->write_buffer, record->str, record->len);
+  self->write_buffer_records++;
+  return TRUE;
+}
+
+/*
+ * Writes the records pushed since the last commit with a single write, and
+ * syncs the file if the configured sync policy requires it.
+ *
+ * In group-commit mode the queue has to call this once it finished pushing
+ * a batch, before releasing its lock. Reading operations write the
+ * pending records themselves, so positions never refer to unwritten data,
+ * but a failure is only reported by the next qdisk_commit().
+ *
+ * Returns FALSE if any record pushed since the last commit was lost. The
+ * heads are rolled back over the lost records and further pushes fail until
+ * this is called, so the queue can drop every message it pushed since.
+ */
+gboolean
+qdisk_commit(QDisk *self)
+{
+  gboolean success = _commit_write_buffer(self) && !self->write_failed;
+
+  self->write_failed = FALSE;
+  return success;
+}
+
+static void
+_account_compression(QDisk *self, GString *record)
+{
+  guint32 record_length;
+  guint32 uncompressed_length = record->len - sizeof(record_length);
+
+  memcpy(&record_length, record->str, sizeof(record_length));
+  if (GUINT32_FROM_BE(record_length) & QDISK_RECORD_COMPRESSED)
+    {
+      memcpy(&uncompressed_length, record->str + sizeof(record_length) + 1, sizeof(uncompressed_length));
+      uncompressed_length = GUINT32_FROM_BE(uncompressed_length);
+      self->hdr->compression = (guint8) record->str[sizeof(record_length)];
+    }
+
+  self->hdr->compression_input_bytes += uncompressed_length + sizeof(record_length);
+  self->hdr->compression_output_bytes += record->len;
+}
+
 gboolean
 qdisk_push_tail(QDisk *self, GString *record)
 {
-  if (!qdisk_started(self))
+  if (!qdisk_started(self) || self->write_failed)
     return FALSE;
 
   if (_could_not_wrap_write_head_last_push_but_now_can(self))
@@ -706,12 +949,10 @@ qdisk_push_tail(QDisk *self, GString *record)
   if (!qdisk_is_space_avail(self, record->len))
     return FALSE;
 
-  if (!pwrite_strict(self->fd, record->str, record->len, self->hdr->write_head))
-    {
-      msg_error("Error writing disk-queue file",
-                evt_tag_error("error"));
-      return FALSE;
-    }
+  if (!_write_record(self, record))
+    return FALSE;
+
+  _account_compression(self, record);
 
   self->hdr->write_head = self->hdr->write_head + record->len;
 
@@ -765,15 +1006,75 @@ qdisk_push_tail(QDisk *self, GString *record)
         }
     }
   self->hdr->length++;
+
+  if (self->write_buffer && self->write_buffer->len >= QDISK_WRITE_BUFFER_FLUSH_THRESHOLD
+      && !_commit_write_buffer(self))
+    return FALSE;
+
+  return TRUE;
+}
+
+static inline gboolean
+_is_read_buffer_covering(QDisk *self, gint64 position, gsize count)
+{
+  return self->read_buffer
+         && position >= self->read_buffer_ofs
+         && position + count <= self->read_buffer_ofs + self->read_buffer->len;
+}
+
+static gboolean
+_fill_read_buffer(QDisk *self, gint64 position)
+{
+  if (!self->read_buffer)
+    self->read_buffer = g_string_sized_new(self->options->readahead_size);
+
+  g_string_set_size(self->read_buffer, self->options->readahead_size);
+  gssize bytes_read = pread(self->fd, self->read_buffer->str, self->options->readahead_size, position);
+  if (bytes_read < 0)
+    {
+      g_string_truncate(self->read_buffer, 0);
+      return FALSE;
+    }
+
+  g_string_truncate(self->read_buffer, bytes_read);
+  self->read_buffer_ofs = position;
   return TRUE;
 }
 
+/*
+ * Records are read sequentially both by the read head and (when acking or
+ * rewinding) by the backlog head, so instead of two small reads per
+ * record, a large chunk is read ahead and records are copied out of it.
+ * The unread and unacked data never changes, writes and truncation
+ * invalidate the chunk if they touch the region it covers.
+ */
+static gssize
+_read_from_disk(QDisk *self, gpointer buf, gsize count, gint64 position)
+{
+  if (self->options->readahead_size <= 0 || count > (gsize) self->options->readahead_size)
+    return pread(self->fd, buf, count, position);
+
+  if (!_is_read_buffer_covering(self, position, count))
+    {
+      if (!_fill_read_buffer(self, position))
+        return -1;
+
+      /* short read, at the end of the file */
+      count = MIN(count, self->read_buffer->len);
+    }
+
+  memcpy(buf, self->read_buffer->str + (position - self->read_buffer_ofs), count);
+  return count;
+}
+
 static inline gssize
-_read_record_length_from_disk(QDisk *self, gint64 position, guint32 *record_length)
+_read_record_length_from_disk(QDisk *self, gint64 position, guint32 *record_length, gboolean *compressed)
 {
-  gssize bytes_read = pread(self->fd, (gchar *)record_length, sizeof(guint32), position);
+  gssize bytes_read = _read_from_disk(self, (gchar *)record_length, sizeof(guint32), position);
 
   *record_length = GUINT32_FROM_BE(*record_length);
+  *compressed = !!(*record_length & QDISK_RECORD_COMPRESSED);
+  *record_length &= ~QDISK_RECORD_COMPRESSED;
 
   return bytes_read;
 }
@@ -818,15 +1119,18 @@ _is_record_length_valid(QDisk *self, gssize bytes_read, guint32 record_length, g
 }
 
 static inline gboolean
-_try_reading_record_length(QDisk *self, gint64 position, guint32 *record_length)
+_try_reading_record_length(QDisk *self, gint64 position, guint32 *record_length, gboolean *compressed)
 {
   guint32 read_record_length;
-  gssize bytes_read = _read_record_length_from_disk(self, position, &read_record_length);
+  gboolean read_compressed;
+  gssize bytes_read = _read_record_length_from_disk(self, position, &read_record_length, &read_compressed);
 
   if (!_is_record_length_valid(self, bytes_read, read_record_length, position))
     return FALSE;
 
   *record_length = read_record_length;
+  if (compressed)
+    *compressed = read_compressed;
   return TRUE;
 }
 
@@ -835,7 +1139,7 @@ _read_record_from_disk(QDisk *self, GString *record, guint32 record_length)
 {
   g_string_set_size(record, record_length);
 
-  gssize bytes_read = pread(self->fd, record->str, record_length, self->hdr->read_head + sizeof(record_length));
+  gssize bytes_read = _read_from_disk(self, record->str, record_length, self->hdr->read_head + sizeof(record_length));
   if (bytes_read != record_length)
     {
       msg_error("Error reading disk-queue file",
@@ -849,6 +1153,59 @@ _read_record_from_disk(QDisk *self, GString *record, guint32 record_length)
   return TRUE;
 }
 
+static gboolean
+_decompress_record(QDisk *self, GString *record)
+{
+  guint32 uncompressed_length;
+
+  if (record->len <= QDISK_COMPRESSED_RECORD_HEADER_LENGTH)
+    goto error;
+
+  DiskQueueCompression compression = (guint8) record->str[0];
+  memcpy(&uncompressed_length, record->str + 1, sizeof(uncompressed_length));
+  uncompressed_length = GUINT32_FROM_BE(uncompressed_length);
+
+  if (_is_record_length_reached_hard_limit(uncompressed_length))
+    goto error;
+
+  ScratchBuffersMarker marker;
+  GString *decompressed = scratch_buffers_alloc_and_mark(&marker);
+  if (!diskq_decompress(compression, record->str + QDISK_COMPRESSED_RECORD_HEADER_LENGTH,
+                        record->len - QDISK_COMPRESSED_RECORD_HEADER_LENGTH, uncompressed_length, decompressed))
+    {
+      scratch_buffers_reclaim_marked(marker);
+      goto error;
+    }
+
+  g_string_assign_len(record, decompressed->str, decompressed->len);
+  scratch_buffers_reclaim_marked(marker);
+  return TRUE;
+
+error:
+  msg_error("Error decompressing record of disk-queue file",
+            evt_tag_str("filename", self->filename),
+            evt_tag_str("compression", diskq_compression_name((guint8) record->str[0])),
+            evt_tag_long("offset", self->hdr->read_head));
+  return FALSE;
+}
+
+static gboolean
+_read_record(QDisk *self, GString *record, guint32 *record_length)
+{
+  gboolean compressed;
+
+  if (!_try_reading_record_length(self, self->hdr->read_head, record_length, &compressed))
+    return FALSE;
+
+  if (!_read_record_from_disk(self, record, *record_length))
+    return FALSE;
+
+  if (compressed && !_decompress_record(self, record))
+    return FALSE;
+
+  return TRUE;
+}
+
 static inline void
 _maybe_apply_non_reliable_corrections(QDisk *self)
 {
@@ -885,6 +1242,8 @@ qdisk_get_next_head_position(QDisk *self)
 gboolean
 qdisk_peek_head(QDisk *self, GString *record)
 {
+  _commit_write_buffer(self);
+
   if (self->hdr->read_head == self->hdr->write_head)
     return FALSE;
 
@@ -892,10 +1251,7 @@ qdisk_peek_head(QDisk *self, GString *record)
     self->hdr->read_head = _correct_position_if_max_size_is_reached(self, self->hdr->read_head);
 
   guint32 record_length;
-  if (!_try_reading_record_length(self, self->hdr->read_head, &record_length))
-    return FALSE;
-
-  if (!_read_record_from_disk(self, record, record_length))
+  if (!_read_record(self, record, &record_length))
     return FALSE;
 
   return TRUE;
@@ -904,6 +1260,8 @@ qdisk_peek_head(QDisk *self, GString *record)
 gboolean
 qdisk_pop_head(QDisk *self, GString *record)
 {
+  _commit_write_buffer(self);
+
   if (self->hdr->read_head == self->hdr->write_head)
     return FALSE;
 
@@ -911,10 +1269,7 @@ qdisk_pop_head(QDisk *self, GString *record)
     self->hdr->read_head = _correct_position_if_max_size_is_reached(self, self->hdr->read_head);
 
   guint32 record_length;
-  if (!_try_reading_record_length(self, self->hdr->read_head, &record_length))
-    return FALSE;
-
-  if (!_read_record_from_disk(self, record, record_length))
+  if (!_read_record(self, record, &record_length))
     return FALSE;
 
   _update_position_after_read(self, record_length, &self->hdr->read_head);
@@ -928,6 +1283,8 @@ qdisk_pop_head(QDisk *self, GString *record)
 static gboolean
 _skip_record(QDisk *self, gint64 position, gint64 *new_position)
 {
+  _commit_write_buffer(self);
+
   if (position == self->hdr->write_head)
     return FALSE;
 
@@ -937,7 +1294,7 @@ _skip_record(QDisk *self, gint64 position, gint64 *new_position)
   *new_position = position;
 
   guint32 record_length;
-  if (!_try_reading_record_length(self, *new_position, &record_length))
+  if (!_try_reading_record_length(self, *new_position, &record_length, NULL))
     return FALSE;
 
   _update_position_after_read(self, record_length, new_position);
@@ -1019,6 +1376,41 @@ _overwrite_with_real_record_length(GString *serialized)
   return TRUE;
 }
 
+/*
+ * Compresses a record produced by qdisk_serialize() in place, if
+ * compression is enabled and it makes the record smaller. It does not
+ * touch the state of the queue, so it can be called without holding the
+ * lock of the queue.
+ */
+void
+qdisk_compress_record(QDisk *self, GString *record)
+{
+  DiskQueueCompression compression = self->options->compression;
+  gsize payload_length = record->len - sizeof(guint32);
+
+  if (compression == DISKQ_COMPRESSION_NONE || payload_length < QDISK_COMPRESSION_MIN_LENGTH)
+    return;
+
+  ScratchBuffersMarker marker;
+  GString *compressed = scratch_buffers_alloc_and_mark(&marker);
+
+  guint32 record_length = 0;
+  guint32 uncompressed_length = GUINT32_TO_BE(payload_length);
+  g_string_append_len(compressed, (gchar *) &record_length, sizeof(record_length));
+  g_string_append_c(compressed, compression);
+  g_string_append_len(compressed, (gchar *) &uncompressed_length, sizeof(uncompressed_length));
+
+  if (diskq_compress(compression, record->str + sizeof(guint32), payload_length, compressed)
+      && compressed->len < record->len)
+    {
+      record_length = GUINT32_TO_BE((compressed->len - sizeof(record_length)) | QDISK_RECORD_COMPRESSED);
+      g_string_overwrite_len(compressed, 0, (gchar *) &record_length, sizeof(record_length));
+      g_string_assign_len(record, compressed->str, compressed->len);
+    }
+
+  scratch_buffers_reclaim_marked(marker);
+}
+
 gboolean
 qdisk_serialize(GString *serialized, QDiskSerializeFunc serialize_func, gpointer user_data, GError **error)
 {
@@ -1358,6 +1750,9 @@ _close_file(QDisk *self)
     }
 
   self->cached_file_size = 0;
+
+  if (self->read_buffer)
+    g_string_truncate(self->read_buffer, 0);
 }
 
 static void
@@ -1381,6 +1776,8 @@ _ensure_header_byte_order(QDisk *self)
       self->hdr->backlog_head = GUINT64_SWAP_LE_BE(self->hdr->backlog_head);
       self->hdr->backlog_len = GUINT64_SWAP_LE_BE(self->hdr->backlog_len);
       self->hdr->capacity_bytes = GUINT64_SWAP_LE_BE(self->hdr->capacity_bytes);
+      self->hdr->compression_input_bytes = GUINT64_SWAP_LE_BE(self->hdr->compression_input_bytes);
+      self->hdr->compression_output_bytes = GUINT64_SWAP_LE_BE(self->hdr->compression_output_bytes);
       self->hdr->big_endian = (G_BYTE_ORDER == G_BIG_ENDIAN);
     }
 }
@@ -1410,6 +1807,10 @@ _open_file(const gchar *filename, gboolean read_only, gint *fd)
       return FALSE;
     }
 
+#ifdef POSIX_FADV_SEQUENTIAL
+  posix_fadvise(local_fd, 0, 0, POSIX_FADV_SEQUENTIAL);
+#endif
+
   *fd = local_fd;
   return TRUE;
 }
@@ -1451,6 +1852,9 @@ _create_header(QDisk *self)
   self->hdr->length = 0;
   self->hdr->use_v1_wrap_condition = FALSE;
   self->hdr->capacity_bytes = self->options->capacity_bytes;
+  self->hdr->compression = self->options->compression;
+  self->hdr->compression_input_bytes = 0;
+  self->hdr->compression_output_bytes = 0;
 
   return TRUE;
 }
@@ -1482,6 +1886,13 @@ _upgrade_header(QDisk *self)
       self->hdr->capacity_bytes = self->options->capacity_bytes;
     }
 
+  if (self->hdr->version < 4)
+    {
+      self->hdr->compression = DISKQ_COMPRESSION_NONE;
+      self->hdr->compression_input_bytes = 0;
+      self->hdr->compression_output_bytes = 0;
+    }
+
   self->hdr->version = QDISK_HDR_VERSION_CURRENT;
 }
 
@@ -1749,7 +2160,12 @@ qdisk_stop(QDisk *self, GQueue *front_cache, GQueue *backlog, GQueue *flow_contr
   gboolean result = TRUE;
 
   if (!self->options->read_only)
-    result = _save_state(self, front_cache, backlog, flow_control_window);
+    {
+      result = qdisk_commit(self) && _save_state(self, front_cache, backlog, flow_control_window);
+
+      if (self->unsynced_records > 0 && _is_sync_policy_configured(self))
+        _sync_file(self);
+    }
 
   _close_file(self);
 
@@ -1799,6 +2215,24 @@ qdisk_get_file_size(QDisk *self)
   return self->cached_file_size;
 }
 
+DiskQueueCompression
+qdisk_get_compression(QDisk *self)
+{
+  return self->hdr->compression;
+}
+
+gint64
+qdisk_get_compression_input_bytes(QDisk *self)
+{
+  return self->hdr->compression_input_bytes;
+}
+
+gint64
+qdisk_get_compression_output_bytes(QDisk *self)
+{
+  return self->hdr->compression_output_bytes;
+}
+
 gint64
 qdisk_get_writer_head(QDisk *self)
 {
@@ -1839,6 +2273,10 @@ void
 qdisk_free(QDisk *self)
 {
   self->options = NULL;
+  if (self->write_buffer)
+    g_string_free(self->write_buffer, TRUE);
+  if (self->read_buffer)
+    g_string_free(self->read_buffer, TRUE);
   g_free(self->filename);
   g_free(self);
 }
@@ -1851,6 +2289,7 @@ qdisk_new(DiskQueueOptions *options, const gchar *file_id, const gchar *filename
   self->fd = -1;
   self->cached_file_size = 0;
   self->options = options;
+  self->last_sync_time = g_get_monotonic_time();
 
   self->file_id = file_id;
   self->filename = g_strdup(filename);
@@ -61,6 +61,8 @@ gint64 qdisk_get_max_useful_space(QDisk *self);
 gint64 qdisk_get_empty_space(QDisk *self);
 gint64 qdisk_get_used_useful_space(QDisk *self);
 gboolean qdisk_push_tail(QDisk *self, GString *record);
+gboolean qdisk_commit(QDisk *self);
+void qdisk_sync_if_interval_elapsed(QDisk *self);
 gboolean qdisk_pop_head(QDisk *self, GString *record);
 gboolean qdisk_peek_head(QDisk *self, GString *record);
 gboolean qdisk_remove_head(QDisk *self);
@@ -86,11 +88,15 @@ gint qdisk_get_flow_control_window_bytes(QDisk *self);
 gboolean qdisk_is_read_only(QDisk *self);
 const gchar *qdisk_get_filename(QDisk *self);
 gint64 qdisk_get_file_size(QDisk *self);
+DiskQueueCompression qdisk_get_compression(QDisk *self);
+gint64 qdisk_get_compression_input_bytes(QDisk *self);
+gint64 qdisk_get_compression_output_bytes(QDisk *self);
 
 gchar *qdisk_get_next_filename(const gchar *dir, gboolean reliable);
 gboolean qdisk_is_file_a_disk_buffer_file(const gchar *filename);
 gboolean qdisk_is_disk_buffer_file_reliable(const gchar *filename, gboolean *reliable);
 
+void qdisk_compress_record(QDisk *self, GString *record);
 gboolean qdisk_serialize(GString *serialized, QDiskSerializeFunc serialize_func, gpointer user_data, GError **error);
 gboolean qdisk_deserialize(GString *serialized, QDiskDeSerializeFunc deserialize_func, gpointer user_data,
                            GError **error);
@@ -534,6 +534,132 @@ ParameterizedTest(diskq_tester_parameters_t *parameters, diskq, test_diskq_stati
   disk_queue_options_destroy(&options);
 }
 
+static void
+_feed_numbered_messages(LogQueue *q, gint first, gint n)
+{
+  LogPathOptions path_options = LOG_PATH_OPTIONS_INIT;
+
+  path_options.flow_control_requested = TRUE;
+  for (gint i = first; i < first + n; i++)
+    {
+      LogMessage *msg = log_msg_new_empty();
+      gchar seq[16];
+
+      g_snprintf(seq, sizeof(seq), "%d", i);
+      log_msg_set_value_by_name(msg, "SEQ", seq, -1);
+      log_queue_push_tail(q, msg, &path_options);
+    }
+}
+
+static void
+_assert_pop_numbered_batch(LogQueue *q, gint max_count, gint first, gint expected_count)
+{
+  LogMessage *msgs[max_count];
+  LogPathOptions path_options[max_count];
+
+  gint count = log_queue_pop_head_batch(q, msgs, path_options, max_count);
+  cr_assert_eq(count, expected_count, "popped messages: %d, expected: %d", count, expected_count);
+
+  for (gint i = 0; i < count; i++)
+    {
+      cr_assert_eq(atoi(log_msg_get_value_by_name(msgs[i], "SEQ", NULL)), first + i);
+      if (path_options[i].ack_needed)
+        log_msg_ack(msgs[i], &path_options[i], AT_PROCESSED);
+      log_msg_unref(msgs[i]);
+    }
+}
+
+ParameterizedTestParameters(diskq, test_diskq_batch_pop_and_rewind)
+{
+  static diskq_tester_parameters_t test_cases[] =
+  {
+    { .disk_size = 500*1024, .reliable = TRUE, .front_cache_size = 0, .filename = "batch-reliable.rqf" },
+    { .disk_size = 500*1024, .reliable = FALSE, .front_cache_size = 0, .filename = "batch-non-reliable.qf" },
+    { .disk_size = 500*1024, .reliable = FALSE, .front_cache_size = 16, .filename = "batch-front-cache.qf" },
+  };
+
+  return cr_make_param_array(diskq_tester_parameters_t, test_cases, sizeof(test_cases) / sizeof(test_cases[0]));
+}
+
+ParameterizedTest(diskq_tester_parameters_t *parameters, diskq, test_diskq_batch_pop_and_rewind)
+{
+  DiskQueueOptions options = {0};
+  LogQueue *q = testcase_diskq_prepare(&options, parameters);
+
+  _feed_numbered_messages(q, 0, 100);
+  cr_assert_eq(stats_counter_get(q->metrics.shared.queued_messages), 100, "queued messages: line: %d", __LINE__);
+
+  _assert_pop_numbered_batch(q, 32, 0, 32);
+  cr_assert_eq(stats_counter_get(q->metrics.shared.queued_messages), 68, "queued messages: line: %d", __LINE__);
+  cr_assert_eq(log_queue_get_length(q), 68);
+
+  /* the first 10 were delivered, the rest of the batch goes back in order */
+  log_queue_ack_backlog(q, 10);
+  log_queue_rewind_backlog(q, 22);
+  cr_assert_eq(stats_counter_get(q->metrics.shared.queued_messages), 90, "queued messages: line: %d", __LINE__);
+  cr_assert_eq(log_queue_get_length(q), 90);
+
+  _assert_pop_numbered_batch(q, 50, 10, 50);
+  log_queue_rewind_backlog_all(q);
+  cr_assert_eq(log_queue_get_length(q), 90);
+
+  _assert_pop_numbered_batch(q, 100, 10, 90);
+  cr_assert_eq(stats_counter_get(q->metrics.shared.queued_messages), 0, "queued messages: line: %d", __LINE__);
+  log_queue_ack_backlog(q, 90);
+
+  unlink(parameters->filename);
+
+  gboolean persistent;
+  log_queue_disk_stop(q, &persistent);
+  log_queue_unref(q);
+  disk_queue_options_destroy(&options);
+}
+
+Test(diskq, test_diskq_prefetch_rewinds_only_what_was_not_handed_out)
+{
+  diskq_tester_parameters_t parameters = { .disk_size = 500*1024, .reliable = TRUE, .filename = "prefetch.rqf" };
+  DiskQueueOptions options = {0};
+  LogQueue *q = testcase_diskq_prepare(&options, &parameters);
+  LogPathOptions path_options = LOG_PATH_OPTIONS_INIT;
+  LogQueuePrefetch prefetch = { 0 };
+
+  _feed_numbered_messages(q, 0, 100);
+  log_queue_set_throttle(q, 50);
+
+  for (gint i = 0; i < 5; i++)
+    {
+      LogMessage *msg = log_queue_prefetch_pop(&prefetch, q, &path_options, LOG_QUEUE_PREFETCH_SIZE, FALSE);
+      cr_assert_eq(atoi(log_msg_get_value_by_name(msg, "SEQ", NULL)), i);
+      log_msg_unref(msg);
+    }
+  cr_assert_eq(log_queue_prefetch_get_pending(&prefetch), LOG_QUEUE_PREFETCH_SIZE - 5);
+
+  /* the messages not handed out give back their throttle tokens */
+  log_queue_prefetch_rewind(&prefetch, q);
+  cr_assert_eq(log_queue_get_length(q), 95);
+  cr_assert_eq(q->throttle_buckets, 45);
+  log_queue_ack_backlog(q, 5);
+
+  /* the next batch is only as large as what the consumer took last time */
+  LogMessage *msg = log_queue_prefetch_pop(&prefetch, q, &path_options, LOG_QUEUE_PREFETCH_SIZE, FALSE);
+  cr_assert_eq(atoi(log_msg_get_value_by_name(msg, "SEQ", NULL)), 5);
+  cr_assert_eq(log_queue_prefetch_get_pending(&prefetch), 4);
+  log_msg_unref(msg);
+  log_queue_prefetch_rewind(&prefetch, q);
+  log_queue_ack_backlog(q, 1);
+
+  cr_assert_eq(log_queue_get_length(q), 94);
+  _assert_pop_numbered_batch(q, 100, 6, 44);
+  log_queue_ack_backlog(q, 44);
+
+  unlink(parameters.filename);
+
+  gboolean persistent;
+  log_queue_disk_stop(q, &persistent);
+  log_queue_unref(q);
+  disk_queue_options_destroy(&options);
+}
+
 gchar *
 qdisk_get_next_filename(const gchar *dir, gboolean reliable)
 {
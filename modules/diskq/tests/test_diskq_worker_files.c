@@ -0,0 +1,115 @@
+/*
+ * Copyright (c) 2024 Balabit
+ *
+ * This program is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License version 2 as published
+ * by the Free Software Foundation, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+ *
+ * As an additional exemption you are allowed to compile & link against the
+ * OpenSSL libraries as published by the OpenSSL project. See the file
+ * COPYING for details.
+ *
+ */
+
+#include <criterion/criterion.h>
+#include "libtest/persist_lib.h"
+
+#include "diskq-worker-files.h"
+#include "apphook.h"
+
+static void
+assert_destination(const gchar *persist_name, const gchar *expected_destination, gint expected_worker_index)
+{
+  gint worker_index = -1;
+  gchar *destination = diskq_worker_files_get_destination(persist_name, &worker_index);
+
+  cr_assert_str_eq(destination, expected_destination, "persist_name: %s", persist_name);
+  cr_assert_eq(worker_index, expected_worker_index, "persist_name: %s", persist_name);
+  g_free(destination);
+}
+
+Test(diskq_worker_files, destination_and_worker_index_from_persist_name)
+{
+  assert_destination("afsocket_dd_qfile(stream,localhost:514)", "afsocket_dd_qfile(stream,localhost:514)", 0);
+  assert_destination("d_http#0", "d_http#0", 0);
+  assert_destination("d_http#0.1.queue", "d_http#0", 1);
+  assert_destination("d_http#0.12.queue", "d_http#0", 12);
+
+  assert_destination("d_http#0.queue", "d_http#0.queue", 0);
+  assert_destination("d_http#0.0.queue", "d_http#0.0.queue", 0);
+  assert_destination("d_http#0.-1.queue", "d_http#0.-1.queue", 0);
+  assert_destination("d_http#0.first.queue", "d_http#0.first.queue", 0);
+  assert_destination("d_http#0..queue", "d_http#0..queue", 0);
+}
+
+static gboolean
+_holds_queue_file(PersistState *state, const gchar *persist_name)
+{
+  gchar *value = persist_state_lookup_string(state, persist_name, NULL, NULL);
+  gboolean result = value && g_str_has_suffix(value, "qf");
+
+  g_free(value);
+  return result;
+}
+
+static void
+assert_worker_file(GPtrArray *files, guint index, gint expected_worker_index, const gchar *expected_filename)
+{
+  DiskqWorkerFile *file = g_ptr_array_index(files, index);
+
+  cr_assert_eq(file->worker_index, expected_worker_index);
+  cr_assert_str_eq(file->filename, expected_filename);
+}
+
+Test(diskq_worker_files, queue_files_are_grouped_by_destination_and_ordered_by_worker)
+{
+  PersistState *state = clean_and_create_persist_state_for_test("test_diskq_worker_files.persist");
+
+  persist_state_alloc_string(state, "d_http#0.2.queue", "/var/lib/syslog-ng/syslog-ng-00003.qf", -1);
+  persist_state_alloc_string(state, "d_http#0", "/var/lib/syslog-ng/syslog-ng-00001.qf", -1);
+  persist_state_alloc_string(state, "d_http#0.1.queue", "/var/lib/syslog-ng/syslog-ng-00002.qf", -1);
+  persist_state_alloc_string(state, "afsocket_dd_qfile(stream,localhost:514)",
+                             "/var/lib/syslog-ng/syslog-ng-00000.rqf", -1);
+  persist_state_alloc_string(state, "affile_sd_curpos(/var/log/messages)", "not a queue file", -1);
+
+  GHashTable *destinations = diskq_worker_files_collect(state, _holds_queue_file);
+  cr_assert_eq(g_hash_table_size(destinations), 2);
+
+  GPtrArray *files = g_hash_table_lookup(destinations, "d_http#0");
+  cr_assert(files);
+  cr_assert_eq(files->len, 3);
+  assert_worker_file(files, 0, 0, "/var/lib/syslog-ng/syslog-ng-00001.qf");
+  assert_worker_file(files, 1, 1, "/var/lib/syslog-ng/syslog-ng-00002.qf");
+  assert_worker_file(files, 2, 2, "/var/lib/syslog-ng/syslog-ng-00003.qf");
+
+  files = g_hash_table_lookup(destinations, "afsocket_dd_qfile(stream,localhost:514)");
+  cr_assert(files);
+  cr_assert_eq(files->len, 1);
+  assert_worker_file(files, 0, 0, "/var/lib/syslog-ng/syslog-ng-00000.rqf");
+
+  g_hash_table_destroy(destinations);
+  cancel_and_destroy_persist_state(state);
+}
+
+static void
+setup(void)
+{
+  app_startup();
+}
+
+static void
+teardown(void)
+{
+  app_shutdown();
+}
+
+TestSuite(diskq_worker_files, .init = setup, .fini = teardown);
@@ -29,7 +29,9 @@
 #include "scratch-buffers.h"
 
 #include <unistd.h>
+#include <signal.h>
 #include <sys/stat.h>
+#include <sys/resource.h>
 #include <errno.h>
 
 /* QDisk-internal: the frame is a 4-byte integer */
@@ -377,6 +379,243 @@ Test(qdisk, prealloc)
   cleanup_qdisk(filename, qdisk);
 }
 
+static gint64
+_get_real_file_size(const gchar *filename)
+{
+  struct stat file_stats;
+  cr_assert(stat(filename, &file_stats) == 0, "Stat call failed, errno: %d", errno);
+  return file_stats.st_size;
+}
+
+Test(qdisk, group_commit_writes_records_on_commit)
+{
+  const gchar *filename = "test_group_commit.rqf";
+
+  DiskQueueOptions *opts = construct_diskq_options(TDISKQ_RELIABLE, MiB(1));
+  disk_queue_options_set_prealloc(opts, FALSE);
+  disk_queue_options_set_group_commit(opts, TRUE);
+  disk_queue_options_set_sync_records(opts, 2);
+  QDisk *qdisk = qdisk_new(opts, "TEST", filename);
+  qdisk_start(qdisk, NULL, NULL, NULL);
+
+  guint record_len = 128;
+  for (gint i = 0; i < 3; i++)
+    cr_assert(push_dummy_record(qdisk, record_len));
+
+  cr_assert_eq(qdisk_get_length(qdisk), 3);
+  cr_assert_eq(qdisk_get_writer_head(qdisk), QDISK_RESERVED_SPACE + 3 * (FRAME_LENGTH + record_len));
+  cr_assert_eq(_get_real_file_size(filename), QDISK_RESERVED_SPACE, "records should not be written before commit");
+
+  cr_assert(qdisk_commit(qdisk));
+  cr_assert_eq(_get_real_file_size(filename), qdisk_get_writer_head(qdisk));
+
+  GString *popped_data = g_string_new(NULL);
+  for (gint i = 0; i < 3; i++)
+    {
+      cr_assert(reliable_pop_record_without_backlog(qdisk, popped_data));
+      assert_dummy_record(popped_data, record_len);
+    }
+  cr_assert_eq(qdisk_get_length(qdisk), 0);
+
+  g_string_free(popped_data, TRUE);
+  cr_assert(qdisk_stop(qdisk, NULL, NULL, NULL));
+  cleanup_qdisk(filename, qdisk);
+}
+
+Test(qdisk, group_commit_pending_records_are_readable)
+{
+  const gchar *filename = "test_group_commit_pending.rqf";
+
+  DiskQueueOptions *opts = construct_diskq_options(TDISKQ_RELIABLE, MIN_CAPACITY_BYTES);
+  disk_queue_options_set_group_commit(opts, TRUE);
+  QDisk *qdisk = qdisk_new(opts, "TEST", filename);
+  qdisk_start(qdisk, NULL, NULL, NULL);
+
+  guint record_len = 100 * 1024;
+  GString *popped_data = g_string_new(NULL);
+  for (gint i = 0; i < 9; i++)
+    {
+      cr_assert(push_dummy_record(qdisk, record_len));
+      cr_assert(qdisk_pop_head(qdisk, popped_data));
+      cr_assert(qdisk_ack_backlog(qdisk));
+    }
+
+  /* the write head wraps around within the uncommitted group */
+  for (gint i = 0; i < 3; i++)
+    cr_assert(push_dummy_record(qdisk, record_len));
+  cr_assert_eq(qdisk_get_writer_head(qdisk), QDISK_RESERVED_SPACE + FRAME_LENGTH + record_len);
+
+  for (gint i = 0; i < 3; i++)
+    {
+      cr_assert(qdisk_pop_head(qdisk, popped_data));
+      assert_dummy_record(popped_data, record_len);
+      cr_assert(qdisk_ack_backlog(qdisk));
+    }
+  cr_assert_eq(qdisk_get_length(qdisk), 0);
+
+  g_string_free(popped_data, TRUE);
+  cr_assert(qdisk_stop(qdisk, NULL, NULL, NULL));
+  cleanup_qdisk(filename, qdisk);
+}
+
+Test(qdisk, group_commit_failure_rolls_back_the_uncommitted_records)
+{
+  const gchar *filename = "test_group_commit_failure.rqf";
+
+  DiskQueueOptions *opts = construct_diskq_options(TDISKQ_RELIABLE, MiB(1));
+  disk_queue_options_set_prealloc(opts, FALSE);
+  disk_queue_options_set_group_commit(opts, TRUE);
+  QDisk *qdisk = qdisk_new(opts, "TEST", filename);
+  qdisk_start(qdisk, NULL, NULL, NULL);
+
+  guint record_len = 128;
+  for (gint i = 0; i < 2; i++)
+    cr_assert(push_dummy_record(qdisk, record_len));
+  cr_assert(qdisk_commit(qdisk));
+  gint64 committed_write_head = qdisk_get_writer_head(qdisk);
+
+  /* make the next write of the file fail with EFBIG */
+  struct rlimit orig_limit, limit;
+  cr_assert(getrlimit(RLIMIT_FSIZE, &orig_limit) == 0);
+  limit = orig_limit;
+  limit.rlim_cur = committed_write_head;
+  void (*orig_handler)(int) = signal(SIGXFSZ, SIG_IGN);
+  cr_assert(setrlimit(RLIMIT_FSIZE, &limit) == 0);
+
+  for (gint i = 0; i < 2; i++)
+    cr_assert(push_dummy_record(qdisk, record_len));
+
+  /* reading writes out the group, the failure is still reported by the commit */
+  GString *peeked_data = g_string_new(NULL);
+  cr_assert(qdisk_peek_head(qdisk, peeked_data));
+  g_string_free(peeked_data, TRUE);
+  cr_assert_not(qdisk_commit(qdisk));
+
+  cr_assert(setrlimit(RLIMIT_FSIZE, &orig_limit) == 0);
+  signal(SIGXFSZ, orig_handler);
+
+  cr_assert_eq(qdisk_get_length(qdisk), 2, "lost records should not be counted");
+  cr_assert_eq(qdisk_get_writer_head(qdisk), committed_write_head);
+
+  cr_assert(push_dummy_record(qdisk, record_len));
+  cr_assert(qdisk_commit(qdisk));
+  cr_assert_eq(qdisk_get_length(qdisk), 3);
+
+  GString *popped_data = g_string_new(NULL);
+  for (gint i = 0; i < 3; i++)
+    {
+      cr_assert(reliable_pop_record_without_backlog(qdisk, popped_data));
+      assert_dummy_record(popped_data, record_len);
+    }
+  cr_assert_eq(qdisk_get_length(qdisk), 0);
+
+  g_string_free(popped_data, TRUE);
+  cr_assert(qdisk_stop(qdisk, NULL, NULL, NULL));
+  cleanup_qdisk(filename, qdisk);
+}
+
+Test(qdisk, readahead_keeps_backlog_and_rewind_semantics)
+{
+  const gchar *filename = "test_readahead.rqf";
+
+  DiskQueueOptions *opts = construct_diskq_options(TDISKQ_RELIABLE, MiB(1));
+  /* records span chunk boundaries */
+  disk_queue_options_set_readahead_size(opts, 300);
+  QDisk *qdisk = qdisk_new(opts, "TEST", filename);
+  qdisk_start(qdisk, NULL, NULL, NULL);
+
+  guint record_len = 128;
+  GString *popped_data = g_string_new(NULL);
+  for (gint i = 0; i < 10; i++)
+    cr_assert(push_dummy_record(qdisk, record_len));
+
+  for (gint i = 0; i < 5; i++)
+    {
+      cr_assert(qdisk_pop_head(qdisk, popped_data));
+      assert_dummy_record(popped_data, record_len);
+    }
+  cr_assert(qdisk_ack_backlog(qdisk));
+  cr_assert(qdisk_rewind_backlog(qdisk, 4));
+  cr_assert_eq(qdisk_get_length(qdisk), 9);
+
+  /* records written after the read-ahead chunk was filled are seen */
+  cr_assert(push_dummy_record(qdisk, 2 * record_len));
+  for (gint i = 0; i < 9; i++)
+    {
+      cr_assert(qdisk_pop_head(qdisk, popped_data));
+      assert_dummy_record(popped_data, record_len);
+    }
+  cr_assert(qdisk_pop_head(qdisk, popped_data));
+  assert_dummy_record(popped_data, 2 * record_len);
+  cr_assert_not(qdisk_pop_head(qdisk, popped_data));
+
+  g_string_free(popped_data, TRUE);
+  cr_assert(qdisk_stop(qdisk, NULL, NULL, NULL));
+  cleanup_qdisk(filename, qdisk);
+}
+
+static void
+_test_compression(DiskQueueCompression compression)
+{
+  const gchar *filename = "test_compression.rqf";
+
+  if (!diskq_compression_is_supported(compression))
+    {
+      cr_log_warn("compression is not supported by this build: %s", diskq_compression_name(compression));
+      return;
+    }
+
+  DiskQueueOptions *opts = construct_diskq_options(TDISKQ_RELIABLE, MiB(1));
+  opts->compression = compression;
+  QDisk *qdisk = qdisk_new(opts, "TEST", filename);
+  qdisk_start(qdisk, NULL, NULL, NULL);
+
+  guint record_len = 4096;
+  GString *data = g_string_new(NULL);
+  GError *error = NULL;
+
+  cr_assert(qdisk_serialize(data, generate_dummy_payload, GUINT_TO_POINTER(record_len), &error));
+  qdisk_compress_record(qdisk, data);
+  cr_assert_lt(data->len, record_len, "the record is expected to be compressed");
+  cr_assert(qdisk_push_tail(qdisk, data));
+
+  /* records that do not compress well are stored as they are */
+  g_string_truncate(data, 0);
+  cr_assert(qdisk_serialize(data, generate_dummy_payload, GUINT_TO_POINTER(16), &error));
+  qdisk_compress_record(qdisk, data);
+  cr_assert(qdisk_push_tail(qdisk, data));
+
+  cr_assert_eq(qdisk_get_compression(qdisk), compression);
+  cr_assert_gt(qdisk_get_compression_input_bytes(qdisk), qdisk_get_compression_output_bytes(qdisk));
+
+  GString *popped_data = g_string_new(NULL);
+  cr_assert(qdisk_pop_head(qdisk, popped_data));
+  assert_dummy_record(popped_data, record_len);
+  cr_assert(qdisk_pop_head(qdisk, popped_data));
+  assert_dummy_record(popped_data, 16);
+
+  /* acking and rewinding only need the length of compressed records */
+  cr_assert(qdisk_rewind_backlog(qdisk, 2));
+  cr_assert(qdisk_pop_head(qdisk, popped_data));
+  assert_dummy_record(popped_data, record_len);
+  cr_assert(qdisk_ack_backlog(qdisk));
+
+  g_string_free(popped_data, TRUE);
+  g_string_free(data, TRUE);
+  cr_assert(qdisk_stop(qdisk, NULL, NULL, NULL));
+  cleanup_qdisk(filename, qdisk);
+}
+
+Test(qdisk, zlib_compressed_records)
+{
+  _test_compression(DISKQ_COMPRESSION_ZLIB);
+}
+
+Test(qdisk, zstd_compressed_records)
+{
+  _test_compression(DISKQ_COMPRESSION_ZSTD);
+}
+
 static gboolean
 _serialize_len_of_zeroes(SerializeArchive *sa, gpointer user_data)
 {
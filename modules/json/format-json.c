@@ -284,9 +284,11 @@ tf_json_append_double(const gchar *name, gdouble d, json_state_t *state)
 static inline void
 tf_json_append_int(const gchar *name, gint64 i, json_state_t *state)
 {
-  GString *int_buf = scratch_buffers_alloc();
-  format_int64_padded(int_buf, 0, 0, 10, i);
-  tf_json_append_value(name, int_buf->str, int_buf->len, state, FALSE);
+  tf_json_append_key(name, state);
+  g_string_append_c(state->buffer, ':');
+
+  /* digits and '-' never need escaping, format straight into the output */
+  format_int64_padded(state->buffer, 0, 0, 10, i);
 }
 
 
@@ -66,6 +66,7 @@ python_source_flags_new(guint32 flags)
     { "guess-timezone",            flags & LP_GUESS_TIMEZONE },
     { "header",                   ~flags & LP_NO_HEADER },
     { "rfc3164-fallback",         ~flags & LP_NO_RFC3164_FALLBACK },
+    { "zero-copy",                 flags & LP_ZERO_COPY },
   };
 
   for (gint i = 0; i < G_N_ELEMENTS(mappings); i++)
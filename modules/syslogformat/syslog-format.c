@@ -49,8 +49,67 @@ static struct
   gboolean initialized;
   NVHandle is_synced;
   NVHandle cisco_seqid;
+  NVHandle zero_copy_buffer;
 } handles;
 
+#define RAW_MESSAGE_MAX_SLICES 8
+
+/*
+ * In zero-copy mode the raw message is stored once as a hidden value and
+ * the parsed fields are set as slices of it.  As builtin values have to be
+ * NUL terminated, the character following each slice is overwritten in
+ * the stored copy, so we keep track of the slices to avoid overwriting
+ * the contents of another one.  Because of these terminators the stored
+ * copy is not the raw message anymore, it is an internal buffer of the
+ * parser, unrelated to $RAWMSG or ".raw_message".
+ */
+typedef struct _RawMessage
+{
+  const guchar *data;
+  gsize length;
+  gint num_slices;
+  struct
+  {
+    gsize ofs;
+    gsize len;
+  } slices[RAW_MESSAGE_MAX_SLICES];
+} RawMessage;
+
+static gboolean
+_raw_message_add_slice(RawMessage *raw, const guchar *value, gsize value_len)
+{
+  if (!raw || raw->num_slices >= RAW_MESSAGE_MAX_SLICES)
+    return FALSE;
+
+  if (value < raw->data || value + value_len > raw->data + raw->length)
+    return FALSE;
+
+  gsize ofs = value - raw->data;
+  for (gint i = 0; i < raw->num_slices; i++)
+    {
+      gsize other_ofs = raw->slices[i].ofs;
+      gsize other_end = other_ofs + raw->slices[i].len;
+
+      if ((ofs + value_len >= other_ofs && ofs + value_len < other_end) ||
+          (other_end >= ofs && other_end < ofs + value_len))
+        return FALSE;
+    }
+
+  raw->slices[raw->num_slices].ofs = ofs;
+  raw->slices[raw->num_slices].len = value_len;
+  raw->num_slices++;
+  return TRUE;
+}
+
+static void
+_set_field(LogMessage *msg, NVHandle handle, const guchar *value, gsize value_len, RawMessage *raw)
+{
+  if (_raw_message_add_slice(raw, value, value_len))
+    log_msg_set_value_slice(msg, handle, handles.zero_copy_buffer, value - raw->data, value_len);
+  else
+    log_msg_set_value(msg, handle, (const gchar *) value, value_len);
+}
+
 static inline gboolean
 _skip_char(const guchar **data, gint *left)
 {
@@ -162,7 +221,8 @@ _syslog_format_parse_pri(LogMessage *msg, const guchar **data, gint *length, gui
 }
 
 static void
-_syslog_format_parse_column(LogMessage *msg, NVHandle handle, const guchar **data, gint *length, gint max_length)
+_syslog_format_parse_column(LogMessage *msg, NVHandle handle, const guchar **data, gint *length, gint max_length,
+                            RawMessage *raw)
 {
   const guchar *src, *space;
   gint left;
@@ -185,7 +245,7 @@ _syslog_format_parse_column(LogMessage *msg, NVHandle handle, const guchar **dat
       if ((*length - left) > 1 || (*data)[0] != '-')
         {
           gint len = (*length - left) > max_length ? max_length : (*length - left);
-          log_msg_set_value(msg, handle, (gchar *) *data, len);
+          _set_field(msg, handle, *data, len, raw);
         }
     }
   *data = src;
@@ -327,7 +387,8 @@ _syslog_format_parse_version(LogMessage *msg, const guchar **data, gint *length)
 }
 
 static void
-_syslog_format_parse_legacy_program_name(LogMessage *msg, const guchar **data, gint *length, guint flags)
+_syslog_format_parse_legacy_program_name(LogMessage *msg, const guchar **data, gint *length, guint flags,
+                                         RawMessage *raw)
 {
   /* the data pointer will not change */
   const guchar *src, *prog_start;
@@ -340,7 +401,7 @@ _syslog_format_parse_legacy_program_name(LogMessage *msg, const guchar **data, g
     {
       _skip_char(&src, &left);
     }
-  log_msg_set_value(msg, LM_V_PROGRAM, (gchar *) prog_start, src - prog_start);
+  _set_field(msg, LM_V_PROGRAM, prog_start, src - prog_start, raw);
   if (left > 0 && *src == '[')
     {
       const guchar *pid_start = src + 1;
@@ -350,7 +411,7 @@ _syslog_format_parse_legacy_program_name(LogMessage *msg, const guchar **data, g
         }
       if (left)
         {
-          log_msg_set_value(msg, LM_V_PID, (gchar *) pid_start, src - pid_start);
+          _set_field(msg, LM_V_PID, pid_start, src - pid_start, raw);
         }
       if (left > 0 && *src == ']')
         {
@@ -793,7 +854,8 @@ _syslog_format_parse_sd_column(LogMessage *msg, const guchar **data, gint *lengt
 gboolean
 _syslog_format_parse_message_column(LogMessage *msg,
                                     const guchar **data, gint *length,
-                                    const MsgFormatOptions *parse_options)
+                                    const MsgFormatOptions *parse_options,
+                                    RawMessage *raw)
 {
   const guchar *src = (guchar *) *data;
   gint left = *length;
@@ -814,7 +876,7 @@ _syslog_format_parse_message_column(LogMessage *msg,
           src += 3;
           left -= 3;
 
-          log_msg_set_value(msg, LM_V_MESSAGE, (gchar *) src, left);
+          _set_field(msg, LM_V_MESSAGE, src, left, raw);
           return TRUE;
         }
 
@@ -836,13 +898,13 @@ _syslog_format_parse_message_column(LogMessage *msg,
       else if ((parse_options->flags & LP_VALIDATE_UTF8) && g_utf8_validate((gchar *) src, left, NULL))
         msg->flags |= LF_UTF8;
     }
-  log_msg_set_value(msg, LM_V_MESSAGE, (gchar *) src, left);
+  _set_field(msg, LM_V_MESSAGE, src, left, raw);
   return TRUE;
 }
 
 static gboolean
 _syslog_format_parse_legacy_header(LogMessage *msg, const guchar **data, gint *length,
-                                   const MsgFormatOptions *parse_options)
+                                   const MsgFormatOptions *parse_options, RawMessage *raw)
 {
   const guchar *src = *data;
   gint left = *length;
@@ -894,13 +956,13 @@ _syslog_format_parse_legacy_header(LogMessage *msg, const guchar **data, gint *l
             }
 
           /* Try to extract a program name */
-          _syslog_format_parse_legacy_program_name(msg, &src, &left, parse_options->flags);
+          _syslog_format_parse_legacy_program_name(msg, &src, &left, parse_options->flags, raw);
         }
 
       /* If we did manage to find a hostname, store it. */
       if (hostname_start)
         {
-          log_msg_set_value(msg, LM_V_HOST, (gchar *) hostname_start, hostname_len);
+          _set_field(msg, LM_V_HOST, hostname_start, hostname_len, raw);
         }
     }
   else
@@ -918,7 +980,7 @@ _syslog_format_parse_legacy_header(LogMessage *msg, const guchar **data, gint *l
         {
           log_msg_set_tag_by_id(msg, LM_T_SYSLOG_RFC3164_MISSING_HEADER);
           /* Capture the program name */
-          _syslog_format_parse_legacy_program_name(msg, &src, &left, parse_options->flags);
+          _syslog_format_parse_legacy_program_name(msg, &src, &left, parse_options->flags, raw);
         }
     }
   *data = src;
@@ -963,7 +1025,8 @@ _syslog_format_check_framing(LogMessage *msg, const guchar **data, gint *length)
 static void
 _syslog_format_parse_legacy_message(LogMessage *msg,
                                     const guchar **data, gint *length,
-                                    const MsgFormatOptions *parse_options)
+                                    const MsgFormatOptions *parse_options,
+                                    RawMessage *raw)
 {
   const guchar *src = (const guchar *) *data;
   gint left = *length;
@@ -993,7 +1056,7 @@ _syslog_format_parse_legacy_message(LogMessage *msg,
       msg->flags |= LF_UTF8;
     }
 
-  log_msg_set_value(msg, LM_V_MESSAGE, (gchar *) src, left);
+  _set_field(msg, LM_V_MESSAGE, src, left, raw);
 }
 
 /**
@@ -1009,7 +1072,8 @@ _syslog_format_parse_legacy_message(LogMessage *msg,
 static gboolean
 _syslog_format_parse_legacy(const MsgFormatOptions *parse_options,
                             const guchar *data, gint length,
-                            LogMessage *msg, gsize *position)
+                            LogMessage *msg, gsize *position,
+                            RawMessage *raw)
 {
   const guchar *src;
   gint left;
@@ -1024,9 +1088,9 @@ _syslog_format_parse_legacy(const MsgFormatOptions *parse_options,
     }
 
   if ((parse_options->flags & LP_NO_HEADER) == 0)
-    _syslog_format_parse_legacy_header(msg, &src, &left, parse_options);
+    _syslog_format_parse_legacy_header(msg, &src, &left, parse_options, raw);
 
-  _syslog_format_parse_legacy_message(msg, &src, &left, parse_options);
+  _syslog_format_parse_legacy_message(msg, &src, &left, parse_options, raw);
 
   log_msg_set_value_to_string(msg, LM_V_MSGFORMAT, "rfc3164");
   return TRUE;
@@ -1043,7 +1107,8 @@ error:
 static gboolean
 _syslog_format_parse_syslog_proto(const MsgFormatOptions *parse_options, const guchar *data, gint length,
                                   LogMessage *msg,
-                                  gsize *position)
+                                  gsize *position,
+                                  RawMessage *raw)
 {
   /**
    *  SYSLOG-MSG      = HEADER SP STRUCTURED-DATA [SP MSG]
@@ -1069,7 +1134,7 @@ _syslog_format_parse_syslog_proto(const MsgFormatOptions *parse_options, const g
       !_syslog_format_parse_version(msg, &src, &left))
     {
       if ((parse_options->flags & LP_NO_RFC3164_FALLBACK) == 0)
-        return _syslog_format_parse_legacy(parse_options, data, length, msg, position);
+        return _syslog_format_parse_legacy(parse_options, data, length, msg, position, raw);
       return FALSE;
     }
 
@@ -1099,21 +1164,21 @@ _syslog_format_parse_syslog_proto(const MsgFormatOptions *parse_options, const g
     ;
   else if (hostname_start)
     {
-      log_msg_set_value(msg, LM_V_HOST, (gchar *) hostname_start, hostname_len);
+      _set_field(msg, LM_V_HOST, hostname_start, hostname_len, raw);
     }
 
   /* application name 48 ascii*/
-  _syslog_format_parse_column(msg, LM_V_PROGRAM, &src, &left, 48);
+  _syslog_format_parse_column(msg, LM_V_PROGRAM, &src, &left, 48, raw);
   if (!_skip_space(&src, &left))
     goto error;
 
   /* process id 128 ascii */
-  _syslog_format_parse_column(msg, LM_V_PID, &src, &left, 128);
+  _syslog_format_parse_column(msg, LM_V_PID, &src, &left, 128, raw);
   if (!_skip_space(&src, &left))
     goto error;
 
   /* message id 32 ascii */
-  _syslog_format_parse_column(msg, LM_V_MSGID, &src, &left, 32);
+  _syslog_format_parse_column(msg, LM_V_MSGID, &src, &left, 32, raw);
   if (!_skip_space(&src, &left))
     goto error;
 
@@ -1121,7 +1186,7 @@ _syslog_format_parse_syslog_proto(const MsgFormatOptions *parse_options, const g
   if (!_syslog_format_parse_sd_column(msg, &src, &left, parse_options))
     goto error;
 
-  if (!_syslog_format_parse_message_column(msg, &src, &left, parse_options))
+  if (!_syslog_format_parse_message_column(msg, &src, &left, parse_options, raw))
     goto error;
 
   log_msg_set_value_to_string(msg, LM_V_MSGFORMAT, "rfc5424");
@@ -1138,16 +1203,28 @@ syslog_format_handler(const MsgFormatOptions *parse_options,
                       const guchar *data, gsize length,
                       gsize *problem_position)
 {
+  RawMessage raw_message = { .data = data }, *raw = NULL;
   gboolean success;
 
   while (length > 0 && (data[length - 1] == '\n' || data[length - 1] == '\0'))
     length--;
 
+  if (parse_options->flags & LP_ZERO_COPY)
+    {
+      gssize stored_length;
+
+      log_msg_set_value(msg, handles.zero_copy_buffer, (const gchar *) data, length);
+      /* the value might have been truncated to the maximum payload size */
+      log_msg_get_value(msg, handles.zero_copy_buffer, &stored_length);
+      raw_message.length = stored_length;
+      raw = &raw_message;
+    }
+
   msg->initial_parse = TRUE;
   if (parse_options->flags & LP_SYSLOG_PROTOCOL)
-    success = _syslog_format_parse_syslog_proto(parse_options, data, length, msg, problem_position);
+    success = _syslog_format_parse_syslog_proto(parse_options, data, length, msg, problem_position, raw);
   else
-    success = _syslog_format_parse_legacy(parse_options, data, length, msg, problem_position);
+    success = _syslog_format_parse_legacy(parse_options, data, length, msg, problem_position, raw);
   msg->initial_parse = FALSE;
 
   return success;
@@ -1160,6 +1237,7 @@ syslog_format_init(void)
     {
       handles.is_synced = log_msg_get_value_handle(".SDATA.timeQuality.isSynced");
       handles.cisco_seqid = log_msg_get_value_handle(".SDATA.meta.sequenceId");
+      handles.zero_copy_buffer = log_msg_get_value_handle(".syslog.zero_copy_buffer");
       handles.initialized = TRUE;
     }
 
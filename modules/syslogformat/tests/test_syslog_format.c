@@ -376,3 +376,107 @@ Test(syslog_format, test_framing_not_detected_on_input_starting_with_whitespace)
 
   log_msg_unref(msg);
 }
+
+static void
+_assert_zero_copy_fields_are_references(LogMessage *msg)
+{
+  NVHandle builtin_fields[] = { LM_V_HOST, LM_V_PROGRAM, LM_V_PID, LM_V_MESSAGE };
+  NVIndexEntry *index_entry, *index_slot;
+
+  for (gint i = 0; i < G_N_ELEMENTS(builtin_fields); i++)
+    {
+      NVEntry *entry = nv_table_get_entry(msg->payload, builtin_fields[i], &index_entry, &index_slot);
+      cr_assert(entry && entry->indirect, "%s is expected to reference the raw message",
+                log_msg_get_value_name(builtin_fields[i], NULL));
+    }
+}
+
+Test(syslog_format, zero_copy_rfc3164_fields_reference_the_raw_message)
+{
+  const gchar *data = "<189>Feb  3 12:34:56 host program[pid]: message\n";
+  gsize data_length = strlen(data);
+
+  parse_options.flags |= LP_ZERO_COPY;
+  LogMessage *msg = msg_format_construct_message(&parse_options, (const guchar *) data, data_length);
+
+  gsize problem_position;
+  cr_assert(syslog_format_handler(&parse_options, msg, (const guchar *) data, data_length, &problem_position));
+  _assert_zero_copy_fields_are_references(msg);
+
+  /* the fields are NUL terminated, so they can be used without a length */
+  cr_assert_str_eq(log_msg_get_value(msg, LM_V_HOST, NULL), "host");
+  cr_assert_str_eq(log_msg_get_value(msg, LM_V_PROGRAM, NULL), "program");
+  cr_assert_str_eq(log_msg_get_value(msg, LM_V_PID, NULL), "pid");
+  cr_assert_str_eq(log_msg_get_value(msg, LM_V_MESSAGE, NULL), "message");
+  assert_log_message_value_by_name(msg, "LEGACY_MSGHDR", "program[pid]: ");
+  assert_log_message_value_by_name(msg, "MSGFORMAT", "rfc3164");
+
+  /* the referenced buffer is not exposed as the raw message */
+  cr_assert_null(log_msg_get_value_if_set(msg, log_msg_get_value_handle(".raw_message"), NULL));
+
+  /* changing the referenced buffer turns the references into copies */
+  log_msg_set_value_by_name(msg, ".syslog.zero_copy_buffer", "foobar", -1);
+  cr_assert_str_eq(log_msg_get_value(msg, LM_V_HOST, NULL), "host");
+  cr_assert_str_eq(log_msg_get_value(msg, LM_V_MESSAGE, NULL), "message");
+
+  log_msg_unref(msg);
+}
+
+Test(syslog_format, zero_copy_rfc5424_fields_reference_the_raw_message)
+{
+  const gchar *data = "<189>1 2024-02-03T12:34:56Z host program pid msgid [foo bar=\"baz\"] message";
+  gsize data_length = strlen(data);
+
+  parse_options.flags |= LP_SYSLOG_PROTOCOL | LP_ZERO_COPY;
+  LogMessage *msg = msg_format_construct_message(&parse_options, (const guchar *) data, data_length);
+
+  gsize problem_position;
+  cr_assert(syslog_format_handler(&parse_options, msg, (const guchar *) data, data_length, &problem_position));
+  _assert_zero_copy_fields_are_references(msg);
+
+  cr_assert_str_eq(log_msg_get_value(msg, LM_V_HOST, NULL), "host");
+  cr_assert_str_eq(log_msg_get_value(msg, LM_V_PROGRAM, NULL), "program");
+  cr_assert_str_eq(log_msg_get_value(msg, LM_V_PID, NULL), "pid");
+  cr_assert_str_eq(log_msg_get_value(msg, LM_V_MSGID, NULL), "msgid");
+  cr_assert_str_eq(log_msg_get_value(msg, LM_V_MESSAGE, NULL), "message");
+  assert_log_message_value_by_name(msg, ".SDATA.foo.bar", "baz");
+  assert_log_message_value_by_name(msg, "MSGFORMAT", "rfc5424");
+
+  log_msg_unref(msg);
+}
+
+Test(syslog_format, zero_copy_keeps_the_stored_raw_message_intact)
+{
+  const gchar *data = "<189>Feb  3 12:34:56 host program[pid]: message";
+  gsize data_length = strlen(data);
+
+  parse_options.flags |= LP_ZERO_COPY | LP_STORE_RAW_MESSAGE;
+  LogMessage *msg = msg_format_construct_message(&parse_options, (const guchar *) data, data_length);
+  /* as done by msg_format_parse() for store-raw-message */
+  log_msg_set_value(msg, LM_V_RAWMSG, data, data_length);
+
+  gsize problem_position;
+  cr_assert(syslog_format_handler(&parse_options, msg, (const guchar *) data, data_length, &problem_position));
+
+  cr_assert_str_eq(log_msg_get_value(msg, LM_V_HOST, NULL), "host");
+  cr_assert_str_eq(log_msg_get_value(msg, LM_V_RAWMSG, NULL), data);
+
+  log_msg_unref(msg);
+}
+
+Test(syslog_format, zero_copy_is_not_used_for_sanitized_values)
+{
+  const gchar *data = "<189>Feb  3 12:34:56 host program: invalid \xff utf8";
+  gsize data_length = strlen(data);
+
+  parse_options.flags |= LP_ZERO_COPY | LP_SANITIZE_UTF8;
+  LogMessage *msg = msg_format_construct_message(&parse_options, (const guchar *) data, data_length);
+
+  gsize problem_position;
+  cr_assert(syslog_format_handler(&parse_options, msg, (const guchar *) data, data_length, &problem_position));
+  cr_assert_str_eq(log_msg_get_value(msg, LM_V_HOST, NULL), "host");
+  cr_assert_str_eq(log_msg_get_value(msg, LM_V_PROGRAM, NULL), "program");
+  cr_assert_str_eq(log_msg_get_value(msg, LM_V_MESSAGE, NULL), "invalid \\xff utf8");
+
+  log_msg_unref(msg);
+}
@@ -105,11 +105,12 @@ import test_file_source
 import test_filters
 import test_input_drivers
 import test_performance
+import test_io_uring_performance
 import test_sql
 import test_python
 import test_map_value_pairs
 
-tests = (test_input_drivers, test_sql, test_file_source, test_filters, test_performance, test_python, test_map_value_pairs)
+tests = (test_input_drivers, test_sql, test_file_source, test_filters, test_performance, test_io_uring_performance, test_python, test_map_value_pairs)
 failed_tests = []
 
 init_env()
@@ -0,0 +1,104 @@
+#############################################################################
+# Copyright (c) 2024 Balabit
+#
+# This program is free software; you can redistribute it and/or modify it
+# under the terms of the GNU General Public License version 2 as published
+# by the Free Software Foundation, or (at your option) any later version.
+#
+# This program is distributed in the hope that it will be useful,
+# but WITHOUT ANY WARRANTY; without even the implied warranty of
+# MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+# GNU General Public License for more details.
+#
+# You should have received a copy of the GNU General Public License
+# along with this program; if not, write to the Free Software
+# Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+#
+# As an additional exemption you are allowed to compile & link against the
+# OpenSSL libraries as published by the OpenSSL project. See the file
+# COPYING for details.
+#
+#############################################################################
+
+import resource
+import time
+
+from globals import *
+from log import *
+from messagegen import *
+from messagecheck import *
+
+# Compares the io_uring receive path with the epoll one under loggen, the
+# results are printed for each config.  It takes a lot of file descriptors
+# and time, so it only runs if SYSLOG_NG_PERFORMANCE_TESTS is set.
+#
+# loggen starts a thread for each active connection, the rest of the
+# connections are kept open but idle, which is the typical situation for a
+# central log server
+active_connections = 100
+idle_connections = 9900
+connections = active_connections + idle_connections
+
+config_template = """@version: %(syslog_ng_version)s
+
+options { ts_format(iso); chain_hostnames(no); keep_hostname(yes); threaded(yes); };
+
+source s_tcp { tcp(port(%(port_number)d) max-connections(%(connections)d) io-uring(%(io_uring)s)); };
+
+destination d_messages { file("%(output_file)s"); };
+
+log { source(s_tcp); destination(d_messages); };
+
+"""
+
+output_file = "test-io-uring-performance.log"
+
+config = {
+  'epoll': config_template % dict(locals(), io_uring='no'),
+  'io_uring': config_template % dict(locals(), io_uring='yes'),
+}
+
+def count_lines(fname):
+    try:
+        with open(fname, 'rb') as f:
+            return sum(1 for line in f)
+    except IOError:
+        return 0
+
+def wait_for_lines(fname, expected, timeout=60):
+    deadline = time.time() + timeout
+    lines = count_lines(fname)
+    while lines < expected and time.time() < deadline:
+        time.sleep(1)
+        lines = count_lines(fname)
+    return lines
+
+def check_env():
+    if 'SYSLOG_NG_PERFORMANCE_TESTS' not in os.environ:
+        print_user("io_uring performance test skipped, set SYSLOG_NG_PERFORMANCE_TESTS to run it")
+        return False
+
+    # both syslog-ng and loggen need a file descriptor for each connection
+    soft_limit, hard_limit = resource.getrlimit(resource.RLIMIT_NOFILE)
+    if hard_limit != resource.RLIM_INFINITY and hard_limit < connections + 1024:
+        print_user("io_uring performance test skipped, RLIMIT_NOFILE is too low: %d" % hard_limit)
+        return False
+
+    resource.setrlimit(resource.RLIMIT_NOFILE, (hard_limit, hard_limit))
+    return True
+
+def test_io_uring_performance():
+    lines_before = count_lines(output_file)
+
+    print_user("Starting loggen for 10 seconds with %d connections" % connections)
+    out = os.popen("../loggen/loggen --quiet --stream --inet --rate 10000 --size 160 --interval 10 --active-connections %d --idle-connections %d 127.0.0.1 %d 2>&1 |tail -n +1" % (active_connections, idle_connections, port_number), 'r').read()
+
+    print_user("performance: %s" % out)
+    rate = float(re.sub('^.*rate = ([0-9.]+).*$', '\\1', out))
+    sent = int(re.findall('count=([0-9]+)', out)[-1])
+
+    # loggen only measures its own send rate, check that everything arrived
+    delivered = wait_for_lines(output_file, lines_before + sent) - lines_before
+    print_user("delivered %d of %d messages" % (delivered, sent))
+
+    return rate > 100 and delivered == sent